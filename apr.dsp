@@ -196,6 +196,10 @@ SOURCE=.\buckets\apr_buckets_simple.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\buckets\apr_buckets_slab.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\buckets\apr_buckets_socket.c
 # End Source File
 # End Group
@@ -315,6 +319,10 @@ SOURCE=.\file_io\win32\buffer.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\file_io\unix\appender.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file_io\unix\copy.c
 # End Source File
 # Begin Source File
@@ -375,6 +383,10 @@ SOURCE=.\file_io\win32\seek.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\file_io\unix\statcache.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file_io\unix\tempdir.c
 # End Source File
 # End Group
@@ -728,6 +740,10 @@ SOURCE=.\util-misc\apu_dso.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\util-misc\apr_lock_profile.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\util-misc\apr_queue.c
 # End Source File
 # Begin Source File
@@ -740,6 +756,14 @@ SOURCE=.\util-misc\apr_rmm.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\util-misc\apr_shm_hash.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_socket_pool.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\util-misc\apr_thread_pool.c
 # End Source File
 # End Group
@@ -894,6 +918,14 @@ SOURCE=.\include\apr_errno.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_file_aio.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_file_appender.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_file_info.h
 # End Source File
 # Begin Source File
@@ -958,6 +990,10 @@ SOURCE=.\include\apr_random.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_resolver.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_ring.h
 # End Source File
 # Begin Source File
@@ -974,6 +1010,14 @@ SOURCE=.\include\apr_skiplist.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_socket_pool.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_stat_cache.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_strings.h
 # End Source File
 # Begin Source File
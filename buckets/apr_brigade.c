@@ -21,6 +21,7 @@
 #include "apr_tables.h"
 #include "apr_buckets.h"
 #include "apr_errno.h"
+#include "apr_buckets_internal.h"
 #define APR_WANT_MEMFUNC
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
@@ -322,60 +323,279 @@ APR_DECLARE(apr_status_t) apr_brigade_pflatten(apr_bucket_brigade *bb,
     return APR_SUCCESS;
 }
 
-APR_DECLARE(apr_status_t) apr_brigade_split_line(apr_bucket_brigade *bbOut,
-                                                 apr_bucket_brigade *bbIn,
-                                                 apr_read_type_e block,
-                                                 apr_off_t maxbytes)
+/* Match the delimiter against the len bytes at str, the end of the data
+ * of bucket e, and the data of the buckets which follow.
+ */
+static apr_status_t brigade_match(apr_bucket_brigade *bb, apr_bucket *e,
+                                  const char *str, apr_size_t len,
+                                  const char *delim, apr_size_t dlen,
+                                  apr_read_type_e block)
 {
-    apr_off_t readbytes = 0;
-    apr_bucket *prev = NULL;
+    apr_status_t rv;
 
-    while (!APR_BRIGADE_EMPTY(bbIn)) {
-        const char *pos;
-        const char *str;
-        apr_size_t len;
-        apr_status_t rv;
-        apr_bucket *e;
+    for (;;) {
+        apr_size_t n = len < dlen ? len : dlen;
 
-        e = APR_BRIGADE_FIRST(bbIn);
-        if (e == prev) {         /* PR#51062: prevent infinite loop on a corrupt brigade */
-            return APR_EGENERAL; /* FIXME: this should definitely be a "can't happen"!   */
+        if (memcmp(str, delim, n)) {
+            return APR_NOTFOUND;
         }
-        prev = e;
-        rv = apr_bucket_read(e, &str, &len, block);
+        delim += n;
+        dlen -= n;
+        if (!dlen) {
+            return APR_SUCCESS;
+        }
+
+        do {
+            e = APR_BUCKET_NEXT(e);
+            if (e == APR_BRIGADE_SENTINEL(bb)) {
+                return APR_INCOMPLETE;
+            }
+            if (APR_BUCKET_IS_METADATA(e)) {
+                len = 0;
+                continue;
+            }
+            rv = apr_bucket_read(e, &str, &len, block);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        } while (!len);
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_find(apr_bucket_brigade *bb,
+                                           const char *delim,
+                                           apr_size_t dlen,
+                                           apr_read_type_e block,
+                                           apr_off_t maxbytes,
+                                           apr_off_t *offset)
+{
+    apr_off_t pos = 0;
+    apr_bucket *e;
+    apr_status_t rv;
+
+    if (dlen == APR_BUCKETS_STRING) {
+        dlen = strlen(delim);
+    }
+    if (!dlen || maxbytes < 0) {
+        *offset = 0;
+        return APR_EINVAL;
+    }
+
+    for (e = APR_BRIGADE_FIRST(bb);
+         e != APR_BRIGADE_SENTINEL(bb) && pos < maxbytes;
+         e = APR_BUCKET_NEXT(e))
+    {
+        const char *str, *s, *p;
+        apr_size_t len, left;
 
+        if (APR_BUCKET_IS_METADATA(e)) {
+            continue;
+        }
+        rv = apr_bucket_read(e, &str, &len, block);
         if (rv != APR_SUCCESS) {
+            *offset = pos;
             return rv;
         }
 
-        pos = memchr(str, APR_ASCII_LF, len);
-        /* We found a match. */
-        if (pos != NULL) {
-            apr_bucket_split(e, pos - str + 1);
-            APR_BUCKET_REMOVE(e);
-            APR_BRIGADE_INSERT_TAIL(bbOut, e);
-            return APR_SUCCESS;
-        }
-        APR_BUCKET_REMOVE(e);
-        if (APR_BUCKET_IS_METADATA(e) || len > APR_BUCKET_BUFF_SIZE/4) {
-            APR_BRIGADE_INSERT_TAIL(bbOut, e);
+        /* memchr() is vectorized by the C library, let it find the
+         * candidates and compare only there.
+         */
+        left = len;
+        if ((apr_off_t)left > maxbytes - pos) {
+            left = (apr_size_t)(maxbytes - pos);
         }
-        else {
-            if (len > 0) {
-                rv = apr_brigade_write(bbOut, NULL, NULL, str, len);
-                if (rv != APR_SUCCESS) {
-                    return rv;
+        for (s = str;
+             left && (p = memchr(s, delim[0], left)) != NULL;
+             left -= p + 1 - s, s = p + 1)
+        {
+            apr_off_t at = pos + (p - str);
+            apr_size_t avail = len - (p - str);
+
+            if (at + (apr_off_t)dlen > maxbytes) {
+                /* no room left for the delimiter */
+                *offset = at;
+                return APR_INCOMPLETE;
+            }
+            if (dlen <= avail) {
+                if (!memcmp(p, delim, dlen)) {
+                    *offset = at;
+                    return APR_SUCCESS;
                 }
+                continue;
+            }
+
+            /* the delimiter would span the next bucket(s) */
+            rv = brigade_match(bb, e, p, avail, delim, dlen, block);
+            if (rv == APR_SUCCESS) {
+                *offset = at;
+                return APR_SUCCESS;
+            }
+            if (rv != APR_NOTFOUND) {
+                *offset = at;
+                return rv;
+            }
+        }
+        pos += len;
+    }
+
+    *offset = pos < maxbytes ? pos : maxbytes;
+    return APR_INCOMPLETE;
+}
+
+/* Move the first len bytes of bbIn to the end of bbOut */
+static apr_status_t brigade_move(apr_bucket_brigade *bbOut,
+                                 apr_bucket_brigade *bbIn, apr_off_t len)
+{
+    apr_bucket *e, *end, *prev = NULL;
+    apr_status_t rv;
+
+    rv = apr_brigade_partition(bbIn, len, &end);
+    if (rv != APR_SUCCESS && rv != APR_INCOMPLETE) {
+        return rv;
+    }
+    while ((e = APR_BRIGADE_FIRST(bbIn)) != end) {
+        if (e == prev) {         /* PR#51062: prevent infinite loop on a corrupt brigade */
+            return APR_EGENERAL; /* FIXME: this should definitely be a "can't happen"!   */
+        }
+        prev = e;
+        APR_BUCKET_REMOVE(e);
+        APR_BRIGADE_INSERT_TAIL(bbOut, e);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
+                                                     apr_bucket_brigade *bbIn,
+                                                     apr_read_type_e block,
+                                                     const char *boundary,
+                                                     apr_size_t boundary_len,
+                                                     apr_off_t maxbytes)
+{
+    apr_off_t offset;
+    apr_bucket *e, *end;
+    apr_status_t rv, arv;
+
+    if (boundary_len == APR_BUCKETS_STRING) {
+        boundary_len = strlen(boundary);
+    }
+
+    rv = apr_brigade_find(bbIn, boundary, boundary_len, block, maxbytes,
+                          &offset);
+    arv = brigade_move(bbOut, bbIn, offset);
+    if (arv != APR_SUCCESS) {
+        return arv;
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* drop the boundary */
+    arv = apr_brigade_partition(bbIn, boundary_len, &end);
+    if (arv != APR_SUCCESS && arv != APR_INCOMPLETE) {
+        return arv;
+    }
+    while ((e = APR_BRIGADE_FIRST(bbIn)) != end) {
+        apr_bucket_delete(e);
+    }
+    return APR_SUCCESS;
+}
+
+/* The offset of the end of the bucket of bb which holds the byte before
+ * offset, or of the first bucket if offset is 0.
+ */
+static apr_status_t brigade_bucket_end(apr_bucket_brigade *bb,
+                                       apr_off_t offset,
+                                       apr_read_type_e block,
+                                       apr_off_t *end)
+{
+    apr_off_t pos = 0;
+    apr_bucket *e;
+
+    for (e = APR_BRIGADE_FIRST(bb);
+         e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e))
+    {
+        if (e->length == (apr_size_t)(-1)) {
+            const char *str;
+            apr_size_t len;
+            apr_status_t rv;
+
+            rv = apr_bucket_read(e, &str, &len, block);
+            if (rv != APR_SUCCESS) {
+                return rv;
             }
-            apr_bucket_destroy(e);
         }
-        readbytes += len;
-        /* We didn't find an APR_ASCII_LF within the maximum line length. */
-        if (readbytes >= maxbytes) {
+        pos += e->length;
+        if (pos >= offset) {
             break;
         }
     }
+    *end = pos;
+    return APR_SUCCESS;
+}
 
+APR_DECLARE(apr_status_t) apr_brigade_split_line(apr_bucket_brigade *bbOut,
+                                                 apr_bucket_brigade *bbIn,
+                                                 apr_read_type_e block,
+                                                 apr_off_t maxbytes)
+{
+    apr_off_t offset, end, limit = maxbytes > 0 ? maxbytes : 0;
+    apr_bucket *e;
+    apr_status_t rv, arv;
+
+    /* maxbytes counts whole buckets: the bucket it ends in is searched
+     * to its end, and the first bucket always is.
+     */
+    for (;;) {
+        rv = apr_brigade_find(bbIn, "\n", 1, block, limit, &offset);
+        if (rv != APR_INCOMPLETE || offset < limit) {
+            break;
+        }
+        arv = brigade_bucket_end(bbIn, offset, block, &end);
+        if (arv != APR_SUCCESS) {
+            return arv;
+        }
+        if (end <= limit) {
+            break;
+        }
+        limit = end;
+    }
+
+    if (rv == APR_INCOMPLETE && offset < limit) {
+        /* no LF at all, the whole brigade is the line */
+        APR_BRIGADE_CONCAT(bbOut, bbIn);
+        return APR_SUCCESS;
+    }
+    if (rv == APR_SUCCESS) {
+        /* keep the LF with the line */
+        offset++;
+    }
+    arv = brigade_move(bbOut, bbIn, offset);
+    if (arv != APR_SUCCESS) {
+        return arv;
+    }
+
+    if (rv == APR_INCOMPLETE) {
+        /* a partial line, of one metadata or empty bucket at least */
+        if (!offset && !APR_BRIGADE_EMPTY(bbIn)) {
+            e = APR_BRIGADE_FIRST(bbIn);
+            APR_BUCKET_REMOVE(e);
+            APR_BRIGADE_INSERT_TAIL(bbOut, e);
+        }
+        return APR_SUCCESS;
+    }
+    if (rv != APR_SUCCESS) {
+        /* a read error: the buckets before the one which failed */
+        while (!APR_BRIGADE_EMPTY(bbIn)) {
+            e = APR_BRIGADE_FIRST(bbIn);
+            if (!APR_BUCKET_IS_METADATA(e) && e->length != 0) {
+                break;
+            }
+            APR_BUCKET_REMOVE(e);
+            APR_BRIGADE_INSERT_TAIL(bbOut, e);
+        }
+        return rv;
+    }
     return APR_SUCCESS;
 }
 
@@ -412,6 +632,158 @@ APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_brigade_peek_iovec(apr_bucket_brigade *bb,
+                                                 struct iovec *vec,
+                                                 int *nvec, apr_size_t *len,
+                                                 apr_read_type_e block)
+{
+    apr_size_t max = *len, total = 0;
+    int left = *nvec, n = 0;
+    apr_bucket *e;
+    apr_status_t rv = APR_SUCCESS;
+
+    for (e = APR_BRIGADE_FIRST(bb);
+         e != APR_BRIGADE_SENTINEL(bb) && left > 0 && total < max;
+         e = APR_BUCKET_NEXT(e))
+    {
+        const char *data;
+        apr_size_t dlen;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            break;
+        }
+
+        rv = apr_bucket_read(e, &data, &dlen, total ? APR_NONBLOCK_READ
+                                                    : block);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        if (dlen == 0) {
+            continue;
+        }
+        if (dlen > max - total) {
+            dlen = max - total;
+        }
+
+        vec[n].iov_base = (void *)data;
+        vec[n].iov_len = dlen;
+        total += dlen;
+        n++;
+        left--;
+    }
+
+    *nvec = n;
+    *len = total;
+    return total ? APR_SUCCESS : rv;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_consume(apr_bucket_brigade *bb,
+                                              apr_size_t len)
+{
+    apr_status_t rv;
+
+    while (len > 0) {
+        apr_bucket *e = APR_BRIGADE_FIRST(bb);
+
+        if (e == APR_BRIGADE_SENTINEL(bb) || APR_BUCKET_IS_METADATA(e)) {
+            return APR_INCOMPLETE;
+        }
+
+        if (e->length == (apr_size_t)(-1)) {
+            const char *data;
+            apr_size_t dlen;
+
+            rv = apr_bucket_read(e, &data, &dlen, APR_BLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+
+        if (e->length > len) {
+            rv = apr_bucket_split(e, len);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+
+        len -= e->length;
+        apr_bucket_delete(e);
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_splice_to_socket(apr_bucket_brigade *bb,
+                                                       apr_socket_t *sock,
+                                                       apr_size_t *len)
+{
+    apr_size_t max = *len, total = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (!APR_BRIGADE_EMPTY(bb) && total < max) {
+        apr_bucket *e = APR_BRIGADE_FIRST(bb);
+        const char *data;
+        apr_size_t n;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            break;
+        }
+
+#if APR_HAS_SPLICE
+        if (APR_BUCKET_IS_PIPE(e)) {
+            apr_file_t *pipe = e->data;
+
+            n = max - total;
+            rv = apr_socket_splice_send(sock, pipe, &n);
+            total += n;
+            if (rv == APR_EOF) {
+                /* as pipe_bucket_read() does at the end of the pipe */
+                apr_file_close(pipe);
+                apr_bucket_delete(e);
+                rv = APR_SUCCESS;
+                continue;
+            }
+            if (rv != APR_ENOTIMPL) {
+                if (rv != APR_SUCCESS) {
+                    break;
+                }
+                continue;
+            }
+            /* can't splice this one, read it */
+        }
+#endif
+
+        rv = apr_bucket_read(e, &data, &n, APR_BLOCK_READ);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        if (n > max - total) {
+            apr_bucket_split(e, max - total);
+            n = max - total;
+        }
+        if (n) {
+            apr_size_t sent = n;
+
+            rv = apr_socket_send(sock, data, &sent);
+            total += sent;
+            if (sent < n) {
+                if (sent) {
+                    apr_bucket_split(e, sent);
+                    apr_bucket_delete(e);
+                }
+                if (rv != APR_SUCCESS) {
+                    break;
+                }
+                continue;
+            }
+        }
+        apr_bucket_delete(e);
+    }
+
+    *len = total;
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_brigade_vputstrs(apr_bucket_brigade *b, 
                                                apr_brigade_flush flush,
                                                void *ctx,
@@ -452,26 +824,92 @@ APR_DECLARE(apr_status_t) apr_brigade_putc(apr_bucket_brigade *b,
     return apr_brigade_write(b, flush, ctx, &c, 1);
 }
 
-APR_DECLARE(apr_status_t) apr_brigade_write(apr_bucket_brigade *b,
-                                            apr_brigade_flush flush,
-                                            void *ctx, 
-                                            const char *str, apr_size_t nbyte)
+/*
+ * Find where nbyte more bytes may be written at the end of the brigade:
+ * in a heap bucket whose buffer is not shared with another bucket, or
+ * in a slab bucket which ends where its slab is used up.  When the slab
+ * is full but the bucket would still hold less than a buffer's worth,
+ * the bucket moves to a buffer of its own, so that flushing happens at
+ * APR_BUCKET_BUFF_SIZE whatever the slabs are shared with.
+ * On return *buf is NULL if there is no buffer bucket to write to.
+ */
+static apr_status_t brigade_tail_buffer(apr_bucket_brigade *b,
+                                        apr_size_t nbyte,
+                                        apr_bucket_slab **slab,
+                                        char **buf, apr_size_t *remaining)
 {
     apr_bucket *e = APR_BRIGADE_LAST(b);
-    apr_size_t remaining = APR_BUCKET_BUFF_SIZE;
-    char *buf = NULL;
 
-    /*
-     * If the last bucket is a heap bucket and its buffer is not shared with
-     * another bucket, we may write into that bucket.
-     */
-    if (!APR_BRIGADE_EMPTY(b) && APR_BUCKET_IS_HEAP(e)
+    *slab = NULL;
+    *buf = NULL;
+    *remaining = APR_BUCKET_BUFF_SIZE;
+
+    if (APR_BRIGADE_EMPTY(b)) {
+        return APR_SUCCESS;
+    }
+
+    if (APR_BUCKET_IS_HEAP(e)
         && ((apr_bucket_heap *)(e->data))->refcount.refcount == 1) {
         apr_bucket_heap *h = e->data;
 
         /* HEAP bucket start offsets are always in-memory, safe to cast */
-        remaining = h->alloc_len - (e->length + (apr_size_t)e->start);
-        buf = h->base + e->start + e->length;
+        *remaining = h->alloc_len - (e->length + (apr_size_t)e->start);
+        *buf = h->base + e->start + e->length;
+    }
+    else if (APR_BUCKET_IS_SLAB(e)) {
+        apr_bucket_slab *s = e->data;
+        apr_size_t room = 0;
+        char *heap;
+
+        if ((apr_size_t)e->start + e->length == s->used) {
+            room = s->size - s->used;
+        }
+        if (nbyte <= room) {
+            *slab = s;
+            *buf = s->base + s->used;
+            *remaining = room;
+        }
+        else if (e->length + nbyte <= APR_BUCKET_BUFF_SIZE) {
+            apr_size_t len = e->length;
+
+            heap = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, b->bucket_alloc);
+            if (heap == NULL) {
+                return APR_ENOMEM;
+            }
+            memcpy(heap, s->base + e->start, len);
+            e->type->destroy(e->data);
+            apr_bucket_heap_make(e, heap, APR_BUCKET_BUFF_SIZE,
+                                 apr_bucket_free);
+            e->length = len;
+            *buf = heap + len;
+            *remaining = APR_BUCKET_BUFF_SIZE - len;
+        }
+        else {
+            if (room) {
+                *slab = s;
+                *buf = s->base + s->used;
+            }
+            *remaining = room;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_write(apr_bucket_brigade *b,
+                                            apr_brigade_flush flush,
+                                            void *ctx, 
+                                            const char *str, apr_size_t nbyte)
+{
+    apr_bucket *e;
+    apr_bucket_slab *s;
+    apr_size_t remaining;
+    char *buf;
+    apr_status_t rv;
+
+    rv = brigade_tail_buffer(b, nbyte, &s, &buf, &remaining);
+    if (rv != APR_SUCCESS) {
+        return rv;
     }
 
     if (nbyte > remaining) {
@@ -491,22 +929,22 @@ APR_DECLARE(apr_status_t) apr_brigade_write(apr_bucket_brigade *b,
     }
     else if (!buf) {
         /* we don't have a buffer, but the data is small enough
-         * that we don't mind making a new buffer */
-        buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, b->bucket_alloc);
-        e = apr_bucket_heap_create(buf, APR_BUCKET_BUFF_SIZE,
-                                   apr_bucket_free, b->bucket_alloc);
+         * to be copied into the allocator's current slab */
+        e = apr_bucket_slab_create(str, nbyte, b->bucket_alloc);
+        if (e == NULL) {
+            return APR_ENOMEM;
+        }
         APR_BRIGADE_INSERT_TAIL(b, e);
-        e->length = 0;   /* We are writing into the brigade, and
-                          * allocating more memory than we need.  This
-                          * ensures that the bucket thinks it is empty just
-                          * after we create it.  We'll fix the length
-                          * once we put data in it below.
-                          */
+        return APR_SUCCESS;
     }
 
     /* there is a sufficiently big buffer bucket available now */
+    e = APR_BRIGADE_LAST(b);
     memcpy(buf, str, nbyte);
     e->length += nbyte;
+    if (s) {
+        s->used += nbyte;
+    }
 
     return APR_SUCCESS;
 }
@@ -518,9 +956,12 @@ APR_DECLARE(apr_status_t) apr_brigade_writev(apr_bucket_brigade *b,
                                              apr_size_t nvec)
 {
     apr_bucket *e;
+    apr_bucket_slab *s;
+    apr_size_t remaining;
     apr_size_t total_len;
     apr_size_t i;
     char *buf;
+    apr_status_t rv;
 
     /* Compute the total length of the data to be written.
      */
@@ -553,80 +994,68 @@ APR_DECLARE(apr_status_t) apr_brigade_writev(apr_bucket_brigade *b,
         }
     }
 
+    rv = brigade_tail_buffer(b, total_len, &s, &buf, &remaining);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
     i = 0;
+    if (buf) {
+        /* Copy into the buffer bucket at the end of the brigade as
+         * much of the data as fits there.
+         */
+        const char *start_buf = buf;
 
-    /* If there is a heap bucket at the end of the brigade
-     * already, and its refcount is 1, copy into the existing bucket.
-     */
-    e = APR_BRIGADE_LAST(b);
-    if (!APR_BRIGADE_EMPTY(b) && APR_BUCKET_IS_HEAP(e)
-        && ((apr_bucket_heap *)(e->data))->refcount.refcount == 1) {
-        apr_bucket_heap *h = e->data;
-        apr_size_t remaining = h->alloc_len -
-            (e->length + (apr_size_t)e->start);
-        buf = h->base + e->start + e->length;
-
-        if (remaining >= total_len) {
-            /* Simple case: all the data will fit in the
-             * existing heap bucket
-             */
-            for (; i < nvec; i++) {
-                apr_size_t len = vec[i].iov_len;
-                memcpy(buf, (const void *) vec[i].iov_base, len);
-                buf += len;
+        for (; i < nvec; i++) {
+            apr_size_t len = vec[i].iov_len;
+            if (len > remaining) {
+                break;
             }
-            e->length += total_len;
-            return APR_SUCCESS;
+            memcpy(buf, (const void *) vec[i].iov_base, len);
+            buf += len;
+            remaining -= len;
         }
-        else {
-            /* More complicated case: not all of the data
-             * will fit in the existing heap bucket.  The
-             * total data size is <= APR_BUCKET_BUFF_SIZE,
-             * so we'll need only one additional bucket.
-             */
-            const char *start_buf = buf;
-            for (; i < nvec; i++) {
-                apr_size_t len = vec[i].iov_len;
-                if (len > remaining) {
-                    break;
-                }
-                memcpy(buf, (const void *) vec[i].iov_base, len);
-                buf += len;
-                remaining -= len;
-            }
-            e->length += (buf - start_buf);
-            total_len -= (buf - start_buf);
+        e = APR_BRIGADE_LAST(b);
+        e->length += (buf - start_buf);
+        if (s) {
+            s->used += (buf - start_buf);
+        }
+        total_len -= (buf - start_buf);
 
-            if (flush) {
-                apr_status_t rv = flush(b, ctx);
-                if (rv != APR_SUCCESS) {
-                    return rv;
-                }
-            }
+        if (i == nvec) {
+            return APR_SUCCESS;
+        }
+    }
 
-            /* Now fall through into the case below to
-             * allocate another heap bucket and copy the
-             * rest of the array.  (Note that i is not
-             * reset to zero here; it holds the index
-             * of the first vector element to be
-             * written to the new bucket.)
-             */
+    if (total_len > remaining && flush) {
+        /* The buffer bucket is full: flush it, only once since the
+         * rest of the data fits in one new bucket.
+         */
+        rv = flush(b, ctx);
+        if (rv != APR_SUCCESS) {
+            return rv;
         }
     }
 
-    /* Allocate a new heap bucket, and copy the data into it.
-     * The checks above ensure that the amount of data to be
-     * written here is no larger than APR_BUCKET_BUFF_SIZE.
+    /* Copy the rest of the data into a new bucket.  The checks above
+     * ensure that it is no larger than APR_BUCKET_BUFF_SIZE.
      */
-    buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, b->bucket_alloc);
-    e = apr_bucket_heap_create(buf, APR_BUCKET_BUFF_SIZE,
-                               apr_bucket_free, b->bucket_alloc);
+    e = apr_bucket_alloc(sizeof(*e), b->bucket_alloc);
+    if (e == NULL) {
+        return APR_ENOMEM;
+    }
+    APR_BUCKET_INIT(e);
+    e->free = apr_bucket_free;
+    e->list = b->bucket_alloc;
+    if (apr_bucket_slab_reserve(e, total_len, &buf) == NULL) {
+        apr_bucket_free(e);
+        return APR_ENOMEM;
+    }
     for (; i < nvec; i++) {
         apr_size_t len = vec[i].iov_len;
         memcpy(buf, (const void *) vec[i].iov_base, len);
         buf += len;
     }
-    e->length = total_len;
     APR_BRIGADE_INSERT_TAIL(b, e);
 
     return APR_SUCCESS;
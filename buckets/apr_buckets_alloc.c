@@ -19,6 +19,7 @@
 #include "apr_buckets.h"
 #include "apr_allocator.h"
 #include "apr_support.h"
+#include "apr_buckets_internal.h"
 
 #define ALLOC_AMT (8192 - APR_MEMNODE_T_SIZE)
 
@@ -31,6 +32,7 @@ typedef struct node_header_t {
 
 #define SIZEOF_NODE_HEADER_T  APR_ALIGN_DEFAULT(sizeof(node_header_t))
 #define SMALL_NODE_SIZE       (APR_BUCKET_ALLOC_SIZE + SIZEOF_NODE_HEADER_T)
+#define SLAB_CACHE_MAX        4
 
 /** A list of free memory from which new buckets or private bucket
  *  structures can be allocated.
@@ -40,12 +42,32 @@ struct apr_bucket_alloc_t {
     apr_allocator_t *allocator;
     node_header_t *freelist;
     apr_memnode_t *blocks;
+    apr_bucket_slab *slab;
+    apr_bucket_slab *slab_cache;
+    int slab_cached;
 };
 
+static void slab_cleanup(apr_bucket_alloc_t *list)
+{
+    apr_bucket_slab *slab = list->slab;
+
+    /* Buckets still using the current slab will free it */
+    if (slab && apr_bucket_shared_destroy(slab)) {
+        apr_bucket_free(slab);
+    }
+    while ((slab = list->slab_cache) != NULL) {
+        list->slab_cache = slab->next;
+        apr_bucket_free(slab);
+    }
+    list->slab = NULL;
+    list->slab_cached = 0;
+}
+
 static apr_status_t alloc_cleanup(void *data)
 {
     apr_bucket_alloc_t *list = data;
 
+    slab_cleanup(list);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -102,6 +124,9 @@ APR_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(
     list->allocator = allocator;
     list->freelist = NULL;
     list->blocks = block;
+    list->slab = NULL;
+    list->slab_cache = NULL;
+    list->slab_cached = 0;
     block->first_avail += APR_ALIGN_DEFAULT(sizeof(*list));
     APR_VALGRIND_NOACCESS(block->first_avail,
                           block->endp - block->first_avail);
@@ -114,6 +139,7 @@ APR_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
         apr_pool_cleanup_kill(list->pool, list, alloc_cleanup);
     }
 
+    slab_cleanup(list);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -209,3 +235,58 @@ APR_DECLARE_NONSTD(void) apr_bucket_free(void *mem)
         apr_allocator_free(list->allocator, node->memnode);
     }
 }
+
+apr_bucket_slab *apr_bucket_slab_get(apr_bucket_alloc_t *list,
+                                     apr_size_t len)
+{
+    apr_bucket_slab *slab = list->slab;
+
+    if (slab) {
+        /* Start over if no bucket uses the slab anymore */
+        if (slab->refcount.refcount == 1) {
+            slab->used = 0;
+        }
+        if (slab->size - slab->used >= len) {
+            return slab;
+        }
+        list->slab = NULL;
+        if (apr_bucket_shared_destroy(slab)) {
+            apr_bucket_slab_put(slab);
+        }
+    }
+
+    if (list->slab_cache) {
+        slab = list->slab_cache;
+        list->slab_cache = slab->next;
+        list->slab_cached--;
+    }
+    else {
+        char *mem = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, list);
+        if (!mem) {
+            return NULL;
+        }
+        slab = (apr_bucket_slab *)mem;
+        slab->size = APR_BUCKET_SLAB_SIZE;
+        slab->base = mem + (APR_BUCKET_BUFF_SIZE - APR_BUCKET_SLAB_SIZE);
+        slab->list = list;
+    }
+    slab->refcount.refcount = 1;
+    slab->used = 0;
+    slab->next = NULL;
+    list->slab = slab;
+    return slab;
+}
+
+void apr_bucket_slab_put(apr_bucket_slab *slab)
+{
+    apr_bucket_alloc_t *list = slab->list;
+
+    if (list->slab_cached < SLAB_CACHE_MAX) {
+        slab->next = list->slab_cache;
+        list->slab_cache = slab;
+        list->slab_cached++;
+    }
+    else {
+        apr_bucket_free(slab);
+    }
+}
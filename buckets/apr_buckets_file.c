@@ -114,13 +114,19 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
     *str = NULL;  /* in case we die prematurely */
     buf = apr_bucket_alloc(*len, e->list);
 
-    /* Handle offset ... */
-    rv = apr_file_seek(f, APR_SET, &fileoffset);
-    if (rv != APR_SUCCESS) {
-        apr_bucket_free(buf);
-        return rv;
+    /* Read at the offset, seeking to it where that is not possible */
+    rv = apr_file_read_at(f, buf, len, fileoffset);
+    if (rv == APR_ENOTIMPL || rv == APR_ESPIPE) {
+        *len = (filelength > APR_BUCKET_BUFF_SIZE)
+                   ? APR_BUCKET_BUFF_SIZE
+                   : filelength;
+        rv = apr_file_seek(f, APR_SET, &fileoffset);
+        if (rv != APR_SUCCESS) {
+            apr_bucket_free(buf);
+            return rv;
+        }
+        rv = apr_file_read(f, buf, len);
     }
-    rv = apr_file_read(f, buf, len);
     if (rv != APR_SUCCESS && rv != APR_EOF) {
         apr_bucket_free(buf);
         return rv;
@@ -15,11 +15,14 @@
  */
 
 #include "apr_buckets.h"
+#include "apr_buckets_internal.h"
 
 static apr_status_t pipe_bucket_read(apr_bucket *a, const char **str,
                                      apr_size_t *len, apr_read_type_e block)
 {
     apr_file_t *p = a->data;
+    apr_off_t state = a->start;
+    apr_size_t size = apr_bucket_read_size(state);
     char *buf;
     apr_status_t rv;
     apr_interval_time_t timeout;
@@ -30,7 +33,7 @@ static apr_status_t pipe_bucket_read(apr_bucket *a, const char **str,
     }
 
     *str = NULL;
-    *len = APR_BUCKET_BUFF_SIZE;
+    *len = size;
     buf = apr_bucket_alloc(*len, a->list); /* XXX: check for failure? */
 
     rv = apr_file_read(p, buf, len);
@@ -57,12 +60,15 @@ static apr_status_t pipe_bucket_read(apr_bucket *a, const char **str,
      */
     if (*len > 0) {
         apr_bucket_heap *h;
+        apr_bucket *b;
         /* Change the current bucket to refer to what we read */
         a = apr_bucket_heap_make(a, buf, *len, apr_bucket_free);
         h = a->data;
-        h->alloc_len = APR_BUCKET_BUFF_SIZE; /* note the real buffer size */
+        h->alloc_len = size; /* note the real buffer size */
         *str = buf;
-        APR_BUCKET_INSERT_AFTER(a, apr_bucket_pipe_create(p, a->list));
+        b = apr_bucket_pipe_create(p, a->list);
+        b->start = apr_bucket_read_next(state, *len);
+        APR_BUCKET_INSERT_AFTER(a, b);
     }
     else {
         apr_bucket_free(buf);
@@ -109,6 +115,17 @@ APR_DECLARE(apr_bucket *) apr_bucket_pipe_create(apr_file_t *p,
     return apr_bucket_pipe_make(b, p);
 }
 
+APR_DECLARE(apr_bucket *) apr_bucket_pipe_create_ex(apr_file_t *p,
+                                                    apr_size_t min_read,
+                                                    apr_size_t max_read,
+                                                    apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_pipe_create(p, list);
+
+    b->start = apr_bucket_read_init(min_read, max_read);
+    return b;
+}
+
 APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_pipe = {
     "PIPE", 5, APR_BUCKET_DATA, 
     apr_bucket_destroy_noop,
@@ -0,0 +1,111 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_buckets.h"
+#include "apr_buckets_internal.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+static apr_status_t slab_bucket_read(apr_bucket *b, const char **str,
+                                     apr_size_t *len, apr_read_type_e block)
+{
+    apr_bucket_slab *s = b->data;
+
+    *str = s->base + b->start;
+    *len = b->length;
+    return APR_SUCCESS;
+}
+
+static void slab_bucket_destroy(void *data)
+{
+    apr_bucket_slab *s = data;
+
+    if (apr_bucket_shared_destroy(s)) {
+        apr_bucket_slab_put(s);
+    }
+}
+
+apr_bucket *apr_bucket_slab_reserve(apr_bucket *b, apr_size_t length,
+                                    char **buf)
+{
+    apr_bucket_slab *s;
+
+    if (length > APR_BUCKET_SLAB_SIZE) {
+        char *mem = apr_bucket_alloc(length, b->list);
+        if (mem == NULL) {
+            return NULL;
+        }
+        *buf = mem;
+        return apr_bucket_heap_make(b, mem, length, apr_bucket_free);
+    }
+
+    s = apr_bucket_slab_get(b->list, length);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    /* Not apr_bucket_shared_make(), the slab may be in use already */
+    s->refcount.refcount++;
+    b->data = s;
+    b->start = s->used;
+    b->length = length;
+    b->type = &apr_bucket_type_slab;
+    *buf = s->base + s->used;
+    s->used += length;
+
+    return b;
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_slab_make(apr_bucket *b, const char *buf,
+                                               apr_size_t length)
+{
+    char *mem;
+
+    if (apr_bucket_slab_reserve(b, length, &mem) == NULL) {
+        return NULL;
+    }
+    memcpy(mem, buf, length);
+
+    return b;
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_slab_create(const char *buf,
+                                                 apr_size_t length,
+                                                 apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_alloc(sizeof(*b), list);
+
+    if (b == NULL) {
+        return NULL;
+    }
+    APR_BUCKET_INIT(b);
+    b->free = apr_bucket_free;
+    b->list = list;
+    if (apr_bucket_slab_make(b, buf, length) == NULL) {
+        apr_bucket_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_slab = {
+    "SLAB", 5, APR_BUCKET_DATA,
+    slab_bucket_destroy,
+    slab_bucket_read,
+    apr_bucket_setaside_noop,
+    apr_bucket_shared_split,
+    apr_bucket_shared_copy
+};
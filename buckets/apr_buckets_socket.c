@@ -15,11 +15,71 @@
  */
 
 #include "apr_buckets.h"
+#include "apr_buckets_internal.h"
+
+/* The bits of each shift in the read state, see apr_buckets_internal.h */
+#define READ_SHIFT_BITS 5
+#define READ_SHIFT_MASK ((1 << READ_SHIFT_BITS) - 1)
+
+/* The largest read is min_read << READ_SHIFT_MAX */
+#define READ_SHIFT_MAX 24
+
+/* The largest min_read */
+#define READ_MIN_MAX ((apr_size_t)1 << 20)
+
+apr_off_t apr_bucket_read_init(apr_size_t min_read, apr_size_t max_read)
+{
+    apr_off_t max = 0;
+
+    if (!min_read) {
+        min_read = APR_BUCKET_BUFF_SIZE;
+    }
+    else if (min_read > READ_MIN_MAX) {
+        min_read = READ_MIN_MAX;
+    }
+    while (max < READ_SHIFT_MAX && min_read <= (max_read >> (max + 1))) {
+        max++;
+    }
+    return ((apr_off_t)min_read << (2 * READ_SHIFT_BITS))
+           | (max << READ_SHIFT_BITS);
+}
+
+apr_size_t apr_bucket_read_size(apr_off_t state)
+{
+    if (state < 0) {
+        return APR_BUCKET_BUFF_SIZE;
+    }
+    return (apr_size_t)(state >> (2 * READ_SHIFT_BITS))
+           << (state & READ_SHIFT_MASK);
+}
+
+apr_off_t apr_bucket_read_next(apr_off_t state, apr_size_t got)
+{
+    apr_size_t size = apr_bucket_read_size(state);
+    apr_off_t cur, max;
+
+    if (state < 0) {
+        /* fixed size reads */
+        return state;
+    }
+    cur = state & READ_SHIFT_MASK;
+    max = (state >> READ_SHIFT_BITS) & READ_SHIFT_MASK;
+
+    if (got == size && cur < max) {
+        return state + 1;
+    }
+    if (got < size / 2 && cur > 0) {
+        return state - 1;
+    }
+    return state;
+}
 
 static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
                                        apr_size_t *len, apr_read_type_e block)
 {
     apr_socket_t *p = a->data;
+    apr_off_t state = a->start;
+    apr_size_t size = apr_bucket_read_size(state);
     char *buf;
     apr_status_t rv;
     apr_interval_time_t timeout;
@@ -30,7 +90,7 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
     }
 
     *str = NULL;
-    *len = APR_BUCKET_BUFF_SIZE;
+    *len = size;
     buf = apr_bucket_alloc(*len, a->list); /* XXX: check for failure? */
 
     rv = apr_socket_recv(p, buf, len);
@@ -60,12 +120,15 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
      */
     if (*len > 0) {
         apr_bucket_heap *h;
+        apr_bucket *b;
         /* Change the current bucket to refer to what we read */
         a = apr_bucket_heap_make(a, buf, *len, apr_bucket_free);
         h = a->data;
-        h->alloc_len = APR_BUCKET_BUFF_SIZE; /* note the real buffer size */
+        h->alloc_len = size; /* note the real buffer size */
         *str = buf;
-        APR_BUCKET_INSERT_AFTER(a, apr_bucket_socket_create(p, a->list));
+        b = apr_bucket_socket_create(p, a->list);
+        b->start = apr_bucket_read_next(state, *len);
+        APR_BUCKET_INSERT_AFTER(a, b);
     }
     else {
         apr_bucket_free(buf);
@@ -104,6 +167,17 @@ APR_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *p,
     return apr_bucket_socket_make(b, p);
 }
 
+APR_DECLARE(apr_bucket *) apr_bucket_socket_create_ex(apr_socket_t *p,
+                                                      apr_size_t min_read,
+                                                      apr_size_t max_read,
+                                                      apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_socket_create(p, list);
+
+    b->start = apr_bucket_read_init(min_read, max_read);
+    return b;
+}
+
 APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket = {
     "SOCKET", 5, APR_BUCKET_DATA,
     apr_bucket_destroy_noop,
@@ -32,6 +32,7 @@
 #include "apr_hooks.h"
 #include "apr_inherit.h"
 #include "apr_lib.h"
+#include "apr_lock_profile.h"
 #include "apr_md4.h"
 #include "apr_md5.h"
 #include "apr_memcache.h"
@@ -51,7 +52,9 @@
 #include "apr_sdbm.h"
 #include "apr_sha1.h"
 #include "apr_shm.h"
+#include "apr_shm_hash.h"
 #include "apr_signal.h"
+#include "apr_socket_pool.h"
 #include "apr_strings.h"
 #include "apr_strmatch.h"
 #include "apr_support.h"
@@ -0,0 +1,656 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_file_io.h"
+#include "apr_file_aio.h"
+#include "apr_portable.h"
+#include "apr_time.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_pool.h"
+
+#if APR_HAS_FILE_AIO
+
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/* The most threads run operations at once */
+#define AIO_MAX_THREADS 8
+
+struct apr_file_aio_t {
+    apr_pool_t *pool;
+    const char *method;
+    apr_uint32_t depth;
+    apr_uint32_t inflight;
+    /* Signalled on completions: an eventfd, or a pipe */
+    int notify_rfd;
+    int notify_wfd;
+    apr_file_t *notify;
+    /* Operations completed by threads or synchronously */
+    apr_file_aio_op_t *done;
+    apr_file_aio_op_t *done_tail;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+    apr_thread_pool_t *threads;
+#endif
+#ifdef HAVE_IO_URING
+    int ring_fd;
+    apr_uint32_t unsubmitted;
+    apr_uint32_t uring_inflight;
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+static void aio_signal(apr_file_aio_t *aio)
+{
+#ifdef HAVE_EVENTFD
+    apr_uint64_t one = 1;
+#else
+    char one = 1;
+#endif
+
+    /* A full pipe or counter is signalled already */
+    while (write(aio->notify_wfd, &one, sizeof(one)) == -1
+           && errno == EINTR)
+        ;
+}
+
+static void aio_drain(apr_file_aio_t *aio)
+{
+    char buf[64];
+    apr_ssize_t n;
+
+    do {
+        n = read(aio->notify_rfd, buf, sizeof(buf));
+    } while (n > 0 || (n == -1 && errno == EINTR));
+}
+
+/* Run an operation synchronously */
+static void aio_run(apr_file_aio_op_t *op)
+{
+    switch (op->type) {
+    case APR_FILE_AIO_READ:
+        op->status = apr_file_read_at(op->file, op->buf, &op->nbytes,
+                                      op->offset);
+        break;
+    case APR_FILE_AIO_WRITE:
+        op->status = apr_file_write_at(op->file, op->buf, &op->nbytes,
+                                       op->offset);
+        break;
+    case APR_FILE_AIO_FSYNC:
+        op->status = apr_file_sync(op->file);
+        break;
+    case APR_FILE_AIO_OPEN:
+        op->status = apr_file_open(&op->file, op->fname, op->flags,
+                                   op->perm, op->pool);
+        break;
+    case APR_FILE_AIO_STAT:
+        op->status = apr_stat(op->finfo, op->fname, op->flags, op->pool);
+        break;
+    }
+}
+
+static void aio_complete(apr_file_aio_t *aio, apr_file_aio_op_t *op)
+{
+    op->next = NULL;
+#if APR_HAS_THREADS
+    if (aio->lock) {
+        apr_thread_mutex_lock(aio->lock);
+    }
+#endif
+    if (aio->done_tail) {
+        aio->done_tail->next = op;
+    }
+    else {
+        aio->done = op;
+    }
+    aio->done_tail = op;
+#if APR_HAS_THREADS
+    if (aio->lock) {
+        apr_thread_mutex_unlock(aio->lock);
+    }
+#endif
+    aio_signal(aio);
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC aio_task(apr_thread_t *thd, void *data)
+{
+    apr_file_aio_op_t *op = data;
+    void *aio;
+
+    aio_run(op);
+    apr_thread_pool_task_owner_get(thd, &aio);
+    aio_complete(aio, op);
+    return NULL;
+}
+
+static apr_status_t aio_threads_init(apr_file_aio_t *aio)
+{
+    apr_size_t max = aio->depth < AIO_MAX_THREADS ? aio->depth
+                                                  : AIO_MAX_THREADS;
+    apr_status_t rv;
+
+    rv = apr_thread_mutex_create(&aio->lock, APR_THREAD_MUTEX_DEFAULT,
+                                 aio->pool);
+    if (rv == APR_SUCCESS) {
+        rv = apr_thread_pool_create(&aio->threads, 0, max, aio->pool);
+    }
+    if (rv == APR_SUCCESS) {
+        apr_thread_pool_idle_max_set(aio->threads, max);
+    }
+    return rv;
+}
+#endif
+
+#ifdef HAVE_IO_URING
+
+#define ring_load_acquire(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ring_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static apr_status_t uring_setup(apr_file_aio_t *aio)
+{
+    struct io_uring_params params;
+    char *sq, *cq;
+    int fd;
+
+    memset(&params, 0, sizeof(params));
+    fd = (int)syscall(__NR_io_uring_setup, aio->depth, &params);
+    if (fd < 0) {
+        return errno;
+    }
+    aio->ring_fd = fd;
+
+    /* IORING_OP_READ and IORING_OP_WRITE came with this feature */
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        return APR_ENOTIMPL;
+    }
+
+    aio->sq_ring_len = params.sq_off.array
+                       + params.sq_entries * sizeof(unsigned);
+    aio->cq_ring_len = params.cq_off.cqes
+                       + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (aio->cq_ring_len > aio->sq_ring_len) {
+            aio->sq_ring_len = aio->cq_ring_len;
+        }
+        aio->cq_ring_len = 0;
+    }
+    aio->sq_ring = mmap(NULL, aio->sq_ring_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (aio->sq_ring == MAP_FAILED) {
+        aio->sq_ring = NULL;
+        return errno;
+    }
+    if (aio->cq_ring_len) {
+        aio->cq_ring = mmap(NULL, aio->cq_ring_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_CQ_RING);
+        if (aio->cq_ring == MAP_FAILED) {
+            aio->cq_ring = NULL;
+            return errno;
+        }
+    }
+    aio->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    aio->sqes = mmap(NULL, aio->sqes_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (aio->sqes == MAP_FAILED) {
+        aio->sqes = NULL;
+        return errno;
+    }
+
+    sq = aio->sq_ring;
+    cq = aio->cq_ring ? aio->cq_ring : aio->sq_ring;
+    aio->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    aio->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    aio->sq_array = (unsigned *)(sq + params.sq_off.array);
+    aio->cq_head = (unsigned *)(cq + params.cq_off.head);
+    aio->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    aio->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    aio->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    /* Completions signal the same descriptor as the threads do */
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD,
+                &aio->notify_wfd, 1) < 0) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+
+/* Hand the queued entries to the kernel; those it does not take now are
+ * retried by the next submit or poll.
+ */
+static void uring_flush(apr_file_aio_t *aio)
+{
+    int rc;
+
+    while (aio->unsubmitted) {
+        rc = uring_enter(aio->ring_fd, aio->unsubmitted, 0, 0);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        aio->unsubmitted -= rc;
+        if (rc == 0) {
+            break;
+        }
+    }
+}
+
+static void uring_submit(apr_file_aio_t *aio, apr_file_aio_op_t *op)
+{
+    unsigned tail = *aio->sq_tail, index = tail & *aio->sq_mask;
+    struct io_uring_sqe *sqe = &aio->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (op->type == APR_FILE_AIO_FSYNC) {
+        sqe->opcode = IORING_OP_FSYNC;
+    }
+    else {
+        sqe->opcode = (op->type == APR_FILE_AIO_READ) ? IORING_OP_READ
+                                                       : IORING_OP_WRITE;
+        sqe->addr = (apr_uint64_t)(apr_uintptr_t)op->buf;
+        /* Larger transfers are done partially */
+        sqe->len = op->nbytes > APR_UINT32_MAX ? APR_UINT32_MAX
+                                               : (apr_uint32_t)op->nbytes;
+        sqe->off = op->offset;
+    }
+    sqe->fd = op->file->filedes;
+    sqe->user_data = (apr_uint64_t)(apr_uintptr_t)op;
+
+    aio->sq_array[index] = index;
+    ring_store_release(aio->sq_tail, tail + 1);
+    aio->unsubmitted++;
+    aio->uring_inflight++;
+    uring_flush(aio);
+}
+
+static apr_int32_t uring_reap(apr_file_aio_t *aio, apr_file_aio_op_t **ops,
+                              apr_int32_t num)
+{
+    unsigned head = *aio->cq_head, tail = ring_load_acquire(aio->cq_tail);
+    apr_int32_t n = 0;
+
+    while (head != tail && n < num) {
+        struct io_uring_cqe *cqe = &aio->cqes[head & *aio->cq_mask];
+        apr_file_aio_op_t *op = (apr_file_aio_op_t *)(apr_uintptr_t)
+                                cqe->user_data;
+
+        if (cqe->res < 0) {
+            op->status = -cqe->res;
+            if (op->type != APR_FILE_AIO_FSYNC) {
+                op->nbytes = 0;
+            }
+        }
+        else if (op->type == APR_FILE_AIO_FSYNC) {
+            op->status = APR_SUCCESS;
+        }
+        else {
+            op->status = (cqe->res == 0 && op->nbytes
+                          && op->type == APR_FILE_AIO_READ)
+                         ? APR_EOF : APR_SUCCESS;
+            op->nbytes = cqe->res;
+        }
+        ops[n++] = op;
+        head++;
+    }
+    ring_store_release(aio->cq_head, head);
+    aio->uring_inflight -= n;
+    return n;
+}
+
+static int uring_pending(apr_file_aio_t *aio)
+{
+    return *aio->cq_head != ring_load_acquire(aio->cq_tail);
+}
+
+#endif /* HAVE_IO_URING */
+
+static apr_status_t aio_cleanup(void *data)
+{
+    apr_file_aio_t *aio = data;
+
+#ifdef HAVE_IO_URING
+    if (aio->ring_fd >= 0) {
+        /* The kernel may still use the buffers of operations in flight */
+        if (aio->sqes) {
+            uring_flush(aio);
+        }
+        while (aio->sqes && aio->uring_inflight > aio->unsubmitted) {
+            apr_file_aio_op_t *ops[16];
+
+            if (!uring_reap(aio, ops, 16)
+                && uring_enter(aio->ring_fd, 0, 1,
+                               IORING_ENTER_GETEVENTS) < 0
+                && errno != EINTR) {
+                break;
+            }
+        }
+        if (aio->sqes) {
+            munmap(aio->sqes, aio->sqes_len);
+        }
+        if (aio->cq_ring) {
+            munmap(aio->cq_ring, aio->cq_ring_len);
+        }
+        if (aio->sq_ring) {
+            munmap(aio->sq_ring, aio->sq_ring_len);
+        }
+        close(aio->ring_fd);
+    }
+#endif
+    if (aio->notify_wfd != aio->notify_rfd) {
+        close(aio->notify_wfd);
+    }
+    close(aio->notify_rfd);
+    return APR_SUCCESS;
+}
+
+static apr_status_t aio_notify_create(apr_file_aio_t *aio)
+{
+#ifdef HAVE_EVENTFD
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (fd < 0) {
+        return errno;
+    }
+    aio->notify_rfd = aio->notify_wfd = fd;
+#else
+    int fds[2], i;
+
+    if (pipe(fds) < 0) {
+        return errno;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    }
+    aio->notify_rfd = fds[0];
+    aio->notify_wfd = fds[1];
+#endif
+    return apr_os_file_put(&aio->notify, &aio->notify_rfd, APR_FOPEN_READ,
+                           aio->pool);
+}
+
+APR_DECLARE(apr_status_t) apr_file_aio_create(apr_file_aio_t **paio,
+                                              apr_uint32_t depth,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p)
+{
+    apr_file_aio_t *aio;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    if (depth == 0) {
+        return APR_EINVAL;
+    }
+
+    rv = apr_pool_create(&pool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    aio = apr_pcalloc(pool, sizeof(*aio));
+    aio->pool = pool;
+    aio->depth = depth;
+#ifdef HAVE_IO_URING
+    aio->ring_fd = -1;
+#endif
+
+    rv = aio_notify_create(aio);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return rv;
+    }
+    apr_pool_cleanup_register(pool, aio, aio_cleanup, apr_pool_cleanup_null);
+
+#ifdef HAVE_IO_URING
+    if (!(flags & APR_FILE_AIO_NOURING)) {
+        if (uring_setup(aio) == APR_SUCCESS) {
+            aio->method = "io_uring";
+        }
+        else {
+            /* Fall back to threads */
+            if (aio->sqes) {
+                munmap(aio->sqes, aio->sqes_len);
+                aio->sqes = NULL;
+            }
+            if (aio->cq_ring) {
+                munmap(aio->cq_ring, aio->cq_ring_len);
+                aio->cq_ring = NULL;
+            }
+            if (aio->sq_ring) {
+                munmap(aio->sq_ring, aio->sq_ring_len);
+                aio->sq_ring = NULL;
+            }
+            if (aio->ring_fd >= 0) {
+                close(aio->ring_fd);
+                aio->ring_fd = -1;
+            }
+        }
+    }
+#endif
+
+    if (!aio->method) {
+#if APR_HAS_THREADS
+        rv = aio_threads_init(aio);
+        if (rv != APR_SUCCESS) {
+            apr_pool_destroy(pool);
+            return rv;
+        }
+        aio->method = "threads";
+#else
+        aio->method = "sync";
+#endif
+    }
+
+    *paio = aio;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_aio_destroy(apr_file_aio_t *aio)
+{
+    apr_pool_destroy(aio->pool);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_aio_submit(apr_file_aio_t *aio,
+                                              apr_file_aio_op_t *op)
+{
+    apr_status_t rv;
+
+    if (aio->inflight >= aio->depth) {
+        return APR_EAGAIN;
+    }
+
+    switch (op->type) {
+    case APR_FILE_AIO_READ:
+    case APR_FILE_AIO_WRITE:
+    case APR_FILE_AIO_FSYNC:
+        if (op->file->buffered) {
+            rv = apr_file_flush(op->file);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+#ifdef HAVE_IO_URING
+        if (aio->sqes) {
+            aio->inflight++;
+            uring_submit(aio, op);
+            return APR_SUCCESS;
+        }
+#endif
+        break;
+    case APR_FILE_AIO_OPEN:
+    case APR_FILE_AIO_STAT:
+        /* These need the pool and the apr_finfo_t of the APR functions,
+         * so they always run on a thread.
+         */
+#if APR_HAS_THREADS
+        if (!aio->threads) {
+            rv = aio_threads_init(aio);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+#endif
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    aio->inflight++;
+#if APR_HAS_THREADS
+    if (aio->threads) {
+        rv = apr_thread_pool_push(aio->threads, aio_task, op,
+                                  APR_THREAD_TASK_PRIORITY_NORMAL, aio);
+        if (rv != APR_SUCCESS) {
+            aio->inflight--;
+        }
+        return rv;
+    }
+#endif
+    aio_run(op);
+    aio_complete(aio, op);
+    return APR_SUCCESS;
+}
+
+static apr_int32_t aio_reap(apr_file_aio_t *aio, apr_file_aio_op_t **ops,
+                            apr_int32_t num)
+{
+    apr_int32_t n = 0;
+    int more;
+
+#if APR_HAS_THREADS
+    if (aio->lock) {
+        apr_thread_mutex_lock(aio->lock);
+    }
+#endif
+    while (aio->done && n < num) {
+        ops[n++] = aio->done;
+        aio->done = aio->done->next;
+    }
+    if (!aio->done) {
+        aio->done_tail = NULL;
+    }
+    more = aio->done != NULL;
+#if APR_HAS_THREADS
+    if (aio->lock) {
+        apr_thread_mutex_unlock(aio->lock);
+    }
+#endif
+
+#ifdef HAVE_IO_URING
+    if (aio->sqes) {
+        uring_flush(aio);
+        n += uring_reap(aio, ops + n, num - n);
+        more = more || uring_pending(aio);
+    }
+#endif
+
+    /* Keep the pollfd readable for what did not fit */
+    if (more) {
+        aio_signal(aio);
+    }
+    aio->inflight -= n;
+    return n;
+}
+
+APR_DECLARE(apr_status_t) apr_file_aio_poll(apr_file_aio_t *aio,
+                                            apr_interval_time_t timeout,
+                                            apr_file_aio_op_t **ops,
+                                            apr_int32_t *num)
+{
+    apr_time_t deadline = 0;
+    apr_int32_t n;
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    for (;;) {
+        struct pollfd pfd;
+        int rc;
+
+        /* Drain first, so that no later signal gets lost */
+        aio_drain(aio);
+        n = aio_reap(aio, ops, *num);
+        if (n || timeout == 0) {
+            break;
+        }
+
+        if (timeout > 0) {
+            timeout = deadline - apr_time_now();
+            if (timeout <= 0) {
+                break;
+            }
+        }
+        pfd.fd = aio->notify_rfd;
+        pfd.events = POLLIN;
+        rc = poll(&pfd, 1, timeout < 0 ? -1
+                                       : (int)((timeout + 999) / 1000));
+        if (rc < 0 && errno != EINTR) {
+            *num = 0;
+            return errno;
+        }
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : APR_TIMEUP;
+}
+
+APR_DECLARE(void) apr_file_aio_pollfd_get(apr_file_aio_t *aio,
+                                          apr_pollfd_t *pfd)
+{
+    pfd->p = aio->pool;
+    pfd->desc_type = APR_POLL_FILE;
+    pfd->reqevents = APR_POLLIN;
+    pfd->rtnevents = 0;
+    pfd->desc.f = aio->notify;
+}
+
+APR_DECLARE(const char *) apr_file_aio_method_name(apr_file_aio_t *aio)
+{
+    return aio->method;
+}
+
+#endif /* APR_HAS_FILE_AIO */
@@ -0,0 +1,323 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_file_appender.h"
+#include "apr_thread_proc.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APR_HAS_THREADS
+
+#define APPENDER_DEFAULT_BUFSIZE (64 * 1024)
+
+/* One of the two batches: the records accepted since the last swap, as
+ * an iovec over the buffer and over the caller memory of large records.
+ */
+typedef struct appender_batch_t {
+    char *buf;
+    apr_size_t used;
+    struct iovec *vec;
+    apr_size_t nvec;
+    /* whether vec[nvec - 1] points into buf and may be extended */
+    int in_buf;
+} appender_batch_t;
+
+struct apr_file_appender_t {
+    apr_pool_t *pool;
+    apr_file_t *file;
+    apr_int32_t flags;
+    apr_size_t bufsize;
+    apr_thread_mutex_t *mutex;
+    /* signalled when the active batch gets its first record, or on
+     * shutdown */
+    apr_thread_cond_t *work;
+    /* broadcast when the batches are swapped */
+    apr_thread_cond_t *swapped;
+    /* broadcast when a batch has been written (and synced) */
+    apr_thread_cond_t *done;
+    apr_thread_t *thread;
+    appender_batch_t batch[2];
+    appender_batch_t *active;
+    /* bytes accepted, and bytes written (and synced) */
+    apr_uint64_t appended;
+    apr_uint64_t completed;
+    apr_status_t status;
+    int shutdown;
+};
+
+static void * APR_THREAD_FUNC appender_thread(apr_thread_t *thd, void *data)
+{
+    apr_file_appender_t *ap = data;
+    appender_batch_t *batch;
+    apr_uint64_t end;
+    apr_size_t written;
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(ap->mutex);
+    for (;;) {
+        while (!ap->active->nvec && !ap->shutdown) {
+            apr_thread_cond_wait(ap->work, ap->mutex);
+        }
+        if (!ap->active->nvec) {
+            break;
+        }
+
+        /* Writers go on filling the other batch while this one is out,
+         * which is what the next round commits at once.
+         */
+        batch = ap->active;
+        ap->active = (batch == &ap->batch[0]) ? &ap->batch[1] : &ap->batch[0];
+        end = ap->appended;
+        apr_thread_cond_broadcast(ap->swapped);
+        rv = ap->status;
+        apr_thread_mutex_unlock(ap->mutex);
+
+        if (rv == APR_SUCCESS) {
+            rv = apr_file_writev_full(ap->file, batch->vec, batch->nvec,
+                                      &written);
+        }
+        if (rv == APR_SUCCESS) {
+            rv = apr_file_flush(ap->file);
+        }
+        if (rv == APR_SUCCESS && (ap->flags & APR_FILE_APPENDER_DATASYNC)) {
+            rv = apr_file_datasync(ap->file);
+        }
+
+        apr_thread_mutex_lock(ap->mutex);
+        batch->used = batch->nvec = 0;
+        batch->in_buf = 0;
+        if (rv == APR_SUCCESS) {
+            ap->completed = end;
+        }
+        else if (ap->status == APR_SUCCESS) {
+            ap->status = rv;
+        }
+        apr_thread_cond_broadcast(ap->done);
+    }
+    apr_thread_mutex_unlock(ap->mutex);
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static apr_status_t appender_cleanup(void *data)
+{
+    apr_file_appender_t *ap = data;
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(ap->mutex);
+    ap->shutdown = 1;
+    apr_thread_cond_signal(ap->work);
+    apr_thread_mutex_unlock(ap->mutex);
+
+    apr_thread_join(&rv, ap->thread);
+
+    apr_thread_cond_destroy(ap->done);
+    apr_thread_cond_destroy(ap->swapped);
+    apr_thread_cond_destroy(ap->work);
+    apr_thread_mutex_destroy(ap->mutex);
+
+    return ap->status;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_create(apr_file_appender_t **ap,
+                                                   apr_file_t *file,
+                                                   apr_size_t bufsize,
+                                                   apr_int32_t flags,
+                                                   apr_pool_t *p)
+{
+    apr_file_appender_t *new;
+    apr_status_t rv;
+    int i;
+
+    if (!bufsize) {
+        bufsize = APPENDER_DEFAULT_BUFSIZE;
+    }
+
+    new = apr_pcalloc(p, sizeof(*new));
+    new->pool = p;
+    new->file = file;
+    new->flags = flags;
+    new->bufsize = bufsize;
+    for (i = 0; i < 2; i++) {
+        new->batch[i].buf = apr_palloc(p, bufsize);
+        new->batch[i].vec = apr_palloc(p, APR_MAX_IOVEC_SIZE
+                                          * sizeof(struct iovec));
+    }
+    new->active = &new->batch[0];
+
+    if ((rv = apr_thread_mutex_create(&new->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      p)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_thread_cond_create(&new->work, p)) != APR_SUCCESS
+        || (rv = apr_thread_cond_create(&new->swapped, p)) != APR_SUCCESS
+        || (rv = apr_thread_cond_create(&new->done, p)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_thread_create(&new->thread, NULL, appender_thread, new,
+                                p)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* Join the thread before the pool's children, the thread's own pool
+     * among them, are destroyed */
+    apr_pool_pre_cleanup_register(p, new, appender_cleanup);
+
+    *ap = new;
+    return APR_SUCCESS;
+}
+
+/* Add the record to the active batch, with the mutex held */
+static int batch_add(apr_file_appender_t *ap, const struct iovec *vec,
+                     apr_size_t nvec, apr_size_t len)
+{
+    appender_batch_t *batch = ap->active;
+    apr_size_t i;
+
+    if (len > ap->bufsize / 4) {
+        if (batch->nvec + nvec > APR_MAX_IOVEC_SIZE) {
+            return 0;
+        }
+        memcpy(batch->vec + batch->nvec, vec, nvec * sizeof(struct iovec));
+        batch->nvec += nvec;
+        batch->in_buf = 0;
+        return 1;
+    }
+
+    if (batch->used + len > ap->bufsize
+        || (!batch->in_buf && batch->nvec == APR_MAX_IOVEC_SIZE)) {
+        return 0;
+    }
+    if (!batch->in_buf) {
+        batch->vec[batch->nvec].iov_base = batch->buf + batch->used;
+        batch->vec[batch->nvec].iov_len = 0;
+        batch->nvec++;
+        batch->in_buf = 1;
+    }
+    for (i = 0; i < nvec; i++) {
+        memcpy(batch->buf + batch->used, vec[i].iov_base, vec[i].iov_len);
+        batch->used += vec[i].iov_len;
+    }
+    batch->vec[batch->nvec - 1].iov_len += len;
+    return 1;
+}
+
+/* Wait for the bytes up to ticket to be completed, with the mutex held */
+static apr_status_t appender_wait(apr_file_appender_t *ap,
+                                  apr_uint64_t ticket)
+{
+    while (ap->completed < ticket && ap->status == APR_SUCCESS) {
+        apr_thread_cond_wait(ap->done, ap->mutex);
+    }
+    return ap->completed < ticket ? ap->status : APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_writev(apr_file_appender_t *ap,
+                                                   const struct iovec *vec,
+                                                   apr_size_t nvec,
+                                                   apr_uint64_t *ticket)
+{
+    apr_size_t i, len = 0;
+    apr_uint64_t end;
+    apr_status_t rv;
+    int was_empty;
+
+    if (nvec >= APR_MAX_IOVEC_SIZE) {
+        return APR_EINVAL;
+    }
+    for (i = 0; i < nvec; i++) {
+        len += vec[i].iov_len;
+    }
+
+    apr_thread_mutex_lock(ap->mutex);
+
+    for (;;) {
+        if (ap->status != APR_SUCCESS) {
+            rv = ap->status;
+            apr_thread_mutex_unlock(ap->mutex);
+            return rv;
+        }
+        was_empty = !ap->active->nvec;
+        if (batch_add(ap, vec, nvec, len)) {
+            break;
+        }
+        /* The active batch is full, wait for the background thread to
+         * take it.
+         */
+        apr_thread_cond_wait(ap->swapped, ap->mutex);
+    }
+    if (was_empty) {
+        apr_thread_cond_signal(ap->work);
+    }
+    ap->appended += len;
+    end = ap->appended;
+    if (ticket) {
+        *ticket = end;
+    }
+
+    rv = APR_SUCCESS;
+    if (len > ap->bufsize / 4) {
+        /* the data is not ours to keep */
+        rv = appender_wait(ap, end);
+    }
+
+    apr_thread_mutex_unlock(ap->mutex);
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_write(apr_file_appender_t *ap,
+                                                  const void *buf,
+                                                  apr_size_t nbytes,
+                                                  apr_uint64_t *ticket)
+{
+    struct iovec vec;
+
+    vec.iov_base = (void *)buf;
+    vec.iov_len = nbytes;
+    return apr_file_appender_writev(ap, &vec, 1, ticket);
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_wait(apr_file_appender_t *ap,
+                                                 apr_uint64_t ticket)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(ap->mutex);
+    rv = appender_wait(ap, ticket);
+    apr_thread_mutex_unlock(ap->mutex);
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_flush(apr_file_appender_t *ap)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(ap->mutex);
+    rv = appender_wait(ap, ap->appended);
+    apr_thread_mutex_unlock(ap->mutex);
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_destroy(apr_file_appender_t *ap)
+{
+    return apr_pool_cleanup_run(ap->pool, ap, appender_cleanup);
+}
+
+#endif /* APR_HAS_THREADS */
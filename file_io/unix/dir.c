@@ -17,6 +17,12 @@
 #include "apr_arch_file_io.h"
 #include "apr_strings.h"
 #include "apr_portable.h"
+#include "apr_atomic.h"
+#if APR_HAS_THREADS
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+#include "apr_thread_pool.h"
+#endif
 #if APR_HAVE_SYS_SYSLIMITS_H
 #include <sys/syslimits.h>
 #endif
@@ -91,6 +97,13 @@ apr_status_t apr_dir_open(apr_dir_t **new, const char *dirname,
     (*new)->dirname = apr_pstrdup(pool, dirname);
     (*new)->dirstruct = dir;
     (*new)->entry = apr_pcalloc(pool, dirent_size);
+#ifdef HAVE_GETDENTS64
+    (*new)->dents = NULL;
+    (*new)->dents_len = (*new)->dents_pos = 0;
+#endif
+#if APR_HAS_THREADS
+    (*new)->tp = NULL;
+#endif
 
     apr_pool_cleanup_register((*new)->pool, *new, dir_cleanup,
                               apr_pool_cleanup_null);
@@ -130,13 +143,10 @@ static apr_filetype_e filetype_from_dirent_type(int type)
 }
 #endif
 
-apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
-                          apr_dir_t *thedir)
+/* Read the next entry into thedir->entry */
+static apr_status_t dir_readdir(apr_dir_t *thedir)
 {
     apr_status_t ret = 0;
-#ifdef DIRENT_TYPE
-    apr_filetype_e type;
-#endif
 #if APR_HAS_THREADS && defined(_POSIX_THREAD_SAFE_FUNCTIONS) \
                     && !defined(READDIR_IS_THREAD_SAFE)
 #ifdef APR_USE_READDIR64_R
@@ -194,6 +204,19 @@ apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
     }
 #endif
 
+    return ret;
+}
+
+apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
+                          apr_dir_t *thedir)
+{
+    apr_status_t ret;
+#ifdef DIRENT_TYPE
+    apr_filetype_e type;
+#endif
+
+    ret = dir_readdir(thedir);
+
     /* No valid bit flag to test here - do we want one? */
     finfo->fname = NULL;
 
@@ -213,13 +236,14 @@ apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
 #ifdef APR_USE_READDIR64_R
         /* If readdir64_r is used, check for the overflow case of trying
          * to fit a 64-bit integer into a 32-bit integer. */
-        if (sizeof(apr_ino_t) >= sizeof(retent->DIRENT_INODE)
-            || (apr_ino_t)retent->DIRENT_INODE == retent->DIRENT_INODE) {
+        if (sizeof(apr_ino_t) >= sizeof(thedir->entry->DIRENT_INODE)
+            || (apr_ino_t)thedir->entry->DIRENT_INODE
+               == thedir->entry->DIRENT_INODE) {
             wanted &= ~APR_FINFO_INODE;
         } else {
             /* Prevent the fallback code below from filling in the
              * inode if the stat call fails. */
-            retent->DIRENT_INODE = 0;
+            thedir->entry->DIRENT_INODE = 0;
         }
 #else
         wanted &= ~APR_FINFO_INODE;
@@ -279,12 +303,926 @@ apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
     return APR_SUCCESS;
 }
 
+#ifdef HAVE_GETDENTS64
+#define DIR_DENTS_SIZE (64 * 1024)
+#endif
+
+/* Entries stat'ed by each task of a parallel apr_dir_read_batch() */
+#define DIR_STAT_CHUNK 64
+
+/* Fill in the name, and the type and inode when the entry has them */
+static void dir_entry_finfo(apr_finfo_t *finfo, const char *name,
+                            int has_type, int type, apr_uint64_t ino,
+                            apr_pool_t *pool)
+{
+    finfo->pool = pool;
+    finfo->fname = NULL;
+    finfo->valid = APR_FINFO_NAME;
+    finfo->name = apr_pstrdup(pool, name);
+#ifdef DIRENT_TYPE
+    if (has_type) {
+        finfo->filetype = filetype_from_dirent_type(type);
+        if (finfo->filetype != APR_UNKFILE) {
+            finfo->valid |= APR_FINFO_TYPE;
+        }
+    }
+#endif
+    if (ino && ino != (apr_uint64_t)-1
+        && (sizeof(apr_ino_t) >= sizeof(ino) || (apr_ino_t)ino == ino)) {
+        finfo->inode = (apr_ino_t)ino;
+        finfo->valid |= APR_FINFO_INODE;
+    }
+}
+
+static apr_status_t dir_next_entry(apr_finfo_t *finfo, apr_dir_t *thedir,
+                                   apr_pool_t *pool)
+{
+#ifdef HAVE_GETDENTS64
+    struct dirent64 *ent;
+
+    if (thedir->dents_pos >= thedir->dents_len) {
+        ssize_t n;
+
+        if (!thedir->dents) {
+            thedir->dents = apr_palloc(thedir->pool, DIR_DENTS_SIZE);
+        }
+        do {
+            n = getdents64(dirfd(thedir->dirstruct), thedir->dents,
+                           DIR_DENTS_SIZE);
+        } while (n == -1 && errno == EINTR);
+        if (n == -1) {
+            return errno;
+        }
+        if (n == 0) {
+            return APR_ENOENT;
+        }
+        thedir->dents_len = n;
+        thedir->dents_pos = 0;
+    }
+
+    ent = (struct dirent64 *)(thedir->dents + thedir->dents_pos);
+    thedir->dents_pos += ent->d_reclen;
+    dir_entry_finfo(finfo, ent->d_name, 1, ent->d_type, ent->d_ino, pool);
+#else
+    apr_status_t rv = dir_readdir(thedir);
+
+    if (rv) {
+        return rv;
+    }
+    dir_entry_finfo(finfo, thedir->entry->d_name,
+#ifdef DIRENT_TYPE
+                    1, thedir->entry->DIRENT_TYPE,
+#else
+                    0, 0,
+#endif
+#ifdef DIRENT_INODE
+                    thedir->entry->DIRENT_INODE,
+#else
+                    0,
+#endif
+                    pool);
+#endif
+    return APR_SUCCESS;
+}
+
+/* Stat the entries which lack wanted fields */
+static void dir_stat_entries(apr_dir_t *thedir, apr_finfo_t *finfo,
+                             apr_size_t n, apr_int32_t wanted)
+{
+    apr_size_t i;
+
+    for (i = 0; i < n; i++) {
+        const char *name = finfo[i].name;
+        apr_status_t rv;
+#ifdef HAVE_FSTATAT
+        struct_stat info;
+#else
+        char fspec[APR_PATH_MAX];
+        char *end;
+#endif
+
+        if (!(wanted & ~finfo[i].valid)) {
+            continue;
+        }
+#ifdef HAVE_FSTATAT
+        if (fstatat(dirfd(thedir->dirstruct), name, &info,
+                    AT_SYMLINK_NOFOLLOW) == 0) {
+            apr_unix_fill_finfo(&finfo[i], &info, wanted);
+            rv = APR_SUCCESS;
+        }
+        else {
+            rv = errno;
+        }
+#else
+        end = apr_cpystrn(fspec, thedir->dirname, sizeof fspec);
+        if (end > fspec && end[-1] != '/' && (end < fspec + APR_PATH_MAX))
+            *end++ = '/';
+        apr_cpystrn(end, name, sizeof fspec - (end - fspec));
+
+        rv = apr_stat(&finfo[i], fspec, APR_FINFO_LINK | wanted,
+                      finfo[i].pool);
+        finfo[i].fname = NULL;
+#endif
+        if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+            finfo[i].name = name;
+            finfo[i].valid |= APR_FINFO_NAME;
+        }
+    }
+}
+
+#if APR_HAS_THREADS
+typedef struct dir_stat_task_t {
+    apr_dir_t *thedir;
+    apr_finfo_t *finfo;
+    apr_size_t n;
+    apr_int32_t wanted;
+    apr_size_t *pending;
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+} dir_stat_task_t;
+
+static void * APR_THREAD_FUNC dir_stat_task(apr_thread_t *thd, void *data)
+{
+    dir_stat_task_t *task = data;
+
+    dir_stat_entries(task->thedir, task->finfo, task->n, task->wanted);
+
+    apr_thread_mutex_lock(task->mutex);
+    if (!--*task->pending) {
+        apr_thread_cond_signal(task->cond);
+    }
+    apr_thread_mutex_unlock(task->mutex);
+    return NULL;
+}
+
+/* Fan the stats out to the thread pool by chunks, doing the last chunk
+ * ourselves.
+ */
+static apr_status_t dir_stat_parallel(apr_dir_t *thedir, apr_finfo_t *finfo,
+                                      apr_size_t n, apr_int32_t wanted,
+                                      apr_pool_t *pool)
+{
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    dir_stat_task_t *task;
+    apr_size_t pending = 1, i;
+    apr_status_t rv;
+
+    if ((rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_thread_cond_create(&cond, pool)) != APR_SUCCESS) {
+        apr_thread_mutex_destroy(mutex);
+        return rv;
+    }
+
+    for (i = 0; i + DIR_STAT_CHUNK < n; i += DIR_STAT_CHUNK) {
+        task = apr_palloc(pool, sizeof(*task));
+        task->thedir = thedir;
+        task->finfo = finfo + i;
+        task->n = DIR_STAT_CHUNK;
+        task->wanted = wanted;
+        task->pending = &pending;
+        task->mutex = mutex;
+        task->cond = cond;
+
+        apr_thread_mutex_lock(mutex);
+        pending++;
+        apr_thread_mutex_unlock(mutex);
+        if (apr_thread_pool_push(thedir->tp, dir_stat_task, task,
+                                 APR_THREAD_TASK_PRIORITY_NORMAL,
+                                 thedir) != APR_SUCCESS) {
+            dir_stat_task(NULL, task);
+        }
+    }
+    dir_stat_entries(thedir, finfo + i, n - i, wanted);
+
+    apr_thread_mutex_lock(mutex);
+    pending--;
+    while (pending) {
+        apr_thread_cond_wait(cond, mutex);
+    }
+    apr_thread_mutex_unlock(mutex);
+
+    apr_thread_cond_destroy(cond);
+    apr_thread_mutex_destroy(mutex);
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_dir_thread_pool_set(apr_dir_t *thedir,
+                                     apr_thread_pool_t *tp)
+{
+    thedir->tp = tp;
+    return APR_SUCCESS;
+}
+#endif
+
+apr_status_t apr_dir_read_batch(apr_finfo_t *finfo, apr_size_t *nfinfo,
+                                apr_int32_t wanted, apr_dir_t *thedir,
+                                apr_pool_t *pool)
+{
+    apr_size_t n = 0, i;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (n < *nfinfo) {
+        rv = dir_next_entry(&finfo[n], thedir, pool);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n++;
+    }
+    *nfinfo = n;
+    if (n == 0) {
+        return rv;
+    }
+
+    /* Skip what the entries alone provided */
+    wanted &= ~APR_FINFO_LINK;
+    for (i = 0; i < n && !(wanted & ~finfo[i].valid); i++)
+        ;
+    if (i == n) {
+        return APR_SUCCESS;
+    }
+
+#if APR_HAS_THREADS
+    if (!thedir->tp || n - i <= DIR_STAT_CHUNK
+        || dir_stat_parallel(thedir, finfo + i, n - i, wanted,
+                             pool) != APR_SUCCESS)
+#endif
+    {
+        dir_stat_entries(thedir, finfo + i, n - i, wanted);
+    }
+
+    for (; i < n; i++) {
+        if (wanted & ~finfo[i].valid) {
+            return APR_INCOMPLETE;
+        }
+    }
+    return APR_SUCCESS;
+}
+
 apr_status_t apr_dir_rewind(apr_dir_t *thedir)
 {
     rewinddir(thedir->dirstruct);
+#ifdef HAVE_GETDENTS64
+    thedir->dents_len = thedir->dents_pos = 0;
+#endif
     return APR_SUCCESS;
 }
 
+#if defined(HAVE_OPENAT) && defined(HAVE_FDOPENDIR)
+#define DIR_WALK_AT
+#endif
+
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/* The directories kept open for their subdirectories to be opened
+ * relative to them; past that, subdirectories are opened by path.
+ */
+#define DIR_WALK_MAX_OPEN 128
+
+/* The size classes of the nodes, from 64 bytes up by powers of two */
+#define DIR_WALK_NODE_CLASSES 16
+
+typedef struct dir_walk_node_t dir_walk_node_t;
+
+/* A directory to read.  Released nodes are recycled by size class, so
+ * that the memory of a long walk stays bounded by the directories
+ * pending.
+ */
+struct dir_walk_node_t {
+    dir_walk_node_t *parent;
+    /* in the deque of a worker, or in its free list */
+    dir_walk_node_t *prev;
+    dir_walk_node_t *next;
+    int sclass;
+    /* kept open until the subdirectories are opened, or NULL */
+    DIR *dirstruct;
+    /* the node itself and its live subdirectories */
+    apr_uint32_t refs;
+    /* the subdirectories not opened yet */
+    apr_uint32_t unopened;
+    dev_t device;
+    ino_t inode;
+    apr_size_t namepos;
+    char path[1];
+};
+
+typedef struct dir_walk_t dir_walk_t;
+
+typedef struct dir_walk_worker_t {
+    dir_walk_t *walk;
+    int index;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+    apr_thread_t *thread;
+#endif
+    dir_walk_node_t *head;
+    dir_walk_node_t *tail;
+    /* the nodes made and released by this worker */
+    apr_pool_t *nodes;
+    dir_walk_node_t *free[DIR_WALK_NODE_CLASSES];
+    /* for the callback, cleared after each directory */
+    apr_pool_t *pool;
+    void *entry;
+    char path[APR_PATH_MAX];
+} dir_walk_worker_t;
+
+struct dir_walk_t {
+    apr_int32_t wanted;
+    apr_int32_t flags;
+    apr_dir_walk_fn_t *fn;
+    void *baton;
+    dir_walk_worker_t *workers;
+    int nworkers;
+    /* the directories queued or being read */
+    apr_uint32_t pending;
+    apr_uint32_t open_dirs;
+    volatile apr_uint32_t stop;
+    apr_status_t status;
+    dev_t device;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    int nidle;
+    /* bumped whenever directories are queued */
+    apr_uint32_t queued;
+#endif
+};
+
+#if APR_HAS_THREADS
+#define dir_walk_lock(m) do { if (m) apr_thread_mutex_lock(m); } while (0)
+#define dir_walk_unlock(m) do { if (m) apr_thread_mutex_unlock(m); } while (0)
+#else
+#define dir_walk_lock(m) do {} while (0)
+#define dir_walk_unlock(m) do {} while (0)
+#endif
+
+/* Wake up the idle workers, when there are any */
+static void dir_walk_wake(dir_walk_t *walk)
+{
+#if APR_HAS_THREADS
+    if (walk->mutex) {
+        apr_thread_mutex_lock(walk->mutex);
+        apr_thread_cond_broadcast(walk->cond);
+        apr_thread_mutex_unlock(walk->mutex);
+    }
+#endif
+}
+
+static void dir_walk_error(dir_walk_t *walk, apr_status_t rv)
+{
+    dir_walk_lock(walk->mutex);
+    if (walk->status == APR_SUCCESS) {
+        walk->status = rv;
+    }
+    dir_walk_unlock(walk->mutex);
+}
+
+static dir_walk_node_t *dir_walk_node_make(dir_walk_worker_t *w,
+                                           dir_walk_node_t *parent,
+                                           const char *path,
+                                           apr_size_t pathlen,
+                                           apr_size_t namepos)
+{
+    dir_walk_node_t *node;
+    int sclass = 0;
+
+    while (((apr_size_t)64 << sclass) < sizeof(*node) + pathlen) {
+        if (++sclass == DIR_WALK_NODE_CLASSES) {
+            return NULL;
+        }
+    }
+    node = w->free[sclass];
+    if (node) {
+        w->free[sclass] = node->next;
+    }
+    else {
+        node = apr_palloc(w->nodes, (apr_size_t)64 << sclass);
+    }
+
+    if (node) {
+        node->parent = parent;
+        node->sclass = sclass;
+        node->prev = node->next = NULL;
+        node->dirstruct = NULL;
+        node->refs = 1;
+        node->unopened = 0;
+        node->namepos = namepos;
+        memcpy(node->path, path, pathlen);
+        node->path[pathlen] = '\0';
+    }
+    return node;
+}
+
+/* Drop a reference, recycling the node and then its ancestors when they
+ * are no longer needed.
+ */
+static void dir_walk_node_release(dir_walk_worker_t *w,
+                                  dir_walk_node_t *node)
+{
+    while (node && apr_atomic_dec32(&node->refs) == 0) {
+        dir_walk_node_t *parent = node->parent;
+        node->next = w->free[node->sclass];
+        w->free[node->sclass] = node;
+        node = parent;
+    }
+}
+
+/* The node has been opened (or given up on), its parent may close */
+static void dir_walk_opened(dir_walk_t *walk, dir_walk_node_t *node)
+{
+    dir_walk_node_t *parent = node->parent;
+
+    if (parent && apr_atomic_dec32(&parent->unopened) == 0
+        && parent->dirstruct) {
+        closedir(parent->dirstruct);
+        apr_atomic_dec32(&walk->open_dirs);
+    }
+}
+
+static DIR *dir_walk_open(dir_walk_t *walk, dir_walk_node_t *node,
+                          const char *path, apr_status_t *rv)
+{
+    DIR *dirstruct;
+    struct_stat info;
+#ifdef DIR_WALK_AT
+    dir_walk_node_t *parent = node->parent;
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd;
+
+    /* The root is opened whatever it is a link to */
+    if (parent && !(walk->flags & APR_DIR_WALK_FOLLOW)) {
+        flags |= O_NOFOLLOW;
+    }
+    if (parent && parent->dirstruct) {
+        fd = openat(dirfd(parent->dirstruct), node->path + node->namepos,
+                    flags);
+    }
+    else {
+        fd = open(path, flags);
+    }
+    dir_walk_opened(walk, node);
+    if (fd == -1) {
+        *rv = errno;
+        return NULL;
+    }
+    if (fstat(fd, &info) == -1 || !(dirstruct = fdopendir(fd))) {
+        *rv = errno;
+        close(fd);
+        return NULL;
+    }
+#else
+    dirstruct = opendir(path);
+    dir_walk_opened(walk, node);
+    if (!dirstruct) {
+        *rv = errno;
+        return NULL;
+    }
+    if (fstat(dirfd(dirstruct), &info) == -1) {
+        *rv = errno;
+        closedir(dirstruct);
+        return NULL;
+    }
+#endif
+    node->device = info.st_dev;
+    node->inode = info.st_ino;
+    *rv = APR_SUCCESS;
+    return dirstruct;
+}
+
+/* Whether the directory is to be left alone: on another device, or a
+ * symlinked ancestor of itself.
+ */
+static int dir_walk_prune(dir_walk_t *walk, dir_walk_node_t *node)
+{
+    dir_walk_node_t *ancestor;
+
+    if (node->parent == NULL) {
+        walk->device = node->device;
+        return 0;
+    }
+    if ((walk->flags & APR_DIR_WALK_XDEV) && node->device != walk->device) {
+        return 1;
+    }
+    if (walk->flags & APR_DIR_WALK_FOLLOW) {
+        for (ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+            if (ancestor->device == node->device
+                && ancestor->inode == node->inode) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static apr_status_t dir_walk_stat(DIR *dirstruct, const char *name,
+                                  const char *path, apr_finfo_t *finfo,
+                                  apr_int32_t wanted, int follow)
+{
+    struct_stat info;
+    int rc;
+
+#ifdef HAVE_FSTATAT
+    rc = fstatat(dirfd(dirstruct), name, &info,
+                 follow ? 0 : AT_SYMLINK_NOFOLLOW);
+#else
+    rc = follow ? stat(path, &info) : lstat(path, &info);
+#endif
+    if (rc == -1) {
+        return errno;
+    }
+    apr_unix_fill_finfo(finfo, &info, wanted);
+    finfo->valid |= APR_FINFO_NAME;
+    return APR_SUCCESS;
+}
+
+static void dir_walk_push(dir_walk_worker_t *w, dir_walk_node_t *first,
+                          dir_walk_node_t *last)
+{
+    dir_walk_lock(w->mutex);
+    first->prev = w->tail;
+    if (w->tail) {
+        w->tail->next = first;
+    }
+    else {
+        w->head = first;
+    }
+    w->tail = last;
+    dir_walk_unlock(w->mutex);
+}
+
+/* Read a directory, passing its entries to the callback and queueing
+ * its subdirectories.
+ */
+static void dir_walk_read(dir_walk_worker_t *w, dir_walk_node_t *node)
+{
+    dir_walk_t *walk = w->walk;
+    dir_walk_node_t *first = NULL, *last = NULL, *child;
+    apr_int32_t wanted = walk->wanted;
+    apr_size_t len = strlen(node->path), nchildren = 0;
+    apr_finfo_t finfo;
+    apr_dir_t dir;
+    apr_status_t rv;
+
+    dir.pool = w->pool;
+    dir.dirname = node->path;
+    dir.entry = w->entry;
+#ifdef HAVE_GETDENTS64
+    dir.dents = NULL;
+    dir.dents_len = dir.dents_pos = 0;
+#endif
+#if APR_HAS_THREADS
+    dir.tp = NULL;
+#endif
+
+    dir.dirstruct = dir_walk_open(walk, node,
+                                  node->parent || len ? node->path : "/",
+                                  &rv);
+    if (!dir.dirstruct) {
+        dir_walk_error(walk, rv);
+        return;
+    }
+    if (dir_walk_prune(walk, node)) {
+        closedir(dir.dirstruct);
+        return;
+    }
+
+    memcpy(w->path, node->path, len);
+    w->path[len++] = '/';
+
+    while (!walk->stop) {
+        const char *name;
+        apr_size_t namelen;
+        apr_dir_walk_e action;
+        int follow;
+
+        rv = dir_readdir(&dir);
+        if (rv != APR_SUCCESS) {
+            if (!APR_STATUS_IS_ENOENT(rv)) {
+                dir_walk_error(walk, rv);
+            }
+            break;
+        }
+        name = dir.entry->d_name;
+        if (name[0] == '.'
+            && (!name[1] || (name[1] == '.' && !name[2]))) {
+            continue;
+        }
+        namelen = strlen(name);
+        if (len + namelen >= sizeof(w->path)) {
+            dir_walk_error(walk, APR_ENAMETOOLONG);
+            continue;
+        }
+        memcpy(w->path + len, name, namelen + 1);
+
+        dir_entry_finfo(&finfo, name,
+#ifdef DIRENT_TYPE
+                        1, dir.entry->DIRENT_TYPE,
+#else
+                        0, 0,
+#endif
+#ifdef DIRENT_INODE
+                        dir.entry->DIRENT_INODE,
+#else
+                        0,
+#endif
+                        w->pool);
+
+        follow = (walk->flags & APR_DIR_WALK_FOLLOW)
+                 && (!(finfo.valid & APR_FINFO_TYPE)
+                     || finfo.filetype == APR_LNK);
+        if ((wanted & ~finfo.valid) || follow) {
+            rv = dir_walk_stat(dir.dirstruct, name, w->path, &finfo, wanted,
+                               walk->flags & APR_DIR_WALK_FOLLOW);
+            if (rv != APR_SUCCESS && follow) {
+                /* a dangling link */
+                dir_walk_stat(dir.dirstruct, name, w->path, &finfo, wanted,
+                              0);
+            }
+        }
+        finfo.fname = w->path;
+
+        action = walk->fn(walk->baton, w->path, &finfo, w->pool);
+        if (action == APR_DIR_WALK_STOP) {
+            walk->stop = 1;
+            break;
+        }
+        if (action == APR_DIR_WALK_SKIP || !(finfo.valid & APR_FINFO_TYPE)
+            || finfo.filetype != APR_DIR) {
+            continue;
+        }
+
+        child = dir_walk_node_make(w, node, w->path, len + namelen, len);
+        if (!child) {
+            dir_walk_error(walk, APR_ENOMEM);
+            continue;
+        }
+        child->prev = last;
+        if (last) {
+            last->next = child;
+        }
+        else {
+            first = child;
+        }
+        last = child;
+        nchildren++;
+    }
+
+    /* Keep the directory open for its subdirectories, within limits */
+    if (nchildren && !walk->stop
+        && apr_atomic_inc32(&walk->open_dirs) < DIR_WALK_MAX_OPEN) {
+        node->dirstruct = dir.dirstruct;
+    }
+    else {
+        if (nchildren && !walk->stop) {
+            apr_atomic_dec32(&walk->open_dirs);
+        }
+        closedir(dir.dirstruct);
+    }
+
+    if (nchildren) {
+        apr_atomic_add32(&node->refs, nchildren);
+        apr_atomic_set32(&node->unopened, nchildren);
+        apr_atomic_add32(&walk->pending, nchildren);
+        dir_walk_push(w, first, last);
+#if APR_HAS_THREADS
+        if (walk->mutex) {
+            apr_thread_mutex_lock(walk->mutex);
+            walk->queued++;
+            if (walk->nidle) {
+                apr_thread_cond_broadcast(walk->cond);
+            }
+            apr_thread_mutex_unlock(walk->mutex);
+        }
+#endif
+    }
+}
+
+/* Take a node from our own deque, from the end depth first and from the
+ * start breadth first, or steal the oldest node of another worker.
+ */
+static dir_walk_node_t *dir_walk_take(dir_walk_worker_t *w)
+{
+    dir_walk_t *walk = w->walk;
+    dir_walk_node_t *node;
+    int i;
+
+    for (i = 0; i < walk->nworkers; i++) {
+        dir_walk_worker_t *v = &walk->workers[(w->index + i)
+                                              % walk->nworkers];
+        int from_tail = !i && !(walk->flags & APR_DIR_WALK_BREADTH);
+
+        dir_walk_lock(v->mutex);
+        node = from_tail ? v->tail : v->head;
+        if (node) {
+            if (node->prev) {
+                node->prev->next = node->next;
+            }
+            else {
+                v->head = node->next;
+            }
+            if (node->next) {
+                node->next->prev = node->prev;
+            }
+            else {
+                v->tail = node->prev;
+            }
+        }
+        dir_walk_unlock(v->mutex);
+        if (node) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static void dir_walk_run(dir_walk_worker_t *w)
+{
+    dir_walk_t *walk = w->walk;
+    dir_walk_node_t *node;
+
+    for (;;) {
+#if APR_HAS_THREADS
+        apr_uint32_t queued = 0;
+
+        if (walk->mutex) {
+            apr_thread_mutex_lock(walk->mutex);
+            queued = walk->queued;
+            apr_thread_mutex_unlock(walk->mutex);
+        }
+#endif
+        node = dir_walk_take(w);
+        if (!node) {
+            if (apr_atomic_read32(&walk->pending) == 0) {
+                break;
+            }
+#if APR_HAS_THREADS
+            /* Others are busy, wait for them to queue more or finish */
+            if (!walk->mutex) {
+                break;
+            }
+            apr_thread_mutex_lock(walk->mutex);
+            walk->nidle++;
+            while (apr_atomic_read32(&walk->pending)
+                   && walk->queued == queued) {
+                apr_thread_cond_wait(walk->cond, walk->mutex);
+            }
+            walk->nidle--;
+            apr_thread_mutex_unlock(walk->mutex);
+#endif
+            continue;
+        }
+
+        if (walk->stop) {
+            dir_walk_opened(walk, node);
+        }
+        else {
+            dir_walk_read(w, node);
+            apr_pool_clear(w->pool);
+        }
+        dir_walk_node_release(w, node);
+
+        if (apr_atomic_dec32(&walk->pending) == 0) {
+            dir_walk_wake(walk);
+        }
+    }
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC dir_walk_thread(apr_thread_t *thd, void *data)
+{
+    dir_walk_run(data);
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+#endif
+
+apr_status_t apr_dir_walk(const char *path, apr_int32_t wanted,
+                          apr_int32_t flags, int nthreads,
+                          apr_dir_walk_fn_t *fn, void *baton,
+                          apr_pool_t *pool)
+{
+    apr_dir_t *d = NULL;
+    apr_size_t dirent_size =
+        sizeof(*d->entry) + (sizeof(d->entry->d_name) > 1 ? 0 : 255);
+    dir_walk_t walk;
+    dir_walk_node_t *root;
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+#if APR_HAS_THREADS
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+#else
+    nthreads = 1;
+#endif
+
+    path = path_canonicalize(path, pool);
+
+    memset(&walk, 0, sizeof(walk));
+    walk.wanted = (wanted | APR_FINFO_TYPE) & ~APR_FINFO_LINK;
+    walk.flags = flags;
+    walk.fn = fn;
+    walk.baton = baton;
+    walk.nworkers = nthreads;
+    walk.pending = 1;
+    walk.workers = apr_pcalloc(pool, nthreads * sizeof(*walk.workers));
+#if APR_HAS_THREADS
+    if (nthreads > 1
+        && ((rv = apr_thread_mutex_create(&walk.mutex,
+                                          APR_THREAD_MUTEX_DEFAULT,
+                                          pool)) != APR_SUCCESS
+            || (rv = apr_thread_cond_create(&walk.cond, pool))
+               != APR_SUCCESS)) {
+        return rv;
+    }
+#endif
+
+    for (i = 0; i < nthreads && rv == APR_SUCCESS; i++) {
+        dir_walk_worker_t *w = &walk.workers[i];
+        apr_allocator_t *allocator;
+
+        w->walk = &walk;
+        w->index = i;
+        w->entry = apr_pcalloc(pool, dirent_size);
+        /* Each worker allocates and clears its pools on its own */
+        if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+            break;
+        }
+        if ((rv = apr_pool_create_ex(&w->nodes, pool, NULL,
+                                     allocator)) != APR_SUCCESS) {
+            apr_allocator_destroy(allocator);
+            break;
+        }
+        apr_allocator_owner_set(allocator, w->nodes);
+        if ((rv = apr_pool_create(&w->pool, w->nodes)) != APR_SUCCESS) {
+            break;
+        }
+#if APR_HAS_THREADS
+        if (nthreads > 1) {
+            rv = apr_thread_mutex_create(&w->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                         pool);
+        }
+#endif
+    }
+    if (rv == APR_SUCCESS) {
+        root = dir_walk_node_make(&walk.workers[0], NULL, path, strlen(path),
+                                  0);
+        if (!root) {
+            rv = APR_ENOMEM;
+        }
+    }
+    if (rv != APR_SUCCESS) {
+        for (i = 0; i < nthreads; i++) {
+            if (walk.workers[i].nodes) {
+                apr_pool_destroy(walk.workers[i].nodes);
+            }
+        }
+        return rv;
+    }
+
+    dir_walk_push(&walk.workers[0], root, root);
+
+#if APR_HAS_THREADS
+    for (i = 1; i < nthreads; i++) {
+        if (apr_thread_create(&walk.workers[i].thread, NULL, dir_walk_thread,
+                              &walk.workers[i], pool) != APR_SUCCESS) {
+            /* the others take over its share */
+            walk.workers[i].thread = NULL;
+        }
+    }
+#endif
+
+    dir_walk_run(&walk.workers[0]);
+
+#if APR_HAS_THREADS
+    for (i = 1; i < nthreads; i++) {
+        if (walk.workers[i].thread) {
+            apr_thread_join(&rv, walk.workers[i].thread);
+        }
+    }
+#endif
+    for (i = 0; i < nthreads; i++) {
+        apr_pool_destroy(walk.workers[i].nodes);
+    }
+
+    if (walk.stop) {
+        return APR_INCOMPLETE;
+    }
+    return walk.status;
+}
+
 apr_status_t apr_dir_make(const char *path, apr_fileperms_t perm, 
                           apr_pool_t *pool)
 {
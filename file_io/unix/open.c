@@ -217,8 +217,10 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
     (*new)->buffered = (flag & APR_FOPEN_BUFFERED) > 0;
 
     if ((*new)->buffered) {
-        (*new)->buffer = apr_palloc(pool, APR_FILE_DEFAULT_BUFSIZE);
-        (*new)->bufsize = APR_FILE_DEFAULT_BUFSIZE;
+        (*new)->bufsize = (flag & APR_FOPEN_SEQUENTIAL)
+                          ? APR_FILE_SEQUENTIAL_BUFSIZE
+                          : APR_FILE_DEFAULT_BUFSIZE;
+        (*new)->buffer = apr_palloc(pool, (*new)->bufsize);
     }
     else {
         (*new)->buffer = NULL;
@@ -236,6 +238,14 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
     (*new)->bufpos = 0;
     (*new)->dataRead = 0;
     (*new)->direction = 0;
+
+    /* Advisory only, failures don't matter */
+    if (flag & APR_FOPEN_SEQUENTIAL) {
+        apr_file_advise(*new, 0, 0, APR_FILE_ADVICE_SEQUENTIAL);
+    }
+    if (flag & APR_FOPEN_NOCACHE) {
+        apr_file_advise(*new, 0, 0, APR_FILE_ADVICE_NOREUSE);
+    }
 #ifndef WAITIO_USES_POLL
     /* Start out with no pollset.  apr_wait_for_io_or_timeout() will
      * initialize the pollset if needed.
@@ -332,8 +342,10 @@ APR_DECLARE(apr_status_t) apr_os_file_put(apr_file_t **file,
 #endif
 
     if ((*file)->buffered) {
-        (*file)->buffer = apr_palloc(pool, APR_FILE_DEFAULT_BUFSIZE);
-        (*file)->bufsize = APR_FILE_DEFAULT_BUFSIZE;
+        (*file)->bufsize = (flags & APR_FOPEN_SEQUENTIAL)
+                           ? APR_FILE_SEQUENTIAL_BUFSIZE
+                           : APR_FILE_DEFAULT_BUFSIZE;
+        (*file)->buffer = apr_palloc(pool, (*file)->bufsize);
 #if APR_HAS_THREADS
         if ((*file)->flags & APR_FOPEN_XTHREAD) {
             apr_status_t rv;
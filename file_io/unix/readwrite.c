@@ -27,6 +27,33 @@
 #define USE_WAIT_FOR_IO
 #endif
 
+#ifdef HAVE_POSIX_FADVISE
+/* Keep the kernel reading ahead of an APR_FOPEN_SEQUENTIAL reader, and
+ * have it drop the pages an APR_FOPEN_NOCACHE reader went past.  Both
+ * are done APR_FILE_READAHEAD bytes at a time to limit the syscalls.
+ */
+static void file_read_advise(apr_file_t *thefile)
+{
+    apr_off_t pos = thefile->filePtr;
+
+    if ((thefile->flags & APR_FOPEN_SEQUENTIAL)
+        && pos + (apr_off_t)thefile->bufsize > thefile->readahead_end) {
+        if (thefile->readahead_end < pos) {
+            thefile->readahead_end = pos;
+        }
+        posix_fadvise(thefile->filedes, thefile->readahead_end,
+                      APR_FILE_READAHEAD, POSIX_FADV_WILLNEED);
+        thefile->readahead_end += APR_FILE_READAHEAD;
+    }
+    if ((thefile->flags & APR_FOPEN_NOCACHE)
+        && pos - thefile->dropped_end >= APR_FILE_READAHEAD) {
+        posix_fadvise(thefile->filedes, thefile->dropped_end,
+                      pos - thefile->dropped_end, POSIX_FADV_DONTNEED);
+        thefile->dropped_end = pos;
+    }
+}
+#endif
+
 static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
                                        apr_size_t *nbytes)
 {
@@ -68,6 +95,11 @@ static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
             thefile->dataRead = bytesread;
             thefile->filePtr += thefile->dataRead;
             thefile->bufpos = 0;
+#ifdef HAVE_POSIX_FADVISE
+            if (thefile->flags & (APR_FOPEN_SEQUENTIAL | APR_FOPEN_NOCACHE)) {
+                file_read_advise(thefile);
+            }
+#endif
         }
 
         blocksize = size > thefile->dataRead - thefile->bufpos ? thefile->dataRead - thefile->bufpos : size;
@@ -307,6 +339,81 @@ APR_DECLARE(apr_status_t) apr_file_write(apr_file_t *thefile, const void *buf, a
     }
 }
 
+#ifdef HAVE_WRITEV
+/* The most pieces passed to a single writev() of a buffered file, on
+ * top of the buffer itself; callers deal with partial writes anyway.
+ */
+#define WRITEV_BUFFERED_MAX 64
+
+/* Copy the leading pieces which fit into the buffer, then write what it
+ * holds along with the rest of the pieces in a single writev().
+ */
+static apr_status_t file_writev_buffered(apr_file_t *thefile,
+                                         const struct iovec *vec,
+                                         apr_size_t nvec, apr_size_t *nbytes)
+{
+    struct iovec iov[WRITEV_BUFFERED_MAX + 1];
+    apr_size_t i, n;
+    apr_ssize_t bytes;
+
+    if (thefile->direction == 0) {
+        /* Position file pointer for writing at the offset we are
+         * logically reading from
+         */
+        apr_int64_t offset = thefile->filePtr - thefile->dataRead +
+                             thefile->bufpos;
+        if (offset != thefile->filePtr)
+            lseek(thefile->filedes, offset, SEEK_SET);
+        thefile->bufpos = thefile->dataRead = 0;
+        thefile->direction = 1;
+    }
+
+    *nbytes = 0;
+    for (i = 0; i < nvec; i++) {
+        if (vec[i].iov_len > thefile->bufsize - thefile->bufpos) {
+            break;
+        }
+        memcpy(thefile->buffer + thefile->bufpos, vec[i].iov_base,
+               vec[i].iov_len);
+        thefile->bufpos += vec[i].iov_len;
+        *nbytes += vec[i].iov_len;
+    }
+    if (i == nvec) {
+        return APR_SUCCESS;
+    }
+
+    n = nvec - i;
+    if (n > WRITEV_BUFFERED_MAX) {
+        n = WRITEV_BUFFERED_MAX;
+    }
+    memcpy(iov + 1, vec + i, n * sizeof(struct iovec));
+    for (;;) {
+        iov[0].iov_base = thefile->buffer;
+        iov[0].iov_len = thefile->bufpos;
+        do {
+            bytes = writev(thefile->filedes, iov, n + 1);
+        } while (bytes == -1 && errno == EINTR);
+        if (bytes == -1) {
+            return errno;
+        }
+
+        thefile->filePtr += bytes;
+        if ((apr_size_t)bytes >= thefile->bufpos) {
+            *nbytes += bytes - thefile->bufpos;
+            thefile->bufpos = 0;
+            return APR_SUCCESS;
+        }
+
+        /* The buffer went out partially, keep the rest at its start
+         * and try again.
+         */
+        memmove(thefile->buffer, thefile->buffer + bytes,
+                thefile->bufpos - bytes);
+        thefile->bufpos -= bytes;
+    }
+}
+#endif
+
 APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iovec *vec,
                                           apr_size_t nvec, apr_size_t *nbytes)
 {
@@ -315,25 +422,16 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
     apr_ssize_t bytes;
 
     if (thefile->buffered) {
-        file_lock(thefile);
-
-        rv = apr_file_flush_locked(thefile);
+        rv = file_rotating_check(thefile);
         if (rv != APR_SUCCESS) {
-            file_unlock(thefile);
             return rv;
         }
-        if (thefile->direction == 0) {
-            /* Position file pointer for writing at the offset we are
-             * logically reading from
-             */
-            apr_int64_t offset = thefile->filePtr - thefile->dataRead +
-                                 thefile->bufpos;
-            if (offset != thefile->filePtr)
-                lseek(thefile->filedes, offset, SEEK_SET);
-            thefile->bufpos = thefile->dataRead = 0;
-        }
 
+        file_lock(thefile);
+        rv = file_writev_buffered(thefile, vec, nvec, nbytes);
         file_unlock(thefile);
+
+        return rv;
     }
 
     rv = file_rotating_check(thefile);
@@ -370,6 +468,164 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
 #endif
 }
 
+#if defined(HAVE_PREAD) || defined(HAVE_PWRITE)
+/* Positional I/O bypasses the buffer, so write out what it holds first */
+static apr_status_t file_flush_for_pio(apr_file_t *thefile)
+{
+    apr_status_t rv;
+
+    file_lock(thefile);
+    rv = apr_file_flush_locked(thefile);
+    file_unlock(thefile);
+    return rv;
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_file_read_at(apr_file_t *thefile, void *buf,
+                                           apr_size_t *nbytes,
+                                           apr_off_t offset)
+{
+#ifdef HAVE_PREAD
+    apr_ssize_t rv;
+
+    if (*nbytes == 0) {
+        return APR_SUCCESS;
+    }
+    if (thefile->buffered) {
+        apr_status_t arv = file_flush_for_pio(thefile);
+        if (arv != APR_SUCCESS) {
+            *nbytes = 0;
+            return arv;
+        }
+    }
+
+    do {
+        rv = pread(thefile->filedes, buf, *nbytes, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    return rv ? APR_SUCCESS : APR_EOF;
+#else
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_readv_at(apr_file_t *thefile,
+                                            const struct iovec *vec,
+                                            apr_size_t nvec, apr_off_t offset,
+                                            apr_size_t *nbytes)
+{
+#ifdef HAVE_PREADV
+    apr_ssize_t rv;
+    apr_size_t i, len = 0;
+
+    for (i = 0; i < nvec; i++) {
+        len += vec[i].iov_len;
+    }
+    *nbytes = 0;
+    if (len == 0) {
+        return APR_SUCCESS;
+    }
+    if (thefile->buffered) {
+        apr_status_t arv = file_flush_for_pio(thefile);
+        if (arv != APR_SUCCESS) {
+            return arv;
+        }
+    }
+
+    do {
+        rv = preadv(thefile->filedes, vec, nvec, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        return errno;
+    }
+    *nbytes = rv;
+    return rv ? APR_SUCCESS : APR_EOF;
+#else
+    /* One read per buffer, stopping at the first short one */
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t i, n;
+
+    *nbytes = 0;
+    for (i = 0; i < nvec; i++) {
+        if (vec[i].iov_len == 0) {
+            continue;
+        }
+        n = vec[i].iov_len;
+        rv = apr_file_read_at(thefile, vec[i].iov_base, &n, offset);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        *nbytes += n;
+        offset += n;
+        if (n < vec[i].iov_len) {
+            break;
+        }
+    }
+    return *nbytes ? APR_SUCCESS : rv;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_write_at(apr_file_t *thefile,
+                                            const void *buf,
+                                            apr_size_t *nbytes,
+                                            apr_off_t offset)
+{
+#ifdef HAVE_PWRITE
+    apr_ssize_t rv;
+
+    if (thefile->buffered) {
+        apr_off_t start;
+        apr_status_t arv;
+
+        file_lock(thefile);
+        arv = apr_file_flush_locked(thefile);
+        if (arv != APR_SUCCESS) {
+            file_unlock(thefile);
+            *nbytes = 0;
+            return arv;
+        }
+
+        do {
+            rv = pwrite(thefile->filedes, buf, *nbytes, offset);
+        } while (rv == -1 && errno == EINTR);
+
+        /* Keep the data buffered for reading up to date */
+        start = thefile->filePtr - thefile->dataRead;
+        if (rv > 0 && thefile->direction == 0
+            && offset < thefile->filePtr && offset + rv > start) {
+            apr_off_t from = offset > start ? offset : start;
+            apr_off_t to = offset + rv < thefile->filePtr ? offset + rv
+                                                          : thefile->filePtr;
+            memcpy(thefile->buffer + (from - start),
+                   (const char *)buf + (from - offset), (size_t)(to - from));
+        }
+        file_unlock(thefile);
+    }
+    else {
+        do {
+            rv = pwrite(thefile->filedes, buf, *nbytes, offset);
+        } while (rv == -1 && errno == EINTR);
+    }
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    return APR_SUCCESS;
+#else
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_file_putc(char ch, apr_file_t *thefile)
 {
     apr_size_t nbytes = 1;
@@ -487,6 +743,62 @@ APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice)
+{
+#ifdef HAVE_POSIX_FADVISE
+    int rc;
+
+    switch (advice) {
+    case APR_FILE_ADVICE_NORMAL:
+        advice = POSIX_FADV_NORMAL;
+        break;
+    case APR_FILE_ADVICE_SEQUENTIAL:
+        advice = POSIX_FADV_SEQUENTIAL;
+        break;
+    case APR_FILE_ADVICE_RANDOM:
+        advice = POSIX_FADV_RANDOM;
+        break;
+    case APR_FILE_ADVICE_WILLNEED:
+        advice = POSIX_FADV_WILLNEED;
+        break;
+    case APR_FILE_ADVICE_DONTNEED:
+        advice = POSIX_FADV_DONTNEED;
+        break;
+    case APR_FILE_ADVICE_NOREUSE:
+        advice = POSIX_FADV_NOREUSE;
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    /* posix_fadvise() returns the error rather than setting errno */
+    rc = posix_fadvise(thefile->filedes, offset, len, advice);
+    if (rc == ESPIPE) {
+        return APR_ENOTIMPL;
+    }
+    return rc;
+#elif defined(HAVE_READAHEAD)
+    if (advice == APR_FILE_ADVICE_WILLNEED) {
+        if (readahead(thefile->filedes, offset,
+                      len ? (size_t)len : APR_FILE_READAHEAD) == -1) {
+            return errno;
+        }
+        return APR_SUCCESS;
+    }
+    if (advice < APR_FILE_ADVICE_NORMAL || advice > APR_FILE_ADVICE_NOREUSE) {
+        return APR_EINVAL;
+    }
+    return APR_ENOTIMPL;
+#else
+    if (advice < APR_FILE_ADVICE_NORMAL || advice > APR_FILE_ADVICE_NOREUSE) {
+        return APR_EINVAL;
+    }
+    return APR_ENOTIMPL;
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
 {
     apr_status_t rv = APR_SUCCESS; /* get rid of gcc warning */
@@ -38,6 +38,7 @@ static apr_status_t setptr(apr_file_t *thefile, apr_off_t pos )
         if (lseek(thefile->filedes, pos, SEEK_SET) != -1) {
             thefile->bufpos = thefile->dataRead = 0;
             thefile->filePtr = pos;
+            thefile->readahead_end = thefile->dropped_end = pos;
             rv = APR_SUCCESS;
         }
         else {
@@ -0,0 +1,201 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_file_io.h"
+#include "apr_time.h"
+
+#if APR_HAS_SPLICE
+
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+
+static apr_status_t splice_wait(int fd, int for_read,
+                                apr_interval_time_t timeout)
+{
+    struct pollfd pfd;
+    int rc;
+
+    if (timeout == 0) {
+        return APR_EAGAIN;
+    }
+
+    pfd.fd = fd;
+    pfd.events = for_read ? POLLIN : POLLOUT;
+    do {
+        rc = poll(&pfd, 1, timeout < 0 ? -1 : (int)((timeout + 999) / 1000));
+    } while (rc == -1 && errno == EINTR);
+    if (rc == 0) {
+        return APR_TIMEUP;
+    }
+    else if (rc < 0) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+
+/* The longest sleep after splice() would block with both ends ready */
+#define SPLICE_BACKOFF_MAX apr_time_from_msec(16)
+
+/* splice(), or tee() which copies the data of a pipe to another one
+ * instead of moving it.
+ */
+static apr_status_t unix_splice(int fdin, apr_interval_time_t tin,
+                                int in_pipe, int fdout,
+                                apr_interval_time_t tout, int out_pipe,
+                                apr_size_t *len, int copy)
+{
+    unsigned int flags = copy ? 0 : SPLICE_F_MOVE;
+    apr_interval_time_t backoff = 0, slept = 0;
+    apr_ssize_t rv;
+    apr_status_t arv;
+
+    if (*len == 0) {
+        return APR_SUCCESS;
+    }
+
+    /* SPLICE_F_NONBLOCK applies to the pipe ends only, the other end
+     * follows its own O_NONBLOCK.
+     */
+    if ((in_pipe && tin >= 0) || (out_pipe && tout >= 0)) {
+        flags |= SPLICE_F_NONBLOCK;
+    }
+
+    for (;;) {
+        struct pollfd pfd[2];
+
+        do {
+            if (copy) {
+                rv = tee(fdin, fdout, *len, flags);
+            }
+            else {
+                rv = splice(fdin, NULL, fdout, NULL, *len, flags);
+            }
+        } while (rv == -1 && errno == EINTR);
+
+        if (rv >= 0) {
+            break;
+        }
+        if (errno == EINVAL) {
+            /* not a pipe, or not a descriptor splice() supports */
+            *len = 0;
+            return APR_ENOTIMPL;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            *len = 0;
+            return errno;
+        }
+
+        /* Wait for whichever end is not ready */
+        pfd[0].fd = fdin;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = fdout;
+        pfd[1].events = POLLOUT;
+        pfd[0].revents = pfd[1].revents = 0;
+        do {
+            rv = poll(pfd, 2, 0);
+        } while (rv == -1 && errno == EINTR);
+
+        if (!pfd[0].revents) {
+            arv = splice_wait(fdin, 1, tin);
+        }
+        else if (!pfd[1].revents) {
+            arv = splice_wait(fdout, 0, tout);
+        }
+        else if (tout == 0) {
+            arv = APR_EAGAIN;
+        }
+        else if (tout > 0 && slept >= tout) {
+            arv = APR_TIMEUP;
+        }
+        else {
+            /* Both ends look ready, yet splice() would block: poll()
+             * reports a pipe writable with some room, where splice()
+             * needs a whole buffer.  Rather than spinning, wait for
+             * the output end to drain, backing off within its timeout.
+             */
+            backoff = backoff ? backoff * 2 : apr_time_from_msec(1);
+            if (backoff > SPLICE_BACKOFF_MAX) {
+                backoff = SPLICE_BACKOFF_MAX;
+            }
+            if (tout > 0 && backoff > tout - slept) {
+                backoff = tout - slept;
+            }
+            apr_sleep(backoff);
+            slept += backoff;
+            arv = APR_SUCCESS;
+        }
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+    }
+
+    *len = rv;
+    if (rv == 0) {
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_unix_splice(int fdin, apr_interval_time_t tin, int in_pipe,
+                             int fdout, apr_interval_time_t tout,
+                             int out_pipe, apr_size_t *len)
+{
+    return unix_splice(fdin, tin, in_pipe, fdout, tout, out_pipe, len, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_file_splice(apr_file_t *out, apr_file_t *in,
+                                          apr_size_t *len)
+{
+    apr_status_t rv;
+
+    if (in->buffered || out->buffered || in->ungetchar != -1) {
+        *len = 0;
+        return APR_ENOTIMPL;
+    }
+
+    rv = apr_unix_splice(in->filedes, in->timeout, in->is_pipe,
+                         out->filedes, out->timeout, out->is_pipe, len);
+    if (rv == APR_EOF) {
+        in->eof_hit = 1;
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_file_tee(apr_file_t *out, apr_file_t *in,
+                                       apr_size_t *len)
+{
+    apr_status_t rv;
+
+    if (!in->is_pipe || !out->is_pipe || in->buffered || out->buffered
+        || in->ungetchar != -1) {
+        *len = 0;
+        return APR_ENOTIMPL;
+    }
+
+    rv = unix_splice(in->filedes, in->timeout, 1,
+                     out->filedes, out->timeout, 1, len, 1);
+    if (rv == APR_EOF) {
+        in->eof_hit = 1;
+    }
+    return rv;
+}
+
+#endif /* APR_HAS_SPLICE */
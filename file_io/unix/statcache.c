@@ -0,0 +1,797 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+
+#include "apr_stat_cache.h"
+#include "apr_atomic.h"
+#include "apr_hash.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "apr_thread_mutex.h"
+
+#define APR_WANT_MEMFUNC
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if APR_HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#if APR_HAS_THREADS && defined(HAVE_INOTIFY_INIT1) && defined(HAVE_POLL_H)
+#define STAT_CACHE_INOTIFY 1
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+/* Lookups read the slots without the lock, under a sequence count which
+ * is odd while a slot is being written.
+ */
+#if HAVE_ATOMIC_BUILTINS || !APR_HAS_THREADS
+#define STAT_CACHE_LOCKFREE 1
+#if HAVE_ATOMIC_BUILTINS
+#define STAT_CACHE_BARRIER() __sync_synchronize()
+#else
+#define STAT_CACHE_BARRIER()
+#endif
+#endif
+
+#if APR_HAS_THREADS
+#define STAT_CACHE_LOCK(c)   apr_thread_mutex_lock((c)->mutex)
+#define STAT_CACHE_UNLOCK(c) apr_thread_mutex_unlock((c)->mutex)
+#else
+#define STAT_CACHE_LOCK(c)
+#define STAT_CACHE_UNLOCK(c)
+#endif
+
+#define STAT_CACHE_DEFAULT_ENTRIES 4096
+/* The slots a name may be stored in */
+#define STAT_CACHE_WAYS 4
+/* Longer names bypass the cache */
+#define STAT_CACHE_NAME_MAX 256
+
+#ifdef STAT_CACHE_INOTIFY
+#define STAT_CACHE_WATCH_MASK (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE \
+                               | IN_CREATE | IN_DELETE | IN_MOVED_FROM \
+                               | IN_MOVED_TO | IN_DELETE_SELF \
+                               | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+typedef struct stat_cache_slot_t {
+    /* odd while the slot is being written */
+    volatile apr_uint32_t seq;
+    apr_uint32_t hash;
+    /* the length of name, 0 for a free slot */
+    apr_size_t namelen;
+    /* the APR_FINFO_* the entry was stat()ed for */
+    apr_int32_t wanted;
+    apr_status_t status;
+    /* the watch of the entry's directory, -1 for none */
+    int wd;
+    apr_uint32_t stamp;
+    /* when the entry goes stale */
+    apr_time_t expires;
+    apr_finfo_t finfo;
+    char name[STAT_CACHE_NAME_MAX];
+} stat_cache_slot_t;
+
+/* A 64 bit counter incremented with 32 bit atomics */
+typedef struct stat_cache_counter_t {
+    volatile apr_uint32_t lo;
+    volatile apr_uint32_t hi;
+} stat_cache_counter_t;
+
+#ifdef STAT_CACHE_INOTIFY
+/* A watched directory, as the prefix of the names in it; the kernel
+ * gives the same descriptor to the names of the same directory.
+ */
+typedef struct stat_cache_watch_t stat_cache_watch_t;
+struct stat_cache_watch_t {
+    int wd;
+    stat_cache_watch_t *next;
+    apr_size_t prefixlen;
+    char prefix[1];
+};
+#endif
+
+struct apr_stat_cache_t {
+    apr_pool_t *pool;
+    stat_cache_slot_t *slots;
+    apr_size_t nsets;
+    apr_interval_time_t ttl;
+    /* held to write the slots and the watches */
+    apr_thread_mutex_t *mutex;
+    apr_uint32_t stamp;
+    apr_size_t entries;
+    /* bumped by each invalidation, so that a stat() which raced with one
+     * is not cached */
+    volatile apr_uint32_t generation;
+    stat_cache_counter_t hits;
+    stat_cache_counter_t misses;
+    stat_cache_counter_t evictions;
+    stat_cache_counter_t invalidations;
+#ifdef STAT_CACHE_INOTIFY
+    int ifd;
+    int wakeup[2];
+    apr_thread_t *thread;
+    /* prefix -> stat_cache_watch_t, wd -> list of stat_cache_watch_t */
+    apr_hash_t *watches;
+    apr_hash_t *wds;
+    apr_size_t nwatches;
+    apr_size_t max_watches;
+#endif
+};
+
+static void counter_inc(stat_cache_counter_t *c)
+{
+    if (apr_atomic_inc32(&c->lo) == APR_UINT32_MAX) {
+        apr_atomic_inc32(&c->hi);
+    }
+}
+
+static apr_uint64_t counter_get(stat_cache_counter_t *c)
+{
+    apr_uint32_t hi = apr_atomic_read32(&c->hi);
+
+    return ((apr_uint64_t)hi << 32) | apr_atomic_read32(&c->lo);
+}
+
+static APR_INLINE stat_cache_slot_t *slot_set(apr_stat_cache_t *cache,
+                                              apr_uint32_t hash)
+{
+    return cache->slots + (hash & (cache->nsets - 1)) * STAT_CACHE_WAYS;
+}
+
+static APR_INLINE int slot_match(stat_cache_slot_t *slot, apr_uint32_t hash,
+                                 const char *fname, apr_size_t len)
+{
+    return slot->namelen == len && slot->hash == hash
+           && memcmp(slot->name, fname, len) == 0;
+}
+
+/* Whether the entry answers a lookup for wanted: a lstat() for a lstat(),
+ * with the fields asked for.
+ */
+static APR_INLINE int slot_answers(stat_cache_slot_t *slot,
+                                   apr_int32_t wanted)
+{
+    return !((slot->wanted ^ wanted) & APR_FINFO_LINK)
+           && !(wanted & ~slot->wanted);
+}
+
+static int slot_lookup(apr_stat_cache_t *cache, apr_uint32_t hash,
+                       const char *fname, apr_size_t len, apr_int32_t wanted,
+                       apr_finfo_t *finfo, apr_status_t *status)
+{
+    stat_cache_slot_t *set = slot_set(cache, hash);
+    apr_time_t now = 0;
+    int i, found = 0;
+
+#ifndef STAT_CACHE_LOCKFREE
+    STAT_CACHE_LOCK(cache);
+#endif
+    for (i = 0; i < STAT_CACHE_WAYS && !found; i++) {
+        stat_cache_slot_t *slot = set + i;
+#ifdef STAT_CACHE_LOCKFREE
+        apr_uint32_t seq;
+
+        for (;;) {
+            seq = slot->seq;
+            if (seq & 1) {
+                continue;
+            }
+            STAT_CACHE_BARRIER();
+            found = slot_match(slot, hash, fname, len)
+                    && slot_answers(slot, wanted);
+            if (found) {
+                *finfo = slot->finfo;
+                *status = slot->status;
+                if (slot->expires) {
+                    if (!now) {
+                        now = apr_time_now();
+                    }
+                    found = slot->expires > now;
+                }
+            }
+            STAT_CACHE_BARRIER();
+            if (slot->seq == seq) {
+                break;
+            }
+        }
+#else
+        found = slot_match(slot, hash, fname, len)
+                && slot_answers(slot, wanted);
+        if (found) {
+            *finfo = slot->finfo;
+            *status = slot->status;
+            if (slot->expires) {
+                if (!now) {
+                    now = apr_time_now();
+                }
+                found = slot->expires > now;
+            }
+        }
+#endif
+    }
+#ifndef STAT_CACHE_LOCKFREE
+    STAT_CACHE_UNLOCK(cache);
+#endif
+
+    return found;
+}
+
+/* The slot writers, with the lock held */
+
+static APR_INLINE void slot_begin(stat_cache_slot_t *slot)
+{
+    slot->seq++;
+#ifdef STAT_CACHE_LOCKFREE
+    STAT_CACHE_BARRIER();
+#endif
+}
+
+static APR_INLINE void slot_end(stat_cache_slot_t *slot)
+{
+#ifdef STAT_CACHE_LOCKFREE
+    STAT_CACHE_BARRIER();
+#endif
+    slot->seq++;
+}
+
+static void slot_free(apr_stat_cache_t *cache, stat_cache_slot_t *slot)
+{
+    slot_begin(slot);
+    slot->namelen = 0;
+    slot_end(slot);
+    cache->entries--;
+}
+
+static void slot_store(apr_stat_cache_t *cache, apr_uint32_t hash,
+                       const char *fname, apr_size_t len, apr_int32_t wanted,
+                       int wd, const apr_finfo_t *finfo, apr_status_t status)
+{
+    stat_cache_slot_t *set = slot_set(cache, hash);
+    stat_cache_slot_t *slot = NULL;
+    apr_time_t now = 0;
+    int i;
+
+    /* The entry being replaced, else a free or expired slot, else the
+     * oldest entry.
+     */
+    for (i = 0; i < STAT_CACHE_WAYS; i++) {
+        if (set[i].namelen
+            && slot_match(set + i, hash, fname, len)
+            && !((set[i].wanted ^ wanted) & APR_FINFO_LINK)) {
+            slot = set + i;
+            break;
+        }
+    }
+    for (i = 0; i < STAT_CACHE_WAYS && !slot; i++) {
+        if (!set[i].namelen) {
+            slot = set + i;
+        }
+        else if (set[i].expires) {
+            if (!now) {
+                now = apr_time_now();
+            }
+            if (set[i].expires <= now) {
+                slot_free(cache, set + i);
+                slot = set + i;
+            }
+        }
+    }
+    if (!slot) {
+        slot = set;
+        for (i = 1; i < STAT_CACHE_WAYS; i++) {
+            if ((apr_int32_t)(set[i].stamp - slot->stamp) < 0) {
+                slot = set + i;
+            }
+        }
+        slot_free(cache, slot);
+        counter_inc(&cache->evictions);
+    }
+
+    slot_begin(slot);
+    if (!slot->namelen) {
+        cache->entries++;
+    }
+    slot->hash = hash;
+    slot->namelen = len;
+    slot->wanted = wanted;
+    slot->status = status;
+    slot->wd = wd;
+    slot->stamp = cache->stamp++;
+    /* Watched entries expire too, for the changes the watches miss */
+    slot->expires = apr_time_now() + (cache->ttl > 0
+                                      ? cache->ttl
+                                      : APR_STAT_CACHE_DEFAULT_TTL);
+    slot->finfo = *finfo;
+    slot->finfo.pool = NULL;
+    slot->finfo.fname = NULL;
+    slot->finfo.name = NULL;
+    slot->finfo.filehand = NULL;
+    memcpy(slot->name, fname, len);
+    slot_end(slot);
+}
+
+static void cache_invalidate(apr_stat_cache_t *cache, const char *fname,
+                             apr_size_t len)
+{
+    apr_uint32_t hash;
+    stat_cache_slot_t *set;
+    apr_ssize_t klen = len;
+    int i;
+
+    if (len >= STAT_CACHE_NAME_MAX) {
+        return;
+    }
+    hash = apr_hashfunc_default(fname, &klen);
+    set = slot_set(cache, hash);
+
+    apr_atomic_inc32(&cache->generation);
+    for (i = 0; i < STAT_CACHE_WAYS; i++) {
+        if (set[i].namelen && slot_match(set + i, hash, fname, len)) {
+            slot_free(cache, set + i);
+            counter_inc(&cache->invalidations);
+        }
+    }
+}
+
+static void cache_clear(apr_stat_cache_t *cache, int wd)
+{
+    apr_size_t i;
+
+    apr_atomic_inc32(&cache->generation);
+    for (i = 0; i < cache->nsets * STAT_CACHE_WAYS; i++) {
+        stat_cache_slot_t *slot = cache->slots + i;
+
+        if (slot->namelen && (wd < 0 || slot->wd == wd)) {
+            slot_free(cache, slot);
+            counter_inc(&cache->invalidations);
+        }
+    }
+}
+
+#ifdef STAT_CACHE_INOTIFY
+
+static void watch_remove(apr_stat_cache_t *cache, int wd)
+{
+    stat_cache_watch_t *w, *next;
+
+    w = apr_hash_get(cache->wds, &wd, sizeof(wd));
+    if (!w) {
+        return;
+    }
+    apr_hash_set(cache->wds, &w->wd, sizeof(w->wd), NULL);
+    for (; w; w = next) {
+        next = w->next;
+        apr_hash_set(cache->watches, w->prefix, w->prefixlen, NULL);
+        cache->nwatches--;
+        free(w);
+    }
+    cache_clear(cache, wd);
+}
+
+/* The watch of the directory whose names start with prefix (the name of
+ * the directory and a '/', or nothing for the working directory), added
+ * if needed; -1 if the directory cannot be watched.
+ */
+static int watch_get(apr_stat_cache_t *cache, const char *prefix,
+                     apr_size_t prefixlen, int *added)
+{
+    stat_cache_watch_t *w, *first;
+    char dir[STAT_CACHE_NAME_MAX];
+    int wd;
+
+    *added = 0;
+    if (cache->ifd < 0) {
+        return -1;
+    }
+
+    STAT_CACHE_LOCK(cache);
+    w = apr_hash_get(cache->watches, prefix, prefixlen);
+    if (w) {
+        wd = w->wd;
+        STAT_CACHE_UNLOCK(cache);
+        return wd;
+    }
+    if (cache->nwatches >= cache->max_watches) {
+        STAT_CACHE_UNLOCK(cache);
+        return -1;
+    }
+
+    if (!prefixlen) {
+        strcpy(dir, ".");
+    }
+    else if (prefixlen == 1) {
+        strcpy(dir, "/");
+    }
+    else {
+        memcpy(dir, prefix, prefixlen - 1);
+        dir[prefixlen - 1] = '\0';
+    }
+    wd = inotify_add_watch(cache->ifd, dir, STAT_CACHE_WATCH_MASK);
+    if (wd < 0) {
+        STAT_CACHE_UNLOCK(cache);
+        return -1;
+    }
+
+    w = malloc(sizeof(*w) + prefixlen);
+    if (!w) {
+        STAT_CACHE_UNLOCK(cache);
+        return -1;
+    }
+    w->wd = wd;
+    w->prefixlen = prefixlen;
+    memcpy(w->prefix, prefix, prefixlen);
+    w->prefix[prefixlen] = '\0';
+    first = apr_hash_get(cache->wds, &wd, sizeof(wd));
+    w->next = first ? first->next : NULL;
+    if (first) {
+        first->next = w;
+    }
+    else {
+        apr_hash_set(cache->wds, &w->wd, sizeof(w->wd), w);
+    }
+    apr_hash_set(cache->watches, w->prefix, w->prefixlen, w);
+    cache->nwatches++;
+    *added = 1;
+    STAT_CACHE_UNLOCK(cache);
+
+    return wd;
+}
+
+static void notify_event(apr_stat_cache_t *cache,
+                         const struct inotify_event *ev)
+{
+    stat_cache_watch_t *w;
+    char name[STAT_CACHE_NAME_MAX];
+
+    if (ev->mask & IN_Q_OVERFLOW) {
+        cache_clear(cache, -1);
+        return;
+    }
+    if (ev->mask & (IN_IGNORED | IN_MOVE_SELF | IN_DELETE_SELF)) {
+        /* The directory is gone from where it was watched */
+        if (ev->mask & IN_MOVE_SELF) {
+            inotify_rm_watch(cache->ifd, ev->wd);
+        }
+        watch_remove(cache, ev->wd);
+        return;
+    }
+
+    for (w = apr_hash_get(cache->wds, &ev->wd, sizeof(ev->wd)); w;
+         w = w->next) {
+        apr_size_t len;
+
+        /* The directory itself changes with its entries */
+        if (w->prefixlen == 1) {
+            cache_invalidate(cache, w->prefix, 1);
+        }
+        else if (w->prefixlen) {
+            cache_invalidate(cache, w->prefix, w->prefixlen - 1);
+        }
+
+        if (ev->len) {
+            len = strlen(ev->name);
+            if (w->prefixlen + len < sizeof(name)) {
+                memcpy(name, w->prefix, w->prefixlen);
+                memcpy(name + w->prefixlen, ev->name, len);
+                cache_invalidate(cache, name, w->prefixlen + len);
+            }
+        }
+    }
+}
+
+static void * APR_THREAD_FUNC notify_thread(apr_thread_t *thd, void *data)
+{
+    apr_stat_cache_t *cache = data;
+    union {
+        struct inotify_event ev;
+        char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    } u;
+    struct pollfd pfd[2];
+    ssize_t n;
+    char *p;
+
+    pfd[0].fd = cache->ifd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = cache->wakeup[0];
+    pfd[1].events = POLLIN;
+    for (;;) {
+        pfd[0].revents = pfd[1].revents = 0;
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfd[1].revents) {
+            break;
+        }
+
+        while ((n = read(cache->ifd, u.buf, sizeof(u.buf))) > 0) {
+            STAT_CACHE_LOCK(cache);
+            for (p = u.buf; p < u.buf + n;) {
+                struct inotify_event *ev = (struct inotify_event *)p;
+
+                notify_event(cache, ev);
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+            STAT_CACHE_UNLOCK(cache);
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static apr_status_t notify_start(apr_stat_cache_t *cache)
+{
+    apr_status_t rv;
+
+    cache->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->ifd < 0) {
+        return errno;
+    }
+    if (pipe(cache->wakeup) < 0) {
+        rv = errno;
+        close(cache->ifd);
+        cache->ifd = -1;
+        return rv;
+    }
+    cache->watches = apr_hash_make(cache->pool);
+    cache->wds = apr_hash_make(cache->pool);
+
+    if ((rv = apr_thread_create(&cache->thread, NULL, notify_thread, cache,
+                                cache->pool)) != APR_SUCCESS) {
+        close(cache->wakeup[0]);
+        close(cache->wakeup[1]);
+        close(cache->ifd);
+        cache->ifd = -1;
+    }
+    return rv;
+}
+
+static void notify_stop(apr_stat_cache_t *cache)
+{
+    apr_hash_index_t *hi;
+    apr_status_t rv;
+
+    if (cache->ifd < 0) {
+        return;
+    }
+
+    if (write(cache->wakeup[1], "", 1) == 1) {
+        apr_thread_join(&rv, cache->thread);
+    }
+    close(cache->wakeup[0]);
+    close(cache->wakeup[1]);
+    close(cache->ifd);
+    cache->ifd = -1;
+
+    for (hi = apr_hash_first(NULL, cache->watches); hi;
+         hi = apr_hash_next(hi)) {
+        free(apr_hash_this_val(hi));
+    }
+}
+
+#endif /* STAT_CACHE_INOTIFY */
+
+static apr_status_t stat_cache_cleanup(void *data)
+{
+#ifdef STAT_CACHE_INOTIFY
+    notify_stop(data);
+#endif
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_stat_cache_create(apr_stat_cache_t **cache,
+                                                apr_size_t max_entries,
+                                                apr_interval_time_t ttl,
+                                                apr_int32_t flags,
+                                                apr_pool_t *p)
+{
+    apr_stat_cache_t *new;
+    apr_size_t nsets;
+    apr_status_t rv;
+
+    if (!max_entries) {
+        max_entries = STAT_CACHE_DEFAULT_ENTRIES;
+    }
+    for (nsets = 1; nsets * STAT_CACHE_WAYS < max_entries; nsets <<= 1)
+        ;
+
+    new = apr_pcalloc(p, sizeof(*new));
+    new->pool = p;
+    new->nsets = nsets;
+    new->ttl = ttl;
+    new->slots = apr_pcalloc(p, nsets * STAT_CACHE_WAYS
+                                * sizeof(stat_cache_slot_t));
+
+#if APR_HAS_THREADS
+    if ((rv = apr_thread_mutex_create(&new->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      p)) != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+
+#ifdef STAT_CACHE_INOTIFY
+    new->ifd = -1;
+    new->max_watches = nsets * STAT_CACHE_WAYS;
+    if (!(flags & APR_STAT_CACHE_TTL_ONLY)) {
+        /* Without inotify, fall back to the time to live */
+        notify_start(new);
+    }
+#endif
+
+    /* Stop the notification thread before the pool's children, the
+     * thread's own pool among them, are destroyed */
+    apr_pool_pre_cleanup_register(p, new, stat_cache_cleanup);
+
+    *cache = new;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_stat_cache_destroy(apr_stat_cache_t *cache)
+{
+    return apr_pool_cleanup_run(cache->pool, cache, stat_cache_cleanup);
+}
+
+APR_DECLARE(apr_status_t) apr_stat_cache_stat(apr_stat_cache_t *cache,
+                                              apr_finfo_t *finfo,
+                                              const char *fname,
+                                              apr_int32_t wanted,
+                                              apr_pool_t *pool)
+{
+    apr_size_t len = strlen(fname);
+    apr_ssize_t klen = len;
+    apr_uint32_t hash, generation;
+    apr_status_t rv;
+    int wd = -1;
+
+    if (len == 0 || len >= STAT_CACHE_NAME_MAX
+        || (wanted & APR_FINFO_NAME)) {
+        return apr_stat(finfo, fname, wanted, pool);
+    }
+
+    hash = apr_hashfunc_default(fname, &klen);
+    if (slot_lookup(cache, hash, fname, len, wanted, finfo, &rv)) {
+        counter_inc(&cache->hits);
+        if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+            finfo->pool = pool;
+            finfo->fname = apr_pstrmemdup(pool, fname, len);
+            rv = (wanted & ~APR_FINFO_LINK & ~finfo->valid)
+                 ? APR_INCOMPLETE : APR_SUCCESS;
+        }
+        return rv;
+    }
+    counter_inc(&cache->misses);
+
+    /* Watch the directory before stat()ing, so that no change goes
+     * unnoticed; a change noticed meanwhile drops the result.
+     */
+    generation = apr_atomic_read32(&cache->generation);
+#ifdef STAT_CACHE_INOTIFY
+    if (cache->ifd >= 0 && fname[len - 1] != '/') {
+        const char *slash = strrchr(fname, '/');
+        int added;
+
+        wd = watch_get(cache, fname, slash ? slash - fname + 1 : 0, &added);
+    }
+#endif
+
+    /* A watched symbolic link is lstat()ed first, its target is not
+     * watched.
+     */
+    rv = apr_stat(finfo, fname, wd >= 0 ? wanted | APR_FINFO_LINK : wanted,
+                  pool);
+    if (wd >= 0 && !(wanted & APR_FINFO_LINK)
+        && (rv == APR_SUCCESS || rv == APR_INCOMPLETE)
+        && finfo->filetype == APR_LNK) {
+        wd = -1;
+        rv = apr_stat(finfo, fname, wanted, pool);
+    }
+
+#ifdef STAT_CACHE_INOTIFY
+    if (wd >= 0 && (rv == APR_SUCCESS || rv == APR_INCOMPLETE)
+        && finfo->filetype == APR_DIR) {
+        char prefix[STAT_CACHE_NAME_MAX + 1];
+        int added;
+
+        /* A directory changes with its entries: watch it too, and wait
+         * for the next lookup if it was not watched already.
+         */
+        memcpy(prefix, fname, len);
+        prefix[len] = '/';
+        if (watch_get(cache, prefix, len + 1, &added) < 0 || added) {
+            return rv;
+        }
+    }
+#endif
+
+    if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+        STAT_CACHE_LOCK(cache);
+        if (generation == apr_atomic_read32(&cache->generation)) {
+            slot_store(cache, hash, fname, len,
+                       wanted | (finfo->valid & ~APR_FINFO_LINK), wd,
+                       finfo, rv);
+        }
+        STAT_CACHE_UNLOCK(cache);
+    }
+    else if (APR_STATUS_IS_ENOENT(rv) || APR_STATUS_IS_ENOTDIR(rv)) {
+        apr_finfo_t none;
+
+        memset(&none, 0, sizeof(none));
+        STAT_CACHE_LOCK(cache);
+        if (generation == apr_atomic_read32(&cache->generation)) {
+            slot_store(cache, hash, fname, len, wanted, wd, &none, rv);
+        }
+        STAT_CACHE_UNLOCK(cache);
+    }
+
+    return rv;
+}
+
+APR_DECLARE(void) apr_stat_cache_invalidate(apr_stat_cache_t *cache,
+                                            const char *fname)
+{
+    STAT_CACHE_LOCK(cache);
+    cache_invalidate(cache, fname, strlen(fname));
+    STAT_CACHE_UNLOCK(cache);
+}
+
+APR_DECLARE(void) apr_stat_cache_clear(apr_stat_cache_t *cache)
+{
+    STAT_CACHE_LOCK(cache);
+    cache_clear(cache, -1);
+    STAT_CACHE_UNLOCK(cache);
+}
+
+APR_DECLARE(void) apr_stat_cache_stats_get(apr_stat_cache_t *cache,
+                                           apr_stat_cache_stats_t *stats)
+{
+    stats->hits = counter_get(&cache->hits);
+    stats->misses = counter_get(&cache->misses);
+    stats->evictions = counter_get(&cache->evictions);
+    stats->invalidations = counter_get(&cache->invalidations);
+    STAT_CACHE_LOCK(cache);
+    stats->entries = cache->entries;
+#ifdef STAT_CACHE_INOTIFY
+    stats->watches = cache->nwatches;
+#else
+    stats->watches = 0;
+#endif
+    STAT_CACHE_UNLOCK(cache);
+}
+
+APR_DECLARE(const char *) apr_stat_cache_method_name(apr_stat_cache_t *cache)
+{
+#ifdef STAT_CACHE_INOTIFY
+    if (cache->ifd >= 0) {
+        return "inotify";
+    }
+#endif
+    return "ttl";
+}
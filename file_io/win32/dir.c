@@ -257,6 +257,46 @@ APR_DECLARE(apr_status_t) apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_dir_read_batch(apr_finfo_t *finfo,
+                                             apr_size_t *nfinfo,
+                                             apr_int32_t wanted,
+                                             apr_dir_t *thedir,
+                                             apr_pool_t *pool)
+{
+    apr_status_t rv = APR_SUCCESS, ret = APR_SUCCESS;
+    apr_size_t n;
+
+    for (n = 0; n < *nfinfo; n++) {
+        rv = apr_dir_read(&finfo[n], wanted, thedir);
+        if (rv == APR_INCOMPLETE) {
+            ret = APR_INCOMPLETE;
+        }
+        else if (rv != APR_SUCCESS) {
+            break;
+        }
+        finfo[n].name = apr_pstrdup(pool, finfo[n].name);
+        finfo[n].pool = pool;
+    }
+    *nfinfo = n;
+    return n ? ret : rv;
+}
+
+#if APR_HAS_THREADS
+APR_DECLARE(apr_status_t) apr_dir_thread_pool_set(apr_dir_t *thedir,
+                                                  struct apr_thread_pool *tp)
+{
+    return APR_ENOTIMPL;
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_dir_walk(const char *path, apr_int32_t wanted,
+                                       apr_int32_t flags, int nthreads,
+                                       apr_dir_walk_fn_t *fn, void *baton,
+                                       apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_dir_rewind(apr_dir_t *dir)
 {
     apr_status_t rv;
@@ -557,6 +557,42 @@ APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile){
     return apr_file_sync(thefile);
 }
 
+APR_DECLARE(apr_status_t) apr_file_read_at(apr_file_t *thefile, void *buf,
+                                           apr_size_t *nbytes,
+                                           apr_off_t offset)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_readv_at(apr_file_t *thefile,
+                                            const struct iovec *vec,
+                                            apr_size_t nvec, apr_off_t offset,
+                                            apr_size_t *nbytes)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_write_at(apr_file_t *thefile,
+                                            const void *buf,
+                                            apr_size_t *nbytes,
+                                            apr_off_t offset)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice)
+{
+    if (advice < APR_FILE_ADVICE_NORMAL || advice > APR_FILE_ADVICE_NOREUSE) {
+        return APR_EINVAL;
+    }
+    return APR_ENOTIMPL;
+}
+
 struct apr_file_printf_data {
     apr_vformatter_buff_t vbuff;
     apr_file_t *fptr;
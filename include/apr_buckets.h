@@ -53,6 +53,14 @@ extern "C" {
 /** default bucket buffer size - 8KB minus room for memory allocator headers */
 #define APR_BUCKET_BUFF_SIZE 8000
 
+/** the length of a delimiter given as a NUL terminated string, see
+ *  apr_brigade_find() */
+#define APR_BUCKETS_STRING ((apr_size_t)-1)
+
+/** a sensible upper bound of the adaptive read size of socket and pipe
+ *  buckets, see apr_bucket_socket_create_ex() */
+#define APR_BUCKET_READ_MAX (APR_BUCKET_BUFF_SIZE * 16)
+
 /** Determines how a bucket or brigade should be read */
 typedef enum {
     APR_BLOCK_READ,   /**< block until data becomes available */
@@ -486,6 +494,12 @@ typedef apr_status_t (*apr_brigade_flush)(apr_bucket_brigade *bb, void *ctx);
  * @return true or false
  */
 #define APR_BUCKET_IS_HEAP(e)        ((e)->type == &apr_bucket_type_heap)
+/**
+ * Determine if a bucket is a SLAB bucket
+ * @param e The bucket to inspect
+ * @return true or false
+ */
+#define APR_BUCKET_IS_SLAB(e)        ((e)->type == &apr_bucket_type_slab)
 /**
  * Determine if a bucket is a TRANSIENT bucket
  * @param e The bucket to inspect
@@ -556,6 +570,31 @@ struct apr_bucket_heap {
     void (*free_func)(void *data);
 };
 
+/** @see apr_bucket_slab */
+typedef struct apr_bucket_slab apr_bucket_slab;
+/**
+ * A bucket referring to part of a slab, a buffer which the small
+ * copies made from one bucket allocator are packed into one after the
+ * other.  The slab returns to the allocator's cache once the last
+ * bucket referring to it is destroyed.
+ */
+struct apr_bucket_slab {
+    /** Number of buckets using this slab, plus one while the allocator
+     *  still copies new data into it */
+    apr_bucket_refcount  refcount;
+    /** The start of the slab's data */
+    char    *base;
+    /** The size of the slab's data */
+    apr_size_t  size;
+    /** How much of the slab's data is in use; bytes below this offset
+     *  belong to buckets and are never written again */
+    apr_size_t  used;
+    /** The allocator the slab was allocated from */
+    apr_bucket_alloc_t *list;
+    /** The next slab in the allocator's cache */
+    apr_bucket_slab *next;
+};
+
 /** @see apr_bucket_pool */
 typedef struct apr_bucket_pool apr_bucket_pool;
 /**
@@ -774,6 +813,59 @@ APR_DECLARE(apr_status_t) apr_brigade_pflatten(apr_bucket_brigade *bb,
                                                apr_pool_t *pool)
                           __attribute__((nonnull(1,2,3,4)));
 
+/**
+ * Find a delimiter in a brigade, across bucket boundaries and without
+ * copying the data.  Metadata buckets are skipped.
+ * @param bb The brigade to search
+ * @param delim The delimiter to look for
+ * @param dlen The length of the delimiter, or APR_BUCKETS_STRING if it
+ *             is a NUL terminated string
+ * @param block The blocking mode used to read the buckets
+ * @param maxbytes The maximum number of bytes to search; the delimiter
+ *                 must end within them
+ * @param offset On APR_SUCCESS, the offset of the delimiter in the data of
+ *               the brigade.  Otherwise, the length of the data searched
+ *               which can not hold the start of the delimiter, so that
+ *               a later search can resume from there.
+ * @return APR_SUCCESS if the delimiter was found, APR_INCOMPLETE if it
+ *         was not found within @a maxbytes or the data of the brigade, or
+ *         the error from reading a bucket (such as APR_EAGAIN for a non
+ *         blocking read).
+ * @remark The buckets searched are read, so buckets of unknown length
+ *         (pipes, sockets) are morphed into buckets holding their data.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_find(apr_bucket_brigade *bb,
+                                           const char *delim,
+                                           apr_size_t dlen,
+                                           apr_read_type_e block,
+                                           apr_off_t maxbytes,
+                                           apr_off_t *offset)
+                          __attribute__((nonnull(1,2,6)));
+
+/**
+ * Split a brigade at a boundary.  The data before the first occurrence of
+ * the boundary is moved to @a bbOut, and the boundary itself is removed
+ * from @a bbIn.
+ * @param bbOut The brigade the data before the boundary is appended to
+ * @param bbIn The brigade to search for the boundary
+ * @param block The blocking mode used to read the buckets
+ * @param boundary The boundary
+ * @param boundary_len The length of the boundary, or APR_BUCKETS_STRING if
+ *                     it is a NUL terminated string
+ * @param maxbytes The maximum number of bytes to search
+ * @return APR_SUCCESS if the boundary was found.  Otherwise the data which
+ *         can not hold the start of the boundary is moved to @a bbOut,
+ *         and APR_INCOMPLETE or the error from reading is returned, see
+ *         apr_brigade_find().
+ */
+APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
+                                                     apr_bucket_brigade *bbIn,
+                                                     apr_read_type_e block,
+                                                     const char *boundary,
+                                                     apr_size_t boundary_len,
+                                                     apr_off_t maxbytes)
+                          __attribute__((nonnull(1,2,4)));
+
 /**
  * Split a brigade to represent one LF line.
  * @param bbOut The bucket brigade that will have the LF line appended to.
@@ -801,6 +893,70 @@ APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
                                                struct iovec *vec, int *nvec)
                           __attribute__((nonnull(1,2,3)));
 
+/**
+ * Describe the data at the start of a brigade with an iovec, without
+ * removing anything from the brigade, so that it can be parsed in place.
+ * Buckets of unknown length are read (and thus morphed) as
+ * apr_bucket_read() does; file buckets for which mmap is enabled become
+ * mmap views rather than heap copies where the file allows it.
+ * @param bb The brigade to look into
+ * @param vec The iovec to fill in
+ * @param nvec The number of elements in the iovec.  On return, the
+ *             number of elements filled in.
+ * @param len The maximum number of bytes to describe.  On return, the
+ *            number of bytes described.
+ * @param block Whether to block until some data is available.  Only the
+ *              first read may block; once some data was found, reads
+ *              which would block end the iovec.
+ * @return APR_SUCCESS if some data was found, or if the brigade is empty
+ *         or starts with a metadata bucket; otherwise the status of the
+ *         failed read, e.g. APR_EAGAIN
+ * @remark The iovec ends before the first metadata bucket.  The data it
+ *         refers to stays valid until the buckets are changed, e.g. by
+ *         apr_brigade_consume().
+ */
+APR_DECLARE(apr_status_t) apr_brigade_peek_iovec(apr_bucket_brigade *bb,
+                                                 struct iovec *vec,
+                                                 int *nvec, apr_size_t *len,
+                                                 apr_read_type_e block)
+                          __attribute__((nonnull(1,2,3,4)));
+
+/**
+ * Remove bytes from the start of a brigade, splitting the last bucket
+ * involved if needed.  Typically used to drop what a parser consumed
+ * of the data returned by apr_brigade_peek_iovec().
+ * @param bb The brigade to consume from
+ * @param len The number of bytes to remove
+ * @return APR_SUCCESS, APR_INCOMPLETE if fewer than @a len bytes precede
+ *         the first metadata bucket (all of them are removed), or the
+ *         status of a failed read or split
+ * @remark Buckets of unknown length are read with APR_BLOCK_READ.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_consume(apr_bucket_brigade *bb,
+                                              apr_size_t len)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Send the data at the start of a brigade to a socket, removing what was
+ * sent from the brigade.  Where the platform supports it, the data of pipe
+ * buckets is moved from the pipe to the socket by the kernel (see
+ * apr_socket_splice_send()) rather than read into heap buckets; all
+ * other buckets are read and sent as usual.
+ * @param bb The brigade to send from
+ * @param sock The socket to send to
+ * @param len On entry, the maximum number of bytes to send, or
+ *            (apr_size_t)-1 for no limit; on exit, the number of bytes
+ *            sent.
+ * @return APR_SUCCESS once @a len bytes were sent, the brigade is empty
+ *         or its first bucket is a metadata bucket (which is left in
+ *         place), otherwise the error from reading or sending, such as
+ *         APR_EAGAIN or APR_TIMEUP when the socket has a timeout.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_splice_to_socket(apr_bucket_brigade *bb,
+                                                       apr_socket_t *sock,
+                                                       apr_size_t *len)
+                          __attribute__((nonnull(1,2,3)));
+
 /**
  * This function writes a list of strings into a bucket brigade. 
  * @param b The bucket brigade to add to
@@ -1218,6 +1374,12 @@ APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_file;
  * heap.
  */
 APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_heap;
+/**
+ * The SLAB bucket type.  This bucket represents a copy of some data
+ * which shares its buffer, the slab, with other small copies made from
+ * the same bucket allocator.
+ */
+APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_slab;
 #if APR_HAS_MMAP
 /**
  * The MMAP bucket type.  This bucket represents an MMAP'ed file
@@ -1470,6 +1632,33 @@ APR_DECLARE(apr_bucket *) apr_bucket_heap_make(apr_bucket *b, const char *buf,
                                                void (*free_func)(void *data))
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Create a bucket holding a copy of some data.  Copies which fit are
+ * packed into the current slab of the bucket allocator, so that many
+ * small copies share one allocation; larger data gets a HEAP bucket
+ * of its own.
+ * @param buf The buffer to copy into the bucket
+ * @param nbyte The size of the buffer to copy
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket, or NULL if allocation failed
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_slab_create(const char *buf,
+                                                 apr_size_t nbyte,
+                                                 apr_bucket_alloc_t *list)
+                          __attribute__((nonnull(1,3)));
+
+/**
+ * Make the bucket passed in a bucket holding a copy of some data, as
+ * apr_bucket_slab_create() does.
+ * @param b The bucket to make into a SLAB bucket
+ * @param buf The buffer to copy into the bucket
+ * @param nbyte The size of the buffer to copy
+ * @return The new bucket, or NULL if allocation failed
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_slab_make(apr_bucket *b, const char *buf,
+                                               apr_size_t nbyte)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Create a bucket referring to memory allocated from a pool.
  *
@@ -1538,6 +1727,27 @@ APR_DECLARE(apr_bucket *) apr_bucket_mmap_make(apr_bucket *b, apr_mmap_t *mm,
 APR_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *thissock,
                                                    apr_bucket_alloc_t *list)
                           __attribute__((nonnull(1,2)));
+
+/**
+ * Create a bucket referring to a socket, whose reads adapt their size to
+ * the data available.
+ * @param thissock The socket to put in the bucket
+ * @param min_read The first and smallest read, 0 for APR_BUCKET_BUFF_SIZE
+ * @param max_read The largest read
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket, or NULL if allocation failed
+ * @remark Reading a socket bucket morphs it into a heap bucket followed by
+ * a new socket bucket.  The first read is of @a min_read bytes; each read
+ * which fills its buffer doubles the size of the next one, up to
+ * @a max_read, and each read which fills less than half of it halves the
+ * size of the next one, down to @a min_read.  The buckets made by
+ * apr_bucket_socket_create() always read APR_BUCKET_BUFF_SIZE bytes.
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_socket_create_ex(apr_socket_t *thissock,
+                                                      apr_size_t min_read,
+                                                      apr_size_t max_read,
+                                                      apr_bucket_alloc_t *list)
+                          __attribute__((nonnull(1,4)));
 /**
  * Make the bucket passed in a bucket refer to a socket
  * @param b The bucket to make into a SOCKET bucket
@@ -1558,6 +1768,21 @@ APR_DECLARE(apr_bucket *) apr_bucket_pipe_create(apr_file_t *thispipe,
                                                  apr_bucket_alloc_t *list)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Create a bucket referring to a pipe, whose reads adapt their size to
+ * the data available, see apr_bucket_socket_create_ex().
+ * @param thispipe The pipe to put in the bucket
+ * @param min_read The first and smallest read, 0 for APR_BUCKET_BUFF_SIZE
+ * @param max_read The largest read
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket, or NULL if allocation failed
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_pipe_create_ex(apr_file_t *thispipe,
+                                                    apr_size_t min_read,
+                                                    apr_size_t max_read,
+                                                    apr_bucket_alloc_t *list)
+                          __attribute__((nonnull(1,4)));
+
 /**
  * Make the bucket passed in a bucket refer to a pipe
  * @param b The bucket to make into a PIPE bucket
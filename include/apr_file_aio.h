@@ -0,0 +1,177 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_FILE_AIO_H
+#define APR_FILE_AIO_H
+
+/**
+ * @file apr_file_aio.h
+ * @brief APR Asynchronous File I/O
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_file_io.h"
+#include "apr_file_info.h"
+#include "apr_poll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_file_aio Asynchronous File I/O
+ * @ingroup APR
+ * @{
+ */
+
+#if APR_HAS_FILE_AIO || defined(DOXYGEN)
+
+/**
+ * @remark File operations are submitted to an apr_file_aio_t and complete
+ * in the background, on io_uring where the kernel provides it and on a
+ * small set of threads otherwise.  Completions are collected with
+ * apr_file_aio_poll(), whose pollfd (see apr_file_aio_pollfd_get()) can
+ * be added to an apr_pollset_t or apr_pollcb_t so that file I/O is driven
+ * from the same loop as the sockets.
+ *
+ * @remark An apr_file_aio_t is to be used by one thread at a time.
+ */
+
+/** Opaque asynchronous file I/O context */
+typedef struct apr_file_aio_t apr_file_aio_t;
+
+/** The operations that can be submitted */
+typedef enum {
+    APR_FILE_AIO_READ,      /**< apr_file_read_at() */
+    APR_FILE_AIO_WRITE,     /**< apr_file_write_at() */
+    APR_FILE_AIO_FSYNC,     /**< apr_file_sync() */
+    APR_FILE_AIO_OPEN,      /**< apr_file_open() */
+    APR_FILE_AIO_STAT       /**< apr_stat() */
+} apr_file_aio_type_e;
+
+/** @see apr_file_aio_op_t */
+typedef struct apr_file_aio_op_t apr_file_aio_op_t;
+
+/**
+ * An operation, owned by the caller and left untouched until it completes.
+ */
+struct apr_file_aio_op_t {
+    /** The operation */
+    apr_file_aio_type_e type;
+    /** The file to read, write or sync; the file opened for OPEN */
+    apr_file_t *file;
+    /** The data to read or write */
+    void *buf;
+    /** The number of bytes to read or write; on completion, the number
+     *  of bytes read or written */
+    apr_size_t nbytes;
+    /** The offset to read or write at */
+    apr_off_t offset;
+    /** The name of the file to open or stat */
+    const char *fname;
+    /** The apr_file_open() flags for OPEN, the wanted APR_FINFO_* for STAT */
+    apr_int32_t flags;
+    /** The permissions of a file created by OPEN */
+    apr_fileperms_t perm;
+    /** The information filled in by STAT */
+    apr_finfo_t *finfo;
+    /** The pool to open or stat with, not to be used until completion */
+    apr_pool_t *pool;
+    /** Free for the caller's use */
+    void *baton;
+    /** The status of the completed operation, as returned by the
+     *  function it stands for */
+    apr_status_t status;
+    /** For internal use */
+    apr_file_aio_op_t *next;
+};
+
+/** Use threads even where io_uring is available */
+#define APR_FILE_AIO_NOURING  0x1
+
+/**
+ * Create an asynchronous file I/O context.
+ * @param aio The new context
+ * @param depth The maximum number of operations in flight
+ * @param flags Zero or APR_FILE_AIO_NOURING
+ * @param p The pool to allocate from, the context is destroyed with it
+ */
+APR_DECLARE(apr_status_t) apr_file_aio_create(apr_file_aio_t **aio,
+                                              apr_uint32_t depth,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p);
+
+/**
+ * Destroy an asynchronous file I/O context, waiting for the operations in
+ * flight.
+ * @param aio The context to destroy
+ */
+APR_DECLARE(apr_status_t) apr_file_aio_destroy(apr_file_aio_t *aio);
+
+/**
+ * Submit an operation.
+ * @param aio The context
+ * @param op The operation
+ * @return APR_SUCCESS, APR_EAGAIN if the maximum number of operations is
+ *         in flight, or APR_EINVAL for an unknown operation
+ * @remark Reads and writes of buffered files bypass the buffer, as
+ *         apr_file_read_at() and apr_file_write_at() do; data pending in
+ *         the buffer is written out when submitting.
+ */
+APR_DECLARE(apr_status_t) apr_file_aio_submit(apr_file_aio_t *aio,
+                                              apr_file_aio_op_t *op);
+
+/**
+ * Collect completed operations.
+ * @param aio The context
+ * @param timeout How long to wait for a completion, -1 for no limit
+ * @param ops The array to store the completed operations in
+ * @param num On entry, the size of @a ops; on exit, the number of
+ *            operations stored
+ * @return APR_SUCCESS, or APR_TIMEUP if nothing completed in time
+ */
+APR_DECLARE(apr_status_t) apr_file_aio_poll(apr_file_aio_t *aio,
+                                            apr_interval_time_t timeout,
+                                            apr_file_aio_op_t **ops,
+                                            apr_int32_t *num);
+
+/**
+ * Fill in a pollfd which becomes readable when operations complete, for
+ * use with apr_pollset_add() or apr_pollcb_add().
+ * @param aio The context
+ * @param pfd The pollfd to fill in; its client_data is left alone
+ * @remark Call apr_file_aio_poll() with a timeout of 0 when it signals.
+ */
+APR_DECLARE(void) apr_file_aio_pollfd_get(apr_file_aio_t *aio,
+                                          apr_pollfd_t *pfd);
+
+/**
+ * The name of the method used, "io_uring", "threads" or "sync".
+ * @param aio The context
+ */
+APR_DECLARE(const char *) apr_file_aio_method_name(apr_file_aio_t *aio);
+
+#endif /* APR_HAS_FILE_AIO */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_FILE_AIO_H */
@@ -0,0 +1,145 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_FILE_APPENDER_H
+#define APR_FILE_APPENDER_H
+
+/**
+ * @file apr_file_appender.h
+ * @brief APR Group Commit File Appender
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_file_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_file_appender Group Commit File Appender
+ * @ingroup APR
+ * @{
+ */
+
+#if APR_HAS_THREADS || defined(DOXYGEN)
+
+/**
+ * @remark An appender collects the records written by any number of
+ * threads into one of two batches, while a background thread writes the
+ * other batch out with a single writev() and, for durable appenders, a
+ * single apr_file_datasync() covering every record of the batch.
+ *
+ * @remark Each record written gets a ticket, which apr_file_appender_wait()
+ * takes to wait for the record to be written (or synced).  Tickets are
+ * the number of bytes appended up to and including the record.
+ *
+ * @remark Records are never interleaved with each other, but records from
+ * different threads are written in the order they were accepted, not in
+ * the order the calls were made.
+ */
+
+/** Opaque group commit file appender */
+typedef struct apr_file_appender_t apr_file_appender_t;
+
+/** Sync the file after each batch, apr_file_appender_wait() waits for
+ *  the records to be on stable storage */
+#define APR_FILE_APPENDER_DATASYNC  0x1
+
+/**
+ * Create an appender.
+ * @param ap The new appender
+ * @param file The file to append to, preferably opened with
+ *             APR_FOPEN_APPEND and without APR_FOPEN_BUFFERED
+ * @param bufsize The size of each of the two batch buffers, 0 for the
+ *                default
+ * @param flags Zero or APR_FILE_APPENDER_DATASYNC
+ * @param p The pool to allocate from, the appender is destroyed with it
+ * @remark The file is not to be written to by other means while the
+ *         appender exists.
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_create(apr_file_appender_t **ap,
+                                                   apr_file_t *file,
+                                                   apr_size_t bufsize,
+                                                   apr_int32_t flags,
+                                                   apr_pool_t *p);
+
+/**
+ * Append a record.
+ * @param ap The appender
+ * @param buf The data of the record
+ * @param nbytes The length of the record
+ * @param ticket The ticket of the record, or NULL
+ * @return APR_SUCCESS, or the error the background writes ran into
+ * @remark Records of up to a quarter of the buffer size are copied and
+ *         the call returns immediately; larger ones are written from
+ *         @a buf, and the call returns once they have been written.
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_write(apr_file_appender_t *ap,
+                                                  const void *buf,
+                                                  apr_size_t nbytes,
+                                                  apr_uint64_t *ticket);
+
+/**
+ * Append a record made of several pieces.
+ * @param ap The appender
+ * @param vec The pieces of the record
+ * @param nvec The number of pieces, less than #APR_MAX_IOVEC_SIZE
+ * @param ticket The ticket of the record, or NULL
+ * @return APR_SUCCESS, APR_EINVAL if there are too many pieces, or the
+ *         error the background writes ran into
+ * @remark As apr_file_appender_write(), according to the length of the
+ *         whole record.
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_writev(apr_file_appender_t *ap,
+                                                   const struct iovec *vec,
+                                                   apr_size_t nvec,
+                                                   apr_uint64_t *ticket);
+
+/**
+ * Wait for a record to be written out, and to be synced when the
+ * appender was created with APR_FILE_APPENDER_DATASYNC.
+ * @param ap The appender
+ * @param ticket The ticket of the record
+ * @return APR_SUCCESS, or the error the background writes ran into
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_wait(apr_file_appender_t *ap,
+                                                 apr_uint64_t ticket);
+
+/**
+ * Wait for all the records appended so far, as apr_file_appender_wait().
+ * @param ap The appender
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_flush(apr_file_appender_t *ap);
+
+/**
+ * Write out the pending records, stop the background thread and destroy
+ * the appender.  The file is left open.
+ * @param ap The appender to destroy
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_destroy(apr_file_appender_t *ap);
+
+#endif /* APR_HAS_THREADS */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_FILE_APPENDER_H */
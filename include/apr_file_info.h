@@ -267,6 +267,105 @@ APR_DECLARE(apr_status_t) apr_dir_close(apr_dir_t *thedir);
 APR_DECLARE(apr_status_t) apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
                                        apr_dir_t *thedir);
 
+/**
+ * Read the next entries from the specified directory.
+ * @param finfo the array of file info structures to fill in
+ * @param nfinfo on entry, the size of @a finfo; on exit, the number of
+ *        entries read
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of APR_FINFO_
+ *        values
+ * @param thedir the directory descriptor returned from apr_dir_open
+ * @param pool the pool to allocate the names from, which may be cleared
+ *        between calls when the names are not kept
+ * @remark Entries are read many at a time where the system allows it, and
+ *         the fields they lack are filled in relative to the directory,
+ *         across the threads of the pool given to apr_dir_thread_pool_set()
+ *         if any.  As with apr_dir_read(), symbolic links are not followed.
+ * @remark Reading with apr_dir_read() and apr_dir_read_batch() from the
+ *         same directory descriptor without an apr_dir_rewind() in between
+ *         may skip or repeat entries.
+ * @note If @c APR_INCOMPLETE is returned some of the entries lack wanted
+ *       fields, check their @c valid bitmask.  When no more entries are
+ *       available, APR_ENOENT is returned and @a nfinfo is 0.
+ */
+APR_DECLARE(apr_status_t) apr_dir_read_batch(apr_finfo_t *finfo,
+                                             apr_size_t *nfinfo,
+                                             apr_int32_t wanted,
+                                             apr_dir_t *thedir,
+                                             apr_pool_t *pool);
+
+#if APR_HAS_THREADS || defined(DOXYGEN)
+struct apr_thread_pool;
+
+/**
+ * Have apr_dir_read_batch() fan the stat calls of large batches out to a
+ * thread pool.
+ * @param thedir the directory descriptor returned from apr_dir_open
+ * @param tp the thread pool, or NULL to stat from the calling thread
+ * @return APR_SUCCESS, or APR_ENOTIMPL where batches are not stat'ed
+ *         by the directory
+ */
+APR_DECLARE(apr_status_t) apr_dir_thread_pool_set(apr_dir_t *thedir,
+                                                  struct apr_thread_pool *tp);
+#endif
+
+/** What to do after an entry was passed to an apr_dir_walk_fn_t */
+typedef enum {
+    APR_DIR_WALK_CONTINUE,      /**< Go on with the walk */
+    APR_DIR_WALK_SKIP,          /**< Do not descend into this directory */
+    APR_DIR_WALK_STOP           /**< Stop the walk */
+} apr_dir_walk_e;
+
+/**
+ * The callback of apr_dir_walk(), called for each entry below the
+ * starting directory.
+ * @param baton The baton given to apr_dir_walk()
+ * @param path The path of the entry, the starting directory joined
+ *        with the names of the directories leading to it
+ * @param finfo The wanted fields of the entry, along with its type
+ * @param pool A pool which is cleared once the directory holding the
+ *        entry has been read
+ * @remark @a path and @a finfo are only valid during the call.
+ */
+typedef apr_dir_walk_e (apr_dir_walk_fn_t)(void *baton, const char *path,
+                                           const apr_finfo_t *finfo,
+                                           apr_pool_t *pool);
+
+/** Walk breadth first rather than depth first */
+#define APR_DIR_WALK_BREADTH  0x1
+/** Follow symbolic links, skipping those leading to an ancestor */
+#define APR_DIR_WALK_FOLLOW   0x2
+/** Do not descend into directories on other devices */
+#define APR_DIR_WALK_XDEV     0x4
+
+/**
+ * Walk a directory tree.
+ * @param path The directory to walk
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of APR_FINFO_
+ *        values; APR_FINFO_TYPE is always filled in
+ * @param flags Zero or more of APR_DIR_WALK_BREADTH, APR_DIR_WALK_FOLLOW
+ *        and APR_DIR_WALK_XDEV
+ * @param nthreads The number of threads reading directories, the calling
+ *        one included; with more than one, @a fn is called concurrently
+ *        and the order is only approximately depth or breadth first
+ * @param fn The function to call for each entry
+ * @param baton The first argument of @a fn
+ * @param pool The pool to allocate from
+ * @return APR_SUCCESS, APR_INCOMPLETE if @a fn stopped the walk, or the
+ *         first error met opening or reading a directory, in which case
+ *         the walk went on with the others
+ * @remark Subdirectories are opened relative to their parent where the
+ *         system allows it.  The memory used is bounded by the directories
+ *         waiting to be read, which are the subdirectories of the current
+ *         one and of its ancestors depth first, and the directories of the
+ *         next level breadth first.  Without threads @a nthreads is
+ *         ignored.
+ */
+APR_DECLARE(apr_status_t) apr_dir_walk(const char *path, apr_int32_t wanted,
+                                       apr_int32_t flags, int nthreads,
+                                       apr_dir_walk_fn_t *fn, void *baton,
+                                       apr_pool_t *pool);
+
 /**
  * Rewind the directory to the first entry.
  * @param thedir the directory descriptor to rewind.
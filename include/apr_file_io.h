@@ -79,6 +79,9 @@ extern "C" {
 #define APR_FOPEN_SENDFILE_ENABLED 0x01000 /**< Advisory flag that this
                                              file should support
                                              apr_socket_sendfile operation */
+#define APR_FOPEN_NOCACHE     0x02000 /**< Advisory flag that the file's
+                                       * data should not stay cached once
+                                       * read, see WARNING below */
 #define APR_FOPEN_LARGEFILE   0x04000 /**< Platform dependent flag to enable
                                        * large file support, see WARNING below 
                                        */
@@ -94,6 +97,10 @@ extern "C" {
 #define APR_FOPEN_NONBLOCK    0x40000 /**< Platform dependent flag to enable
                                        * non blocking file io */
 
+#define APR_FOPEN_SEQUENTIAL  0x80000 /**< Advisory flag that the file will
+                                       * be read sequentially, see WARNING
+                                       * below */
+
  
 
 /* backcompat */
@@ -112,6 +119,17 @@ extern "C" {
 #define APR_SENDFILE_ENABLED APR_FOPEN_SENDFILE_ENABLED /**< @deprecated @see APR_FOPEN_SENDFILE_ENABLED */   
 #define APR_LARGEFILE        APR_FOPEN_LARGEFILE  /**< @deprecated @see APR_FOPEN_LARGEFILE */   
 
+/** @def APR_FOPEN_SEQUENTIAL
+ * @warning APR_FOPEN_SEQUENTIAL only has effect on some platforms.  It
+ * gives buffered files a larger buffer, and where the kernel supports it
+ * has it read ahead of a buffered reader.
+ *
+ * @def APR_FOPEN_NOCACHE
+ * @warning APR_FOPEN_NOCACHE only has effect on some platforms.  It has
+ * the kernel drop the cached pages a buffered reader has gone past, which
+ * keeps a single pass over a large file from evicting other data.
+ */
+
 /** @def APR_FOPEN_LARGEFILE 
  * @warning APR_FOPEN_LARGEFILE flag only has effect on some
  * platforms where sizeof(apr_off_t) == 4.  Where implemented, it
@@ -488,6 +506,10 @@ APR_DECLARE(apr_status_t) apr_file_write(apr_file_t *thefile, const void *buf,
  * @remark It is possible for both bytes to be written and an error to
  * be returned.  #APR_EINTR is never returned.
  *
+ * @remark With a buffered file, the leading elements which fit are copied
+ * into the buffer; once one does not fit, the buffer is written out along
+ * with the remaining elements in a single system call.
+ *
  * @remark apr_file_writev() is available even if the underlying
  * operating system doesn't provide writev().
  */
@@ -495,6 +517,66 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile,
                                           const struct iovec *vec,
                                           apr_size_t nvec, apr_size_t *nbytes);
 
+/**
+ * Read data from the specified file at the given offset, without using
+ * or changing the file's own position.
+ * @param thefile The file descriptor to read from.
+ * @param buf The buffer to store the data to.
+ * @param nbytes On entry, the number of bytes to read; on exit, the number
+ *               of bytes read.
+ * @param offset The offset in the file to read from.
+ *
+ * @remark Threads may read from one file concurrently with this function,
+ * unbuffered files take no lock.  Buffered files take their lock to write
+ * out their buffer first, a put back char is ignored.
+ *
+ * @remark #APR_EOF is returned when reading at or past the end of the
+ * file; #APR_ENOTIMPL where the platform has no positional I/O (or
+ * #APR_ESPIPE for a pipe).  #APR_EINTR is never returned.
+ */
+APR_DECLARE(apr_status_t) apr_file_read_at(apr_file_t *thefile, void *buf,
+                                           apr_size_t *nbytes,
+                                           apr_off_t offset);
+
+/**
+ * Read data from the specified file at the given offset into an iovec
+ * array, without using or changing the file's own position.
+ * @param thefile The file descriptor to read from.
+ * @param vec The array of buffers to store the data to.
+ * @param nvec The number of elements in the struct iovec array.
+ * @param offset The offset in the file to read from.
+ * @param nbytes The number of bytes read.
+ *
+ * @remark Behaves as apr_file_read_at(); the buffers are filled in order.
+ */
+APR_DECLARE(apr_status_t) apr_file_readv_at(apr_file_t *thefile,
+                                            const struct iovec *vec,
+                                            apr_size_t nvec, apr_off_t offset,
+                                            apr_size_t *nbytes);
+
+/**
+ * Write data to the specified file at the given offset, without using
+ * or changing the file's own position.
+ * @param thefile The file descriptor to write to.
+ * @param buf The buffer which contains the data.
+ * @param nbytes On entry, the number of bytes to write; on exit, the number
+ *               of bytes written.
+ * @param offset The offset in the file to write at.
+ *
+ * @remark Threads may write to one file concurrently with this function,
+ * unbuffered files take no lock.  Buffered files take their lock to write
+ * out their buffer first, and to update the data they buffered for
+ * reading.  On some platforms, files opened with #APR_FOPEN_APPEND
+ * append whatever the offset.
+ *
+ * @remark It is possible for both bytes to be written and an error to
+ * be returned.  #APR_EINTR is never returned.
+ */
+APR_DECLARE(apr_status_t) apr_file_write_at(apr_file_t *thefile,
+                                            const void *buf,
+                                            apr_size_t *nbytes,
+                                            apr_off_t offset);
+
 /**
  * Read data from the specified file, ensuring that the buffer is filled
  * before returning.
@@ -629,6 +711,35 @@ APR_DECLARE(apr_status_t) apr_file_sync(apr_file_t *thefile);
  */
 APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile);
 
+/**
+ * @defgroup apr_file_advice File Access Advice
+ * @{
+ */
+#define APR_FILE_ADVICE_NORMAL     0 /**< No particular access pattern */
+#define APR_FILE_ADVICE_SEQUENTIAL 1 /**< The data will be read in order */
+#define APR_FILE_ADVICE_RANDOM     2 /**< The data will be read in random
+                                      *   order */
+#define APR_FILE_ADVICE_WILLNEED   3 /**< The data will be read soon, start
+                                      *   reading it into the cache */
+#define APR_FILE_ADVICE_DONTNEED   4 /**< The data will not be read again,
+                                      *   drop it from the cache */
+#define APR_FILE_ADVICE_NOREUSE    5 /**< The data will be read only once */
+/** @} */
+
+/**
+ * Tell the kernel how a range of the file will be accessed.
+ * @param thefile The file the advice is about
+ * @param offset The start of the range
+ * @param len The length of the range, 0 for up to the end of the file
+ * @param advice One of the APR_FILE_ADVICE_* values
+ * @return APR_SUCCESS, APR_EINVAL for an unknown @a advice, or
+ *         APR_ENOTIMPL if the platform does not take the advice
+ * @remark The advice only affects performance, never the data read.
+ */
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice);
+
 /**
  * Duplicate the specified file descriptor.
  * @param new_file The structure to duplicate into. 
@@ -771,6 +882,41 @@ APR_DECLARE(apr_status_t) apr_file_pipe_timeout_get(apr_file_t *thepipe,
 APR_DECLARE(apr_status_t) apr_file_pipe_timeout_set(apr_file_t *thepipe, 
                                                   apr_interval_time_t timeout);
 
+#if APR_HAS_SPLICE || defined(DOXYGEN)
+
+/**
+ * Move data from one file to another inside the kernel, without copying
+ * it to and from user memory.
+ * @param out The file to write to.
+ * @param in The file to read from.
+ * @param len On entry, the maximum number of bytes to move; on exit, the
+ *            number of bytes moved.
+ * @return APR_EOF if @a in is at end of file, APR_ENOTIMPL if these
+ *         files can not be spliced, in which case the caller should fall
+ *         back to apr_file_read() and apr_file_write().
+ * @remark At least one of the files must be a pipe, and neither may be
+ *         buffered.  The timeouts of both files are honored.
+ */
+APR_DECLARE(apr_status_t) apr_file_splice(apr_file_t *out, apr_file_t *in,
+                                          apr_size_t *len);
+
+/**
+ * Copy the data of a pipe to another pipe inside the kernel, leaving it
+ * to be read from the first one, as tee(1) does.
+ * @param out The pipe to write to.
+ * @param in The pipe to copy the data of.
+ * @param len On entry, the maximum number of bytes to copy; on exit, the
+ *            number of bytes copied.
+ * @return APR_EOF if @a in is at end of file, APR_ENOTIMPL if either
+ *         file is not a pipe.
+ * @remark Neither pipe may be buffered.  The timeouts of both pipes are
+ *         honored.
+ */
+APR_DECLARE(apr_status_t) apr_file_tee(apr_file_t *out, apr_file_t *in,
+                                       apr_size_t *len);
+
+#endif /* APR_HAS_SPLICE */
+
 /** file (un)locking functions. */
 
 /**
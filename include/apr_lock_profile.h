@@ -0,0 +1,140 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_LOCK_PROFILE_H
+#define APR_LOCK_PROFILE_H
+
+/**
+ * @file apr_lock_profile.h
+ * @brief APR Lock Contention Profiling
+ */
+
+#include "apr.h"
+#include "apr_errno.h"
+#include "apr_pools.h"
+#include "apr_tables.h"
+#include "apr_time.h"
+#include "apr_file_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_lock_profile Lock Contention Profiling
+ * @ingroup APR
+ * While profiling is enabled, every thread mutex, read-write lock,
+ * condition variable, process mutex and global mutex which gets created
+ * records how often it was acquired, how often and how long callers had
+ * to wait for it and how long it was held.  Locks created while
+ * profiling is disabled cost nothing extra.
+ * @note Profiling is currently implemented for the Unix lock
+ * implementations only; elsewhere no lock is ever profiled.  The
+ * statistics of process and global mutexes are kept per process.
+ * @{
+ */
+
+/** Number of buckets of the hold time histogram */
+#define APR_LOCK_PROFILE_BUCKETS 32
+
+/** Statistics of a profiled lock, see apr_lock_profile_get() */
+typedef struct apr_lock_profile_info_t {
+    /** The lock (an apr_thread_mutex_t *, apr_proc_mutex_t *, ...) */
+    const void *lock;
+    /** "thread_mutex", "thread_rwlock", "thread_cond", "proc_mutex"
+     *  or "global_mutex" */
+    const char *type;
+    /** The name given with apr_lock_profile_name_next() or
+     *  apr_lock_profile_name_set(), or NULL */
+    const char *name;
+    /** Acquisitions (for a condition variable: waits) */
+    apr_uint64_t acquired;
+    /** Acquisitions which had to wait (for a condition variable: waits
+     *  which timed out) */
+    apr_uint64_t contended;
+    /** Total time spent waiting */
+    apr_interval_time_t wait_total;
+    /** Longest single wait */
+    apr_interval_time_t wait_max;
+    /** Total time the lock was held exclusively, in nanoseconds */
+    apr_uint64_t hold_total;
+    /** Exclusive hold times: bucket 0 counts holds below 1 nanosecond,
+     *  bucket i those from 2^(i-1) up to 2^i nanoseconds, and the last
+     *  bucket everything longer.  The nested holds of a recursive mutex
+     *  count as one, from the outermost lock to the outermost unlock. */
+    apr_uint64_t hold_hist[APR_LOCK_PROFILE_BUCKETS];
+} apr_lock_profile_info_t;
+
+/**
+ * Enable or disable profiling of the locks created from now on.
+ * @param on Non-zero to enable profiling, zero to disable it.
+ * @remark Locks keep being profiled, or not, for their whole lifetime.
+ */
+APR_DECLARE(void) apr_lock_profile_enable(int on);
+
+/**
+ * Give a name to the next lock created by the calling thread, to be
+ * reported with its statistics.
+ * @param name The name, which must remain valid until the lock is
+ *        created, and is then copied into the pool of the lock; NULL
+ *        to forget a name not used yet.
+ * @return APR_ENOSPC if too many threads have a name waiting for a lock.
+ * @remark The name is used up by the next lock created, whether or not
+ * it is profiled.
+ */
+APR_DECLARE(apr_status_t) apr_lock_profile_name_next(const char *name);
+
+/**
+ * Give a profiled lock a name to be reported with its statistics.
+ * @param lock The lock, as passed to the lock functions.
+ * @param name The name, copied into the pool of the lock.
+ * @return APR_NOTFOUND if the lock is not profiled.
+ */
+APR_DECLARE(apr_status_t) apr_lock_profile_name_set(const void *lock,
+                                                    const char *name);
+
+/**
+ * Get the statistics of all the profiled locks which still exist.
+ * @param profiles Set to an array of apr_lock_profile_info_t, sorted by
+ *        descending wait_total.
+ * @param pool The pool to allocate the array and the names from.
+ * @remark The statistics of a lock are only updated by the threads using
+ * it, and may be slightly inconsistent while it is in use.
+ */
+APR_DECLARE(apr_status_t) apr_lock_profile_get(apr_array_header_t **profiles,
+                                               apr_pool_t *pool);
+
+/**
+ * Write the statistics of all the profiled locks as text, one lock per
+ * line, hottest first.
+ * @param out The file to write to.
+ * @param pool Pool for temporary allocations.
+ */
+APR_DECLARE(apr_status_t) apr_lock_profile_dump(apr_file_t *out,
+                                                apr_pool_t *pool);
+
+/**
+ * Clear the statistics of all the profiled locks.
+ */
+APR_DECLARE(void) apr_lock_profile_reset(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_LOCK_PROFILE_H */
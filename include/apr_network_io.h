@@ -105,6 +105,43 @@ extern "C" {
                                     */
 #define APR_SO_BROADCAST     65536 /**< Allow broadcast
                                     */
+#define APR_SO_REUSEPORT    131072 /**< Allow several sockets to bind to
+                                    * the same address, sharing the
+                                    * incoming connections or datagrams
+                                    * @see apr_socket_listen_group_create
+                                    */
+#define APR_UDP_GRO         262144 /**< Let the kernel coalesce received
+                                    * datagrams of a flow
+                                    * @see apr_socket_recvfrom_batch
+                                    */
+#define APR_TCP_FASTOPEN    524288 /**< Accept data in the SYN of
+                                    * connections to a listening socket;
+                                    * the value is the number of such
+                                    * connections pending at most
+                                    * @see apr_socket_connect_data
+                                    */
+#define APR_TCP_NOTSENT_LOWAT 1048576 /**< Report a socket writable only
+                                       * while less than the value, in
+                                       * bytes, is queued unsent
+                                       */
+#define APR_SO_BUSY_POLL   2097152 /**< Busy poll the device queue for
+                                    * the value, in microseconds, when
+                                    * receiving finds nothing
+                                    */
+#define APR_SO_PREFER_BUSY_POLL 4194304 /**< Defer device interrupts
+                                         * while the socket busy polls
+                                         */
+#define APR_SO_INCOMING_CPU 8388608 /**< The CPU handling the received
+                                     * packets of the socket; set it on
+                                     * APR_SO_REUSEPORT listeners to pick
+                                     * the one receiving the connections
+                                     * of that CPU, get it on accepted
+                                     * sockets for the actual value
+                                     */
+#define APR_TCP_QUICKACK  16777216 /**< Acknowledge immediately rather
+                                    * than delay; the system may clear it
+                                    * again, set it after each receive
+                                    */
 
 /** @} */
 
@@ -373,6 +410,62 @@ APR_DECLARE(apr_status_t) apr_socket_accept(apr_socket_t **new_sock,
                                             apr_socket_t *sock,
                                             apr_pool_t *connection_pool);
 
+/**
+ * Accept the pending connection requests, up to a maximum.
+ * @param new_socks The array to store the new sockets in
+ * @param num On entry, the size of @a new_socks and @a pools; on exit,
+ *            the number of connections accepted
+ * @param sock The socket we are listening on.
+ * @param pools The pools for the new sockets, one per socket; the same
+ *              pool may be given more than once.
+ * @return APR_SUCCESS if a connection was accepted, or the error of the
+ *         first attempt (APR_EAGAIN if none is pending on a non-blocking
+ *         socket)
+ * @remark Connections past the first are accepted only from a
+ *         non-blocking listening socket (see apr_socket_timeout_set()),
+ *         until none is pending; a blocking socket yields one connection
+ *         per call.
+ * @note The pools are subject to the same restriction as for
+ *       apr_socket_accept().
+ */
+APR_DECLARE(apr_status_t) apr_socket_accept_many(apr_socket_t **new_socks,
+                                                 apr_int32_t *num,
+                                                 apr_socket_t *sock,
+                                                 apr_pool_t **pools);
+
+/** Steer each connection to the listener of the CPU it was received on
+ *  (the CPU number modulo the number of listeners)
+ *  @see apr_socket_listen_group_create */
+#define APR_LISTEN_GROUP_CPU  0x1
+
+/**
+ * Create a group of listening sockets bound to the same address with
+ * APR_SO_REUSEPORT, typically one per worker thread; the kernel spreads
+ * the incoming connections over the sockets of the group.
+ * @param socks The array to store the @a nsocks new sockets in
+ * @param nsocks The number of sockets of the group
+ * @param sa The address to bind to; if its port is 0, the port picked
+ *           for the first socket is used for all of them
+ * @param type The type of the sockets (e.g., SOCK_STREAM)
+ * @param protocol The protocol of the sockets (e.g., APR_PROTO_TCP)
+ * @param backlog The listen queue size of each socket, see
+ *                apr_socket_listen()
+ * @param flags Zero or APR_LISTEN_GROUP_CPU
+ * @param p The pool for the sockets
+ * @return APR_ENOTIMPL where APR_SO_REUSEPORT, or the steering asked
+ *         for, is not supported
+ * @remark With APR_LISTEN_GROUP_CPU, the worker using socks[i] is best
+ *         bound to the CPUs whose number modulo @a nsocks is i.
+ */
+APR_DECLARE(apr_status_t) apr_socket_listen_group_create(apr_socket_t **socks,
+                                                         int nsocks,
+                                                         apr_sockaddr_t *sa,
+                                                         int type,
+                                                         int protocol,
+                                                         apr_int32_t backlog,
+                                                         apr_int32_t flags,
+                                                         apr_pool_t *p);
+
 /**
  * Issue a connection request to a socket either on the same machine 
  * or a different one.
@@ -382,6 +475,59 @@ APR_DECLARE(apr_status_t) apr_socket_accept(apr_socket_t **new_sock,
 APR_DECLARE(apr_status_t) apr_socket_connect(apr_socket_t *sock,
                                              apr_sockaddr_t *sa);
 
+/**
+ * Issue a connection request and send the first data, in the SYN with
+ * TCP Fast Open where the system supports it and holds a cookie from an
+ * earlier connection to the server.
+ * @param sock The socket we wish to use for our side of the connection
+ * @param sa The address of the machine we wish to connect to.
+ * @param buf The data to send
+ * @param len On entry, the number of bytes to send; on exit, the number
+ *            of bytes sent
+ * @return As apr_socket_connect(), the connection (and the sending of
+ *         the data) still being under way when APR_EINPROGRESS is
+ *         returned for a socket with a timeout of 0
+ * @remark Without Fast Open the connection is made first, and the data
+ *         sent with apr_socket_send().  The server must tolerate seeing
+ *         the data more than once, as a SYN carrying it may be replayed.
+ */
+APR_DECLARE(apr_status_t) apr_socket_connect_data(apr_socket_t *sock,
+                                                  apr_sockaddr_t *sa,
+                                                  const char *buf,
+                                                  apr_size_t *len);
+
+/** The delay between connection attempts recommended by RFC 8305
+ *  @see apr_socket_connect_multi */
+#define APR_CONNECT_MULTI_DELAY  apr_time_from_msec(250)
+
+/**
+ * Connect to the first of a list of addresses to answer, as RFC 8305
+ * ("Happy Eyeballs") describes: the attempts are started one after the
+ * other, @a delay apart or as soon as the previous one fails, and race
+ * each other.
+ * @param new_sock The connected socket, blocking as by default
+ * @param sa The addresses to connect to, linked by their next field, as
+ *           apr_sockaddr_info_get() returns them
+ * @param type The type of the socket (e.g., SOCK_STREAM)
+ * @param protocol The protocol of the socket (e.g., APR_PROTO_TCP)
+ * @param delay The time to give an attempt before starting the next one,
+ *              0 for APR_CONNECT_MULTI_DELAY
+ * @param timeout How long to try in all, -1 for no limit
+ * @param p The pool for the socket, which is allocated from a subpool
+ *          of it
+ * @return APR_SUCCESS, APR_TIMEUP if no attempt succeeded in time, or
+ *         the error of the last attempt to fail
+ * @remark The address families are alternated, starting with the family
+ *         of the first address.  Each attempt is made in its own subpool
+ *         of @a p, and those which lose the race are closed and freed.
+ */
+APR_DECLARE(apr_status_t) apr_socket_connect_multi(apr_socket_t **new_sock,
+                                                   apr_sockaddr_t *sa,
+                                                   int type, int protocol,
+                                                   apr_interval_time_t delay,
+                                                   apr_interval_time_t timeout,
+                                                   apr_pool_t *p);
+
 /**
  * Determine whether the receive part of the socket has been closed by
  * the peer (such that a subsequent call to apr_socket_read would
@@ -587,6 +733,60 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
                                               apr_socket_t *sock,
                                               apr_int32_t flags, char *buf, 
                                               apr_size_t *len);
+
+/**
+ * A datagram sent by apr_socket_sendto_batch() or received by
+ * apr_socket_recvfrom_batch().
+ */
+typedef struct apr_socket_msg_t {
+    /** The address to send to, or updated with the address received
+     *  from; NULL for a connected socket */
+    apr_sockaddr_t *addr;
+    /** The data to send, or the buffer to receive into */
+    char *buf;
+    /** The length of the data, or the size of the buffer */
+    apr_size_t len;
+    /** Updated with the number of bytes sent or received */
+    apr_size_t nbytes;
+    /** When sending, the size of the datagrams @a buf is cut into, or 0
+     *  for a single datagram (UDP segmentation offload); when receiving
+     *  on a socket with APR_UDP_GRO, updated with the size of the
+     *  datagrams coalesced into @a buf, or 0 */
+    apr_size_t segment_size;
+} apr_socket_msg_t;
+
+/**
+ * Send datagrams, with as few system calls as possible (sendmmsg()).
+ * @param sock The socket to send from
+ * @param msgs The datagrams
+ * @param num On entry, the number of datagrams; on exit, the number of
+ *            datagrams sent
+ * @param flags The flags to use, as for apr_socket_sendto()
+ * @return APR_SUCCESS if a datagram was sent, or the error of the first
+ * @remark Datagrams with a segment_size are handed to the kernel at once
+ *         where it supports UDP segmentation offload, 64 segments at a
+ *         time at most, and sent one segment at a time otherwise.
+ */
+APR_DECLARE(apr_status_t) apr_socket_sendto_batch(apr_socket_t *sock,
+                                                  apr_socket_msg_t *msgs,
+                                                  apr_int32_t *num,
+                                                  apr_int32_t flags);
+
+/**
+ * Receive the datagrams available, with as few system calls as possible
+ * (recvmmsg()), waiting for the first one as apr_socket_recvfrom() does.
+ * @param sock The socket to receive from
+ * @param msgs The datagrams
+ * @param num On entry, the number of datagrams; on exit, the number of
+ *            datagrams received
+ * @param flags The flags to use, as for apr_socket_recvfrom()
+ * @return APR_SUCCESS if a datagram was received, or the error of the
+ *         first attempt
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvfrom_batch(apr_socket_t *sock,
+                                                    apr_socket_msg_t *msgs,
+                                                    apr_int32_t *num,
+                                                    apr_int32_t flags);
  
 #if APR_HAS_SENDFILE || defined(DOXYGEN)
 
@@ -617,6 +817,41 @@ APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock,
 
 #endif /* APR_HAS_SENDFILE */
 
+#if APR_HAS_SPLICE || defined(DOXYGEN)
+
+/**
+ * Move data from a pipe to a socket inside the kernel, without copying
+ * it to and from user memory.
+ * @param sock The socket to write to.
+ * @param pipe The pipe to read from.
+ * @param len On entry, the maximum number of bytes to move; on exit, the
+ *            number of bytes moved.
+ * @return APR_EOF if the write end of the pipe was closed and all the
+ *         data was read, APR_ENOTIMPL if @a pipe can not be spliced, in
+ *         which case the caller should fall back to apr_file_read() and
+ *         apr_socket_send().
+ * @remark The timeouts of the socket and of the pipe are both honored.
+ */
+APR_DECLARE(apr_status_t) apr_socket_splice_send(apr_socket_t *sock,
+                                                 apr_file_t *pipe,
+                                                 apr_size_t *len);
+
+/**
+ * Move data from a socket to a pipe inside the kernel, without copying
+ * it to and from user memory.
+ * @param sock The socket to read from.
+ * @param pipe The pipe to write to.
+ * @param len On entry, the maximum number of bytes to move; on exit, the
+ *            number of bytes moved.
+ * @return APR_EOF if the peer closed the connection, APR_ENOTIMPL if
+ *         @a pipe can not be spliced, see apr_socket_splice_send().
+ */
+APR_DECLARE(apr_status_t) apr_socket_splice_recv(apr_socket_t *sock,
+                                                 apr_file_t *pipe,
+                                                 apr_size_t *len);
+
+#endif /* APR_HAS_SPLICE */
+
 /**
  * Read data from a network.
  * @param sock The socket to read the data from.
@@ -727,6 +962,79 @@ APR_DECLARE(apr_status_t) apr_socket_timeout_get(apr_socket_t *sock,
 APR_DECLARE(apr_status_t) apr_socket_atmark(apr_socket_t *sock, 
                                             int *atmark);
 
+/**
+ * The state of a TCP connection as the system sees it, see
+ * apr_socket_tcp_info_get().  Fields the system does not report are 0.
+ */
+typedef struct apr_socket_tcp_info_t {
+    /** The smoothed round trip time */
+    apr_interval_time_t rtt;
+    /** The variation of the round trip time */
+    apr_interval_time_t rtt_var;
+    /** The retransmission timeout */
+    apr_interval_time_t rto;
+    /** The congestion window, in bytes */
+    apr_uint64_t snd_cwnd;
+    /** The maximum segment size sent */
+    apr_uint32_t snd_mss;
+    /** The maximum segment size received */
+    apr_uint32_t rcv_mss;
+    /** The segments sent and not yet acknowledged */
+    apr_uint32_t unacked;
+    /** The segments deemed lost */
+    apr_uint32_t lost;
+    /** The segments retransmitted over the connection */
+    apr_uint32_t retransmits;
+} apr_socket_tcp_info_t;
+
+/**
+ * What APR did with a socket, see apr_socket_stats_get().
+ */
+typedef struct apr_socket_stats_t {
+    /** The bytes sent, including @a sendfile_bytes */
+    apr_uint64_t bytes_sent;
+    /** The bytes received, including @a splice_recv_bytes; bytes
+     *  peeked at (MSG_PEEK) are not counted until received */
+    apr_uint64_t bytes_received;
+    /** The system calls made to send */
+    apr_uint64_t send_calls;
+    /** The system calls made to receive */
+    apr_uint64_t recv_calls;
+    /** The send calls which found the socket full (EAGAIN) */
+    apr_uint64_t send_eagain;
+    /** The receive calls which found the socket empty (EAGAIN) */
+    apr_uint64_t recv_eagain;
+    /** The bytes apr_socket_sendfile() sent from the file with the
+     *  system's sendfile(), and apr_socket_splice_send() from the pipe
+     *  with splice(), without copying them; the rest of @a bytes_sent
+     *  was copied from memory.  (Currently only on Linux, the one
+     *  system whose apr_socket_sendfile() updates these counters) */
+    apr_uint64_t sendfile_bytes;
+    /** The bytes apr_socket_splice_recv() moved to the pipe with
+     *  splice(), without copying them */
+    apr_uint64_t splice_recv_bytes;
+} apr_socket_stats_t;
+
+/**
+ * Query the round trip time, congestion window and retransmissions of a
+ * TCP connection (TCP_INFO).
+ * @param sock The connected socket
+ * @param info The state of the connection
+ * @return APR_ENOTIMPL where the system does not tell
+ */
+APR_DECLARE(apr_status_t) apr_socket_tcp_info_get(apr_socket_t *sock,
+                                                  apr_socket_tcp_info_t *info);
+
+/**
+ * Query the bytes and system calls APR has counted for a socket since
+ * its creation.
+ * @param sock The socket
+ * @param stats The counters
+ * @return APR_ENOTIMPL where APR does not count
+ */
+APR_DECLARE(apr_status_t) apr_socket_stats_get(apr_socket_t *sock,
+                                               apr_socket_stats_t *stats);
+
 /**
  * Return an address associated with a socket; either the address to
  * which the socket is bound locally or the address of the peer
@@ -26,6 +26,7 @@
 #include "apr_pools.h"
 #include "apr_errno.h"
 #include "apr_perms_set.h"
+#include "apr_time.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,7 +49,8 @@ typedef enum {
     APR_LOCK_SYSVSEM,       /**< System V Semaphores */
     APR_LOCK_PROC_PTHREAD,  /**< POSIX pthread process-based locking */
     APR_LOCK_POSIXSEM,      /**< POSIX semaphore process-based locking */
-    APR_LOCK_DEFAULT        /**< Use the default process lock */
+    APR_LOCK_DEFAULT,       /**< Use the default process lock */
+    APR_LOCK_FUTEX          /**< Linux futex in anonymous shared memory */
 } apr_lockmech_e;
 
 /** Opaque structure representing a process mutex. */
@@ -70,6 +72,7 @@ typedef struct apr_proc_mutex_t apr_proc_mutex_t;
  *            APR_LOCK_SYSVSEM
  *            APR_LOCK_POSIXSEM
  *            APR_LOCK_PROC_PTHREAD
+ *            APR_LOCK_FUTEX
  *            APR_LOCK_DEFAULT     pick the default mechanism for the platform
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
@@ -113,6 +116,19 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_lock(apr_proc_mutex_t *mutex);
  */
 APR_DECLARE(apr_status_t) apr_proc_mutex_trylock(apr_proc_mutex_t *mutex);
 
+/**
+ * Attempt to acquire the lock for the given mutex, giving up if it could
+ * not be acquired within the given time.
+ * @param mutex the mutex on which to attempt the lock acquiring.
+ * @param timeout the maximum time to wait for the lock; a negative value
+ *        waits forever, zero only tries once.
+ * @return APR_TIMEUP if the lock could not be acquired in time.
+ * @remark Mechanisms without native support for timed waits poll the
+ *         lock with apr_proc_mutex_trylock().
+ */
+APR_DECLARE(apr_status_t) apr_proc_mutex_timedlock(apr_proc_mutex_t *mutex,
+                                                   apr_interval_time_t timeout);
+
 /**
  * Release the lock for the given mutex.
  * @param mutex the mutex from which to release the lock.
@@ -0,0 +1,250 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_RESOLVER_H
+#define APR_RESOLVER_H
+
+/**
+ * @file apr_resolver.h
+ * @brief APR Asynchronous Name Resolution
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_network_io.h"
+#include "apr_poll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_resolver Asynchronous Name Resolution
+ * @ingroup APR
+ * @{
+ */
+
+#if APR_HAS_RESOLVER || defined(DOXYGEN)
+
+/**
+ * @remark Host names are submitted to an apr_resolver_t and resolved in
+ * the background, either by apr_sockaddr_info_get() on a small set of
+ * threads or by a built-in stub resolver which queries the nameservers
+ * of /etc/resolv.conf itself.  Completions are collected with
+ * apr_resolver_poll(), whose pollfd (see apr_resolver_pollfd_get()) can
+ * be added to an apr_pollset_t or apr_pollcb_t.
+ *
+ * @remark Answers, including "no such host", are remembered by an
+ * apr_resolver_cache_t which any number of resolvers, in any number of
+ * threads, may share.  The stub resolver keeps answers for the time to
+ * live given by the nameserver; answers from apr_sockaddr_info_get()
+ * carry no time to live and are kept for the maximum of the cache.
+ *
+ * @remark An apr_resolver_t is to be used by one thread at a time.
+ */
+
+/** Opaque resolver */
+typedef struct apr_resolver_t apr_resolver_t;
+
+/** Opaque cache of resolved names, shared by resolvers */
+typedef struct apr_resolver_cache_t apr_resolver_cache_t;
+
+/** @see apr_resolver_query_t */
+typedef struct apr_resolver_query_t apr_resolver_query_t;
+
+/**
+ * A query, owned by the caller and left untouched until it completes.
+ */
+struct apr_resolver_query_t {
+    /** The host name or numeric address to resolve, as given to
+     *  apr_sockaddr_info_get() */
+    const char *hostname;
+    /** The address family, as given to apr_sockaddr_info_get() */
+    apr_int32_t family;
+    /** The port of the resolved addresses */
+    apr_port_t port;
+    /** APR_IPV4_ADDR_OK or APR_IPV6_ADDR_OK, as given to
+     *  apr_sockaddr_info_get() */
+    apr_int32_t flags;
+    /** The pool to allocate the addresses from, not to be used until
+     *  completion */
+    apr_pool_t *pool;
+    /** Free for the caller's use */
+    void *baton;
+    /** The resolved addresses */
+    apr_sockaddr_t *sa;
+    /** How long the answer remains valid, 0 if unknown or -1 for numeric
+     *  addresses */
+    apr_interval_time_t ttl;
+    /** The status of the completed query, as apr_sockaddr_info_get()
+     *  returns it */
+    apr_status_t status;
+    /** For internal use */
+    apr_resolver_query_t *next;
+};
+
+/** Statistics of a cache, see apr_resolver_cache_stats_get() */
+typedef struct apr_resolver_cache_stats_t {
+    /** Queries answered from the cache */
+    apr_uint64_t hits;
+    /** Queries which were resolved */
+    apr_uint64_t misses;
+    /** Names currently in the cache */
+    apr_size_t entries;
+} apr_resolver_cache_stats_t;
+
+/** Resolve with the built-in stub resolver rather than with
+ *  apr_sockaddr_info_get() */
+#define APR_RESOLVER_STUB  0x1
+
+/** The maximum time to live of cached answers when none is given */
+#define APR_RESOLVER_DEFAULT_TTL           apr_time_from_sec(300)
+
+/** The maximum time to live of cached "no such host" answers when none
+ *  is given */
+#define APR_RESOLVER_DEFAULT_NEGATIVE_TTL  apr_time_from_sec(30)
+
+/**
+ * Create a cache of resolved names.
+ * @param cache The new cache
+ * @param max_entries The number of names to keep, 0 for the default
+ * @param max_ttl How long an answer is kept at most, 0 for
+ *                APR_RESOLVER_DEFAULT_TTL
+ * @param negative_ttl How long a "no such host" answer is kept at most,
+ *                     0 for APR_RESOLVER_DEFAULT_NEGATIVE_TTL, or -1 not
+ *                     to keep them
+ * @param p The pool to allocate from, the cache is destroyed with it
+ * @remark The cache must outlive the resolvers using it.
+ */
+APR_DECLARE(apr_status_t) apr_resolver_cache_create(
+                                              apr_resolver_cache_t **cache,
+                                              apr_size_t max_entries,
+                                              apr_interval_time_t max_ttl,
+                                              apr_interval_time_t negative_ttl,
+                                              apr_pool_t *p);
+
+/**
+ * Drop all the answers of a cache.
+ * @param cache The cache
+ */
+APR_DECLARE(void) apr_resolver_cache_clear(apr_resolver_cache_t *cache);
+
+/**
+ * Get the statistics of a cache.
+ * @param cache The cache
+ * @param stats The statistics, counted since the creation of the cache
+ */
+APR_DECLARE(void) apr_resolver_cache_stats_get(apr_resolver_cache_t *cache,
+                                            apr_resolver_cache_stats_t *stats);
+
+/**
+ * Create a resolver.
+ * @param res The new resolver
+ * @param depth The maximum number of queries in flight
+ * @param cache The cache to use, or NULL for none
+ * @param flags Zero or APR_RESOLVER_STUB
+ * @param p The pool to allocate from, the resolver is destroyed with it
+ */
+APR_DECLARE(apr_status_t) apr_resolver_create(apr_resolver_t **res,
+                                              apr_uint32_t depth,
+                                              apr_resolver_cache_t *cache,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p);
+
+/**
+ * Destroy a resolver, waiting for the queries in flight.
+ * @param res The resolver to destroy
+ */
+APR_DECLARE(apr_status_t) apr_resolver_destroy(apr_resolver_t *res);
+
+/**
+ * Query a nameserver other than those of /etc/resolv.conf.
+ * @param res The stub resolver
+ * @param sa The address of the nameserver, port 53 if none is given
+ * @remark The first nameserver added replaces those of /etc/resolv.conf,
+ *         later ones are tried in turn.  Nameservers are to be added
+ *         before the first query is submitted.
+ */
+APR_DECLARE(apr_status_t) apr_resolver_nameserver_add(apr_resolver_t *res,
+                                                     const apr_sockaddr_t *sa);
+
+/**
+ * Set how long the stub resolver waits for each nameserver, and how many
+ * times it goes through them, before failing with the EAI_AGAIN error of
+ * getaddrinfo().
+ * @param res The stub resolver
+ * @param timeout The time to wait for a nameserver, 0 to keep that of
+ *                /etc/resolv.conf
+ * @param attempts The number of rounds, 0 to keep that of
+ *                 /etc/resolv.conf
+ */
+APR_DECLARE(apr_status_t) apr_resolver_timeout_set(apr_resolver_t *res,
+                                                  apr_interval_time_t timeout,
+                                                  int attempts);
+
+/**
+ * Submit a query.
+ * @param res The resolver
+ * @param query The query
+ * @return APR_SUCCESS, APR_EAGAIN if the maximum number of queries is in
+ *         flight, or APR_EINVAL for invalid flags
+ * @remark Numeric addresses, and names answered by the cache or, for the
+ *         stub resolver, by /etc/hosts complete immediately.
+ */
+APR_DECLARE(apr_status_t) apr_resolver_submit(apr_resolver_t *res,
+                                              apr_resolver_query_t *query);
+
+/**
+ * Collect completed queries.
+ * @param res The resolver
+ * @param timeout How long to wait for a completion, -1 for no limit
+ * @param queries The array to store the completed queries in
+ * @param num On entry, the size of @a queries; on exit, the number of
+ *            queries stored
+ * @return APR_SUCCESS, or APR_TIMEUP if nothing completed in time
+ */
+APR_DECLARE(apr_status_t) apr_resolver_poll(apr_resolver_t *res,
+                                            apr_interval_time_t timeout,
+                                            apr_resolver_query_t **queries,
+                                            apr_int32_t *num);
+
+/**
+ * Fill in a pollfd which becomes readable when queries complete, for use
+ * with apr_pollset_add() or apr_pollcb_add().
+ * @param res The resolver
+ * @param pfd The pollfd to fill in; its client_data is left alone
+ * @remark Call apr_resolver_poll() with a timeout of 0 when it signals.
+ */
+APR_DECLARE(void) apr_resolver_pollfd_get(apr_resolver_t *res,
+                                          apr_pollfd_t *pfd);
+
+/**
+ * The name of the method used, "getaddrinfo" or "stub".
+ * @param res The resolver
+ */
+APR_DECLARE(const char *) apr_resolver_method_name(apr_resolver_t *res);
+
+#endif /* APR_HAS_RESOLVER */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_RESOLVER_H */
@@ -52,6 +52,9 @@ typedef apr_size_t   apr_rmm_off_t;
  * @param cont The pool to use for local storage and management
  * @remark Both @param membuf and @param memsize must be aligned
  * (for instance using APR_ALIGN_DEFAULT).
+ * @remark Allocation and free take constant time, whatever the number
+ * of blocks in the region.  APR_EINVAL is returned if @param memsize is
+ * too small to hold the management header, see apr_rmm_overhead_get().
  */
 APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
                                        void *membuf, apr_size_t memsize, 
@@ -69,6 +72,9 @@ APR_DECLARE(apr_status_t) apr_rmm_destroy(apr_rmm_t *rmm);
  * @param lock An apr_anylock_t of the appropriate type of lock
  * @param membuf The block of relocatable memory already under management
  * @param cont The pool to use for local storage and management
+ * @return APR_EINVAL if @param membuf was not initialized by apr_rmm_init,
+ * or was initialized with an incompatible layout (for instance by a
+ * different version of APR).
  */
 APR_DECLARE(apr_status_t) apr_rmm_attach(apr_rmm_t **rmm, apr_anylock_t *lock,
                                          void *membuf, apr_pool_t *cont);
@@ -105,6 +111,8 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_calloc(apr_rmm_t *rmm, apr_size_t reqsize);
  * Free allocation returned by apr_rmm_malloc or apr_rmm_calloc.
  * @param rmm The relocatable memory block
  * @param entity The memory allocation to free
+ * @return APR_EINVAL if @param entity is not a block currently allocated
+ * from @param rmm.
  */
 APR_DECLARE(apr_status_t) apr_rmm_free(apr_rmm_t *rmm, apr_rmm_off_t entity);
 
@@ -0,0 +1,189 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SHM_HASH_H
+#define APR_SHM_HASH_H
+/**
+ * @file apr_shm_hash.h
+ * @brief APR Shared Memory Hash Tables
+ */
+/**
+ * @defgroup APR_Util_SHM_Hash Shared Memory Hash Tables
+ * @ingroup APR
+ * @{
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_anylock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opaque structure to access a hash table living in a (shared) memory
+ * block.  The table itself holds no pointers, only offsets from the
+ * start of the block, so it may be mapped at different addresses in
+ * different processes.
+ *
+ * The table has a fixed number of slots, each large enough to hold a
+ * key of up to key_max bytes and a value of up to val_max bytes, and
+ * uses open addressing.  Every slot is protected by a sequence lock:
+ * readers never block nor write to the shared memory, they retry if
+ * the slot changed while they were copying it.  Writers are serialized
+ * by the apr_anylock_t given at creation (typically an apr_proc_mutex_t
+ * or apr_global_mutex_t when used across processes).
+ */
+typedef struct apr_shm_hash_t apr_shm_hash_t;
+
+/**
+ * Callback invoked when apr_shm_hash_set() needs to evict an entry to
+ * make room for a new one.
+ * @param ctx The context passed to apr_shm_hash_evict_hook_set()
+ * @param key The key of the entry to be evicted
+ * @param klen The length of the key
+ * @param val The value of the entry to be evicted
+ * @param vlen The length of the value
+ * @return Non-zero to allow the eviction, zero to refuse it, in which
+ * case apr_shm_hash_set() fails with APR_ENOSPC.
+ * @remark The hook is called with the writer lock held, it must not
+ * call back into the table.
+ */
+typedef int (apr_shm_hash_evict_fn_t)(void *ctx,
+                                      const void *key, apr_size_t klen,
+                                      const void *val, apr_size_t vlen);
+
+/**
+ * Compute the size of the memory block needed to hold a table.
+ * @param nslots The number of slots (entries) in the table
+ * @param key_max The maximum length of a key
+ * @param val_max The maximum length of a value
+ */
+APR_DECLARE(apr_size_t) apr_shm_hash_size_get(apr_size_t nslots,
+                                              apr_size_t key_max,
+                                              apr_size_t val_max);
+
+/**
+ * Initialize a hash table in a memory block.
+ * @param ht The hash table handle
+ * @param lock An apr_anylock_t of the appropriate type of lock, or NULL
+ *             if there is only ever one writer.
+ * @param membuf The block of memory to hold the table, aligned with
+ *               APR_ALIGN_DEFAULT (for instance apr_shm_baseaddr_get())
+ * @param memsize The size of the memory block
+ * @param key_max The maximum length of a key
+ * @param val_max The maximum length of a value
+ * @param pool The pool to use for local storage and management
+ * @remark The table holds as many slots as fit in @a memsize, see
+ * apr_shm_hash_size_get().
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_init(apr_shm_hash_t **ht,
+                                            apr_anylock_t *lock,
+                                            void *membuf, apr_size_t memsize,
+                                            apr_size_t key_max,
+                                            apr_size_t val_max,
+                                            apr_pool_t *pool);
+
+/**
+ * Attach to a hash table already initialized in a memory block,
+ * for instance by another process.
+ * @param ht The hash table handle
+ * @param lock An apr_anylock_t of the appropriate type of lock, or NULL
+ * @param membuf The block of memory holding the table
+ * @param pool The pool to use for local storage and management
+ * @return APR_EINVAL if @a membuf does not hold a table compatible with
+ * this version of APR.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_attach(apr_shm_hash_t **ht,
+                                              apr_anylock_t *lock,
+                                              void *membuf,
+                                              apr_pool_t *pool);
+
+/**
+ * Set the eviction hook of this handle.  Hooks are local to the
+ * process (and handle) which sets them.
+ * @param ht The hash table handle
+ * @param evict The hook, or NULL to never evict entries
+ * @param ctx The context passed to the hook
+ * @remark When the slots @a key may occupy are all in use, the oldest
+ * one is offered to the hook for eviction.  Without a hook, the table
+ * never evicts.
+ */
+APR_DECLARE(void) apr_shm_hash_evict_hook_set(apr_shm_hash_t *ht,
+                                              apr_shm_hash_evict_fn_t *evict,
+                                              void *ctx);
+
+/**
+ * Look up a key, copying its value out of the table.
+ * @param ht The hash table handle
+ * @param key The key
+ * @param klen The length of the key
+ * @param val The buffer to copy the value to
+ * @param vlen On input the size of @a val, on output the length of
+ *             the value
+ * @return APR_NOTFOUND if the key is not in the table, APR_ENOSPC if
+ * the value does not fit in @a val (*vlen is still set), APR_EBUSY if
+ * a slot stayed under update for too long (by a writer which died, say).
+ * @remark This function is lock free.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_get(apr_shm_hash_t *ht,
+                                           const void *key, apr_size_t klen,
+                                           void *val, apr_size_t *vlen);
+
+/**
+ * Associate a value with a key, replacing any previous value.
+ * @param ht The hash table handle
+ * @param key The key
+ * @param klen The length of the key, at most key_max
+ * @param val The value
+ * @param vlen The length of the value, at most val_max
+ * @return APR_EINVAL if the key or value is too long, APR_ENOSPC if the
+ * table is full and no entry could be evicted.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_set(apr_shm_hash_t *ht,
+                                           const void *key, apr_size_t klen,
+                                           const void *val, apr_size_t vlen);
+
+/**
+ * Remove a key from the table.
+ * @param ht The hash table handle
+ * @param key The key
+ * @param klen The length of the key
+ * @return APR_NOTFOUND if the key is not in the table.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_remove(apr_shm_hash_t *ht,
+                                              const void *key,
+                                              apr_size_t klen);
+
+/**
+ * Get the number of entries in the table.
+ * @param ht The hash table handle
+ */
+APR_DECLARE(apr_size_t) apr_shm_hash_count(apr_shm_hash_t *ht);
+
+/**
+ * Get the number of slots in the table.
+ * @param ht The hash table handle
+ */
+APR_DECLARE(apr_size_t) apr_shm_hash_capacity(apr_shm_hash_t *ht);
+
+#ifdef __cplusplus
+}
+#endif
+/** @} */
+#endif  /* ! APR_SHM_HASH_H */
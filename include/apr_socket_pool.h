@@ -0,0 +1,142 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SOCKET_POOL_H
+#define APR_SOCKET_POOL_H
+
+/**
+ * @file apr_socket_pool.h
+ * @brief APR Outbound Connection Pool
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_network_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_socket_pool Outbound Connection Pool
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * @remark An apr_socket_pool_t keeps the TCP connections released to it
+ * open, per address connected to, and hands them out again to later
+ * apr_socket_pool_acquire() calls for the same address.  The connection
+ * released last is reused first, as the one most likely to be alive and
+ * with its caches warm.  Before a connection is reused it is checked,
+ * with a poll() of no timeout, not to have been closed by the peer.
+ *
+ * @remark Each address has its own lock, held only to push or pop an
+ * idle connection; connecting and checking are done without any lock.
+ */
+
+/** Opaque pool of connections */
+typedef struct apr_socket_pool_t apr_socket_pool_t;
+
+/** Statistics of a connection pool, see apr_socket_pool_stats_get() */
+typedef struct apr_socket_pool_stats_t {
+    /** Acquisitions answered with an idle connection */
+    apr_uint64_t reused;
+    /** Connections made */
+    apr_uint64_t connected;
+    /** Acquisitions refused as the address had its maximum of
+     *  connections */
+    apr_uint64_t refused;
+    /** Idle connections closed as they outlived the idle time to live,
+     *  or to make room for others */
+    apr_uint64_t expired;
+    /** Idle connections found closed by the peer */
+    apr_uint64_t dead;
+    /** Connections currently acquired */
+    apr_uint32_t active;
+    /** Connections currently idle */
+    apr_uint32_t idle;
+    /** Addresses connected to */
+    apr_uint32_t addresses;
+} apr_socket_pool_stats_t;
+
+/**
+ * Create a pool of connections.
+ * @param spool The new connection pool
+ * @param max The maximum number of connections to an address, acquired
+ *            or idle, 0 for no limit
+ * @param max_idle The maximum number of idle connections kept to an
+ *                 address
+ * @param ttl How long a connection may stay idle before it is closed,
+ *            0 for no limit
+ * @param timeout The timeout of the connections, for connecting and as
+ *                they are handed out (see apr_socket_timeout_set())
+ * @param p The pool to allocate from; all the connections are closed
+ *          with it
+ */
+APR_DECLARE(apr_status_t) apr_socket_pool_create(apr_socket_pool_t **spool,
+                                                 apr_uint32_t max,
+                                                 apr_uint32_t max_idle,
+                                                 apr_interval_time_t ttl,
+                                                 apr_interval_time_t timeout,
+                                                 apr_pool_t *p);
+
+/**
+ * Get a connection to an address, idle or new.
+ * @param sock The connection
+ * @param spool The connection pool
+ * @param sa The address to connect to; only the first of the list is
+ *           used
+ * @return APR_SUCCESS, APR_EAGAIN if the address has its maximum of
+ *         connections, or the error of apr_socket_connect()
+ * @remark The connection must be given back with
+ *         apr_socket_pool_release(), and not be closed otherwise.
+ */
+APR_DECLARE(apr_status_t) apr_socket_pool_acquire(apr_socket_t **sock,
+                                                  apr_socket_pool_t *spool,
+                                                  apr_sockaddr_t *sa);
+
+/**
+ * Give back a connection obtained from apr_socket_pool_acquire().
+ * @param spool The connection pool
+ * @param sock The connection
+ * @param reuse Whether the connection may be reused, i.e. whether it is
+ *              between requests of its protocol; if not it is closed
+ * @return APR_SUCCESS, or APR_EINVAL if the connection is not of
+ *         @a spool
+ */
+APR_DECLARE(apr_status_t) apr_socket_pool_release(apr_socket_pool_t *spool,
+                                                  apr_socket_t *sock,
+                                                  int reuse);
+
+/**
+ * Get the statistics of a connection pool.
+ * @param spool The connection pool
+ * @param stats The statistics, counted since the creation of the pool
+ * @remark The rate of reuse is @a reused / (@a reused + @a connected).
+ */
+APR_DECLARE(void) apr_socket_pool_stats_get(apr_socket_pool_t *spool,
+                                            apr_socket_pool_stats_t *stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_SOCKET_POOL_H */
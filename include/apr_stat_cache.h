@@ -0,0 +1,155 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_STAT_CACHE_H
+#define APR_STAT_CACHE_H
+
+/**
+ * @file apr_stat_cache.h
+ * @brief APR Stat Cache
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_file_info.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_stat_cache Stat Cache
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * @remark A stat cache remembers the results of apr_stat(), including
+ * "not found", keyed by the name given.  Entries are dropped when the
+ * file changes, as reported by inotify watches on the directories of the
+ * names looked up, and in any case when their time to live expires.
+ *
+ * @remark Lookups are lock-free where the compiler provides atomic
+ * builtins; the cache may be used by any number of threads.
+ *
+ * @remark Changes made through another name of the file (a hard link, a
+ * symbolic link to the file or to one of its parent directories) and the
+ * renaming of a grandparent directory are not noticed by the watches,
+ * and only show once the time to live expired.  Names are cached as given; a process changing its working
+ * directory should look up absolute names.
+ */
+
+/** Opaque stat cache */
+typedef struct apr_stat_cache_t apr_stat_cache_t;
+
+/** Statistics of a stat cache, see apr_stat_cache_stats_get() */
+typedef struct apr_stat_cache_stats_t {
+    /** Lookups answered from the cache */
+    apr_uint64_t hits;
+    /** Lookups which went to apr_stat() */
+    apr_uint64_t misses;
+    /** Entries dropped to make room for others */
+    apr_uint64_t evictions;
+    /** Entries dropped because the file changed */
+    apr_uint64_t invalidations;
+    /** Entries currently in the cache */
+    apr_size_t entries;
+    /** Directories currently watched */
+    apr_size_t watches;
+} apr_stat_cache_stats_t;
+
+/** Do not watch for changes, rely on the time to live only */
+#define APR_STAT_CACHE_TTL_ONLY  0x1
+
+/** The time to live used when none is given */
+#define APR_STAT_CACHE_DEFAULT_TTL  apr_time_from_sec(1)
+
+/**
+ * Create a stat cache.
+ * @param cache The new cache
+ * @param max_entries The number of entries to keep, 0 for the default
+ * @param ttl How long an entry is used at most, watched or not, 0 for
+ *            APR_STAT_CACHE_DEFAULT_TTL
+ * @param flags Zero or APR_STAT_CACHE_TTL_ONLY
+ * @param p The pool to allocate from, the cache is destroyed with it
+ */
+APR_DECLARE(apr_status_t) apr_stat_cache_create(apr_stat_cache_t **cache,
+                                                apr_size_t max_entries,
+                                                apr_interval_time_t ttl,
+                                                apr_int32_t flags,
+                                                apr_pool_t *p);
+
+/**
+ * Destroy a stat cache.
+ * @param cache The cache to destroy
+ */
+APR_DECLARE(apr_status_t) apr_stat_cache_destroy(apr_stat_cache_t *cache);
+
+/**
+ * Get the specified file's stats, as apr_stat() does, from the cache when
+ * possible.
+ * @param cache The cache
+ * @param finfo Where to store the information about the file
+ * @param fname The name of the file to stat
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of
+ *               APR_FINFO_* values
+ * @param pool The pool to use for the returned information
+ * @remark Lookups asking for APR_FINFO_NAME bypass the cache.
+ */
+APR_DECLARE(apr_status_t) apr_stat_cache_stat(apr_stat_cache_t *cache,
+                                              apr_finfo_t *finfo,
+                                              const char *fname,
+                                              apr_int32_t wanted,
+                                              apr_pool_t *pool);
+
+/**
+ * Drop the entries of a name, for changes the cache cannot notice.
+ * @param cache The cache
+ * @param fname The name, as given to apr_stat_cache_stat()
+ */
+APR_DECLARE(void) apr_stat_cache_invalidate(apr_stat_cache_t *cache,
+                                            const char *fname);
+
+/**
+ * Drop all the entries.
+ * @param cache The cache
+ */
+APR_DECLARE(void) apr_stat_cache_clear(apr_stat_cache_t *cache);
+
+/**
+ * Get the statistics of a cache.
+ * @param cache The cache
+ * @param stats The statistics, counted since the creation of the cache
+ * @remark The hit rate is hits / (hits + misses).
+ */
+APR_DECLARE(void) apr_stat_cache_stats_get(apr_stat_cache_t *cache,
+                                           apr_stat_cache_stats_t *stats);
+
+/**
+ * The name of the method used to notice changes, "inotify" or "ttl".
+ * @param cache The cache
+ */
+APR_DECLARE(const char *) apr_stat_cache_method_name(apr_stat_cache_t *cache);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_STAT_CACHE_H */
@@ -43,6 +43,7 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
 #define APR_THREAD_MUTEX_DEFAULT  0x0   /**< platform-optimal lock behavior */
 #define APR_THREAD_MUTEX_NESTED   0x1   /**< enable nested (recursive) locks */
 #define APR_THREAD_MUTEX_UNNESTED 0x2   /**< disable nested locks */
+#define APR_THREAD_MUTEX_SPIN     0x4   /**< spin briefly before blocking */
 
 /* Delayed the include to avoid a circular reference */
 #include "apr_pools.h"
@@ -56,11 +57,17 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
  *           APR_THREAD_MUTEX_DEFAULT   platform-optimal lock behavior.
  *           APR_THREAD_MUTEX_NESTED    enable nested (recursive) locks.
  *           APR_THREAD_MUTEX_UNNESTED  disable nested locks (non-recursive).
+ *           APR_THREAD_MUTEX_SPIN      spin for a bounded, adaptive number
+ *                                      of iterations before blocking.
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
  * @warning Be cautious in using APR_THREAD_MUTEX_DEFAULT.  While this is the
  * most optimal mutex based on a given platform's performance characteristics,
  * it will behave as either a nested or an unnested lock.
+ * @remark APR_THREAD_MUTEX_SPIN pays off for locks which are only held for
+ * a short time; waiters then usually get the lock without a trip through
+ * the kernel.  It is a hint, ignored on uniprocessors and on platforms
+ * without support for it.
  */
 APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
                                                   unsigned int flags,
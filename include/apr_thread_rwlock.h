@@ -41,6 +41,13 @@ extern "C" {
 /** Opaque read-write thread-safe lock. */
 typedef struct apr_thread_rwlock_t apr_thread_rwlock_t;
 
+#define APR_THREAD_RWLOCK_DEFAULT       0x0 /**< platform default behavior */
+#define APR_THREAD_RWLOCK_PREFER_WRITER 0x1 /**< waiting writers block new
+                                                 readers */
+#define APR_THREAD_RWLOCK_SPIN          0x2 /**< spin briefly before
+                                                 blocking */
+#define APR_THREAD_RWLOCK_PERCPU        0x4 /**< per-CPU reader slots */
+
 /**
  * Note: The following operations have undefined results: unlocking a
  * read-write lock which is not locked in the calling thread; write
@@ -59,6 +66,38 @@ typedef struct apr_thread_rwlock_t apr_thread_rwlock_t;
  */
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool);
+
+/**
+ * Create and initialize a read-write lock with the given behavior.
+ * @param rwlock the memory address where the newly created readwrite lock
+ *        will be stored.
+ * @param flags Or'ed value of:
+ * <PRE>
+ *           APR_THREAD_RWLOCK_DEFAULT        same as apr_thread_rwlock_create().
+ *           APR_THREAD_RWLOCK_PREFER_WRITER  a waiting writer blocks new
+ *                                            readers, so that writers are
+ *                                            not starved by a steady stream
+ *                                            of readers.
+ *           APR_THREAD_RWLOCK_SPIN           spin for a bounded, adaptive
+ *                                            number of iterations before
+ *                                            blocking.
+ *           APR_THREAD_RWLOCK_PERCPU         spread readers over per-CPU
+ *                                            slots, so that read locking
+ *                                            does not bounce a shared cache
+ *                                            line between CPUs.
+ * </PRE>
+ * @param pool the pool from which to allocate the mutex.
+ * @return APR_ENOTIMPL if APR_THREAD_RWLOCK_PREFER_WRITER is requested and
+ * the platform cannot provide it.
+ * @remark APR_THREAD_RWLOCK_SPIN and APR_THREAD_RWLOCK_PERCPU are hints,
+ * ignored where they are not supported.  APR_THREAD_RWLOCK_PERCPU suits
+ * read-mostly data only: a write lock has to be taken on every slot.
+ * With APR_THREAD_RWLOCK_PREFER_WRITER a thread must not take a read lock
+ * it already holds again, since a waiting writer would deadlock it.
+ */
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool);
 /**
  * Acquire a shared-read lock on the given read-write lock. This will allow
  * multiple threads to enter the same critical section while they have acquired
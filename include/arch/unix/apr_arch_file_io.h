@@ -89,6 +89,11 @@
 /* End System headers */
 
 #define APR_FILE_DEFAULT_BUFSIZE 4096
+/* Buffer size of APR_FOPEN_SEQUENTIAL files */
+#define APR_FILE_SEQUENTIAL_BUFSIZE 65536
+/* How far such files are read ahead, and pages dropped behind for
+ * APR_FOPEN_NOCACHE files, at a time */
+#define APR_FILE_READAHEAD (16 * APR_FILE_SEQUENTIAL_BUFSIZE)
 /* For backwards-compat */
 #define APR_FILE_BUFSIZE  APR_FILE_DEFAULT_BUFSIZE
 
@@ -123,6 +128,8 @@ struct apr_file_t {
     unsigned long dataRead;   /* amount of valid data read into buffer */
     int direction;            /* buffer being used for 0 = read, 1 = write */
     apr_off_t filePtr;        /* position in file of handle */
+    apr_off_t readahead_end;  /* end of the range advised to read ahead */
+    apr_off_t dropped_end;    /* end of the range advised to drop */
 #if APR_HAS_THREADS
     struct apr_thread_mutex_t *thlock;
 #endif
@@ -149,6 +156,9 @@ struct apr_file_t {
 #define fstat(f,b) fstat64(f,b)
 #define lseek(f,o,w) lseek64(f,o,w)
 #define ftruncate(f,l) ftruncate64(f,l)
+#ifdef HAVE_FSTATAT
+#define fstatat(d,f,b,l) fstatat64(d,f,b,l)
+#endif
 typedef struct stat64 struct_stat;
 #else
 typedef struct stat struct_stat;
@@ -169,6 +179,15 @@ struct apr_dir_t {
 #else
     struct dirent *entry;
 #endif
+#ifdef HAVE_GETDENTS64
+    /* getdents64() buffer of apr_dir_read_batch() */
+    char *dents;
+    apr_size_t dents_len;
+    apr_size_t dents_pos;
+#endif
+#if APR_HAS_THREADS
+    struct apr_thread_pool *tp;
+#endif
 };
 
 apr_status_t apr_unix_file_cleanup(void *);
@@ -176,8 +195,21 @@ apr_status_t apr_unix_child_file_cleanup(void *);
 
 mode_t apr_unix_perms2mode(apr_fileperms_t perms);
 apr_fileperms_t apr_unix_mode2perms(mode_t mode);
+void apr_unix_fill_finfo(apr_finfo_t *finfo, struct_stat *info,
+                         apr_int32_t wanted);
 
 apr_status_t apr_file_flush_locked(apr_file_t *thefile);
+
+#if APR_HAS_SPLICE
+/* Move up to *len bytes from fdin to fdout with splice(), one of them
+ * being a pipe.  The timeouts are those of the descriptors: -1 for a
+ * blocking one, 0 for a non-blocking one, and otherwise the time to wait
+ * for it to become ready.
+ */
+apr_status_t apr_unix_splice(int fdin, apr_interval_time_t tin, int in_pipe,
+                             int fdout, apr_interval_time_t tout,
+                             int out_pipe, apr_size_t *len);
+#endif
 apr_status_t apr_file_info_get_locked(apr_finfo_t *finfo, apr_int32_t wanted,
                                       apr_file_t *thefile);
 
@@ -52,6 +52,9 @@
 #if APR_HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
 #if APR_HAVE_NETINET_SCTP_UIO_H
 #include <netinet/sctp_uio.h>
 #endif
@@ -120,6 +123,7 @@ struct apr_socket_t {
     apr_int32_t options;
     apr_int32_t inherit;
     sock_userdata_t *userdata;
+    apr_socket_stats_t stats;
 #ifndef WAITIO_USES_POLL
     /* if there is a timeout set, then this pollset is used */
     apr_pollset_t *pollset;
@@ -130,6 +134,27 @@ const char *apr_inet_ntop(int af, const void *src, char *dst, apr_size_t size);
 int apr_inet_pton(int af, const char *src, void *dst);
 void apr_sockaddr_vars_set(apr_sockaddr_t *, int, apr_port_t);
 
+/* Count a system call of skt which returned rv, as per errno */
+#define apr_socket_stats_count(skt, calls, bytes, eagain, rv)   \
+    do {                                                        \
+        (skt)->stats.calls++;                                   \
+        if ((rv) > 0)                                           \
+            (skt)->stats.bytes += (rv);                         \
+        else if ((rv) == -1 && (errno == EAGAIN                 \
+                                || errno == EWOULDBLOCK))       \
+            (skt)->stats.eagain++;                              \
+    } while (0)
+
+#define apr_socket_stats_send(skt, rv) \
+    apr_socket_stats_count(skt, send_calls, bytes_sent, send_eagain, rv)
+
+#define apr_socket_stats_recv(skt, rv) \
+    apr_socket_stats_count(skt, recv_calls, bytes_received, recv_eagain, rv)
+
+/* Peeked bytes are counted when they are actually received */
+#define apr_socket_stats_recv_flags(skt, rv, flags) \
+    apr_socket_stats_recv(skt, ((flags) & MSG_PEEK) && (rv) > 0 ? 0 : (rv))
+
 #define apr_is_option_set(skt, option)  \
     (((skt)->options & (option)) == (option))
 
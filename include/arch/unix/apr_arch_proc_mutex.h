@@ -26,6 +26,7 @@
 #include "apr_portable.h"
 #include "apr_file_io.h"
 #include "apr_arch_file_io.h"
+#include "apr_lock_profile_internal.h"
 
 /* System headers required by Locks library */
 #if APR_HAVE_SYS_TYPES_H
@@ -65,6 +66,10 @@
 #if APR_HAVE_SEMAPHORE_H
 #include <semaphore.h>
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 /* End System Headers */
 
 struct apr_proc_mutex_unix_lock_methods_t {
@@ -72,6 +77,7 @@ struct apr_proc_mutex_unix_lock_methods_t {
     apr_status_t (*create)(apr_proc_mutex_t *, const char *);
     apr_status_t (*acquire)(apr_proc_mutex_t *);
     apr_status_t (*tryacquire)(apr_proc_mutex_t *);
+    apr_status_t (*timedacquire)(apr_proc_mutex_t *, apr_interval_time_t);
     apr_status_t (*release)(apr_proc_mutex_t *);
     apr_status_t (*cleanup)(void *);
     apr_status_t (*child_init)(apr_proc_mutex_t **, apr_pool_t *, const char *);
@@ -106,6 +112,10 @@ struct apr_proc_mutex_t {
 #if APR_HAS_PROC_PTHREAD_SERIALIZE
     pthread_mutex_t *pthread_interproc;
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    struct apr_proc_mutex_futex_t *futex_interproc;
+#endif
+    apr_lock_profile_t *prof;
 };
 
 void apr_proc_mutex_unix_setup_lock(void);
@@ -24,6 +24,7 @@
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
 #include "apr_pools.h"
+#include "apr_lock_profile_internal.h"
 
 #if APR_HAVE_PTHREAD_H
 #include <pthread.h>
@@ -35,6 +36,7 @@
 struct apr_thread_cond_t {
     apr_pool_t *pool;
     pthread_cond_t cond;
+    apr_lock_profile_t *prof;
 };
 #endif
 
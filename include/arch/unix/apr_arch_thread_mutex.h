@@ -23,16 +23,68 @@
 #include "apr_thread_mutex.h"
 #include "apr_portable.h"
 #include "apr_atomic.h"
+#include "apr_lock_profile_internal.h"
 
 #if APR_HAVE_PTHREAD_H
 #include <pthread.h>
 #endif
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #if APR_HAS_THREADS
 struct apr_thread_mutex_t {
     apr_pool_t *pool;
     pthread_mutex_t mutex;
+    int spin_max;                /* 0 unless APR_THREAD_MUTEX_SPIN */
+    volatile apr_uint32_t spins; /* recent successful spin count */
+    apr_lock_profile_t *prof;    /* NULL unless profiled */
 };
+
+/* Upper bound for the adaptive spinning of the thread locks. */
+#define APR_THREAD_SPIN_MAX 100
+
+/* Spin limit to use for a lock created with a spin flag: spinning
+ * only makes sense if the lock holder can run on another CPU. */
+static APR_INLINE int apr_thread_spin_max(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        return APR_THREAD_SPIN_MAX;
+    }
+#endif
+    return 0;
+}
+
+/* CPU hint for busy-wait loops. */
+static APR_INLINE void apr_thread_spin_pause(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    __asm__ __volatile__ ("pause" : : : "memory");
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__ ("yield" : : : "memory");
+#endif
+}
+
+/* Bound for the next spin phase: about twice the recent average. */
+static APR_INLINE int apr_thread_spin_limit(volatile apr_uint32_t *spins,
+                                            int spin_max)
+{
+    int limit = (int)*spins * 2 + 10;
+
+    return limit < spin_max ? limit : spin_max;
+}
+
+/* Fold the length of a finished spin phase into the running average. */
+static APR_INLINE void apr_thread_spin_update(volatile apr_uint32_t *spins,
+                                              int n)
+{
+    int cur = (int)*spins;
+
+    if (n != cur) {
+        *spins = (apr_uint32_t)(cur + (n - cur) / 8);
+    }
+}
 #endif
 
 #endif  /* THREAD_MUTEX_H */
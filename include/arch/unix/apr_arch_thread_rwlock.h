@@ -22,6 +22,7 @@
 #include "apr_general.h"
 #include "apr_thread_rwlock.h"
 #include "apr_pools.h"
+#include "apr_lock_profile_internal.h"
 
 #if APR_HAVE_PTHREAD_H
 /* this gives us pthread_rwlock_t */
@@ -31,9 +32,21 @@
 #if APR_HAS_THREADS
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+/* APR_THREAD_RWLOCK_PERCPU reader slot, one per cache line */
+typedef union apr_thread_rwlock_slot_t {
+    pthread_rwlock_t rwlock;
+    char pad[(sizeof(pthread_rwlock_t) + 63) & ~63];
+} apr_thread_rwlock_slot_t;
+
 struct apr_thread_rwlock_t {
     apr_pool_t *pool;
     pthread_rwlock_t rwlock;
+    int spin_max;                /* 0 unless APR_THREAD_RWLOCK_SPIN */
+    volatile apr_uint32_t spins; /* recent successful spin count */
+    apr_thread_rwlock_slot_t *slots; /* NULL unless APR_THREAD_RWLOCK_PERCPU */
+    unsigned int nslots;         /* power of two */
+    int wrlocked;                /* all slots held by a writer */
+    apr_lock_profile_t *prof;    /* NULL unless profiled */
 };
 
 #else
@@ -0,0 +1,84 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_BUCKETS_INTERNAL_H
+#define APR_BUCKETS_INTERNAL_H
+
+/**
+ * @file apr_buckets_internal.h
+ * @brief Helpers shared by the bucket implementations
+ */
+
+#include "apr_buckets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Socket and pipe buckets keep the size of their next read in their
+ * otherwise unused start field: the low 5 bits hold n for a read of
+ * min_read << n bytes, the next 5 bits the largest n allowed, and the
+ * bits above min_read.  With the default min_read of APR_BUCKET_BUFF_SIZE
+ * the buffers stay just below a power of two times 8KB, leaving room for
+ * the allocator headers.  A negative start, as set by
+ * apr_bucket_socket_make() and apr_bucket_pipe_make(), stands for reads
+ * of APR_BUCKET_BUFF_SIZE bytes always.
+ */
+
+/** The read state of a new bucket with the given bounds */
+apr_off_t apr_bucket_read_init(apr_size_t min_read, apr_size_t max_read);
+
+/** The size of the next read */
+apr_size_t apr_bucket_read_size(apr_off_t state);
+
+/** The read state after a read of @a got bytes */
+apr_off_t apr_bucket_read_next(apr_off_t state, apr_size_t got);
+
+/*
+ * Slabs are handed out by the bucket allocator, which keeps a reference
+ * to its current slab and a small cache of unused ones.  A slab fills an
+ * APR_BUCKET_BUFF_SIZE allocation, headed by its structure.
+ */
+
+/** The size of a slab's data */
+#define APR_BUCKET_SLAB_SIZE \
+    (APR_BUCKET_BUFF_SIZE - APR_ALIGN_DEFAULT(sizeof(apr_bucket_slab)))
+
+/**
+ * The allocator's current slab, replaced by an empty one if fewer than
+ * @a len bytes are left in it.  @a len must not exceed APR_BUCKET_SLAB_SIZE.
+ * @return The slab, or NULL if allocation failed
+ */
+apr_bucket_slab *apr_bucket_slab_get(apr_bucket_alloc_t *list,
+                                     apr_size_t len);
+
+/** Return a slab whose refcount dropped to zero to its allocator */
+void apr_bucket_slab_put(apr_bucket_slab *slab);
+
+/**
+ * Make @a b a slab bucket of @a length bytes, left for the caller to
+ * fill in at @a buf; a heap bucket if @a length exceeds a slab.
+ * @return @a b, or NULL if allocation failed
+ */
+apr_bucket *apr_bucket_slab_reserve(apr_bucket *b, apr_size_t length,
+                                    char **buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_BUCKETS_INTERNAL_H */
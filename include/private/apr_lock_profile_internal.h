@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_LOCK_PROFILE_INTERNAL_H
+#define APR_LOCK_PROFILE_INTERNAL_H
+
+/**
+ * @file apr_lock_profile_internal.h
+ * @brief Hooks for the lock implementations to feed apr_lock_profile
+ */
+
+#include "apr_lock_profile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** Per lock statistics, NULL for locks which are not profiled */
+typedef struct apr_lock_profile_t apr_lock_profile_t;
+
+/**
+ * Start profiling a lock, if profiling is enabled.
+ * @return The profile to pass to the other hooks, or NULL.
+ */
+apr_lock_profile_t *apr_lock_profile_register(const void *lock,
+                                              const char *type,
+                                              apr_pool_t *pool);
+
+/**
+ * Give a profile the name of another, for a lock made of other locks
+ * to be reported under the name given for it.
+ */
+void apr_lock_profile_name_copy(apr_lock_profile_t *to,
+                                apr_lock_profile_t *from);
+
+/** Stop profiling a lock which is being destroyed. */
+void apr_lock_profile_unregister(apr_lock_profile_t *prof);
+
+/**
+ * Record an exclusive acquisition; wait is negative if the lock was
+ * acquired without waiting.  Must be called with the lock held.
+ */
+void apr_lock_profile_acquired(apr_lock_profile_t *prof,
+                               apr_interval_time_t wait);
+
+/** Record a shared (read) acquisition, see apr_lock_profile_acquired(). */
+void apr_lock_profile_shared(apr_lock_profile_t *prof,
+                             apr_interval_time_t wait);
+
+/**
+ * Record the end of an exclusive hold, before the lock is released.
+ * Does nothing when releasing a shared hold.
+ */
+void apr_lock_profile_released(apr_lock_profile_t *prof);
+
+/** Record a condition variable wait. */
+void apr_lock_profile_waited(apr_lock_profile_t *prof,
+                             apr_interval_time_t wait, int timedout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_LOCK_PROFILE_INTERNAL_H */
@@ -26,6 +26,11 @@ static apr_status_t global_mutex_cleanup(void *data)
     apr_global_mutex_t *m = (apr_global_mutex_t *)data;
     apr_status_t rv;
 
+    if (m->prof) {
+        apr_lock_profile_unregister(m->prof);
+        m->prof = NULL;
+    }
+
     rv = apr_proc_mutex_destroy(m->proc_mutex);
 
 #if APR_HAS_THREADS
@@ -42,6 +47,27 @@ static apr_status_t global_mutex_cleanup(void *data)
     return rv;
 }
 
+/* Profile the global mutex as a whole rather than its parts, under the
+ * name given for it (which went to its process mutex, created first).
+ */
+static void global_mutex_profile(apr_global_mutex_t *m)
+{
+    m->prof = apr_lock_profile_register(m, "global_mutex", m->pool);
+    if (m->proc_mutex->prof) {
+        if (m->prof) {
+            apr_lock_profile_name_copy(m->prof, m->proc_mutex->prof);
+        }
+        apr_lock_profile_unregister(m->proc_mutex->prof);
+        m->proc_mutex->prof = NULL;
+    }
+#if APR_HAS_THREADS
+    if (m->thread_mutex && m->thread_mutex->prof) {
+        apr_lock_profile_unregister(m->thread_mutex->prof);
+        m->thread_mutex->prof = NULL;
+    }
+#endif /* APR_HAS_THREADS */
+}
+
 APR_DECLARE(apr_status_t) apr_global_mutex_create(apr_global_mutex_t **mutex,
                                                   const char *fname,
                                                   apr_lockmech_e mech,
@@ -72,6 +98,8 @@ APR_DECLARE(apr_status_t) apr_global_mutex_create(apr_global_mutex_t **mutex,
     }
 #endif /* APR_HAS_THREADS */
 
+    global_mutex_profile(m);
+
     apr_pool_cleanup_register(m->pool, (void *)m,
                               global_mutex_cleanup, apr_pool_cleanup_null);
     *mutex = m;
@@ -89,7 +117,9 @@ APR_DECLARE(apr_status_t) apr_global_mutex_child_init(
     return rv;
 }
 
-APR_DECLARE(apr_status_t) apr_global_mutex_lock(apr_global_mutex_t *mutex)
+static apr_status_t global_mutex_trylock(apr_global_mutex_t *mutex);
+
+static apr_status_t global_mutex_lock(apr_global_mutex_t *mutex)
 {
     apr_status_t rv;
 
@@ -115,7 +145,28 @@ APR_DECLARE(apr_status_t) apr_global_mutex_lock(apr_global_mutex_t *mutex)
     return rv;
 }
 
-APR_DECLARE(apr_status_t) apr_global_mutex_trylock(apr_global_mutex_t *mutex)
+APR_DECLARE(apr_status_t) apr_global_mutex_lock(apr_global_mutex_t *mutex)
+{
+    apr_time_t start;
+    apr_status_t rv;
+
+    if (!mutex->prof) {
+        return global_mutex_lock(mutex);
+    }
+
+    if (global_mutex_trylock(mutex) == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    rv = global_mutex_lock(mutex);
+    if (rv == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, apr_time_now() - start);
+    }
+    return rv;
+}
+
+static apr_status_t global_mutex_trylock(apr_global_mutex_t *mutex)
 {
     apr_status_t rv;
 
@@ -141,10 +192,25 @@ APR_DECLARE(apr_status_t) apr_global_mutex_trylock(apr_global_mutex_t *mutex)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_global_mutex_trylock(apr_global_mutex_t *mutex)
+{
+    apr_status_t rv;
+
+    rv = global_mutex_trylock(mutex);
+    if (rv == APR_SUCCESS && mutex->prof) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+    }
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_global_mutex_unlock(apr_global_mutex_t *mutex)
 {
     apr_status_t rv;
 
+    if (mutex->prof) {
+        apr_lock_profile_released(mutex->prof);
+    }
+
     rv = apr_proc_mutex_unlock(mutex->proc_mutex);
 #if APR_HAS_THREADS
     if (mutex->thread_mutex) {
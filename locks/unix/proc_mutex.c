@@ -19,6 +19,8 @@
 #include "apr_arch_proc_mutex.h"
 #include "apr_arch_file_io.h" /* for apr_mkstemp() */
 #include "apr_md5.h" /* for apr_md5() */
+#include "apr_atomic.h"
+#include "apr_time.h"
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_destroy(apr_proc_mutex_t *mutex)
 {
@@ -26,7 +28,8 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_destroy(apr_proc_mutex_t *mutex)
 }
 
 #if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_FCNTL_SERIALIZE || \
-    APR_HAS_PROC_PTHREAD_SERIALIZE || APR_HAS_SYSVSEM_SERIALIZE
+    APR_HAS_PROC_PTHREAD_SERIALIZE || APR_HAS_SYSVSEM_SERIALIZE || \
+    APR_HAS_FUTEX_SERIALIZE
 static apr_status_t proc_mutex_no_child_init(apr_proc_mutex_t **mutex,
                                              apr_pool_t *cont,
                                              const char *fname)
@@ -35,7 +38,8 @@ static apr_status_t proc_mutex_no_child_init(apr_proc_mutex_t **mutex,
 }
 #endif    
 
-#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE
+#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE || \
+    APR_HAS_FUTEX_SERIALIZE
 static apr_status_t proc_mutex_no_perms_set(apr_proc_mutex_t *mutex,
                                             apr_fileperms_t perms,
                                             apr_uid_t uid,
@@ -181,6 +185,7 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_posixsem_methods =
     proc_mutex_posix_create,
     proc_mutex_posix_acquire,
     proc_mutex_posix_tryacquire,
+    NULL,
     proc_mutex_posix_release,
     proc_mutex_posix_cleanup,
     proc_mutex_no_child_init,
@@ -321,6 +326,7 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_sysv_methods =
     proc_mutex_sysv_create,
     proc_mutex_sysv_acquire,
     proc_mutex_sysv_tryacquire,
+    NULL,
     proc_mutex_sysv_release,
     proc_mutex_sysv_cleanup,
     proc_mutex_no_child_init,
@@ -517,6 +523,7 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_proc_pthread_methods =
     proc_mutex_proc_pthread_create,
     proc_mutex_proc_pthread_acquire,
     proc_mutex_proc_pthread_tryacquire,
+    NULL,
     proc_mutex_proc_pthread_release,
     proc_mutex_proc_pthread_cleanup,
     proc_mutex_no_child_init,
@@ -526,6 +533,280 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_proc_pthread_methods =
 
 #endif
 
+#if APR_HAS_FUTEX_SERIALIZE
+
+/* The futex word holds the pid of the owner, or zero while the mutex
+ * is free.  PROC_FUTEX_WAITERS is set once a contender has gone (or is
+ * about to go) to sleep in the kernel, so that release only pays for
+ * FUTEX_WAKE when somebody may actually be waiting.  Waiters sleep in
+ * slices of PROC_FUTEX_SLICE and check whether the owner still exists
+ * whenever a slice expires, which lets the mutex survive the death of
+ * a process holding it.
+ */
+#define PROC_FUTEX_WAITERS      0x80000000U
+#define PROC_FUTEX_PID_MASK     0x3fffffffU
+#define PROC_FUTEX_MAX_SPINS    100
+#define PROC_FUTEX_SLICE        apr_time_from_msec(50)
+
+struct apr_proc_mutex_futex_t {
+    volatile apr_uint32_t word;
+    /* running estimate of the spins which succeeded, shared by all
+     * processes using the mutex */
+    volatile apr_uint32_t spins;
+};
+
+static int proc_mutex_futex_ncpus;
+static apr_uint32_t proc_mutex_futex_pid;
+
+#if APR_HAS_THREADS
+static void proc_mutex_futex_atfork_child(void)
+{
+    proc_mutex_futex_pid = (apr_uint32_t)getpid() & PROC_FUTEX_PID_MASK;
+}
+#endif
+
+static void proc_mutex_futex_setup(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    proc_mutex_futex_ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    proc_mutex_futex_pid = (apr_uint32_t)getpid() & PROC_FUTEX_PID_MASK;
+#if APR_HAS_THREADS
+    /* getpid() is a system call on current libcs; keep the owner id
+     * of this process at hand and refresh it in forked children. */
+    pthread_atfork(NULL, NULL, proc_mutex_futex_atfork_child);
+#endif
+}
+
+static APR_INLINE apr_uint32_t proc_mutex_futex_self(void)
+{
+#if APR_HAS_THREADS
+    return proc_mutex_futex_pid;
+#else
+    return (apr_uint32_t)getpid() & PROC_FUTEX_PID_MASK;
+#endif
+}
+
+static APR_INLINE void proc_mutex_futex_relax(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    __asm__ __volatile__ ("pause" : : : "memory");
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__ ("yield" : : : "memory");
+#endif
+}
+
+static int proc_mutex_futex_wait(volatile apr_uint32_t *word,
+                                 apr_uint32_t val,
+                                 apr_interval_time_t timeout)
+{
+    struct timespec ts;
+
+    ts.tv_sec = apr_time_sec(timeout);
+    ts.tv_nsec = apr_time_usec(timeout) * 1000;
+    if (syscall(SYS_futex, word, FUTEX_WAIT, val, &ts, NULL, 0) == -1) {
+        return errno;
+    }
+    return 0;
+}
+
+static void proc_mutex_futex_wake(volatile apr_uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static int proc_mutex_futex_owner_dead(apr_uint32_t word)
+{
+    pid_t owner = (pid_t)(word & PROC_FUTEX_PID_MASK);
+
+    return owner && kill(owner, 0) == -1 && errno == ESRCH;
+}
+
+static apr_status_t proc_mutex_futex_cleanup(void *mutex_)
+{
+    apr_proc_mutex_t *mutex = mutex_;
+    struct apr_proc_mutex_futex_t *futex = mutex->futex_interproc;
+
+    if (mutex->curr_locked == 1) {
+        mutex->curr_locked = 0;
+        if (apr_atomic_xchg32(&futex->word, 0) & PROC_FUTEX_WAITERS) {
+            proc_mutex_futex_wake(&futex->word);
+        }
+    }
+    if (munmap((caddr_t)futex, sizeof(*futex))) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_create(apr_proc_mutex_t *new_mutex,
+                                            const char *fname)
+{
+    void *mem;
+
+    mem = mmap(NULL, sizeof(struct apr_proc_mutex_futex_t),
+               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return errno;
+    }
+    new_mutex->futex_interproc = mem;
+    new_mutex->futex_interproc->word = 0;
+    new_mutex->futex_interproc->spins = 0;
+    new_mutex->curr_locked = 0;
+
+    apr_pool_cleanup_register(new_mutex->pool,
+                              (void *)new_mutex,
+                              apr_proc_mutex_cleanup, 
+                              apr_pool_cleanup_null);
+    return APR_SUCCESS;
+}
+
+/* Acquire the mutex, giving up after timeout (negative waits forever).
+ */
+static apr_status_t proc_mutex_futex_lock(apr_proc_mutex_t *mutex,
+                                          apr_interval_time_t timeout)
+{
+    struct apr_proc_mutex_futex_t *futex = mutex->futex_interproc;
+    apr_uint32_t self = proc_mutex_futex_self();
+    apr_time_t deadline = 0;
+    apr_uint32_t word;
+
+    if (apr_atomic_cas32(&futex->word, self, 0) == 0) {
+        mutex->curr_locked = 1;
+        return APR_SUCCESS;
+    }
+
+    /* Spin for a while before sleeping, but only if the owner can be
+     * running on another CPU.  The spin budget adapts to how long the
+     * mutex was held the last times it was spun for. */
+    if (proc_mutex_futex_ncpus > 1) {
+        int spins = (int)futex->spins;
+        int limit = spins * 2 + 10;
+        int i;
+
+        if (limit > PROC_FUTEX_MAX_SPINS) {
+            limit = PROC_FUTEX_MAX_SPINS;
+        }
+        for (i = 0; i < limit; i++) {
+            proc_mutex_futex_relax();
+            if (futex->word == 0
+                && apr_atomic_cas32(&futex->word, self, 0) == 0) {
+                apr_atomic_set32(&futex->spins, spins + (i - spins) / 8);
+                mutex->curr_locked = 1;
+                return APR_SUCCESS;
+            }
+        }
+        apr_atomic_set32(&futex->spins, spins + (limit - spins) / 8);
+    }
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+    for (;;) {
+        apr_interval_time_t slice = PROC_FUTEX_SLICE;
+        int rv;
+
+        word = futex->word;
+        if (word == 0) {
+            /* Somebody else may still sleep, so keep the waiters bit
+             * set on the way in; the cost is one spurious wake-up. */
+            if (apr_atomic_cas32(&futex->word, self | PROC_FUTEX_WAITERS,
+                                 0) == 0) {
+                break;
+            }
+            continue;
+        }
+        if (!(word & PROC_FUTEX_WAITERS)) {
+            if (apr_atomic_cas32(&futex->word, word | PROC_FUTEX_WAITERS,
+                                 word) != word) {
+                continue;
+            }
+            word |= PROC_FUTEX_WAITERS;
+        }
+        if (timeout >= 0) {
+            apr_interval_time_t left = deadline - apr_time_now();
+            if (timeout == 0 || left <= 0) {
+                return APR_TIMEUP;
+            }
+            if (left < slice) {
+                slice = left;
+            }
+        }
+
+        rv = proc_mutex_futex_wait(&futex->word, word, slice);
+        if (rv == ETIMEDOUT && proc_mutex_futex_owner_dead(word)
+            && apr_atomic_cas32(&futex->word, self | PROC_FUTEX_WAITERS,
+                                word) == word) {
+            /* The owner died holding the mutex; take it over. */
+            break;
+        }
+        /* EAGAIN (word changed), EINTR or a wake-up: try again */
+    }
+
+    mutex->curr_locked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_acquire(apr_proc_mutex_t *mutex)
+{
+    return proc_mutex_futex_lock(mutex, -1);
+}
+
+static apr_status_t proc_mutex_futex_tryacquire(apr_proc_mutex_t *mutex)
+{
+    struct apr_proc_mutex_futex_t *futex = mutex->futex_interproc;
+    apr_uint32_t self = proc_mutex_futex_self();
+    apr_uint32_t word;
+
+    word = apr_atomic_cas32(&futex->word, self, 0);
+    if (word != 0) {
+        if (!proc_mutex_futex_owner_dead(word)
+            || apr_atomic_cas32(&futex->word, self | (word & PROC_FUTEX_WAITERS),
+                                word) != word) {
+            return APR_EBUSY;
+        }
+    }
+    mutex->curr_locked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_timedacquire(apr_proc_mutex_t *mutex,
+                                                  apr_interval_time_t timeout)
+{
+    if (timeout == 0) {
+        apr_status_t rv = proc_mutex_futex_tryacquire(mutex);
+        return APR_STATUS_IS_EBUSY(rv) ? APR_TIMEUP : rv;
+    }
+    return proc_mutex_futex_lock(mutex, timeout < 0 ? -1 : timeout);
+}
+
+static apr_status_t proc_mutex_futex_release(apr_proc_mutex_t *mutex)
+{
+    struct apr_proc_mutex_futex_t *futex = mutex->futex_interproc;
+
+    mutex->curr_locked = 0;
+    if (apr_atomic_xchg32(&futex->word, 0) & PROC_FUTEX_WAITERS) {
+        proc_mutex_futex_wake(&futex->word);
+    }
+    return APR_SUCCESS;
+}
+
+static const apr_proc_mutex_unix_lock_methods_t mutex_futex_methods =
+{
+    APR_PROCESS_LOCK_MECH_IS_GLOBAL,
+    proc_mutex_futex_create,
+    proc_mutex_futex_acquire,
+    proc_mutex_futex_tryacquire,
+    proc_mutex_futex_timedacquire,
+    proc_mutex_futex_release,
+    proc_mutex_futex_cleanup,
+    proc_mutex_no_child_init,
+    proc_mutex_no_perms_set,
+    "futex"
+};
+
+#endif /* futex implementation */
+
 #if APR_HAS_FCNTL_SERIALIZE
 
 static struct flock proc_mutex_lock_it;
@@ -668,6 +949,7 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_fcntl_methods =
     proc_mutex_fcntl_create,
     proc_mutex_fcntl_acquire,
     proc_mutex_fcntl_tryacquire,
+    NULL,
     proc_mutex_fcntl_release,
     proc_mutex_fcntl_cleanup,
     proc_mutex_no_child_init,
@@ -823,6 +1105,7 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_flock_methods =
     proc_mutex_flock_create,
     proc_mutex_flock_acquire,
     proc_mutex_flock_tryacquire,
+    NULL,
     proc_mutex_flock_release,
     proc_mutex_flock_cleanup,
     proc_mutex_flock_child_init,
@@ -834,13 +1117,16 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_flock_methods =
 
 void apr_proc_mutex_unix_setup_lock(void)
 {
-    /* setup only needed for sysvsem and fnctl */
+    /* setup only needed for sysvsem, fnctl and futex */
 #if APR_HAS_SYSVSEM_SERIALIZE
     proc_mutex_sysv_setup();
 #endif
 #if APR_HAS_FCNTL_SERIALIZE
     proc_mutex_fcntl_setup();
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    proc_mutex_futex_setup();
+#endif
 }
 
 static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex, apr_lockmech_e mech)
@@ -879,6 +1165,13 @@ static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex, apr_lo
         new_mutex->inter_meth = &mutex_proc_pthread_methods;
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_LOCK_FUTEX:
+#if APR_HAS_FUTEX_SERIALIZE
+        new_mutex->inter_meth = &mutex_futex_methods;
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     case APR_LOCK_DEFAULT:
@@ -946,6 +1239,8 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_create(apr_proc_mutex_t **mutex,
     if ((rv = proc_mutex_create(new_mutex, mech, fname)) != APR_SUCCESS)
         return rv;
 
+    new_mutex->prof = apr_lock_profile_register(new_mutex, "proc_mutex", pool);
+
     *mutex = new_mutex;
     return APR_SUCCESS;
 }
@@ -959,22 +1254,113 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_child_init(apr_proc_mutex_t **mutex,
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_lock(apr_proc_mutex_t *mutex)
 {
-    return mutex->meth->acquire(mutex);
+    apr_time_t start;
+    apr_status_t rv;
+
+    if (!mutex->prof) {
+        return mutex->meth->acquire(mutex);
+    }
+
+    if (mutex->meth->tryacquire(mutex) == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    rv = mutex->meth->acquire(mutex);
+    if (rv == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, apr_time_now() - start);
+    }
+    return rv;
 }
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_trylock(apr_proc_mutex_t *mutex)
 {
-    return mutex->meth->tryacquire(mutex);
+    apr_status_t rv;
+
+    rv = mutex->meth->tryacquire(mutex);
+    if (rv == APR_SUCCESS && mutex->prof) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+    }
+    return rv;
+}
+
+/* Emulate a timed acquire for mechanisms which cannot wait with a
+ * timeout, by retrying tryacquire with a growing back-off. */
+static apr_status_t proc_mutex_poll_timedacquire(apr_proc_mutex_t *mutex,
+                                                 apr_interval_time_t timeout)
+{
+    apr_time_t deadline = apr_time_now() + timeout;
+    apr_interval_time_t delay = 100;
+
+    for (;;) {
+        apr_status_t rv = mutex->meth->tryacquire(mutex);
+        apr_interval_time_t left;
+
+        if (!APR_STATUS_IS_EBUSY(rv)) {
+            return rv;
+        }
+        left = deadline - apr_time_now();
+        if (left <= 0) {
+            return APR_TIMEUP;
+        }
+        apr_sleep(delay < left ? delay : left);
+        if (delay < apr_time_from_msec(10)) {
+            delay *= 2;
+        }
+    }
+}
+
+static apr_status_t proc_mutex_timedacquire(apr_proc_mutex_t *mutex,
+                                            apr_interval_time_t timeout)
+{
+    if (mutex->meth->timedacquire) {
+        return mutex->meth->timedacquire(mutex, timeout);
+    }
+    if (timeout < 0) {
+        return mutex->meth->acquire(mutex);
+    }
+    return proc_mutex_poll_timedacquire(mutex, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_proc_mutex_timedlock(apr_proc_mutex_t *mutex,
+                                                   apr_interval_time_t timeout)
+{
+    apr_time_t start;
+    apr_status_t rv;
+
+    if (!mutex->prof) {
+        return proc_mutex_timedacquire(mutex, timeout);
+    }
+
+    if (mutex->meth->tryacquire(mutex) == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    rv = proc_mutex_timedacquire(mutex, timeout);
+    if (rv == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, apr_time_now() - start);
+    }
+    return rv;
 }
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_unlock(apr_proc_mutex_t *mutex)
 {
+    if (mutex->prof) {
+        apr_lock_profile_released(mutex->prof);
+    }
     return mutex->meth->release(mutex);
 }
 
-APR_DECLARE(apr_status_t) apr_proc_mutex_cleanup(void *mutex)
+APR_DECLARE(apr_status_t) apr_proc_mutex_cleanup(void *mutex_)
 {
-    return ((apr_proc_mutex_t *)mutex)->meth->cleanup(mutex);
+    apr_proc_mutex_t *mutex = mutex_;
+
+    if (mutex->prof) {
+        apr_lock_profile_unregister(mutex->prof);
+        mutex->prof = NULL;
+    }
+    return mutex->meth->cleanup(mutex);
 }
 
 APR_DECLARE(const char *) apr_proc_mutex_name(apr_proc_mutex_t *mutex)
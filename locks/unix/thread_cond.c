@@ -26,6 +26,11 @@ static apr_status_t thread_cond_cleanup(void *data)
     apr_thread_cond_t *cond = (apr_thread_cond_t *)data;
     apr_status_t rv;
 
+    if (cond->prof) {
+        apr_lock_profile_unregister(cond->prof);
+        cond->prof = NULL;
+    }
+
     rv = pthread_cond_destroy(&cond->cond);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -52,6 +57,8 @@ APR_DECLARE(apr_status_t) apr_thread_cond_create(apr_thread_cond_t **cond,
         return rv;
     }
 
+    new_cond->prof = apr_lock_profile_register(new_cond, "thread_cond", pool);
+
     apr_pool_cleanup_register(new_cond->pool,
                               (void *)new_cond, thread_cond_cleanup,
                               apr_pool_cleanup_null);
@@ -60,10 +67,41 @@ APR_DECLARE(apr_status_t) apr_thread_cond_create(apr_thread_cond_t **cond,
     return APR_SUCCESS;
 }
 
+/* The mutex is released while waiting, which ends its current hold. */
+static void thread_cond_wait_begin(apr_thread_cond_t *cond,
+                                   apr_thread_mutex_t *mutex,
+                                   apr_time_t *start)
+{
+    if (mutex->prof) {
+        apr_lock_profile_released(mutex->prof);
+    }
+    if (cond->prof) {
+        *start = apr_time_now();
+    }
+}
+
+static void thread_cond_wait_end(apr_thread_cond_t *cond,
+                                 apr_thread_mutex_t *mutex,
+                                 apr_time_t start, int timedout)
+{
+    if (cond->prof) {
+        apr_lock_profile_waited(cond->prof, apr_time_now() - start,
+                                timedout);
+    }
+    if (mutex->prof) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+    }
+}
+
 APR_DECLARE(apr_status_t) apr_thread_cond_wait(apr_thread_cond_t *cond,
                                                apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
+    apr_time_t start = 0;
+
+    if (cond->prof || mutex->prof) {
+        thread_cond_wait_begin(cond, mutex, &start);
+    }
 
     rv = pthread_cond_wait(&cond->cond, &mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
@@ -71,6 +109,10 @@ APR_DECLARE(apr_status_t) apr_thread_cond_wait(apr_thread_cond_t *cond,
         rv = errno;
     }
 #endif
+
+    if (cond->prof || mutex->prof) {
+        thread_cond_wait_end(cond, mutex, start, 0);
+    }
     return rv;
 }
 
@@ -79,19 +121,27 @@ APR_DECLARE(apr_status_t) apr_thread_cond_timedwait(apr_thread_cond_t *cond,
                                                     apr_interval_time_t timeout)
 {
     apr_status_t rv;
-    apr_time_t then;
+    apr_time_t then, start = 0;
     struct timespec abstime;
 
     then = apr_time_now() + timeout;
     abstime.tv_sec = apr_time_sec(then);
     abstime.tv_nsec = apr_time_usec(then) * 1000; /* nanoseconds */
 
+    if (cond->prof || mutex->prof) {
+        thread_cond_wait_begin(cond, mutex, &start);
+    }
+
     rv = pthread_cond_timedwait(&cond->cond, &mutex->mutex, &abstime);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
         rv = errno;
     }
 #endif
+
+    if (cond->prof || mutex->prof) {
+        thread_cond_wait_end(cond, mutex, start, ETIMEDOUT == rv);
+    }
     if (ETIMEDOUT == rv) {
         return APR_TIMEUP;
     }
@@ -25,6 +25,11 @@ static apr_status_t thread_mutex_cleanup(void *data)
     apr_thread_mutex_t *mutex = data;
     apr_status_t rv;
 
+    if (mutex->prof) {
+        apr_lock_profile_unregister(mutex->prof);
+        mutex->prof = NULL;
+    }
+
     rv = pthread_mutex_destroy(&mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -34,6 +39,23 @@ static apr_status_t thread_mutex_cleanup(void *data)
     return rv;
 } 
 
+/* Try to get the mutex by spinning, returns non-zero on success. */
+static int thread_mutex_spin(apr_thread_mutex_t *mutex)
+{
+    int limit = apr_thread_spin_limit(&mutex->spins, mutex->spin_max);
+    int n;
+
+    for (n = 0; n < limit; n++) {
+        if (pthread_mutex_trylock(&mutex->mutex) == 0) {
+            apr_thread_spin_update(&mutex->spins, n);
+            return 1;
+        }
+        apr_thread_spin_pause();
+    }
+    apr_thread_spin_update(&mutex->spins, limit);
+    return 0;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
                                                   unsigned int flags,
                                                   apr_pool_t *pool)
@@ -77,6 +99,12 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
         return rv;
     }
 
+    if (flags & APR_THREAD_MUTEX_SPIN) {
+        new_mutex->spin_max = apr_thread_spin_max();
+    }
+    new_mutex->prof = apr_lock_profile_register(new_mutex, "thread_mutex",
+                                                pool);
+
     apr_pool_cleanup_register(new_mutex->pool,
                               new_mutex, thread_mutex_cleanup,
                               apr_pool_cleanup_null);
@@ -85,10 +113,14 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
     return APR_SUCCESS;
 }
 
-APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
+static apr_status_t thread_mutex_lock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
 
+    if (mutex->spin_max && thread_mutex_spin(mutex)) {
+        return APR_SUCCESS;
+    }
+
     rv = pthread_mutex_lock(&mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -99,6 +131,27 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
+{
+    apr_time_t start;
+    apr_status_t rv;
+
+    if (!mutex->prof) {
+        return thread_mutex_lock(mutex);
+    }
+
+    if (pthread_mutex_trylock(&mutex->mutex) == 0) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    rv = thread_mutex_lock(mutex);
+    if (rv == APR_SUCCESS) {
+        apr_lock_profile_acquired(mutex->prof, apr_time_now() - start);
+    }
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
@@ -111,6 +164,9 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
         return (rv == EBUSY) ? APR_EBUSY : rv;
     }
 
+    if (mutex->prof) {
+        apr_lock_profile_acquired(mutex->prof, -1);
+    }
     return APR_SUCCESS;
 }
 
@@ -118,6 +174,10 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_unlock(apr_thread_mutex_t *mutex)
 {
     apr_status_t status;
 
+    if (mutex->prof) {
+        apr_lock_profile_released(mutex->prof);
+    }
+
     status = pthread_mutex_unlock(&mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
     if (status) {
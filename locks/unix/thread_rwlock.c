@@ -15,18 +15,37 @@
  */
 
 #include "apr_arch_thread_rwlock.h"
+#include "apr_arch_thread_mutex.h" /* for the spin helpers */
 #include "apr_private.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
 
 #if APR_HAS_THREADS
 
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+/* Upper bound for the number of APR_THREAD_RWLOCK_PERCPU slots */
+#define THREAD_RWLOCK_MAX_SLOTS 64
+
 /* The rwlock must be initialized but not locked by any thread when
  * cleanup is called. */
 static apr_status_t thread_rwlock_cleanup(void *data)
 {
     apr_thread_rwlock_t *rwlock = (apr_thread_rwlock_t *)data;
     apr_status_t stat;
+    unsigned int n;
+
+    if (rwlock->prof) {
+        apr_lock_profile_unregister(rwlock->prof);
+        rwlock->prof = NULL;
+    }
+
+    if (rwlock->slots) {
+        for (n = 0; n < rwlock->nslots; n++) {
+            pthread_rwlock_destroy(&rwlock->slots[n].rwlock);
+        }
+        return APR_SUCCESS;
+    }
 
     stat = pthread_rwlock_destroy(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
@@ -37,21 +56,173 @@ static apr_status_t thread_rwlock_cleanup(void *data)
     return stat;
 } 
 
+/* Readers of a APR_THREAD_RWLOCK_PERCPU lock always use the same slot
+ * for a given thread, so that unlocking finds the slot again even if
+ * the thread migrated to another CPU in the meantime.
+ */
+static pthread_rwlock_t *thread_rwlock_reader(apr_thread_rwlock_t *rwlock)
+{
+    pthread_t self;
+    apr_uint64_t h = 0;
+
+    if (!rwlock->slots) {
+        return &rwlock->rwlock;
+    }
+    self = pthread_self();
+    memcpy(&h, &self, sizeof(self) < sizeof(h) ? sizeof(self) : sizeof(h));
+    h *= APR_UINT64_C(0x9e3779b97f4a7c15);
+    return &rwlock->slots[(h >> 32) & (rwlock->nslots - 1)].rwlock;
+}
+
+static apr_status_t thread_rwlock_acquire(apr_thread_rwlock_t *rwlock,
+                                          pthread_rwlock_t *rw, int write)
+{
+    apr_status_t stat;
+
+    if (rwlock->spin_max) {
+        int limit = apr_thread_spin_limit(&rwlock->spins, rwlock->spin_max);
+        int n;
+
+        for (n = 0; n < limit; n++) {
+            if ((write ? pthread_rwlock_trywrlock(rw)
+                       : pthread_rwlock_tryrdlock(rw)) == 0) {
+                apr_thread_spin_update(&rwlock->spins, n);
+                return APR_SUCCESS;
+            }
+            apr_thread_spin_pause();
+        }
+        apr_thread_spin_update(&rwlock->spins, limit);
+    }
+
+    stat = write ? pthread_rwlock_wrlock(rw) : pthread_rwlock_rdlock(rw);
+#ifdef HAVE_ZOS_PTHREADS
+    if (stat) {
+        stat = errno;
+    }
+#endif
+    return stat;
+}
+
+static apr_status_t thread_rwlock_try(pthread_rwlock_t *rw, int write)
+{
+    apr_status_t stat;
+
+    stat = write ? pthread_rwlock_trywrlock(rw) : pthread_rwlock_tryrdlock(rw);
+#ifdef HAVE_ZOS_PTHREADS
+    if (stat) {
+        stat = errno;
+    }
+#endif
+    /* Normalize the return code. */
+    if (stat == EBUSY)
+        stat = APR_EBUSY;
+    return stat;
+}
+
+static apr_status_t thread_rwlock_release(pthread_rwlock_t *rw)
+{
+    apr_status_t stat;
+
+    stat = pthread_rwlock_unlock(rw);
+#ifdef HAVE_ZOS_PTHREADS
+    if (stat) {
+        stat = errno;
+    }
+#endif
+    return stat;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool)
+{
+    return apr_thread_rwlock_create_ex(rwlock, APR_THREAD_RWLOCK_DEFAULT,
+                                       pool);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
 {
     apr_thread_rwlock_t *new_rwlock;
+    pthread_rwlockattr_t *attr = NULL;
     apr_status_t stat;
+#ifdef HAVE_PTHREAD_RWLOCKATTR_SETKIND_NP
+    pthread_rwlockattr_t wattr;
+#endif
+
+    if (flags & APR_THREAD_RWLOCK_PREFER_WRITER) {
+#ifdef HAVE_PTHREAD_RWLOCKATTR_SETKIND_NP
+        if ((stat = pthread_rwlockattr_init(&wattr))) {
+            return stat;
+        }
+        if ((stat = pthread_rwlockattr_setkind_np(&wattr,
+                        PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP))) {
+            pthread_rwlockattr_destroy(&wattr);
+            return stat;
+        }
+        attr = &wattr;
+#else
+        return APR_ENOTIMPL;
+#endif
+    }
 
-    new_rwlock = apr_palloc(pool, sizeof(apr_thread_rwlock_t));
+    new_rwlock = apr_pcalloc(pool, sizeof(apr_thread_rwlock_t));
     new_rwlock->pool = pool;
 
-    if ((stat = pthread_rwlock_init(&new_rwlock->rwlock, NULL))) {
+    if (flags & APR_THREAD_RWLOCK_SPIN) {
+        new_rwlock->spin_max = apr_thread_spin_max();
+    }
+
+#ifdef _SC_NPROCESSORS_ONLN
+    if (flags & APR_THREAD_RWLOCK_PERCPU) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned int nslots = 1;
+        char *mem;
+
+        while ((long)nslots < ncpus && nslots < THREAD_RWLOCK_MAX_SLOTS) {
+            nslots <<= 1;
+        }
+        if (nslots > 1) {
+            /* Align the slots on a cache line */
+            mem = apr_palloc(pool, nslots * sizeof(apr_thread_rwlock_slot_t)
+                                   + 63);
+            new_rwlock->slots = (apr_thread_rwlock_slot_t *)
+                (((apr_uintptr_t)mem + 63) & ~(apr_uintptr_t)63);
+        }
+        while (new_rwlock->slots && new_rwlock->nslots < nslots) {
+            stat = pthread_rwlock_init(
+                       &new_rwlock->slots[new_rwlock->nslots].rwlock, attr);
+            if (stat) {
+#ifdef HAVE_ZOS_PTHREADS
+                stat = errno;
+#endif
+                thread_rwlock_cleanup(new_rwlock);
+                if (attr) {
+                    pthread_rwlockattr_destroy(attr);
+                }
+                return stat;
+            }
+            new_rwlock->nslots++;
+        }
+    }
+#endif
+
+    if (!new_rwlock->slots
+        && (stat = pthread_rwlock_init(&new_rwlock->rwlock, attr))) {
 #ifdef HAVE_ZOS_PTHREADS
         stat = errno;
 #endif
+        if (attr) {
+            pthread_rwlockattr_destroy(attr);
+        }
         return stat;
     }
+    if (attr) {
+        pthread_rwlockattr_destroy(attr);
+    }
+
+    new_rwlock->prof = apr_lock_profile_register(new_rwlock, "thread_rwlock",
+                                                 pool);
 
     apr_pool_cleanup_register(new_rwlock->pool,
                               (void *)new_rwlock, thread_rwlock_cleanup,
@@ -63,14 +234,23 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
 
 APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
+    pthread_rwlock_t *rw = thread_rwlock_reader(rwlock);
+    apr_time_t start;
     apr_status_t stat;
 
-    stat = pthread_rwlock_rdlock(&rwlock->rwlock);
-#ifdef HAVE_ZOS_PTHREADS
-    if (stat) {
-        stat = errno;
+    if (!rwlock->prof) {
+        return thread_rwlock_acquire(rwlock, rw, 0);
+    }
+
+    if (thread_rwlock_try(rw, 0) == APR_SUCCESS) {
+        apr_lock_profile_shared(rwlock->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    stat = thread_rwlock_acquire(rwlock, rw, 0);
+    if (stat == APR_SUCCESS) {
+        apr_lock_profile_shared(rwlock->prof, apr_time_now() - start);
     }
-#endif
     return stat;
 }
 
@@ -78,28 +258,76 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_tryrdlock(apr_thread_rwlock_t *rwloc
 {
     apr_status_t stat;
 
-    stat = pthread_rwlock_tryrdlock(&rwlock->rwlock);
-#ifdef HAVE_ZOS_PTHREADS
-    if (stat) {
-        stat = errno;
+    stat = thread_rwlock_try(thread_rwlock_reader(rwlock), 0);
+    if (stat == APR_SUCCESS && rwlock->prof) {
+        apr_lock_profile_shared(rwlock->prof, -1);
     }
-#endif
-    /* Normalize the return code. */
-    if (stat == EBUSY)
-        stat = APR_EBUSY;
     return stat;
 }
 
+static apr_status_t thread_rwlock_wrlock(apr_thread_rwlock_t *rwlock)
+{
+    apr_status_t stat;
+    unsigned int n;
+
+    if (!rwlock->slots) {
+        return thread_rwlock_acquire(rwlock, &rwlock->rwlock, 1);
+    }
+
+    /* Always in the same order, so that writers cannot deadlock */
+    for (n = 0; n < rwlock->nslots; n++) {
+        stat = thread_rwlock_acquire(rwlock, &rwlock->slots[n].rwlock, 1);
+        if (stat) {
+            while (n--) {
+                thread_rwlock_release(&rwlock->slots[n].rwlock);
+            }
+            return stat;
+        }
+    }
+    rwlock->wrlocked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t thread_rwlock_trywrlock(apr_thread_rwlock_t *rwlock)
+{
+    apr_status_t stat;
+    unsigned int n;
+
+    if (!rwlock->slots) {
+        return thread_rwlock_try(&rwlock->rwlock, 1);
+    }
+
+    for (n = 0; n < rwlock->nslots; n++) {
+        stat = thread_rwlock_try(&rwlock->slots[n].rwlock, 1);
+        if (stat) {
+            while (n--) {
+                thread_rwlock_release(&rwlock->slots[n].rwlock);
+            }
+            return stat;
+        }
+    }
+    rwlock->wrlocked = 1;
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_wrlock(apr_thread_rwlock_t *rwlock)
 {
+    apr_time_t start;
     apr_status_t stat;
 
-    stat = pthread_rwlock_wrlock(&rwlock->rwlock);
-#ifdef HAVE_ZOS_PTHREADS
-    if (stat) {
-        stat = errno;
+    if (!rwlock->prof) {
+        return thread_rwlock_wrlock(rwlock);
+    }
+
+    if (thread_rwlock_trywrlock(rwlock) == APR_SUCCESS) {
+        apr_lock_profile_acquired(rwlock->prof, -1);
+        return APR_SUCCESS;
+    }
+    start = apr_time_now();
+    stat = thread_rwlock_wrlock(rwlock);
+    if (stat == APR_SUCCESS) {
+        apr_lock_profile_acquired(rwlock->prof, apr_time_now() - start);
     }
-#endif
     return stat;
 }
 
@@ -107,28 +335,38 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_trywrlock(apr_thread_rwlock_t *rwloc
 {
     apr_status_t stat;
 
-    stat = pthread_rwlock_trywrlock(&rwlock->rwlock);
-#ifdef HAVE_ZOS_PTHREADS
-    if (stat) {
-        stat = errno;
+    stat = thread_rwlock_trywrlock(rwlock);
+    if (stat == APR_SUCCESS && rwlock->prof) {
+        apr_lock_profile_acquired(rwlock->prof, -1);
     }
-#endif
-    /* Normalize the return code. */
-    if (stat == EBUSY)
-        stat = APR_EBUSY;
     return stat;
 }
 
 APR_DECLARE(apr_status_t) apr_thread_rwlock_unlock(apr_thread_rwlock_t *rwlock)
 {
-    apr_status_t stat;
+    apr_status_t stat = APR_SUCCESS;
+    unsigned int n;
 
-    stat = pthread_rwlock_unlock(&rwlock->rwlock);
-#ifdef HAVE_ZOS_PTHREADS
-    if (stat) {
-        stat = errno;
+    if (rwlock->prof) {
+        apr_lock_profile_released(rwlock->prof);
+    }
+
+    if (!rwlock->slots) {
+        return thread_rwlock_release(&rwlock->rwlock);
+    }
+
+    /* No writer can hold the slots while the caller holds a read lock,
+     * so wrlocked tells which kind of lock is being released. */
+    if (!rwlock->wrlocked) {
+        return thread_rwlock_release(thread_rwlock_reader(rwlock));
+    }
+    rwlock->wrlocked = 0;
+    for (n = rwlock->nslots; n--; ) {
+        apr_status_t rv = thread_rwlock_release(&rwlock->slots[n].rwlock);
+        if (rv && !stat) {
+            stat = rv;
+        }
     }
-#endif
     return stat;
 }
 
@@ -145,6 +383,13 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
     return APR_ENOTIMPL;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
     return APR_ENOTIMPL;
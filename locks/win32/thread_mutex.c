@@ -61,7 +61,13 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
          * use a [slower] mutex object, instead.
          */
         IF_WIN_OS_IS_UNICODE {
-            InitializeCriticalSection(&(*mutex)->section);
+            if (flags & APR_THREAD_MUTEX_SPIN) {
+                InitializeCriticalSectionAndSpinCount(&(*mutex)->section,
+                                                      4000);
+            }
+            else {
+                InitializeCriticalSection(&(*mutex)->section);
+            }
             (*mutex)->type = thread_mutex_critical_section;
         }
 #endif
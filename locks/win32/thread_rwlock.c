@@ -59,6 +59,15 @@ APR_DECLARE(apr_status_t)apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
+{
+    /* Waiting writers always hold off new readers here, and the other
+     * flags are hints. */
+    return apr_thread_rwlock_create(rwlock, pool);
+}
+
 static apr_status_t apr_thread_rwlock_rdlock_core(apr_thread_rwlock_t *rwlock,
                                                   DWORD  milliseconds)
 {
@@ -48,6 +48,11 @@ APR_DECLARE(apr_status_t) apr_socket_opt_set(apr_socket_t *sock,
     else
         one = 0;
 
+    if (opt & (APR_TCP_FASTOPEN | APR_TCP_NOTSENT_LOWAT | APR_SO_BUSY_POLL
+               | APR_SO_PREFER_BUSY_POLL | APR_SO_INCOMING_CPU
+               | APR_TCP_QUICKACK)) {
+        return APR_ENOTIMPL;
+    }
     if (opt & APR_SO_KEEPALIVE) {
         if (setsockopt(sock->socketdes, SOL_SOCKET, SO_KEEPALIVE, (void *)&one, sizeof(int)) == -1) {
             return APR_FROM_OS_ERROR(sock_errno());
@@ -108,6 +113,8 @@ APR_DECLARE(apr_status_t) apr_socket_opt_get(apr_socket_t *sock,
                                              apr_int32_t opt, apr_int32_t *on)
 {
     switch(opt) {
+    case APR_SO_INCOMING_CPU:
+        return APR_ENOTIMPL;
     default:
         return APR_EINVAL;
     }
@@ -129,6 +136,18 @@ APR_DECLARE(apr_status_t) apr_socket_atmark(apr_socket_t *sock, int *atmark)
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_tcp_info_get(apr_socket_t *sock,
+                                                  apr_socket_tcp_info_t *info)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_stats_get(apr_socket_t *sock,
+                                               apr_socket_stats_t *stats)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_gethostname(char *buf, apr_int32_t len, 
                                           apr_pool_t *cont)
 {
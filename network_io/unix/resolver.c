@@ -0,0 +1,1528 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_networkio.h"
+#include "apr_resolver.h"
+#include "apr_file_io.h"
+#include "apr_hash.h"
+#include "apr_portable.h"
+#include "apr_strings.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_pool.h"
+
+#if APR_HAS_RESOLVER
+
+#include <stdlib.h>     /* for malloc, free */
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+/* The most threads resolve at once */
+#define RESOLVER_MAX_THREADS 8
+
+/* The most addresses kept for a name */
+#define RESOLVER_MAX_ADDRS 32
+
+/* The names kept by a cache unless told otherwise */
+#define RESOLVER_CACHE_ENTRIES 1024
+
+/* The most addresses kept for a name of the hosts file */
+#define HOSTS_MAX_ADDRS 8
+
+#define RESOLV_CONF  "/etc/resolv.conf"
+#define HOSTS_FILE   "/etc/hosts"
+
+/* The limits and defaults of resolv.conf(5) */
+#define STUB_MAX_NAMESERVERS 3
+#define STUB_MAX_SEARCH      6
+#define STUB_NDOTS           1
+#define STUB_TIMEOUT         apr_time_from_sec(5)
+#define STUB_ATTEMPTS        2
+
+#define DNS_PORT        53
+#define DNS_HEADER_LEN  12
+#define DNS_MAX_NAME    255
+#define DNS_MAX_QUERY   (DNS_HEADER_LEN + DNS_MAX_NAME + 1 + 4)
+#define DNS_MAX_MSG     4096
+#define DNS_MAX_CNAMES  8
+
+#define DNS_TYPE_A      1
+#define DNS_TYPE_CNAME  5
+#define DNS_TYPE_SOA    6
+#define DNS_TYPE_AAAA   28
+#define DNS_CLASS_IN    1
+
+#define DNS_RCODE_NOERROR   0
+#define DNS_RCODE_NXDOMAIN  3
+
+/* getaddrinfo() errors, as apr_sockaddr_info_get() folds them */
+#if defined(NEGATIVE_EAI)
+#define RESOLVER_EAI(e) (APR_OS_START_EAIERR - (e))
+#else
+#define RESOLVER_EAI(e) (APR_OS_START_EAIERR + (e))
+#endif
+#ifdef EAI_NODATA
+#define RESOLVER_EAI_NODATA RESOLVER_EAI(EAI_NODATA)
+#else
+#define RESOLVER_EAI_NODATA RESOLVER_EAI(EAI_NONAME)
+#endif
+
+typedef struct resolver_addr_t {
+    int family;
+    union {
+        struct in_addr in;
+#if APR_HAVE_IPV6
+        struct in6_addr in6;
+#endif
+    } u;
+} resolver_addr_t;
+
+/* A cached answer, allocated along with its addresses and key */
+typedef struct resolver_entry_t {
+    apr_time_t expires;
+    apr_status_t status;
+    int naddrs;
+    resolver_addr_t addrs[1];
+} resolver_entry_t;
+
+struct apr_resolver_cache_t {
+    apr_pool_t *pool;
+    apr_hash_t *entries;
+    apr_size_t max_entries;
+    apr_interval_time_t max_ttl;
+    apr_interval_time_t negative_ttl;
+    apr_uint64_t hits;
+    apr_uint64_t misses;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+};
+
+typedef struct resolver_hosts_t {
+    int naddrs;
+    resolver_addr_t addrs[HOSTS_MAX_ADDRS];
+} resolver_hosts_t;
+
+struct apr_resolver_t {
+    apr_pool_t *pool;
+    const char *method;
+    apr_resolver_cache_t *cache;
+    apr_int32_t flags;
+    apr_uint32_t depth;
+    apr_uint32_t inflight;
+    /* Signalled on completions: an eventfd, or a pipe */
+    int notify_rfd;
+    int notify_wfd;
+    apr_file_t *notify;
+    /* Queries completed by threads or synchronously */
+    apr_resolver_query_t *done;
+    apr_resolver_query_t *done_tail;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+    apr_thread_pool_t *threads;
+#endif
+    /* The configuration of the stub resolver */
+    apr_sockaddr_t *servers[STUB_MAX_NAMESERVERS];
+    int nservers;
+    int servers_added;
+    const char *search[STUB_MAX_SEARCH];
+    int nsearch;
+    int ndots;
+    apr_interval_time_t timeout;
+    int attempts;
+    apr_hash_t *hosts;
+};
+
+/* The answer of a nameserver to one question */
+typedef struct stub_answer_t {
+    int done;
+    int rcode;
+    int naddrs;
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    apr_uint32_t ttl;
+    /* The time to live of a negative answer, from its SOA record */
+    int has_soa;
+    apr_uint32_t negative_ttl;
+} stub_answer_t;
+
+/* A resource record of a message */
+typedef struct dns_rr_t {
+    char owner[DNS_MAX_NAME + 1];
+    int type;
+    int rclass;
+    apr_uint32_t ttl;
+    apr_size_t rdata;
+    apr_size_t rdlen;
+} dns_rr_t;
+
+static int resolver_is_negative(apr_status_t rv)
+{
+    return rv == RESOLVER_EAI(EAI_NONAME) || rv == RESOLVER_EAI_NODATA;
+}
+
+/* Whether a name resolves without asking anyone */
+static int resolver_is_numeric(const apr_resolver_query_t *query)
+{
+    struct in_addr in;
+
+    return !query->hostname
+           || query->family == APR_UNIX
+           || *query->hostname == '/'
+           || strchr(query->hostname, ':')
+           || inet_pton(AF_INET, query->hostname, &in) == 1;
+}
+
+/* The cache key of a query, or 0 for a name too long to cache */
+static int resolver_key(char *key, apr_size_t size,
+                        const apr_resolver_query_t *query)
+{
+    apr_size_t len = strlen(query->hostname), n, i;
+
+    if (len > DNS_MAX_NAME) {
+        return 0;
+    }
+    n = apr_snprintf(key, size, "%d:%d:", (int)query->family,
+                     (int)(query->flags & (APR_IPV4_ADDR_OK
+                                           | APR_IPV6_ADDR_OK)));
+    if (n + len >= size) {
+        return 0;
+    }
+    for (i = 0; i <= len; i++) {
+        key[n + i] = apr_tolower(query->hostname[i]);
+    }
+    return 1;
+}
+
+static apr_sockaddr_t *resolver_sockaddrs(apr_resolver_query_t *query,
+                                          const resolver_addr_t *addrs,
+                                          int naddrs)
+{
+    apr_sockaddr_t *first = NULL, **next = &first;
+    char *hostname = apr_pstrdup(query->pool, query->hostname);
+    int i;
+
+    for (i = 0; i < naddrs; i++) {
+        apr_sockaddr_t *sa = apr_pcalloc(query->pool, sizeof(*sa));
+
+        sa->pool = query->pool;
+        sa->hostname = hostname;
+        apr_sockaddr_vars_set(sa, addrs[i].family, query->port);
+        memcpy(sa->ipaddr_ptr, &addrs[i].u, sa->ipaddr_len);
+        *next = sa;
+        next = &sa->next;
+    }
+    return first;
+}
+
+/* Put the addresses in the order of apr_sockaddr_info_get(): IPv4 first,
+ * and only the addresses of the family asked for by the flags if any.
+ */
+static int resolver_addrs_select(resolver_addr_t *out, int max,
+                                 const resolver_addr_t *in, int n,
+                                 apr_int32_t family, apr_int32_t flags)
+{
+    int num4 = 0, num6 = 0, count = 0, i;
+
+    for (i = 0; i < n; i++) {
+        if (in[i].family == APR_INET) {
+            num4++;
+        }
+        else {
+            num6++;
+        }
+    }
+    if (family == APR_INET6 || (flags & APR_IPV6_ADDR_OK && num6)) {
+        num4 = 0;
+    }
+    if (family == APR_INET || (flags & APR_IPV4_ADDR_OK && num4)) {
+        num6 = 0;
+    }
+    for (i = 0; i < n && num4 && count < max; i++) {
+        if (in[i].family == APR_INET) {
+            out[count++] = in[i];
+        }
+    }
+    for (i = 0; i < n && num6 && count < max; i++) {
+        if (in[i].family != APR_INET) {
+            out[count++] = in[i];
+        }
+    }
+    return count;
+}
+
+/* Cache */
+
+static void cache_entry_remove(apr_resolver_cache_t *cache, const char *key,
+                               resolver_entry_t *entry)
+{
+    apr_hash_set(cache->entries, key, APR_HASH_KEY_STRING, NULL);
+    free(entry);
+}
+
+static void cache_lock(apr_resolver_cache_t *cache)
+{
+#if APR_HAS_THREADS
+    if (cache->lock) {
+        apr_thread_mutex_lock(cache->lock);
+    }
+#endif
+}
+
+static void cache_unlock(apr_resolver_cache_t *cache)
+{
+#if APR_HAS_THREADS
+    if (cache->lock) {
+        apr_thread_mutex_unlock(cache->lock);
+    }
+#endif
+}
+
+static void cache_clear(apr_resolver_cache_t *cache)
+{
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, cache->entries); hi;
+         hi = apr_hash_next(hi)) {
+        cache_entry_remove(cache, apr_hash_this_key(hi),
+                           apr_hash_this_val(hi));
+    }
+}
+
+static apr_status_t cache_cleanup(void *data)
+{
+    cache_clear(data);
+    return APR_SUCCESS;
+}
+
+/* Answer a query from the cache, if possible */
+static int cache_lookup(apr_resolver_cache_t *cache, const char *key,
+                        apr_resolver_query_t *query)
+{
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    resolver_entry_t *entry;
+    apr_time_t now = apr_time_now();
+    int naddrs = 0, found = 0;
+
+    cache_lock(cache);
+    entry = apr_hash_get(cache->entries, key, APR_HASH_KEY_STRING);
+    if (entry && entry->expires <= now) {
+        cache_entry_remove(cache, key, entry);
+        entry = NULL;
+    }
+    if (entry) {
+        query->status = entry->status;
+        query->ttl = entry->expires - now;
+        naddrs = entry->naddrs;
+        memcpy(addrs, entry->addrs, naddrs * sizeof(addrs[0]));
+        cache->hits++;
+        found = 1;
+    }
+    else {
+        cache->misses++;
+    }
+    cache_unlock(cache);
+
+    if (found && naddrs) {
+        query->sa = resolver_sockaddrs(query, addrs, naddrs);
+    }
+    return found;
+}
+
+/* Make room for one more entry, dropping the expired ones or else the
+ * one expiring first.
+ */
+static void cache_make_room(apr_resolver_cache_t *cache, apr_time_t now)
+{
+    apr_hash_index_t *hi;
+    resolver_entry_t *first = NULL;
+    const char *first_key = NULL;
+
+    for (hi = apr_hash_first(NULL, cache->entries); hi;
+         hi = apr_hash_next(hi)) {
+        resolver_entry_t *entry = apr_hash_this_val(hi);
+
+        if (entry->expires <= now) {
+            cache_entry_remove(cache, apr_hash_this_key(hi), entry);
+        }
+        else if (!first || entry->expires < first->expires) {
+            first = entry;
+            first_key = apr_hash_this_key(hi);
+        }
+    }
+    if (apr_hash_count(cache->entries) >= cache->max_entries && first) {
+        cache_entry_remove(cache, first_key, first);
+    }
+}
+
+/* Remember an answer; a time to live below 0 is unknown.  Returns the
+ * time to live of the cached answer.
+ */
+static apr_interval_time_t cache_store(apr_resolver_cache_t *cache,
+                                       const char *key, apr_status_t status,
+                                       const resolver_addr_t *addrs,
+                                       int naddrs, apr_interval_time_t ttl)
+{
+    resolver_entry_t *entry, *old;
+    apr_interval_time_t max = status ? cache->negative_ttl : cache->max_ttl;
+    apr_size_t keylen = strlen(key) + 1, size;
+    apr_time_t now;
+    char *k;
+
+    if (ttl < 0 || ttl > max) {
+        ttl = max;
+    }
+    if (ttl <= 0) {
+        return 0;
+    }
+
+    size = APR_OFFSETOF(resolver_entry_t, addrs)
+           + (naddrs ? naddrs : 1) * sizeof(resolver_addr_t);
+    entry = malloc(size + keylen);
+    if (!entry) {
+        return 0;
+    }
+    k = (char *)entry + size;
+    memcpy(k, key, keylen);
+    entry->status = status;
+    entry->naddrs = naddrs;
+    memcpy(entry->addrs, addrs, naddrs * sizeof(resolver_addr_t));
+
+    cache_lock(cache);
+    now = apr_time_now();
+    entry->expires = now + ttl;
+    old = apr_hash_get(cache->entries, key, APR_HASH_KEY_STRING);
+    if (old) {
+        cache_entry_remove(cache, key, old);
+    }
+    else if (apr_hash_count(cache->entries) >= cache->max_entries) {
+        cache_make_room(cache, now);
+    }
+    apr_hash_set(cache->entries, k, APR_HASH_KEY_STRING, entry);
+    cache_unlock(cache);
+    return ttl;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_cache_create(
+                                              apr_resolver_cache_t **pcache,
+                                              apr_size_t max_entries,
+                                              apr_interval_time_t max_ttl,
+                                              apr_interval_time_t negative_ttl,
+                                              apr_pool_t *p)
+{
+    apr_resolver_cache_t *cache = apr_pcalloc(p, sizeof(*cache));
+
+    cache->pool = p;
+    cache->entries = apr_hash_make(p);
+    cache->max_entries = max_entries ? max_entries : RESOLVER_CACHE_ENTRIES;
+    cache->max_ttl = max_ttl > 0 ? max_ttl : APR_RESOLVER_DEFAULT_TTL;
+    cache->negative_ttl = negative_ttl ? negative_ttl
+                                       : APR_RESOLVER_DEFAULT_NEGATIVE_TTL;
+#if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_mutex_create(&cache->lock,
+                                                  APR_THREAD_MUTEX_DEFAULT,
+                                                  p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    apr_pool_cleanup_register(p, cache, cache_cleanup,
+                              apr_pool_cleanup_null);
+
+    *pcache = cache;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_resolver_cache_clear(apr_resolver_cache_t *cache)
+{
+    cache_lock(cache);
+    cache_clear(cache);
+    cache_unlock(cache);
+}
+
+APR_DECLARE(void) apr_resolver_cache_stats_get(apr_resolver_cache_t *cache,
+                                            apr_resolver_cache_stats_t *stats)
+{
+    cache_lock(cache);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->entries = apr_hash_count(cache->entries);
+    cache_unlock(cache);
+}
+
+/* Stub resolver */
+
+static int stub_addr_parse(resolver_addr_t *addr, const char *str)
+{
+    if (inet_pton(AF_INET, str, &addr->u.in) == 1) {
+        addr->family = APR_INET;
+        return 1;
+    }
+#if APR_HAVE_IPV6
+    if (inet_pton(AF_INET6, str, &addr->u.in6) == 1) {
+        addr->family = APR_INET6;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+static void stub_hosts_read(apr_resolver_t *res)
+{
+    apr_file_t *f;
+    char line[512], *last, *tok, *c;
+    resolver_addr_t addr;
+
+    res->hosts = apr_hash_make(res->pool);
+    if (apr_file_open(&f, HOSTS_FILE, APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                      APR_OS_DEFAULT, res->pool) != APR_SUCCESS) {
+        return;
+    }
+    while (apr_file_gets(line, sizeof(line), f) == APR_SUCCESS) {
+        if ((tok = strchr(line, '#'))) {
+            *tok = '\0';
+        }
+        tok = apr_strtok(line, " \t\r\n", &last);
+        if (!tok || !stub_addr_parse(&addr, tok)) {
+            continue;
+        }
+        while ((tok = apr_strtok(NULL, " \t\r\n", &last))) {
+            resolver_hosts_t *host;
+
+            tok = apr_pstrdup(res->pool, tok);
+            for (c = tok; *c; c++) {
+                *c = apr_tolower(*c);
+            }
+            host = apr_hash_get(res->hosts, tok, APR_HASH_KEY_STRING);
+            if (!host) {
+                host = apr_pcalloc(res->pool, sizeof(*host));
+                apr_hash_set(res->hosts, tok, APR_HASH_KEY_STRING, host);
+            }
+            if (host->naddrs < HOSTS_MAX_ADDRS) {
+                host->addrs[host->naddrs++] = addr;
+            }
+        }
+    }
+    apr_file_close(f);
+}
+
+static void stub_nameserver_set(apr_resolver_t *res, apr_sockaddr_t *ns)
+{
+    apr_sockaddr_vars_set(ns, ns->family, ns->port ? ns->port : DNS_PORT);
+    res->servers[res->nservers++] = ns;
+}
+
+static void stub_config_read(apr_resolver_t *res)
+{
+    apr_file_t *f;
+    char line[512], *last, *tok;
+
+    res->ndots = STUB_NDOTS;
+    res->timeout = STUB_TIMEOUT;
+    res->attempts = STUB_ATTEMPTS;
+
+    if (apr_file_open(&f, RESOLV_CONF, APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                      APR_OS_DEFAULT, res->pool) == APR_SUCCESS) {
+        while (apr_file_gets(line, sizeof(line), f) == APR_SUCCESS) {
+            tok = apr_strtok(line, " \t\r\n", &last);
+            if (!tok) {
+                continue;
+            }
+            if (!strcmp(tok, "nameserver")) {
+                resolver_addr_t addr;
+                apr_sockaddr_t *ns;
+
+                tok = apr_strtok(NULL, " \t\r\n", &last);
+                /* Only numeric addresses, which resolve without blocking;
+                 * an IPv6 address may carry a scope.
+                 */
+                if (tok && res->nservers < STUB_MAX_NAMESERVERS
+                    && (stub_addr_parse(&addr, tok) || strchr(tok, '%'))
+                    && apr_sockaddr_info_get(&ns, tok, APR_UNSPEC, DNS_PORT,
+                                             0, res->pool) == APR_SUCCESS) {
+                    stub_nameserver_set(res, ns);
+                }
+            }
+            else if (!strcmp(tok, "domain") || !strcmp(tok, "search")) {
+                /* The last of these lines wins */
+                res->nsearch = 0;
+                while ((tok = apr_strtok(NULL, " \t\r\n", &last))
+                       && res->nsearch < STUB_MAX_SEARCH) {
+                    res->search[res->nsearch++] = apr_pstrdup(res->pool,
+                                                              tok);
+                }
+            }
+            else if (!strcmp(tok, "options")) {
+                while ((tok = apr_strtok(NULL, " \t\r\n", &last))) {
+                    if (!strncmp(tok, "ndots:", 6)) {
+                        res->ndots = atoi(tok + 6);
+                        if (res->ndots > 15) {
+                            res->ndots = 15;
+                        }
+                    }
+                    else if (!strncmp(tok, "timeout:", 8)) {
+                        int n = atoi(tok + 8);
+
+                        if (n > 0) {
+                            res->timeout = apr_time_from_sec(n < 30 ? n
+                                                                    : 30);
+                        }
+                    }
+                    else if (!strncmp(tok, "attempts:", 9)) {
+                        int n = atoi(tok + 9);
+
+                        if (n > 0) {
+                            res->attempts = n < 5 ? n : 5;
+                        }
+                    }
+                }
+            }
+        }
+        apr_file_close(f);
+    }
+
+    if (!res->nservers) {
+        apr_sockaddr_t *ns;
+
+        if (apr_sockaddr_info_get(&ns, "127.0.0.1", APR_INET, DNS_PORT, 0,
+                                  res->pool) == APR_SUCCESS) {
+            stub_nameserver_set(res, ns);
+        }
+    }
+
+    stub_hosts_read(res);
+}
+
+/* Answer a query from the hosts file, if possible */
+static int stub_hosts_lookup(apr_resolver_t *res,
+                             apr_resolver_query_t *query)
+{
+    resolver_addr_t addrs[HOSTS_MAX_ADDRS];
+    resolver_hosts_t *host;
+    char name[DNS_MAX_NAME + 1];
+    apr_size_t len = strlen(query->hostname), i;
+    int naddrs;
+
+    if (len && query->hostname[len - 1] == '.') {
+        len--;
+    }
+    if (!len || len > DNS_MAX_NAME) {
+        return 0;
+    }
+    for (i = 0; i < len; i++) {
+        name[i] = apr_tolower(query->hostname[i]);
+    }
+    name[len] = '\0';
+
+    host = apr_hash_get(res->hosts, name, len);
+    if (!host) {
+        return 0;
+    }
+    naddrs = resolver_addrs_select(addrs, HOSTS_MAX_ADDRS, host->addrs,
+                                   host->naddrs, query->family, query->flags);
+    if (!naddrs) {
+        return 0;
+    }
+    query->sa = resolver_sockaddrs(query, addrs, naddrs);
+    query->status = APR_SUCCESS;
+    return 1;
+}
+
+static apr_uint16_t dns_get16(const unsigned char *p)
+{
+    return (apr_uint16_t)((p[0] << 8) | p[1]);
+}
+
+static apr_uint32_t dns_get32(const unsigned char *p)
+{
+    return ((apr_uint32_t)p[0] << 24) | ((apr_uint32_t)p[1] << 16)
+           | ((apr_uint32_t)p[2] << 8) | p[3];
+}
+
+static apr_uint16_t dns_id(void)
+{
+    unsigned char id[2];
+
+#if APR_HAS_RANDOM
+    if (apr_generate_random_bytes(id, sizeof(id)) == APR_SUCCESS) {
+        return dns_get16(id);
+    }
+#endif
+    return (apr_uint16_t)(apr_time_now() ^ (apr_uintptr_t)id);
+}
+
+/* Build a recursive query for a name, returning its length or 0 if the
+ * name is not valid.
+ */
+static apr_size_t dns_query_build(unsigned char *msg, apr_uint16_t id,
+                                  const char *name, int type)
+{
+    apr_size_t pos = DNS_HEADER_LEN;
+    const char *label = name, *end;
+
+    memset(msg, 0, DNS_HEADER_LEN);
+    msg[0] = id >> 8;
+    msg[1] = id & 0xff;
+    msg[2] = 0x01;      /* RD */
+    msg[5] = 1;         /* QDCOUNT */
+
+    while (*label) {
+        apr_size_t len;
+
+        end = strchr(label, '.');
+        len = end ? (apr_size_t)(end - label) : strlen(label);
+        if (len == 0 || len > 63
+            || pos + 1 + len > DNS_HEADER_LEN + DNS_MAX_NAME) {
+            return 0;
+        }
+        msg[pos++] = (unsigned char)len;
+        memcpy(msg + pos, label, len);
+        pos += len;
+        label += len;
+        if (*label) {
+            label++;
+        }
+    }
+    msg[pos++] = 0;
+    msg[pos++] = 0;
+    msg[pos++] = type;
+    msg[pos++] = 0;
+    msg[pos++] = DNS_CLASS_IN;
+    return pos;
+}
+
+/* Read a possibly compressed name into a lower case, dotted string */
+static int dns_name_get(const unsigned char *msg, apr_size_t len,
+                        apr_size_t *pos, char *out)
+{
+    apr_size_t p = *pos, outlen = 0;
+    int hops = 0, jumped = 0;
+
+    for (;;) {
+        unsigned c;
+
+        if (p >= len) {
+            return 0;
+        }
+        c = msg[p];
+        if (c == 0) {
+            p++;
+            break;
+        }
+        if ((c & 0xc0) == 0xc0) {
+            if (p + 1 >= len || ++hops > 16) {
+                return 0;
+            }
+            if (!jumped) {
+                *pos = p + 2;
+                jumped = 1;
+            }
+            p = ((c & 0x3f) << 8) | msg[p + 1];
+            continue;
+        }
+        if ((c & 0xc0) || p + 1 + c > len
+            || outlen + c + 1 > DNS_MAX_NAME) {
+            return 0;
+        }
+        if (outlen) {
+            out[outlen++] = '.';
+        }
+        for (p++; c; c--) {
+            out[outlen++] = apr_tolower(msg[p++]);
+        }
+    }
+    if (!jumped) {
+        *pos = p;
+    }
+    out[outlen] = '\0';
+    return 1;
+}
+
+static int dns_rr_get(const unsigned char *msg, apr_size_t len,
+                      apr_size_t *pos, dns_rr_t *rr)
+{
+    if (!dns_name_get(msg, len, pos, rr->owner) || *pos + 10 > len) {
+        return 0;
+    }
+    rr->type = dns_get16(msg + *pos);
+    rr->rclass = dns_get16(msg + *pos + 2);
+    rr->ttl = dns_get32(msg + *pos + 4);
+    /* RFC 2181: a time to live with the top bit set is zero */
+    if (rr->ttl > 0x7fffffff) {
+        rr->ttl = 0;
+    }
+    rr->rdlen = dns_get16(msg + *pos + 8);
+    rr->rdata = *pos + 10;
+    *pos = rr->rdata + rr->rdlen;
+    return *pos <= len;
+}
+
+/* Parse the answer to a question, following the CNAME records.  Returns
+ * the response code, or -1 if the message does not answer the question.
+ */
+static int dns_answer_parse(const unsigned char *msg, apr_size_t len,
+                            apr_uint16_t id, const char *name, int type,
+                            stub_answer_t *ans)
+{
+    char target[DNS_MAX_NAME + 1];
+    apr_size_t pos = DNS_HEADER_LEN, answers, p;
+    unsigned ancount, nscount, i;
+    apr_uint32_t ttl = 0x7fffffff;
+    dns_rr_t rr;
+    int rcode, hops;
+
+    if (len < DNS_HEADER_LEN || dns_get16(msg) != id
+        || !(msg[2] & 0x80)                     /* QR */
+        || dns_get16(msg + 4) != 1) {           /* QDCOUNT */
+        return -1;
+    }
+    rcode = msg[3] & 0x0f;
+    ancount = dns_get16(msg + 6);
+    nscount = dns_get16(msg + 8);
+
+    if (!dns_name_get(msg, len, &pos, target) || strcasecmp(target, name)
+        || pos + 4 > len || dns_get16(msg + pos) != type) {
+        return -1;
+    }
+    pos += 4;
+    if (rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN) {
+        return rcode;
+    }
+    answers = pos;
+
+    /* Follow the chain of aliases; a truncated message still holds whole
+     * records, which are used.
+     */
+    for (hops = 0; hops < DNS_MAX_CNAMES; hops++) {
+        int found = 0;
+
+        for (p = answers, i = 0; i < ancount; i++) {
+            if (!dns_rr_get(msg, len, &p, &rr)) {
+                break;
+            }
+            if (rr.type == DNS_TYPE_CNAME && rr.rclass == DNS_CLASS_IN
+                && !strcmp(rr.owner, target)) {
+                apr_size_t rdata = rr.rdata;
+
+                if (!dns_name_get(msg, len, &rdata, target)) {
+                    return -1;
+                }
+                ttl = rr.ttl < ttl ? rr.ttl : ttl;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+    }
+
+    ans->naddrs = 0;
+    for (p = answers, i = 0; i < ancount; i++) {
+        if (!dns_rr_get(msg, len, &p, &rr)) {
+            break;
+        }
+        if (rr.type != type || rr.rclass != DNS_CLASS_IN
+            || strcmp(rr.owner, target)
+            || ans->naddrs == RESOLVER_MAX_ADDRS) {
+            continue;
+        }
+        if (type == DNS_TYPE_A && rr.rdlen == sizeof(struct in_addr)) {
+            ans->addrs[ans->naddrs].family = APR_INET;
+        }
+#if APR_HAVE_IPV6
+        else if (type == DNS_TYPE_AAAA
+                 && rr.rdlen == sizeof(struct in6_addr)) {
+            ans->addrs[ans->naddrs].family = APR_INET6;
+        }
+#endif
+        else {
+            continue;
+        }
+        memcpy(&ans->addrs[ans->naddrs++].u, msg + rr.rdata, rr.rdlen);
+        ttl = rr.ttl < ttl ? rr.ttl : ttl;
+    }
+    ans->ttl = ttl;
+
+    /* RFC 2308: a negative answer lives as long as the SOA record of the
+     * authority section, and no longer than its minimum field.
+     */
+    ans->has_soa = 0;
+    if (i == ancount) {
+        for (i = 0; i < nscount; i++) {
+            if (!dns_rr_get(msg, len, &p, &rr)) {
+                break;
+            }
+            if (rr.type == DNS_TYPE_SOA && rr.rclass == DNS_CLASS_IN) {
+                apr_size_t rdata = rr.rdata;
+                char soa_name[DNS_MAX_NAME + 1];
+
+                if (dns_name_get(msg, len, &rdata, soa_name)         /* MNAME */
+                    && dns_name_get(msg, len, &rdata, soa_name)      /* RNAME */
+                    && rdata + 20 <= rr.rdata + rr.rdlen) {
+                    apr_uint32_t minimum = dns_get32(msg + rdata + 16);
+
+                    ans->negative_ttl = minimum < rr.ttl ? minimum : rr.ttl;
+                    ans->has_soa = 1;
+                }
+                break;
+            }
+        }
+    }
+
+    ans->rcode = rcode;
+    return rcode;
+}
+
+/* Ask the nameservers in turn until all the questions are answered */
+static apr_status_t stub_exchange(apr_resolver_t *res, const char *name,
+                                  int nquestions, const int *types,
+                                  unsigned char (*queries)[DNS_MAX_QUERY],
+                                  const apr_size_t *lens,
+                                  const apr_uint16_t *ids,
+                                  stub_answer_t *ans)
+{
+    unsigned char msg[DNS_MAX_MSG];
+    int pending = nquestions, attempt, s, i;
+
+    for (attempt = 0; attempt < res->attempts; attempt++) {
+        for (s = 0; s < res->nservers; s++) {
+            apr_sockaddr_t *ns = res->servers[s];
+            apr_time_t deadline;
+            int fd, failed = 0;
+
+            fd = socket(ns->family, SOCK_DGRAM, 0);
+            if (fd < 0) {
+                continue;
+            }
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            /* A connected socket only receives from the nameserver */
+            if (connect(fd, (struct sockaddr *)&ns->sa, ns->salen) < 0) {
+                close(fd);
+                continue;
+            }
+            for (i = 0; i < nquestions; i++) {
+                if (!ans[i].done) {
+                    send(fd, queries[i], lens[i], 0);
+                }
+            }
+
+            deadline = apr_time_now() + res->timeout;
+            while (pending && !failed) {
+                apr_interval_time_t timeout = deadline - apr_time_now();
+                struct pollfd pfd;
+                apr_ssize_t n;
+                int rc;
+
+                if (timeout <= 0) {
+                    break;
+                }
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                rc = poll(&pfd, 1, (int)((timeout + 999) / 1000));
+                if (rc < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (rc <= 0) {
+                    break;
+                }
+                n = recv(fd, msg, sizeof(msg), 0);
+                if (n < 0) {
+                    /* Nothing listens there */
+                    failed = (errno == ECONNREFUSED);
+                    continue;
+                }
+                for (i = 0; i < nquestions; i++) {
+                    if (!ans[i].done) {
+                        rc = dns_answer_parse(msg, n, ids[i], name, types[i],
+                                              &ans[i]);
+                        if (rc == DNS_RCODE_NOERROR
+                            || rc == DNS_RCODE_NXDOMAIN) {
+                            ans[i].done = 1;
+                            pending--;
+                            break;
+                        }
+                        else if (rc >= 0) {
+                            /* SERVFAIL, REFUSED: ask the next one */
+                            failed = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            close(fd);
+            if (!pending) {
+                return APR_SUCCESS;
+            }
+        }
+    }
+    return RESOLVER_EAI(EAI_AGAIN);
+}
+
+/* Resolve a fully qualified name */
+static apr_status_t stub_lookup(apr_resolver_t *res, const char *name,
+                                apr_int32_t family, apr_int32_t flags,
+                                resolver_addr_t *addrs, int *naddrs,
+                                apr_interval_time_t *ttl)
+{
+    unsigned char queries[2][DNS_MAX_QUERY];
+    stub_answer_t ans[2];
+    resolver_addr_t all[2 * RESOLVER_MAX_ADDRS];
+    apr_size_t lens[2];
+    apr_uint16_t ids[2];
+    int types[2], nquestions = 0, nall = 0, nxdomain = 0, i;
+    apr_uint32_t min_ttl = 0x7fffffff;
+    apr_status_t rv;
+
+    if (family != APR_INET6) {
+        types[nquestions++] = DNS_TYPE_A;
+    }
+#if APR_HAVE_IPV6
+    if (family != APR_INET) {
+        types[nquestions++] = DNS_TYPE_AAAA;
+    }
+#endif
+    for (i = 0; i < nquestions; i++) {
+        ids[i] = dns_id();
+        lens[i] = dns_query_build(queries[i], ids[i], name, types[i]);
+        if (!lens[i]) {
+            return RESOLVER_EAI(EAI_NONAME);
+        }
+        ans[i].done = 0;
+    }
+
+    rv = stub_exchange(res, name, nquestions, types, queries, lens, ids, ans);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < nquestions; i++) {
+        if (ans[i].rcode == DNS_RCODE_NXDOMAIN) {
+            nxdomain = 1;
+        }
+        else if (ans[i].naddrs) {
+            memcpy(all + nall, ans[i].addrs,
+                   ans[i].naddrs * sizeof(resolver_addr_t));
+            nall += ans[i].naddrs;
+        }
+    }
+    *naddrs = resolver_addrs_select(addrs, RESOLVER_MAX_ADDRS, all, nall,
+                                    family, flags);
+
+    if (*naddrs) {
+        for (i = 0; i < nquestions; i++) {
+            if (ans[i].naddrs && ans[i].ttl < min_ttl) {
+                min_ttl = ans[i].ttl;
+            }
+        }
+        *ttl = apr_time_from_sec(min_ttl);
+        return APR_SUCCESS;
+    }
+
+    /* Without an SOA record the answer is not to be kept */
+    for (i = 0; i < nquestions; i++) {
+        if (!ans[i].has_soa) {
+            min_ttl = 0;
+        }
+        else if (ans[i].negative_ttl < min_ttl) {
+            min_ttl = ans[i].negative_ttl;
+        }
+    }
+    *ttl = apr_time_from_sec(min_ttl);
+    return nxdomain ? RESOLVER_EAI(EAI_NONAME) : RESOLVER_EAI_NODATA;
+}
+
+/* Resolve a name, trying the search domains as resolv.conf(5) does */
+static apr_status_t stub_resolve(apr_resolver_t *res, const char *hostname,
+                                 apr_int32_t family, apr_int32_t flags,
+                                 resolver_addr_t *addrs, int *naddrs,
+                                 apr_interval_time_t *ttl)
+{
+    char name[DNS_MAX_NAME + 2];
+    apr_size_t len = strlen(hostname);
+    apr_status_t rv = RESOLVER_EAI(EAI_NONAME);
+    const char *p;
+    int order[STUB_MAX_SEARCH + 1];
+    int dots = 0, n = 0, i;
+
+    if (len && hostname[len - 1] == '.') {
+        /* Fully qualified */
+        if (len > DNS_MAX_NAME + 1) {
+            return rv;
+        }
+        memcpy(name, hostname, len - 1);
+        name[len - 1] = '\0';
+        return stub_lookup(res, name, family, flags, addrs, naddrs, ttl);
+    }
+
+    for (p = hostname; *p; p++) {
+        dots += (*p == '.');
+    }
+    /* The name as is (-1) comes first when it has enough dots, and
+     * otherwise after the search domains.
+     */
+    if (dots >= res->ndots) {
+        order[n++] = -1;
+    }
+    for (i = 0; i < res->nsearch; i++) {
+        order[n++] = i;
+    }
+    if (dots < res->ndots) {
+        order[n++] = -1;
+    }
+    for (i = 0; i < n; i++) {
+        int domain = order[i];
+
+        if (domain < 0) {
+            if (len > DNS_MAX_NAME) {
+                continue;
+            }
+            memcpy(name, hostname, len + 1);
+        }
+        else if (apr_snprintf(name, sizeof(name), "%s.%s", hostname,
+                              res->search[domain]) > DNS_MAX_NAME) {
+            continue;
+        }
+        *ttl = 0;
+        rv = stub_lookup(res, name, family, flags, addrs, naddrs, ttl);
+        if (rv == APR_SUCCESS || !resolver_is_negative(rv)) {
+            break;
+        }
+    }
+    return rv;
+}
+
+/* Completion */
+
+static void resolver_signal(apr_resolver_t *res)
+{
+#ifdef HAVE_EVENTFD
+    apr_uint64_t one = 1;
+#else
+    char one = 1;
+#endif
+
+    /* A full pipe or counter is signalled already */
+    while (write(res->notify_wfd, &one, sizeof(one)) == -1
+           && errno == EINTR)
+        ;
+}
+
+static void resolver_drain(apr_resolver_t *res)
+{
+    char buf[64];
+    apr_ssize_t n;
+
+    do {
+        n = read(res->notify_rfd, buf, sizeof(buf));
+    } while (n > 0 || (n == -1 && errno == EINTR));
+}
+
+static void resolver_complete(apr_resolver_t *res,
+                              apr_resolver_query_t *query)
+{
+    query->next = NULL;
+#if APR_HAS_THREADS
+    if (res->lock) {
+        apr_thread_mutex_lock(res->lock);
+    }
+#endif
+    if (res->done_tail) {
+        res->done_tail->next = query;
+    }
+    else {
+        res->done = query;
+    }
+    res->done_tail = query;
+#if APR_HAS_THREADS
+    if (res->lock) {
+        apr_thread_mutex_unlock(res->lock);
+    }
+#endif
+    resolver_signal(res);
+}
+
+/* Resolve a query which was not answered right away, and cache it */
+static void resolver_run(apr_resolver_t *res, apr_resolver_query_t *query)
+{
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    char key[DNS_MAX_NAME + 32];
+    apr_interval_time_t ttl = -1;
+    int naddrs = 0;
+
+    if (res->flags & APR_RESOLVER_STUB) {
+        query->status = stub_resolve(res, query->hostname, query->family,
+                                     query->flags, addrs, &naddrs, &ttl);
+        if (query->status == APR_SUCCESS) {
+            query->sa = resolver_sockaddrs(query, addrs, naddrs);
+        }
+    }
+    else {
+        apr_sockaddr_t *sa;
+
+        query->status = apr_sockaddr_info_get(&query->sa, query->hostname,
+                                              query->family, query->port,
+                                              query->flags, query->pool);
+        for (sa = query->sa; sa && naddrs < RESOLVER_MAX_ADDRS;
+             sa = sa->next) {
+            if (sa->family == APR_INET
+#if APR_HAVE_IPV6
+                || sa->family == APR_INET6
+#endif
+                ) {
+                addrs[naddrs].family = sa->family;
+                memcpy(&addrs[naddrs++].u, sa->ipaddr_ptr, sa->ipaddr_len);
+            }
+        }
+    }
+
+    if (res->cache
+        && ((query->status == APR_SUCCESS && naddrs)
+            || resolver_is_negative(query->status))
+        && resolver_key(key, sizeof(key), query)) {
+        query->ttl = cache_store(res->cache, key, query->status, addrs,
+                                 query->status ? 0 : naddrs, ttl);
+    }
+    else {
+        query->ttl = ttl > 0 ? ttl : 0;
+    }
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC resolver_task(apr_thread_t *thd, void *data)
+{
+    apr_resolver_query_t *query = data;
+    void *res;
+
+    apr_thread_pool_task_owner_get(thd, &res);
+    resolver_run(res, query);
+    resolver_complete(res, query);
+    return NULL;
+}
+
+static apr_status_t resolver_threads_init(apr_resolver_t *res)
+{
+    apr_size_t max = res->depth < RESOLVER_MAX_THREADS
+                     ? res->depth : RESOLVER_MAX_THREADS;
+    apr_status_t rv;
+
+    rv = apr_thread_mutex_create(&res->lock, APR_THREAD_MUTEX_DEFAULT,
+                                 res->pool);
+    if (rv == APR_SUCCESS) {
+        rv = apr_thread_pool_create(&res->threads, 0, max, res->pool);
+    }
+    if (rv == APR_SUCCESS) {
+        apr_thread_pool_idle_max_set(res->threads, max);
+    }
+    return rv;
+}
+#endif
+
+static apr_status_t resolver_cleanup(void *data)
+{
+    apr_resolver_t *res = data;
+
+    if (res->notify_wfd != res->notify_rfd) {
+        close(res->notify_wfd);
+    }
+    close(res->notify_rfd);
+    return APR_SUCCESS;
+}
+
+static apr_status_t resolver_notify_create(apr_resolver_t *res)
+{
+#ifdef HAVE_EVENTFD
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (fd < 0) {
+        return errno;
+    }
+    res->notify_rfd = res->notify_wfd = fd;
+#else
+    int fds[2], i;
+
+    if (pipe(fds) < 0) {
+        return errno;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    }
+    res->notify_rfd = fds[0];
+    res->notify_wfd = fds[1];
+#endif
+    return apr_os_file_put(&res->notify, &res->notify_rfd, APR_FOPEN_READ,
+                           res->pool);
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_create(apr_resolver_t **pres,
+                                              apr_uint32_t depth,
+                                              apr_resolver_cache_t *cache,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p)
+{
+    apr_resolver_t *res;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    if (depth == 0) {
+        return APR_EINVAL;
+    }
+
+    rv = apr_pool_create(&pool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    res = apr_pcalloc(pool, sizeof(*res));
+    res->pool = pool;
+    res->depth = depth;
+    res->cache = cache;
+    res->flags = flags;
+
+    rv = resolver_notify_create(res);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return rv;
+    }
+    apr_pool_cleanup_register(pool, res, resolver_cleanup,
+                              apr_pool_cleanup_null);
+
+    if (flags & APR_RESOLVER_STUB) {
+        stub_config_read(res);
+        res->method = "stub";
+    }
+    else {
+        res->method = "getaddrinfo";
+    }
+
+#if APR_HAS_THREADS
+    rv = resolver_threads_init(res);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return rv;
+    }
+#endif
+
+    *pres = res;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_destroy(apr_resolver_t *res)
+{
+    apr_pool_destroy(res->pool);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_nameserver_add(apr_resolver_t *res,
+                                                     const apr_sockaddr_t *sa)
+{
+    apr_sockaddr_t *ns;
+
+    if (!(res->flags & APR_RESOLVER_STUB)) {
+        return APR_ENOTIMPL;
+    }
+    if (sa->family != APR_INET
+#if APR_HAVE_IPV6
+        && sa->family != APR_INET6
+#endif
+        ) {
+        return APR_EINVAL;
+    }
+    if (!res->servers_added) {
+        res->nservers = 0;
+        res->servers_added = 1;
+    }
+    if (res->nservers == STUB_MAX_NAMESERVERS) {
+        return APR_ENOSPC;
+    }
+    ns = apr_pmemdup(res->pool, sa, sizeof(*sa));
+    ns->pool = res->pool;
+    ns->hostname = NULL;
+    ns->servname = NULL;
+    ns->next = NULL;
+    stub_nameserver_set(res, ns);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_timeout_set(apr_resolver_t *res,
+                                                  apr_interval_time_t timeout,
+                                                  int attempts)
+{
+    if (!(res->flags & APR_RESOLVER_STUB)) {
+        return APR_ENOTIMPL;
+    }
+    if (timeout > 0) {
+        res->timeout = timeout;
+    }
+    if (attempts > 0) {
+        res->attempts = attempts;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_submit(apr_resolver_t *res,
+                                              apr_resolver_query_t *query)
+{
+    apr_int32_t masked = query->flags & (APR_IPV4_ADDR_OK
+                                         | APR_IPV6_ADDR_OK);
+    char key[DNS_MAX_NAME + 32];
+
+    if (res->inflight >= res->depth) {
+        return APR_EAGAIN;
+    }
+    if (masked && (!query->hostname || query->family != APR_UNSPEC
+                   || masked == (APR_IPV4_ADDR_OK | APR_IPV6_ADDR_OK))) {
+        return APR_EINVAL;
+    }
+
+    query->sa = NULL;
+    query->ttl = 0;
+    res->inflight++;
+
+    if (resolver_is_numeric(query)) {
+        query->status = apr_sockaddr_info_get(&query->sa, query->hostname,
+                                              query->family, query->port,
+                                              query->flags, query->pool);
+        if (query->status == APR_SUCCESS) {
+            query->ttl = -1;
+        }
+        resolver_complete(res, query);
+        return APR_SUCCESS;
+    }
+    if (((res->flags & APR_RESOLVER_STUB) && stub_hosts_lookup(res, query))
+        || (res->cache && resolver_key(key, sizeof(key), query)
+            && cache_lookup(res->cache, key, query))) {
+        resolver_complete(res, query);
+        return APR_SUCCESS;
+    }
+
+#if APR_HAS_THREADS
+    if (res->threads) {
+        apr_status_t rv = apr_thread_pool_push(res->threads, resolver_task,
+                                               query,
+                                               APR_THREAD_TASK_PRIORITY_NORMAL,
+                                               res);
+        if (rv != APR_SUCCESS) {
+            res->inflight--;
+        }
+        return rv;
+    }
+#endif
+    resolver_run(res, query);
+    resolver_complete(res, query);
+    return APR_SUCCESS;
+}
+
+static apr_int32_t resolver_reap(apr_resolver_t *res,
+                                 apr_resolver_query_t **queries,
+                                 apr_int32_t num)
+{
+    apr_int32_t n = 0;
+    int more;
+
+#if APR_HAS_THREADS
+    if (res->lock) {
+        apr_thread_mutex_lock(res->lock);
+    }
+#endif
+    while (res->done && n < num) {
+        queries[n++] = res->done;
+        res->done = res->done->next;
+    }
+    if (!res->done) {
+        res->done_tail = NULL;
+    }
+    more = res->done != NULL;
+#if APR_HAS_THREADS
+    if (res->lock) {
+        apr_thread_mutex_unlock(res->lock);
+    }
+#endif
+
+    /* Keep the pollfd readable for what did not fit */
+    if (more) {
+        resolver_signal(res);
+    }
+    res->inflight -= n;
+    return n;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_poll(apr_resolver_t *res,
+                                            apr_interval_time_t timeout,
+                                            apr_resolver_query_t **queries,
+                                            apr_int32_t *num)
+{
+    apr_time_t deadline = 0;
+    apr_int32_t n;
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    for (;;) {
+        struct pollfd pfd;
+        int rc;
+
+        /* Drain first, so that no later signal gets lost */
+        resolver_drain(res);
+        n = resolver_reap(res, queries, *num);
+        if (n || timeout == 0) {
+            break;
+        }
+
+        if (timeout > 0) {
+            timeout = deadline - apr_time_now();
+            if (timeout <= 0) {
+                break;
+            }
+        }
+        pfd.fd = res->notify_rfd;
+        pfd.events = POLLIN;
+        rc = poll(&pfd, 1, timeout < 0 ? -1
+                                       : (int)((timeout + 999) / 1000));
+        if (rc < 0 && errno != EINTR) {
+            *num = 0;
+            return errno;
+        }
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : APR_TIMEUP;
+}
+
+APR_DECLARE(void) apr_resolver_pollfd_get(apr_resolver_t *res,
+                                          apr_pollfd_t *pfd)
+{
+    pfd->p = res->pool;
+    pfd->desc_type = APR_POLL_FILE;
+    pfd->reqevents = APR_POLLIN;
+    pfd->rtnevents = 0;
+    pfd->desc.f = res->notify;
+}
+
+APR_DECLARE(const char *) apr_resolver_method_name(apr_resolver_t *res)
+{
+    return res->method;
+}
+
+#endif /* APR_HAS_RESOLVER */
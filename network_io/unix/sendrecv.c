@@ -17,10 +17,10 @@
 #include "apr_arch_networkio.h"
 #include "apr_support.h"
 
-#if APR_HAS_SENDFILE
+#if APR_HAS_SENDFILE || APR_HAS_SPLICE
 /* This file is needed to allow us access to the apr_file_t internals. */
 #include "apr_arch_file_io.h"
-#endif /* APR_HAS_SENDFILE */
+#endif /* APR_HAS_SENDFILE || APR_HAS_SPLICE */
 
 /* osreldate.h is only needed on FreeBSD for sendfile detection */
 #if defined(__FreeBSD__)
@@ -40,6 +40,7 @@ apr_status_t apr_socket_send(apr_socket_t *sock, const char *buf,
     do {
         rv = write(sock->socketdes, buf, (*len));
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_send(sock, rv);
 
     while (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) 
                     && (sock->timeout > 0)) {
@@ -54,6 +55,7 @@ do_select:
             do {
                 rv = write(sock->socketdes, buf, (*len));
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_send(sock, rv);
         }
     }
     if (rv == -1) {
@@ -80,6 +82,7 @@ apr_status_t apr_socket_recv(apr_socket_t *sock, char *buf, apr_size_t *len)
     do {
         rv = read(sock->socketdes, buf, (*len));
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_recv(sock, rv);
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
@@ -93,6 +96,7 @@ do_select:
             do {
                 rv = read(sock->socketdes, buf, (*len));
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_recv(sock, rv);
         }
     }
     if (rv == -1) {
@@ -120,6 +124,7 @@ apr_status_t apr_socket_sendto(apr_socket_t *sock, apr_sockaddr_t *where,
                     (const struct sockaddr*)&where->sa, 
                     where->salen);
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_send(sock, rv);
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
@@ -133,6 +138,7 @@ apr_status_t apr_socket_sendto(apr_socket_t *sock, apr_sockaddr_t *where,
                             (const struct sockaddr*)&where->sa,
                             where->salen);
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_send(sock, rv);
         }
     }
     if (rv == -1) {
@@ -155,6 +161,7 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
         rv = recvfrom(sock->socketdes, buf, (*len), flags, 
                       (struct sockaddr*)&from->sa, &from->salen);
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_recv_flags(sock, rv, flags);
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
@@ -167,6 +174,7 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
                 rv = recvfrom(sock->socketdes, buf, (*len), flags,
                               (struct sockaddr*)&from->sa, &from->salen);
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_recv_flags(sock, rv, flags);
         }
     }
     if (rv == -1) {
@@ -191,6 +199,392 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
     return APR_SUCCESS;
 }
 
+#if defined(UDP_SEGMENT) || defined(UDP_GRO)
+typedef union socket_cmsg_u {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} socket_cmsg_u;
+#endif
+
+#ifdef UDP_SEGMENT
+/* The segments Linux makes of a single send at most (UDP_MAX_SEGMENTS) */
+#define SOCKET_SEGMENTS_MAX 64
+
+/* Ask for the data of mh to be sent as datagrams of seg bytes */
+static void socket_gso_set(struct msghdr *mh, socket_cmsg_u *control,
+                           apr_size_t seg)
+{
+    struct cmsghdr *cm;
+
+    mh->msg_control = control->buf;
+    mh->msg_controllen = CMSG_SPACE(sizeof(apr_uint16_t));
+    cm = CMSG_FIRSTHDR(mh);
+    cm->cmsg_level = IPPROTO_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(apr_uint16_t));
+    *(apr_uint16_t *)CMSG_DATA(cm) = (apr_uint16_t)seg;
+}
+
+/* Send len bytes as datagrams of seg bytes, with a single sendmsg() */
+static apr_status_t socket_send_gso(apr_socket_t *sock, apr_sockaddr_t *where,
+                                    apr_int32_t flags, const char *buf,
+                                    apr_size_t *len, apr_size_t seg)
+{
+    socket_cmsg_u control;
+    struct msghdr mh;
+    struct iovec iov;
+    apr_ssize_t rv;
+    apr_status_t arv;
+
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = (void *)buf;
+    iov.iov_len = *len;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (where) {
+        mh.msg_name = &where->sa;
+        mh.msg_namelen = where->salen;
+    }
+    socket_gso_set(&mh, &control, seg);
+
+    for (;;) {
+        do {
+            rv = sendmsg(sock->socketdes, &mh, flags);
+        } while (rv == -1 && errno == EINTR);
+        apr_socket_stats_send(sock, rv);
+
+        if (rv >= 0) {
+            *len = rv;
+            return APR_SUCCESS;
+        }
+        if ((errno != EAGAIN && errno != EWOULDBLOCK)
+            || sock->timeout <= 0) {
+            *len = 0;
+            return errno;
+        }
+        if ((arv = apr_wait_for_io_or_timeout(NULL, sock, 0))
+                != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+    }
+}
+#endif
+
+/* Send one datagram, or its segments as many at a time as segmentation
+ * offload allows, else one at a time.
+ */
+static apr_status_t socket_send_msg(apr_socket_t *sock, apr_socket_msg_t *msg,
+                                    apr_int32_t flags)
+{
+    apr_size_t off = 0, seg, step, n;
+    apr_status_t rv;
+
+    seg = step = msg->segment_size ? msg->segment_size : msg->len;
+#ifdef UDP_SEGMENT
+    if (seg < msg->len) {
+        step = seg * SOCKET_SEGMENTS_MAX;
+    }
+#endif
+    msg->nbytes = 0;
+    do {
+        n = msg->len - off < step ? msg->len - off : step;
+#ifdef UDP_SEGMENT
+        if (n > seg) {
+            rv = socket_send_gso(sock, msg->addr, flags, msg->buf + off,
+                                 &n, seg);
+        }
+        else
+#endif
+        if (msg->addr) {
+            rv = apr_socket_sendto(sock, msg->addr, flags, msg->buf + off, &n);
+        }
+        else {
+            rv = apr_socket_send(sock, msg->buf + off, &n);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        off += n;
+        msg->nbytes = off;
+    } while (off < msg->len);
+
+    return APR_SUCCESS;
+}
+
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+
+/* The datagrams handed to the kernel at once */
+#define SOCKET_BATCH_MAX 64
+
+/* sendmmsg() or recvmmsg(), waiting for the socket if it has a timeout
+ * and wait is set.
+ */
+static apr_status_t socket_mmsg(apr_socket_t *sock, struct mmsghdr *hdrs,
+                                unsigned int count, int flags, int for_read,
+                                int wait, int *done)
+{
+    apr_status_t rv;
+    int rc;
+
+    *done = 0;
+    for (;;) {
+        do {
+            if (for_read) {
+                rc = recvmmsg(sock->socketdes, hdrs, count, flags, NULL);
+            }
+            else {
+                rc = sendmmsg(sock->socketdes, hdrs, count, flags);
+            }
+        } while (rc == -1 && errno == EINTR);
+
+        /* the callers count the bytes, from the lengths of the messages */
+        if (for_read) {
+            apr_socket_stats_recv(sock, rc < 0 ? rc : 0);
+        }
+        else {
+            apr_socket_stats_send(sock, rc < 0 ? rc : 0);
+        }
+
+        if (rc >= 0) {
+            *done = rc;
+            return APR_SUCCESS;
+        }
+        if ((errno != EAGAIN && errno != EWOULDBLOCK)
+            || !wait || sock->timeout <= 0) {
+            return errno;
+        }
+        if ((rv = apr_wait_for_io_or_timeout(NULL, sock, for_read))
+                != APR_SUCCESS) {
+            return rv;
+        }
+    }
+}
+
+apr_status_t apr_socket_sendto_batch(apr_socket_t *sock,
+                                     apr_socket_msg_t *msgs,
+                                     apr_int32_t *num, apr_int32_t flags)
+{
+    struct mmsghdr hdrs[SOCKET_BATCH_MAX];
+    struct iovec iov[SOCKET_BATCH_MAX];
+#ifdef UDP_SEGMENT
+    socket_cmsg_u control[SOCKET_BATCH_MAX];
+#endif
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+    int i, count, done;
+
+    while (n < *num) {
+        for (count = 0; n + count < *num && count < SOCKET_BATCH_MAX;
+             count++) {
+            apr_socket_msg_t *msg = &msgs[n + count];
+            struct msghdr *mh = &hdrs[count].msg_hdr;
+            int segmented = msg->segment_size
+                            && msg->segment_size < msg->len;
+
+#ifndef UDP_SEGMENT
+            if (segmented) {
+                break;
+            }
+#else
+            /* Too many segments for a single send, on its own */
+            if (segmented && msg->len > msg->segment_size
+                                        * SOCKET_SEGMENTS_MAX) {
+                break;
+            }
+#endif
+            memset(mh, 0, sizeof(*mh));
+            iov[count].iov_base = msg->buf;
+            iov[count].iov_len = msg->len;
+            mh->msg_iov = &iov[count];
+            mh->msg_iovlen = 1;
+            if (msg->addr) {
+                mh->msg_name = &msg->addr->sa;
+                mh->msg_namelen = msg->addr->salen;
+            }
+#ifdef UDP_SEGMENT
+            if (segmented) {
+                socket_gso_set(mh, &control[count], msg->segment_size);
+            }
+#endif
+        }
+
+        if (!count) {
+            /* No segmentation offload, or too many segments */
+            if ((rv = socket_send_msg(sock, &msgs[n], flags))
+                    != APR_SUCCESS) {
+                break;
+            }
+            n++;
+            continue;
+        }
+
+        if ((rv = socket_mmsg(sock, hdrs, count, flags, 0, 1, &done))
+                != APR_SUCCESS) {
+            break;
+        }
+        for (i = 0; i < done; i++) {
+            msgs[n + i].nbytes = hdrs[i].msg_len;
+            sock->stats.bytes_sent += hdrs[i].msg_len;
+        }
+        n += done;
+        if (done < count) {
+            break;
+        }
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+apr_status_t apr_socket_recvfrom_batch(apr_socket_t *sock,
+                                       apr_socket_msg_t *msgs,
+                                       apr_int32_t *num, apr_int32_t flags)
+{
+    struct mmsghdr hdrs[SOCKET_BATCH_MAX];
+    struct iovec iov[SOCKET_BATCH_MAX];
+#ifdef UDP_GRO
+    socket_cmsg_u control[SOCKET_BATCH_MAX];
+    int gro = apr_is_option_set(sock, APR_UDP_GRO);
+#endif
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+    int i, count, done;
+
+    while (n < *num) {
+        count = *num - n < SOCKET_BATCH_MAX ? *num - n : SOCKET_BATCH_MAX;
+        for (i = 0; i < count; i++) {
+            apr_socket_msg_t *msg = &msgs[n + i];
+            struct msghdr *mh = &hdrs[i].msg_hdr;
+
+            memset(mh, 0, sizeof(*mh));
+            iov[i].iov_base = msg->buf;
+            iov[i].iov_len = msg->len;
+            mh->msg_iov = &iov[i];
+            mh->msg_iovlen = 1;
+            if (msg->addr) {
+                mh->msg_name = &msg->addr->sa;
+                mh->msg_namelen = sizeof(msg->addr->sa);
+            }
+#ifdef UDP_GRO
+            if (gro) {
+                mh->msg_control = control[i].buf;
+                mh->msg_controllen = sizeof(control[i].buf);
+            }
+#endif
+        }
+
+        /* Wait for the first datagram only */
+        rv = socket_mmsg(sock, hdrs, count,
+                         n ? flags | MSG_DONTWAIT : flags | MSG_WAITFORONE,
+                         1, n == 0, &done);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+
+        for (i = 0; i < done; i++) {
+            apr_socket_msg_t *msg = &msgs[n + i];
+
+            msg->nbytes = hdrs[i].msg_len;
+            msg->segment_size = 0;
+            if (!(flags & MSG_PEEK)) {
+                sock->stats.bytes_received += hdrs[i].msg_len;
+            }
+            if (msg->addr) {
+                msg->addr->salen = hdrs[i].msg_hdr.msg_namelen;
+                if (msg->addr->salen > APR_OFFSETOF(struct sockaddr_in,
+                                                    sin_port)) {
+                    apr_sockaddr_vars_set(msg->addr,
+                                          msg->addr->sa.sin.sin_family,
+                                          ntohs(msg->addr->sa.sin.sin_port));
+                }
+            }
+#ifdef UDP_GRO
+            if (gro) {
+                struct cmsghdr *cm;
+
+                for (cm = CMSG_FIRSTHDR(&hdrs[i].msg_hdr); cm;
+                     cm = CMSG_NXTHDR(&hdrs[i].msg_hdr, cm)) {
+                    if (cm->cmsg_level == IPPROTO_UDP
+                        && cm->cmsg_type == UDP_GRO) {
+                        int size;
+
+                        memcpy(&size, CMSG_DATA(cm), sizeof(size));
+                        msg->segment_size = size;
+                    }
+                }
+            }
+#endif
+        }
+        n += done;
+        if (done < count) {
+            break;
+        }
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+#else /* HAVE_SENDMMSG && HAVE_RECVMMSG */
+
+apr_status_t apr_socket_sendto_batch(apr_socket_t *sock,
+                                     apr_socket_msg_t *msgs,
+                                     apr_int32_t *num, apr_int32_t flags)
+{
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (n < *num) {
+        if ((rv = socket_send_msg(sock, &msgs[n], flags)) != APR_SUCCESS) {
+            break;
+        }
+        n++;
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+apr_status_t apr_socket_recvfrom_batch(apr_socket_t *sock,
+                                       apr_socket_msg_t *msgs,
+                                       apr_int32_t *num, apr_int32_t flags)
+{
+    apr_sockaddr_t from;
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (n < *num) {
+        apr_socket_msg_t *msg = &msgs[n];
+        apr_int32_t f = flags;
+
+        /* Only wait for the first datagram */
+        if (n && sock->timeout != 0) {
+#ifdef MSG_DONTWAIT
+            if (sock->timeout > 0) {
+                break;
+            }
+            f |= MSG_DONTWAIT;
+#else
+            break;
+#endif
+        }
+        msg->nbytes = msg->len;
+        msg->segment_size = 0;
+        rv = apr_socket_recvfrom(msg->addr ? msg->addr : &from, sock, f,
+                                 msg->buf, &msg->nbytes);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n++;
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+#endif /* HAVE_SENDMMSG && HAVE_RECVMMSG */
+
 apr_status_t apr_socket_sendv(apr_socket_t * sock, const struct iovec *vec,
                               apr_int32_t nvec, apr_size_t *len)
 {
@@ -211,6 +605,7 @@ apr_status_t apr_socket_sendv(apr_socket_t * sock, const struct iovec *vec,
     do {
         rv = writev(sock->socketdes, vec, nvec);
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_send(sock, rv);
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK) 
                       && (sock->timeout > 0)) {
@@ -225,6 +620,7 @@ do_select:
             do {
                 rv = writev(sock->socketdes, vec, nvec);
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_send(sock, rv);
         }
     }
     if (rv == -1) {
@@ -340,6 +736,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
                       &off,    /* where in the file to start */
                       *len);   /* number of bytes to send */
     } while (rv == -1 && errno == EINTR);
+    apr_socket_stats_send(sock, rv);
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK) 
                       && (sock->timeout > 0)) {
@@ -356,6 +753,7 @@ do_select:
                               &off,    /* where in the file to start */
                               *len);    /* number of bytes to send */
             } while (rv == -1 && errno == EINTR);
+            apr_socket_stats_send(sock, rv);
         }
     }
 
@@ -367,6 +765,7 @@ do_select:
     }
 
     nbytes += rv;
+    sock->stats.sendfile_bytes += rv;
 
     if (rv < *len) {
         *len = nbytes;
@@ -1113,3 +1512,39 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
 	  Tru64/OSF1 */
 
 #endif /* APR_HAS_SENDFILE */
+
+#if APR_HAS_SPLICE
+
+apr_status_t apr_socket_splice_send(apr_socket_t *sock, apr_file_t *pipe,
+                                    apr_size_t *len)
+{
+    apr_status_t rv;
+
+    if (pipe->buffered || pipe->ungetchar != -1) {
+        *len = 0;
+        return APR_ENOTIMPL;
+    }
+    rv = apr_unix_splice(pipe->filedes, pipe->timeout, pipe->is_pipe,
+                         sock->socketdes, sock->timeout, 0, len);
+    sock->stats.bytes_sent += *len;
+    sock->stats.sendfile_bytes += *len;
+    return rv;
+}
+
+apr_status_t apr_socket_splice_recv(apr_socket_t *sock, apr_file_t *pipe,
+                                    apr_size_t *len)
+{
+    apr_status_t rv;
+
+    if (pipe->buffered) {
+        *len = 0;
+        return APR_ENOTIMPL;
+    }
+    rv = apr_unix_splice(sock->socketdes, sock->timeout, 0,
+                         pipe->filedes, pipe->timeout, pipe->is_pipe, len);
+    sock->stats.bytes_received += *len;
+    sock->stats.splice_recv_bytes += *len;
+    return rv;
+}
+
+#endif /* APR_HAS_SPLICE */
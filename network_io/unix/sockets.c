@@ -16,6 +16,7 @@
 
 #include "apr_arch_networkio.h"
 #include "apr_network_io.h"
+#include "apr_poll.h"
 #include "apr_strings.h"
 #include "apr_support.h"
 #include "apr_portable.h"
@@ -91,13 +92,18 @@ static void set_socket_vars(apr_socket_t *sock, int family, int type, int protoc
 
 static void alloc_socket(apr_socket_t **new, apr_pool_t *p)
 {
-    *new = (apr_socket_t *)apr_pcalloc(p, sizeof(apr_socket_t));
+    /* The socket and its addresses, in a single allocation */
+    struct {
+        apr_socket_t sock;
+        apr_sockaddr_t local_addr;
+        apr_sockaddr_t remote_addr;
+    } *mem = apr_pcalloc(p, sizeof(*mem));
+
+    *new = &mem->sock;
     (*new)->pool = p;
-    (*new)->local_addr = (apr_sockaddr_t *)apr_pcalloc((*new)->pool,
-                                                       sizeof(apr_sockaddr_t));
+    (*new)->local_addr = &mem->local_addr;
     (*new)->local_addr->pool = p;
-    (*new)->remote_addr = (apr_sockaddr_t *)apr_pcalloc((*new)->pool,
-                                                        sizeof(apr_sockaddr_t));
+    (*new)->remote_addr = &mem->remote_addr;
     (*new)->remote_addr->pool = p;
     (*new)->remote_addr_unknown = 1;
 #ifndef WAITIO_USES_POLL
@@ -379,41 +385,138 @@ apr_status_t apr_socket_accept(apr_socket_t **new, apr_socket_t *sock,
     return APR_SUCCESS;
 }
 
-apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
+apr_status_t apr_socket_accept_many(apr_socket_t **new_socks,
+                                    apr_int32_t *num, apr_socket_t *sock,
+                                    apr_pool_t **pools)
 {
-    int rc;        
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (n < *num) {
+        rv = apr_socket_accept(&new_socks[n], sock, pools[n]);
+        if (rv == APR_SUCCESS) {
+            n++;
+            if (sock->timeout < 0) {
+                break;
+            }
+        }
+        else if (n && (rv == ECONNABORTED
+#ifdef EPROTO
+                       || rv == EPROTO
+#endif
+                       || rv == EINTR)) {
+            /* lost by the peer, try the next one */
+            continue;
+        }
+        else {
+            break;
+        }
+    }
 
-    do {
-        rc = connect(sock->socketdes,
-                     (const struct sockaddr *)&sa->sa.sin,
-                     sa->salen);
-    } while (rc == -1 && errno == EINTR);
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
 
-    /* we can see EINPROGRESS the first time connect is called on a non-blocking
-     * socket; if called again, we can see EALREADY
-     */
-    if ((rc == -1) && (errno == EINPROGRESS || errno == EALREADY)
-                   && (sock->timeout > 0)) {
-        rc = apr_wait_for_io_or_timeout(NULL, sock, 0);
-        if (rc != APR_SUCCESS) {
-            return rc;
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(HAVE_LINUX_FILTER_H)
+#include <linux/filter.h>
+
+/* Have the group of sock select the listener by the current CPU */
+static apr_status_t listen_group_steer(apr_socket_t *sock, int nsocks)
+{
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, 0 },
+        { BPF_RET | BPF_A, 0, 0, 0 }
+    };
+    struct sock_fprog prog;
+
+    code[1].k = nsocks;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    if (setsockopt(sock->socketdes, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                   &prog, sizeof(prog)) == -1) {
+        return errno == ENOPROTOOPT || errno == EINVAL ? APR_ENOTIMPL
+                                                       : errno;
+    }
+    return APR_SUCCESS;
+}
+#endif
+
+apr_status_t apr_socket_listen_group_create(apr_socket_t **socks, int nsocks,
+                                            apr_sockaddr_t *sa, int type,
+                                            int protocol, apr_int32_t backlog,
+                                            apr_int32_t flags, apr_pool_t *p)
+{
+#ifdef SO_REUSEPORT
+    apr_sockaddr_t *bsa;
+    apr_status_t rv;
+    int i;
+
+#if !defined(SO_ATTACH_REUSEPORT_CBPF) || !defined(HAVE_LINUX_FILTER_H)
+    if (flags & APR_LISTEN_GROUP_CPU) {
+        return APR_ENOTIMPL;
+    }
+#endif
+    if (nsocks < 1) {
+        return APR_EINVAL;
+    }
+
+    /* A copy, which gets the port picked for the first socket */
+    if ((rv = apr_sockaddr_info_copy(&bsa, sa, p)) != APR_SUCCESS) {
+        return rv;
+    }
+    bsa->next = NULL;
+
+    for (i = 0; i < nsocks; i++) {
+        if ((rv = apr_socket_create(&socks[i], bsa->family, type, protocol,
+                                    p)) != APR_SUCCESS) {
+            break;
+        }
+        if ((rv = apr_socket_opt_set(socks[i], APR_SO_REUSEADDR, 1))
+                != APR_SUCCESS
+            || (rv = apr_socket_opt_set(socks[i], APR_SO_REUSEPORT, 1))
+                != APR_SUCCESS
+            || (rv = apr_socket_bind(socks[i], bsa)) != APR_SUCCESS) {
+            apr_socket_close(socks[i]);
+            break;
         }
+        if (i == 0 && bsa->port == 0) {
+            apr_sockaddr_t *local;
 
-#ifdef SO_ERROR
-        {
-            int error;
-            apr_socklen_t len = sizeof(error);
-            if ((rc = getsockopt(sock->socketdes, SOL_SOCKET, SO_ERROR, 
-                                 (char *)&error, &len)) < 0) {
-                return errno;
-            }
-            if (error) {
-                return error;
+            if ((rv = apr_socket_addr_get(&local, APR_LOCAL, socks[0]))
+                    != APR_SUCCESS) {
+                apr_socket_close(socks[i]);
+                break;
             }
+            bsa = local;
+        }
+        if (type == SOCK_STREAM
+            && (rv = apr_socket_listen(socks[i], backlog)) != APR_SUCCESS) {
+            apr_socket_close(socks[i]);
+            break;
         }
-#endif /* SO_ERROR */
     }
 
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(HAVE_LINUX_FILTER_H)
+    if (i == nsocks && (flags & APR_LISTEN_GROUP_CPU) && nsocks > 1) {
+        rv = listen_group_steer(socks[0], nsocks);
+    }
+#endif
+
+    if (rv != APR_SUCCESS) {
+        while (i-- > 0) {
+            apr_socket_close(socks[i]);
+        }
+    }
+    return rv;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+/* Record the addresses of a socket connecting to sa */
+static void connect_addrs_set(apr_socket_t *sock, apr_sockaddr_t *sa)
+{
     if (memcmp(sa->ipaddr_ptr, generic_inaddr_any, sa->ipaddr_len)) {
         /* A real remote address was passed in.  If the unspecified
          * address was used, the actual remote addr will have to be
@@ -446,6 +549,44 @@ apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
          */
         sock->local_interface_unknown = 1;
     }
+}
+
+apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
+{
+    int rc;        
+
+    do {
+        rc = connect(sock->socketdes,
+                     (const struct sockaddr *)&sa->sa.sin,
+                     sa->salen);
+    } while (rc == -1 && errno == EINTR);
+
+    /* we can see EINPROGRESS the first time connect is called on a non-blocking
+     * socket; if called again, we can see EALREADY
+     */
+    if ((rc == -1) && (errno == EINPROGRESS || errno == EALREADY)
+                   && (sock->timeout > 0)) {
+        rc = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        if (rc != APR_SUCCESS) {
+            return rc;
+        }
+
+#ifdef SO_ERROR
+        {
+            int error;
+            apr_socklen_t len = sizeof(error);
+            if ((rc = getsockopt(sock->socketdes, SOL_SOCKET, SO_ERROR, 
+                                 (char *)&error, &len)) < 0) {
+                return errno;
+            }
+            if (error) {
+                return error;
+            }
+        }
+#endif /* SO_ERROR */
+    }
+
+    connect_addrs_set(sock, sa);
 
     if (rc == -1 && errno != EISCONN) {
         return errno;
@@ -457,6 +598,264 @@ apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
     return APR_SUCCESS;
 }
 
+apr_status_t apr_socket_connect_data(apr_socket_t *sock, apr_sockaddr_t *sa,
+                                     const char *buf, apr_size_t *len)
+{
+    apr_status_t rv;
+
+#ifdef MSG_FASTOPEN
+    if (sock->type == SOCK_STREAM && sa->family != APR_UNIX) {
+        ssize_t rc;
+
+        do {
+            rc = sendto(sock->socketdes, buf, *len, MSG_FASTOPEN,
+                        (const struct sockaddr *)&sa->sa.sin, sa->salen);
+        } while (rc == -1 && errno == EINTR);
+        apr_socket_stats_send(sock, rc);
+
+        if (rc >= 0) {
+            /* the data went in the SYN, or the connection was made */
+            connect_addrs_set(sock, sa);
+#ifndef HAVE_POLL
+            sock->connected = 1;
+#endif
+            *len = rc;
+            return APR_SUCCESS;
+        }
+        if (errno == EINPROGRESS && sock->timeout == 0) {
+            /* no cookie yet, a plain SYN went out */
+            connect_addrs_set(sock, sa);
+            *len = 0;
+            return errno;
+        }
+        if (errno != EINPROGRESS && errno != EOPNOTSUPP) {
+            *len = 0;
+            return errno;
+        }
+        /* Fast Open is disabled, or the SYN went out without the data:
+         * complete the connection and send the data then */
+    }
+#endif
+
+    rv = apr_socket_connect(sock, sa);
+    if (rv != APR_SUCCESS) {
+        *len = 0;
+        return rv;
+    }
+    return apr_socket_send(sock, buf, len);
+}
+
+/* Start connecting to an address; APR_EINPROGRESS if under way.  The
+ * socket gets its own subpool of p, for a losing attempt to be freed
+ * along with its socket.
+ */
+static apr_status_t connect_attempt(apr_socket_t **sock, apr_pool_t **sp,
+                                    apr_sockaddr_t *sa, int type,
+                                    int protocol, apr_pool_t *p)
+{
+    apr_status_t rv;
+
+    rv = apr_pool_create(sp, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_socket_create(sock, sa->family, type, protocol, *sp);
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_timeout_set(*sock, 0);
+        if (rv == APR_SUCCESS) {
+            rv = apr_socket_connect(*sock, sa);
+            if (APR_STATUS_IS_EINPROGRESS(rv)) {
+                rv = APR_EINPROGRESS;
+            }
+        }
+    }
+    if (rv != APR_SUCCESS && rv != APR_EINPROGRESS) {
+        apr_pool_destroy(*sp);
+        *sock = NULL;
+        *sp = NULL;
+    }
+    return rv;
+}
+
+apr_status_t apr_socket_connect_multi(apr_socket_t **new_sock,
+                                      apr_sockaddr_t *sa, int type,
+                                      int protocol, apr_interval_time_t delay,
+                                      apr_interval_time_t timeout,
+                                      apr_pool_t *p)
+{
+    apr_pool_t *ptemp;
+    apr_pollset_t *pollset;
+    apr_pollfd_t *pfds;
+    apr_sockaddr_t **addrs, **firsts, **others, *cur;
+    apr_socket_t **socks;
+    apr_pool_t **pools;
+    apr_status_t rv, last_rv = APR_EINVAL;
+    apr_time_t now, deadline = 0, next_attempt;
+    int naddrs = 0, nfirsts, nothers, next = 0, pending = 0;
+    int winner = -1, i, j, k;
+
+    *new_sock = NULL;
+    for (cur = sa; cur; cur = cur->next) {
+        naddrs++;
+    }
+    if (!naddrs) {
+        return APR_EINVAL;
+    }
+    if (delay <= 0) {
+        delay = APR_CONNECT_MULTI_DELAY;
+    }
+
+    rv = apr_pool_create(&ptemp, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_pollset_create(&pollset, naddrs, ptemp, 0);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(ptemp);
+        return rv;
+    }
+    addrs = apr_palloc(ptemp, naddrs * sizeof(*addrs));
+    socks = apr_pcalloc(ptemp, naddrs * sizeof(*socks));
+    pools = apr_pcalloc(ptemp, naddrs * sizeof(*pools));
+    pfds = apr_pcalloc(ptemp, naddrs * sizeof(*pfds));
+
+    /* RFC 8305 section 4: alternate the address families, starting with
+     * the family of the first address and keeping the order within each.
+     */
+    firsts = apr_palloc(ptemp, naddrs * sizeof(*firsts));
+    others = apr_palloc(ptemp, naddrs * sizeof(*others));
+    for (cur = sa, j = 0, k = 0; cur; cur = cur->next) {
+        if (cur->family == sa->family) {
+            firsts[j++] = cur;
+        }
+        else {
+            others[k++] = cur;
+        }
+    }
+    for (i = 0, nfirsts = j, nothers = k, j = 0, k = 0; i < naddrs;) {
+        if (j < nfirsts) {
+            addrs[i++] = firsts[j++];
+        }
+        if (k < nothers) {
+            addrs[i++] = others[k++];
+        }
+    }
+
+    now = apr_time_now();
+    if (timeout >= 0) {
+        deadline = now + timeout;
+    }
+    next_attempt = now;
+
+    while (winner < 0) {
+        apr_interval_time_t wait = -1;
+        const apr_pollfd_t *descs;
+        apr_int32_t num;
+
+        /* Start the next attempt when it is due, at once if none is
+         * under way.
+         */
+        while (next < naddrs && (!pending || now >= next_attempt)) {
+            i = next++;
+            rv = connect_attempt(&socks[i], &pools[i], addrs[i], type,
+                                 protocol, p);
+            if (rv == APR_SUCCESS) {
+                winner = i;
+                break;
+            }
+            if (rv != APR_EINPROGRESS) {
+                last_rv = rv;
+                continue;
+            }
+            pfds[i].p = ptemp;
+            pfds[i].desc_type = APR_POLL_SOCKET;
+            pfds[i].reqevents = APR_POLLOUT;
+            pfds[i].desc.s = socks[i];
+            pfds[i].client_data = &socks[i];
+            rv = apr_pollset_add(pollset, &pfds[i]);
+            if (rv != APR_SUCCESS) {
+                last_rv = rv;
+                apr_pool_destroy(pools[i]);
+                socks[i] = NULL;
+                continue;
+            }
+            pending++;
+            next_attempt = now + delay;
+        }
+        if (winner >= 0 || !pending) {
+            break;
+        }
+
+        if (next < naddrs) {
+            wait = next_attempt - now;
+        }
+        if (deadline) {
+            if (now >= deadline) {
+                last_rv = APR_TIMEUP;
+                break;
+            }
+            if (wait < 0 || wait > deadline - now) {
+                wait = deadline - now;
+            }
+        }
+        rv = apr_pollset_poll(pollset, wait, &num, &descs);
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_TIMEUP(rv)
+            && !APR_STATUS_IS_EINTR(rv)) {
+            last_rv = rv;
+            break;
+        }
+        for (i = 0; rv == APR_SUCCESS && i < num && winner < 0; i++) {
+            apr_socket_t **s = descs[i].client_data;
+            int error = 0;
+#ifdef SO_ERROR
+            apr_socklen_t len = sizeof(error);
+#endif
+
+            apr_pollset_remove(pollset, &descs[i]);
+            pending--;
+#ifdef SO_ERROR
+            if (getsockopt((*s)->socketdes, SOL_SOCKET, SO_ERROR,
+                           (char *)&error, &len) < 0) {
+                error = errno;
+            }
+#endif
+            if (!error) {
+                winner = (int)(s - socks);
+                continue;
+            }
+            /* A failed attempt makes way for the next one at once */
+            last_rv = error;
+            apr_pool_destroy(pools[s - socks]);
+            *s = NULL;
+            next_attempt = apr_time_now();
+        }
+        now = apr_time_now();
+    }
+
+    for (i = 0; i < naddrs; i++) {
+        if (socks[i] && i != winner) {
+            apr_pool_destroy(pools[i]);
+        }
+    }
+
+    if (winner >= 0) {
+        /* Complete the connection state, then block as by default */
+        rv = apr_socket_connect(socks[winner], addrs[winner]);
+        if (rv == APR_SUCCESS) {
+            rv = apr_socket_timeout_set(socks[winner], -1);
+        }
+        if (rv == APR_SUCCESS) {
+            *new_sock = socks[winner];
+        }
+        else {
+            apr_pool_destroy(pools[winner]);
+        }
+        last_rv = rv;
+    }
+    apr_pool_destroy(ptemp);
+    return last_rv;
+}
+
 apr_status_t apr_socket_type_get(apr_socket_t *sock, int *type)
 {
     *type = sock->type;
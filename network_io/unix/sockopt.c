@@ -161,6 +161,30 @@ apr_status_t apr_socket_opt_set(apr_socket_t *sock,
             apr_set_option(sock, APR_SO_REUSEADDR, on);
         }
         break;
+    case APR_SO_REUSEPORT:
+#ifdef SO_REUSEPORT
+        if (on != apr_is_option_set(sock, APR_SO_REUSEPORT)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_REUSEPORT, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_UDP_GRO:
+#ifdef UDP_GRO
+        if (on != apr_is_option_set(sock, APR_UDP_GRO)) {
+            if (setsockopt(sock->socketdes, IPPROTO_UDP, UDP_GRO, (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_UDP_GRO, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
     case APR_SO_SNDBUF:
 #ifdef SO_SNDBUF
         if (setsockopt(sock->socketdes, SOL_SOCKET, SO_SNDBUF, (void *)&on, sizeof(int)) == -1) {
@@ -328,6 +352,75 @@ apr_status_t apr_socket_opt_set(apr_socket_t *sock,
         apr_set_option(sock, APR_IPV6_V6ONLY, on);
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_FASTOPEN:
+#ifdef TCP_FASTOPEN
+        if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_FASTOPEN,
+                       (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+        apr_set_option(sock, APR_TCP_FASTOPEN, on);
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_NOTSENT_LOWAT:
+#ifdef TCP_NOTSENT_LOWAT
+        if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                       (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+        apr_set_option(sock, APR_TCP_NOTSENT_LOWAT, on);
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_BUSY_POLL:
+#ifdef SO_BUSY_POLL
+        if (setsockopt(sock->socketdes, SOL_SOCKET, SO_BUSY_POLL,
+                       (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+        apr_set_option(sock, APR_SO_BUSY_POLL, on);
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_PREFER_BUSY_POLL:
+#ifdef SO_PREFER_BUSY_POLL
+        if (on != apr_is_option_set(sock, APR_SO_PREFER_BUSY_POLL)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_PREFER_BUSY_POLL, (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_PREFER_BUSY_POLL, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_INCOMING_CPU:
+#ifdef SO_INCOMING_CPU
+        if (setsockopt(sock->socketdes, SOL_SOCKET, SO_INCOMING_CPU,
+                       (void *)&on, sizeof(int)) == -1) {
+            return errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_QUICKACK:
+#ifdef TCP_QUICKACK
+        /* the kernel clears it again by itself, so don't check
+         * sock->options
+         */
+        if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_QUICKACK,
+                       (void *)&one, sizeof(int)) == -1) {
+            return errno;
+        }
+        apr_set_option(sock, APR_TCP_QUICKACK, on);
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     default:
@@ -349,6 +442,22 @@ apr_status_t apr_socket_opt_get(apr_socket_t *sock,
                                 apr_int32_t opt, apr_int32_t *on)
 {
     switch(opt) {
+        case APR_SO_INCOMING_CPU:
+#ifdef SO_INCOMING_CPU
+        {
+            int cpu;
+            apr_socklen_t len = sizeof(cpu);
+
+            if (getsockopt(sock->socketdes, SOL_SOCKET, SO_INCOMING_CPU,
+                           (void *)&cpu, &len) == -1) {
+                return errno;
+            }
+            *on = cpu;
+            break;
+        }
+#else
+            return APR_ENOTIMPL;
+#endif
         default:
             *on = apr_is_option_set(sock, opt);
     }
@@ -372,6 +481,68 @@ apr_status_t apr_socket_atmark(apr_socket_t *sock, int *atmark)
 #endif
 }
 
+apr_status_t apr_socket_tcp_info_get(apr_socket_t *sock,
+                                     apr_socket_tcp_info_t *info)
+{
+#if defined(TCP_INFO) && (defined(__linux__) || defined(__FreeBSD__))
+    struct tcp_info ti;
+    apr_socklen_t len = sizeof(ti);
+
+    /* older kernels may fill in less */
+    memset(&ti, 0, sizeof(ti));
+    if (getsockopt(sock->socketdes, IPPROTO_TCP, TCP_INFO,
+                   (void *)&ti, &len) == -1) {
+        return errno;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->rtt = ti.tcpi_rtt;
+    info->rtt_var = ti.tcpi_rttvar;
+    info->rto = ti.tcpi_rto;
+    info->snd_mss = ti.tcpi_snd_mss;
+    info->rcv_mss = ti.tcpi_rcv_mss;
+#ifdef __linux__
+    /* Linux counts the window in segments */
+    info->snd_cwnd = (apr_uint64_t)ti.tcpi_snd_cwnd * ti.tcpi_snd_mss;
+    info->unacked = ti.tcpi_unacked;
+    info->lost = ti.tcpi_lost;
+    info->retransmits = ti.tcpi_total_retrans;
+#else
+    info->snd_cwnd = ti.tcpi_snd_cwnd;
+    info->retransmits = ti.tcpi_snd_rexmitpack;
+#endif
+    return APR_SUCCESS;
+#elif defined(TCP_CONNECTION_INFO)
+    struct tcp_connection_info ti;
+    apr_socklen_t len = sizeof(ti);
+
+    memset(&ti, 0, sizeof(ti));
+    if (getsockopt(sock->socketdes, IPPROTO_TCP, TCP_CONNECTION_INFO,
+                   (void *)&ti, &len) == -1) {
+        return errno;
+    }
+
+    /* Darwin gives times in milliseconds */
+    memset(info, 0, sizeof(*info));
+    info->rtt = apr_time_from_msec(ti.tcpi_srtt);
+    info->rtt_var = apr_time_from_msec(ti.tcpi_rttvar);
+    info->rto = apr_time_from_msec(ti.tcpi_rto);
+    info->snd_cwnd = ti.tcpi_snd_cwnd;
+    info->snd_mss = ti.tcpi_maxseg;
+    info->retransmits = (apr_uint32_t)ti.tcpi_txretransmitpackets;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+apr_status_t apr_socket_stats_get(apr_socket_t *sock,
+                                  apr_socket_stats_t *stats)
+{
+    *stats = sock->stats;
+    return APR_SUCCESS;
+}
+
 apr_status_t apr_gethostname(char *buf, apr_int32_t len, apr_pool_t *cont)
 {
 #ifdef BEOS_R5
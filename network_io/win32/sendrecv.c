@@ -210,6 +210,81 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
 }
 
 
+/* Without batching system calls, one datagram at a time */
+
+static apr_status_t socket_send_msg(apr_socket_t *sock, apr_socket_msg_t *msg,
+                                    apr_int32_t flags)
+{
+    apr_size_t off = 0, seg, n;
+    apr_status_t rv;
+
+    seg = msg->segment_size ? msg->segment_size : msg->len;
+    msg->nbytes = 0;
+    do {
+        n = msg->len - off < seg ? msg->len - off : seg;
+        if (msg->addr) {
+            rv = apr_socket_sendto(sock, msg->addr, flags, msg->buf + off, &n);
+        }
+        else {
+            rv = apr_socket_send(sock, msg->buf + off, &n);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        off += n;
+        msg->nbytes = off;
+    } while (off < msg->len);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_sendto_batch(apr_socket_t *sock,
+                                                  apr_socket_msg_t *msgs,
+                                                  apr_int32_t *num,
+                                                  apr_int32_t flags)
+{
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (n < *num) {
+        if ((rv = socket_send_msg(sock, &msgs[n], flags)) != APR_SUCCESS) {
+            break;
+        }
+        n++;
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_recvfrom_batch(apr_socket_t *sock,
+                                                    apr_socket_msg_t *msgs,
+                                                    apr_int32_t *num,
+                                                    apr_int32_t flags)
+{
+    apr_sockaddr_t from;
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    /* Only a non-blocking socket is drained */
+    while (n < *num && (n == 0 || sock->timeout == 0)) {
+        apr_socket_msg_t *msg = &msgs[n];
+
+        msg->nbytes = msg->len;
+        msg->segment_size = 0;
+        rv = apr_socket_recvfrom(msg->addr ? msg->addr : &from, sock, flags,
+                                 msg->buf, &msg->nbytes);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n++;
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+
 #if APR_HAS_SENDFILE
 static apr_status_t collapse_iovec(char **off, apr_size_t *len, 
                                    struct iovec *iovec, int numvec, 
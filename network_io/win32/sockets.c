@@ -353,6 +353,42 @@ static apr_status_t wait_for_connect(apr_socket_t *sock)
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_socket_accept_many(apr_socket_t **new_socks,
+                                                 apr_int32_t *num,
+                                                 apr_socket_t *sock,
+                                                 apr_pool_t **pools)
+{
+    apr_int32_t n = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    /* Only a non-blocking socket is drained */
+    while (n < *num) {
+        rv = apr_socket_accept(&new_socks[n], sock, pools[n]);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n++;
+        if (sock->timeout != 0) {
+            break;
+        }
+    }
+
+    *num = n;
+    return n ? APR_SUCCESS : rv;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_listen_group_create(apr_socket_t **socks,
+                                                         int nsocks,
+                                                         apr_sockaddr_t *sa,
+                                                         int type,
+                                                         int protocol,
+                                                         apr_int32_t backlog,
+                                                         apr_int32_t flags,
+                                                         apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_socket_connect(apr_socket_t *sock, 
                                              apr_sockaddr_t *sa)
 {
@@ -417,6 +453,64 @@ APR_DECLARE(apr_status_t) apr_socket_connect(apr_socket_t *sock,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_socket_connect_data(apr_socket_t *sock,
+                                                  apr_sockaddr_t *sa,
+                                                  const char *buf,
+                                                  apr_size_t *len)
+{
+    apr_status_t rv;
+
+    rv = apr_socket_connect(sock, sa);
+    if (rv != APR_SUCCESS) {
+        *len = 0;
+        return rv;
+    }
+    return apr_socket_send(sock, buf, len);
+}
+
+APR_DECLARE(apr_status_t) apr_socket_connect_multi(apr_socket_t **new_sock,
+                                                   apr_sockaddr_t *sa,
+                                                   int type, int protocol,
+                                                   apr_interval_time_t delay,
+                                                   apr_interval_time_t timeout,
+                                                   apr_pool_t *p)
+{
+    apr_time_t deadline = 0;
+    apr_status_t rv = APR_EINVAL;
+
+    if (timeout >= 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    /* The addresses are tried one after the other */
+    for (; sa; sa = sa->next) {
+        apr_interval_time_t left = -1;
+
+        if (deadline) {
+            left = deadline - apr_time_now();
+            if (left <= 0) {
+                rv = APR_TIMEUP;
+                break;
+            }
+        }
+        rv = apr_socket_create(new_sock, sa->family, type, protocol, p);
+        if (rv != APR_SUCCESS) {
+            continue;
+        }
+        rv = apr_socket_timeout_set(*new_sock, left);
+        if (rv == APR_SUCCESS) {
+            rv = apr_socket_connect(*new_sock, sa);
+        }
+        if (rv == APR_SUCCESS) {
+            return apr_socket_timeout_set(*new_sock, -1);
+        }
+        apr_socket_close(*new_sock);
+    }
+
+    *new_sock = NULL;
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_socket_type_get(apr_socket_t *sock, int *type)
 {
     *type = sock->type;
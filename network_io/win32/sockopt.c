@@ -238,6 +238,26 @@ APR_DECLARE(apr_status_t) apr_socket_opt_set(apr_socket_t *sock,
         return APR_ENOTIMPL;
 #endif
         break;
+    case APR_TCP_FASTOPEN:
+#ifdef TCP_FASTOPEN
+        /* a mere switch here, for listening and ConnectEx() sockets */
+        if (on != apr_is_option_set(sock, APR_TCP_FASTOPEN)) {
+            if (setsockopt(sock->socketdes, IPPROTO_TCP, TCP_FASTOPEN,
+                           (void *)&one, sizeof(int)) == -1) {
+                return apr_get_netos_error();
+            }
+            apr_set_option(sock, APR_TCP_FASTOPEN, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_TCP_NOTSENT_LOWAT:
+    case APR_SO_BUSY_POLL:
+    case APR_SO_PREFER_BUSY_POLL:
+    case APR_SO_INCOMING_CPU:
+    case APR_TCP_QUICKACK:
+        return APR_ENOTIMPL;
     default:
         return APR_EINVAL;
         break;
@@ -286,6 +306,18 @@ APR_DECLARE(apr_status_t) apr_socket_atmark(apr_socket_t *sock, int *atmark)
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_tcp_info_get(apr_socket_t *sock,
+                                                  apr_socket_tcp_info_t *info)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_stats_get(apr_socket_t *sock,
+                                               apr_socket_stats_t *stats)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_gethostname(char *buf, int len,
                                           apr_pool_t *cont)
 {
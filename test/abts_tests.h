@@ -30,6 +30,8 @@ const struct testlist {
     {testenv},
     {testescape},
     {testfile},
+    {testfileaio},
+    {testfileappender},
     {testfilecopy},
     {testfileinfo},
     {testflock},
@@ -55,9 +57,12 @@ const struct testlist {
     {testproc},
     {testprocmutex},
     {testrand},
+    {testresolver},
     {testsleep},
     {testshm},
+    {testshmhash},
     {testsock},
+    {testsocketpool},
     {testsockets},
     {testsockopt},
     {teststr},
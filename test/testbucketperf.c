@@ -0,0 +1,280 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_buckets.h"
+#include "apr_network_io.h"
+#include "apr_file_io.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "testutil.h"
+
+#if !APR_HAS_FORK
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for fork().\n");
+    return 0;
+}
+#else /* !APR_HAS_FORK */
+
+#define DEFAULT_MBYTES  256
+#define WRITE_SIZE      65536
+
+static int verbose = 0;
+static apr_off_t num_bytes = (apr_off_t)DEFAULT_MBYTES << 20;
+
+/* The max_read values compared */
+static const apr_size_t max_reads[] = {
+    APR_BUCKET_BUFF_SIZE,
+    APR_BUCKET_BUFF_SIZE * 4,
+    APR_BUCKET_READ_MAX,
+    APR_BUCKET_BUFF_SIZE * 128
+};
+
+static void writer(apr_file_t *pipe, apr_socket_t *sock)
+{
+    static char buf[WRITE_SIZE];
+    apr_off_t left = num_bytes;
+    apr_size_t n;
+    apr_status_t rv;
+
+    memset(buf, 'x', sizeof(buf));
+    while (left > 0) {
+        n = left > WRITE_SIZE ? WRITE_SIZE : (apr_size_t)left;
+        if (pipe) {
+            rv = apr_file_write_full(pipe, buf, n, &n);
+        }
+        else {
+            rv = apr_socket_send(sock, buf, &n);
+        }
+        if (rv != APR_SUCCESS) {
+            exit(1);
+        }
+        left -= n;
+    }
+    exit(0);
+}
+
+/* Drain the stream through a PIPE or SOCKET bucket */
+static apr_status_t reader(apr_bucket *e, apr_bucket_alloc_t *ba,
+                           apr_pool_t *pool, const char *desc,
+                           apr_size_t max_read)
+{
+    apr_bucket_brigade *bb = apr_brigade_create(pool, ba);
+    apr_uint64_t reads = 0;
+    apr_off_t total = 0;
+    apr_time_t start, elapsed;
+    apr_status_t rv = APR_SUCCESS;
+
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+
+    start = apr_time_now();
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        const char *data;
+        apr_size_t n;
+
+        e = APR_BRIGADE_FIRST(bb);
+        rv = apr_bucket_read(e, &data, &n, APR_BLOCK_READ);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        reads++;
+        total += n;
+        apr_bucket_delete(e);
+    }
+    elapsed = apr_time_now() - start;
+    if (!elapsed) {
+        elapsed = 1;
+    }
+    apr_brigade_destroy(bb);
+
+    printf("    %-6s max_read %7" APR_SIZE_T_FMT ": %8" APR_UINT64_T_FMT
+           " reads, %7" APR_UINT64_T_FMT " bytes/read, %6" APR_UINT64_T_FMT
+           " MB/s\n", desc, max_read, reads,
+           reads ? (apr_uint64_t)total / reads : 0,
+           (apr_uint64_t)total * APR_USEC_PER_SEC / elapsed / (1 << 20));
+
+    if (rv == APR_SUCCESS && total != num_bytes) {
+        printf("error: read %" APR_OFF_T_FMT " bytes\n", total);
+        rv = APR_EGENERAL;
+    }
+    return rv;
+}
+
+static apr_status_t wait_writer(apr_proc_t *proc)
+{
+    int exitcode;
+    apr_exit_why_e why;
+
+    apr_proc_wait(proc, &exitcode, &why, APR_WAIT);
+    if (why != APR_PROC_EXIT || exitcode != 0) {
+        printf("error: writer failed\n");
+        return APR_EGENERAL;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t test_pipe(apr_pool_t *pool, apr_size_t max_read)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(pool);
+    apr_file_t *readp, *writep;
+    apr_proc_t proc;
+    apr_status_t rv;
+
+    if ((rv = apr_file_pipe_create(&readp, &writep, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    fflush(stdout);
+    rv = apr_proc_fork(&proc, pool);
+    if (rv == APR_INCHILD) {
+        apr_file_close(readp);
+        writer(writep, NULL);
+    }
+    else if (rv != APR_INPARENT) {
+        return rv;
+    }
+    apr_file_close(writep);
+
+    rv = reader(apr_bucket_pipe_create_ex(readp, 0, max_read, ba), ba, pool,
+                "pipe", max_read);
+    apr_file_close(readp);
+    if (rv == APR_SUCCESS) {
+        rv = wait_writer(&proc);
+    }
+    apr_bucket_alloc_destroy(ba);
+    return rv;
+}
+
+static apr_status_t test_socket(apr_pool_t *pool, apr_size_t max_read)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(pool);
+    apr_socket_t *ld, *sd, *cd;
+    apr_sockaddr_t *sa;
+    apr_proc_t proc;
+    apr_status_t rv;
+
+    if ((rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0,
+                                    pool)) != APR_SUCCESS
+        || (rv = apr_socket_create(&ld, sa->family, SOCK_STREAM,
+                                   APR_PROTO_TCP, pool)) != APR_SUCCESS
+        || (rv = apr_socket_bind(ld, sa)) != APR_SUCCESS
+        || (rv = apr_socket_listen(ld, 1)) != APR_SUCCESS
+        || (rv = apr_socket_addr_get(&sa, APR_LOCAL, ld)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    fflush(stdout);
+    rv = apr_proc_fork(&proc, pool);
+    if (rv == APR_INCHILD) {
+        apr_socket_close(ld);
+        if (apr_socket_create(&cd, sa->family, SOCK_STREAM, APR_PROTO_TCP,
+                              pool) != APR_SUCCESS
+            || apr_socket_connect(cd, sa) != APR_SUCCESS) {
+            exit(1);
+        }
+        writer(NULL, cd);
+    }
+    else if (rv != APR_INPARENT) {
+        return rv;
+    }
+
+    if ((rv = apr_socket_accept(&sd, ld, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_socket_close(ld);
+
+    rv = reader(apr_bucket_socket_create_ex(sd, 0, max_read, ba), ba, pool,
+                "socket", max_read);
+    apr_socket_close(sd);
+    if (rv == APR_SUCCESS) {
+        rv = wait_writer(&proc);
+    }
+    apr_bucket_alloc_destroy(ba);
+    return rv;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    int i;
+
+    printf("APR Socket and Pipe Bucket Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "m:v", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'm') {
+            num_bytes = (apr_off_t)atoi(optarg) << 20;
+        }
+        else if (optchar == 'v') {
+            verbose = 1;
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if (num_bytes <= 0) {
+        fprintf(stderr, "Usage: %s [-m megabytes] [-v]\n", argv[0]);
+        exit(-1);
+    }
+
+    printf("Reading %" APR_OFF_T_FMT " MB through buckets\n",
+           num_bytes >> 20);
+    for (i = 0; i < sizeof(max_reads) / sizeof(max_reads[0]); i++) {
+        if ((rv = test_pipe(pool, max_reads[i])) != APR_SUCCESS) {
+            fprintf(stderr, "pipe test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-2);
+        }
+    }
+    for (i = 0; i < sizeof(max_reads) / sizeof(max_reads[0]); i++) {
+        if ((rv = test_socket(pool, max_reads[i])) != APR_SUCCESS) {
+            fprintf(stderr, "socket test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-2);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_FORK */
@@ -226,6 +226,189 @@ static void test_bucket_content(abts_case *tc,
     ABTS_STR_NEQUAL(tc, edata, adata, elen);
 }
 
+/* A brigade of many small buckets, with a flush bucket inside */
+static apr_bucket_brigade *make_small_brigade(apr_bucket_alloc_t *ba)
+{
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    static const char *const parts[] = {
+        "ab", "c\r", "\nd", "", "ef\r", "\n", "gh\nij"
+    };
+    int i;
+
+    for (i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create(parts[i],
+                                        strlen(parts[i]), ba));
+        if (i == 2) {
+            APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+        }
+    }
+    return bb;
+}
+
+static void test_find(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = make_small_brigade(ba);
+    apr_off_t offset;
+
+    /* "abc\r\nd" FLUSH "" "ef\r\ngh\nij" */
+    APR_ASSERT_SUCCESS(tc, "find CRLF",
+                       apr_brigade_find(bb, "\r\n", 2, APR_BLOCK_READ,
+                                        100, &offset));
+    ABTS_INT_EQUAL(tc, 3, (int)offset);
+
+    APR_ASSERT_SUCCESS(tc, "find across a metadata bucket",
+                       apr_brigade_find(bb, "\ndef", APR_BUCKETS_STRING,
+                                        APR_BLOCK_READ, 100, &offset));
+    ABTS_INT_EQUAL(tc, 4, (int)offset);
+
+    APR_ASSERT_SUCCESS(tc, "find LF",
+                       apr_brigade_find(bb, "\n", 1, APR_BLOCK_READ,
+                                        100, &offset));
+    ABTS_INT_EQUAL(tc, 4, (int)offset);
+
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                   apr_brigade_find(bb, "\r\n", 2, APR_BLOCK_READ,
+                                    4, &offset));
+    ABTS_INT_EQUAL(tc, 3, (int)offset);
+
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                   apr_brigade_find(bb, "xyz", 3, APR_BLOCK_READ,
+                                    100, &offset));
+    ABTS_INT_EQUAL(tc, 15, (int)offset);
+
+    /* a partial match at the end may still complete */
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                   apr_brigade_find(bb, "ijk", 3, APR_BLOCK_READ,
+                                    100, &offset));
+    ABTS_INT_EQUAL(tc, 13, (int)offset);
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_brigade_find(bb, "", 0, APR_BLOCK_READ,
+                                    100, &offset));
+
+    flatten_match(tc, "brigade unchanged", bb, "abc\r\ndef\r\ngh\nij");
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_split_boundary(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bin = make_small_brigade(ba);
+    apr_bucket_brigade *bout = apr_brigade_create(p, ba);
+
+    APR_ASSERT_SUCCESS(tc, "split at CRLF",
+                       apr_brigade_split_boundary(bout, bin, APR_BLOCK_READ,
+                                                  "\r\n", 2, 100));
+    flatten_match(tc, "first part", bout, "abc");
+    flatten_match(tc, "remainder", bin, "def\r\ngh\nij");
+    apr_brigade_cleanup(bout);
+
+    APR_ASSERT_SUCCESS(tc, "split at CRLF",
+                       apr_brigade_split_boundary(bout, bin, APR_BLOCK_READ,
+                                                  "\r\n",
+                                                  APR_BUCKETS_STRING, 100));
+    flatten_match(tc, "second part", bout, "def");
+    flatten_match(tc, "remainder", bin, "gh\nij");
+    apr_brigade_cleanup(bout);
+
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                   apr_brigade_split_boundary(bout, bin, APR_BLOCK_READ,
+                                              "jk", 2, 100));
+    flatten_match(tc, "up to a partial boundary", bout, "gh\ni");
+    flatten_match(tc, "partial boundary", bin, "j");
+
+    apr_brigade_destroy(bout);
+    apr_brigade_destroy(bin);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_splitline_small(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bin = make_small_brigade(ba);
+    apr_bucket_brigade *bout = apr_brigade_create(p, ba);
+
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 100));
+    flatten_match(tc, "first line", bout, "abc\r\n");
+    apr_brigade_cleanup(bout);
+
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 100));
+    flatten_match(tc, "second line", bout, "def\r\n");
+    ABTS_ASSERT(tc, "flush bucket moved with the line",
+                APR_BUCKET_IS_FLUSH(APR_BUCKET_NEXT(APR_BRIGADE_FIRST(bout))));
+    apr_brigade_cleanup(bout);
+
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 100));
+    flatten_match(tc, "third line", bout, "gh\n");
+    apr_brigade_cleanup(bout);
+
+    /* no LF: everything */
+    APR_BRIGADE_INSERT_TAIL(bin, apr_bucket_eos_create(ba));
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 100));
+    flatten_match(tc, "last line", bout, "ij");
+    ABTS_ASSERT(tc, "EOS moved", APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(bout)));
+    ABTS_ASSERT(tc, "input empty", APR_BRIGADE_EMPTY(bin));
+    apr_brigade_cleanup(bout);
+    apr_brigade_destroy(bin);
+
+    /* a partial line of whole buckets past maxbytes, or of one bucket */
+    bin = make_small_brigade(ba);
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 1));
+    flatten_match(tc, "partial line", bout, "ab");
+    apr_brigade_cleanup(bout);
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_BLOCK_READ, 0));
+    flatten_match(tc, "one bucket", bout, "c\r");
+
+    apr_brigade_destroy(bout);
+    apr_brigade_destroy(bin);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_splitline_eagain(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bin = apr_brigade_create(p, ba);
+    apr_bucket_brigade *bout = apr_brigade_create(p, ba);
+    apr_file_t *readp, *writep;
+    apr_size_t len = 3;
+    apr_status_t rv;
+
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp, &writep, p));
+
+    APR_BRIGADE_INSERT_TAIL(bin, apr_bucket_immortal_create("ab", 2, ba));
+    APR_BRIGADE_INSERT_TAIL(bin, apr_bucket_flush_create(ba));
+    APR_BRIGADE_INSERT_TAIL(bin, apr_bucket_pipe_create(readp, ba));
+
+    /* the buckets before the one which would block, and only them */
+    rv = apr_brigade_split_line(bout, bin, APR_NONBLOCK_READ, 100);
+    ABTS_ASSERT(tc, "split line would block", APR_STATUS_IS_EAGAIN(rv));
+    flatten_match(tc, "partial line", bout, "ab");
+    ABTS_ASSERT(tc, "flush moved", APR_BUCKET_IS_FLUSH(APR_BRIGADE_LAST(bout)));
+    ABTS_ASSERT(tc, "pipe bucket kept", APR_BUCKET_IS_PIPE(APR_BRIGADE_FIRST(bin)));
+    apr_brigade_cleanup(bout);
+
+    APR_ASSERT_SUCCESS(tc, "write to pipe",
+                       apr_file_write(writep, "c\nd", &len));
+    APR_ASSERT_SUCCESS(tc, "split line",
+                       apr_brigade_split_line(bout, bin, APR_NONBLOCK_READ, 100));
+    flatten_match(tc, "rest of the line", bout, "c\n");
+
+    apr_file_close(writep);
+    apr_brigade_destroy(bout);
+    apr_brigade_destroy(bin);
+    apr_bucket_alloc_destroy(ba);
+}
+
 static void test_splits(abts_case *tc, void *ctx)
 {
     apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
@@ -488,6 +671,240 @@ static void test_write_split(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+static void test_slab(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb1 = apr_brigade_create(p, ba);
+    apr_bucket_brigade *bb2 = apr_brigade_create(p, ba);
+    apr_bucket_slab *s;
+    apr_bucket *e, *f;
+    char big[APR_BUCKET_BUFF_SIZE];
+
+    /* small writes to different brigades share one slab */
+    apr_brigade_write(bb1, NULL, NULL, "abc", 3);
+    apr_brigade_write(bb2, NULL, NULL, "def", 3);
+
+    e = APR_BRIGADE_FIRST(bb1);
+    ABTS_ASSERT(tc, "write makes a slab bucket", APR_BUCKET_IS_SLAB(e));
+    s = e->data;
+    test_bucket_content(tc, e, "abc", 3);
+    f = APR_BRIGADE_FIRST(bb2);
+    ABTS_ASSERT(tc, "second brigade uses the same slab", f->data == s);
+    test_bucket_content(tc, f, "def", 3);
+    ABTS_INT_EQUAL(tc, 3, s->refcount.refcount);
+
+    /* the bucket at the end of the slab grows in place, the other one
+     * moves to a buffer of its own */
+    apr_brigade_write(bb2, NULL, NULL, "ghi", 3);
+    ABTS_ASSERT(tc, "third write appended", f == APR_BRIGADE_LAST(bb2));
+    test_bucket_content(tc, f, "defghi", 6);
+    apr_brigade_write(bb1, NULL, NULL, "jkl", 3);
+    ABTS_ASSERT(tc, "fourth write appended", e == APR_BRIGADE_LAST(bb1));
+    ABTS_ASSERT(tc, "bucket moved to the heap", APR_BUCKET_IS_HEAP(e));
+    test_bucket_content(tc, e, "abcjkl", 6);
+    ABTS_INT_EQUAL(tc, 2, s->refcount.refcount);
+
+    /* copying and splitting share the slab */
+    e = f;
+    APR_ASSERT_SUCCESS(tc, "copy slab bucket", apr_bucket_copy(e, &f));
+    APR_BRIGADE_INSERT_TAIL(bb1, f);
+    APR_ASSERT_SUCCESS(tc, "split slab bucket", apr_bucket_split(e, 2));
+    ABTS_ASSERT(tc, "split bucket uses the same slab",
+                APR_BUCKET_NEXT(e)->data == s);
+    ABTS_INT_EQUAL(tc, 4, s->refcount.refcount);
+    test_bucket_content(tc, e, "de", 2);
+    test_bucket_content(tc, APR_BUCKET_NEXT(e), "fghi", 4);
+    test_bucket_content(tc, f, "defghi", 6);
+
+    /* extending the copy leaves the buckets sharing its data alone */
+    apr_brigade_write(bb1, NULL, NULL, "mno", 3);
+    test_bucket_content(tc, f, "defghimno", 9);
+    test_bucket_content(tc, APR_BUCKET_NEXT(e), "fghi", 4);
+    apr_brigade_write(bb2, NULL, NULL, "pqr", 3);
+    test_bucket_content(tc, APR_BRIGADE_LAST(bb2), "fghipqr", 7);
+    test_bucket_content(tc, f, "defghimno", 9);
+
+    /* an unused slab is filled again from the start */
+    apr_brigade_cleanup(bb1);
+    apr_brigade_cleanup(bb2);
+    ABTS_INT_EQUAL(tc, 1, s->refcount.refcount);
+    apr_brigade_write(bb1, NULL, NULL, "vwx", 3);
+    e = APR_BRIGADE_FIRST(bb1);
+    ABTS_ASSERT(tc, "slab reused", e->data == s);
+    ABTS_ASSERT(tc, "slab filled from the start", e->start == 0);
+    test_bucket_content(tc, e, "vwx", 3);
+
+    /* a full slab is replaced while its buckets still use it */
+    memset(big, 'x', sizeof big);
+    apr_brigade_write(bb2, NULL, NULL, big, s->size - 3);
+    ABTS_ASSERT(tc, "slab used up", s->used == s->size);
+    e = apr_bucket_slab_create("stu", 3, ba);
+    APR_BRIGADE_INSERT_TAIL(bb1, e);
+    ABTS_ASSERT(tc, "new slab", APR_BUCKET_IS_SLAB(e) && e->data != s);
+    test_bucket_content(tc, e, "stu", 3);
+    test_bucket_content(tc, APR_BRIGADE_FIRST(bb1), "vwx", 3);
+
+    /* writing past a full slab moves the bucket to a buffer of its own */
+    apr_brigade_write(bb2, NULL, NULL, "yz", 2);
+    e = APR_BRIGADE_LAST(bb2);
+    ABTS_ASSERT(tc, "bucket moved to the heap", APR_BUCKET_IS_HEAP(e));
+    ABTS_ASSERT(tc, "moved bucket extended", e->length == s->size - 1);
+    ABTS_ASSERT(tc, "only bucket", e == APR_BRIGADE_FIRST(bb2));
+
+    /* data larger than a slab gets a heap bucket */
+    e = apr_bucket_slab_create(big, sizeof big, ba);
+    ABTS_ASSERT(tc, "large copy makes a heap bucket", APR_BUCKET_IS_HEAP(e));
+    apr_bucket_destroy(e);
+
+    apr_brigade_destroy(bb1);
+    apr_brigade_destroy(bb2);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_peek_iovec(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_file_t *f = make_test_file(tc, "peekfile.txt", "brave new ");
+    struct iovec vec[4];
+    apr_size_t len;
+    int nvec;
+
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("hello, ", 7, ba));
+    apr_brigade_insert_file(bb, f, 0, 10, p);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("", 0, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create("world", 5, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("!", 1, ba));
+
+    /* stops at the metadata bucket, skips empty buckets */
+    nvec = 4;
+    len = 100;
+    APR_ASSERT_SUCCESS(tc, "peek brigade",
+                       apr_brigade_peek_iovec(bb, vec, &nvec, &len,
+                                              APR_BLOCK_READ));
+    ABTS_INT_EQUAL(tc, 3, nvec);
+    ABTS_SIZE_EQUAL(tc, 22, len);
+    ABTS_STR_NEQUAL(tc, "hello, ", vec[0].iov_base, 7);
+    ABTS_STR_NEQUAL(tc, "brave new ", vec[1].iov_base, 10);
+    ABTS_STR_NEQUAL(tc, "world", vec[2].iov_base, 5);
+
+    /* the brigade is left alone */
+    flatten_match(tc, "peek is non-destructive", bb, "hello, brave new world!");
+
+    /* limited by bytes and by elements */
+    nvec = 4;
+    len = 9;
+    APR_ASSERT_SUCCESS(tc, "peek 9 bytes",
+                       apr_brigade_peek_iovec(bb, vec, &nvec, &len,
+                                              APR_BLOCK_READ));
+    ABTS_INT_EQUAL(tc, 2, nvec);
+    ABTS_SIZE_EQUAL(tc, 9, len);
+    ABTS_SIZE_EQUAL(tc, 2, vec[1].iov_len);
+    nvec = 1;
+    len = 100;
+    APR_ASSERT_SUCCESS(tc, "peek one element",
+                       apr_brigade_peek_iovec(bb, vec, &nvec, &len,
+                                              APR_BLOCK_READ));
+    ABTS_INT_EQUAL(tc, 1, nvec);
+    ABTS_SIZE_EQUAL(tc, 7, len);
+
+    /* consuming splits the bucket the parser stopped in */
+    APR_ASSERT_SUCCESS(tc, "consume 13 bytes", apr_brigade_consume(bb, 13));
+    nvec = 4;
+    len = 100;
+    APR_ASSERT_SUCCESS(tc, "peek after consume",
+                       apr_brigade_peek_iovec(bb, vec, &nvec, &len,
+                                              APR_BLOCK_READ));
+    ABTS_INT_EQUAL(tc, 2, nvec);
+    ABTS_SIZE_EQUAL(tc, 9, len);
+    ABTS_STR_NEQUAL(tc, "new ", vec[0].iov_base, 4);
+
+    /* consuming stops at the metadata bucket */
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, apr_brigade_consume(bb, 100));
+    ABTS_ASSERT(tc, "flush bucket left",
+                APR_BUCKET_IS_FLUSH(APR_BRIGADE_FIRST(bb)));
+    nvec = 4;
+    len = 100;
+    APR_ASSERT_SUCCESS(tc, "peek at metadata",
+                       apr_brigade_peek_iovec(bb, vec, &nvec, &len,
+                                              APR_BLOCK_READ));
+    ABTS_INT_EQUAL(tc, 0, nvec);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+
+    apr_file_close(f);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+/* Write len bytes to the pipe and check the length of the next read */
+static apr_bucket *pipe_read_len(abts_case *tc, apr_file_t *writep,
+                                 apr_bucket *e, apr_size_t len,
+                                 apr_size_t expected)
+{
+    char buf[20000];
+    const char *data;
+    apr_size_t n;
+
+    memset(buf, 'x', sizeof buf);
+    if (len) {
+        APR_ASSERT_SUCCESS(tc, "write to pipe",
+                           apr_file_write_full(writep, buf, len, NULL));
+    }
+    APR_ASSERT_SUCCESS(tc, "read pipe bucket",
+                       apr_bucket_read(e, &data, &n, APR_BLOCK_READ));
+    ABTS_SIZE_EQUAL(tc, expected, n);
+    ABTS_ASSERT(tc, "pipe bucket follows",
+                APR_BUCKET_IS_PIPE(APR_BUCKET_NEXT(e)));
+    return APR_BUCKET_NEXT(e);
+}
+
+static void test_pipe_read_size(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_file_t *readp, *writep;
+    apr_bucket *e;
+
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp, &writep, p));
+
+    /* by default, reads are of APR_BUCKET_BUFF_SIZE */
+    e = apr_bucket_pipe_create(readp, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    e = pipe_read_len(tc, writep, e, 16000, 8000);
+    e = pipe_read_len(tc, writep, e, 0, 8000);
+    e = pipe_read_len(tc, writep, e, 4000, 4000);
+    e = pipe_read_len(tc, writep, e, 8000, 8000);
+    apr_brigade_cleanup(bb);
+
+    /* full reads grow the next one, short ones shrink it */
+    e = apr_bucket_pipe_create_ex(readp, 0, APR_BUCKET_READ_MAX, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    e = pipe_read_len(tc, writep, e, 8000, 8000);
+    e = pipe_read_len(tc, writep, e, 16000, 16000);
+    e = pipe_read_len(tc, writep, e, 12000, 12000);
+    e = pipe_read_len(tc, writep, e, 20000, 16000);
+    e = pipe_read_len(tc, writep, e, 0, 4000);
+    apr_brigade_cleanup(bb);
+
+    /* within min_read and max_read */
+    e = apr_bucket_pipe_create_ex(readp, 1000, 4000, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    e = pipe_read_len(tc, writep, e, 1000, 1000);
+    e = pipe_read_len(tc, writep, e, 2000, 2000);
+    e = pipe_read_len(tc, writep, e, 5000, 4000);
+    e = pipe_read_len(tc, writep, e, 0, 1000);
+    e = pipe_read_len(tc, writep, e, 500, 500);
+    e = pipe_read_len(tc, writep, e, 2000, 1000);
+    e = pipe_read_len(tc, writep, e, 0, 1000);
+
+    apr_brigade_destroy(bb);
+    apr_file_close(writep);
+    apr_file_close(readp);
+    apr_bucket_alloc_destroy(ba);
+}
+
 static void test_write_putstrs(abts_case *tc, void *data)
 {
     apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
@@ -511,6 +928,65 @@ static void test_write_putstrs(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+typedef struct {
+    int flushes;
+    apr_off_t max;
+} flush_count_t;
+
+static apr_status_t count_flush(apr_bucket_brigade *bb, void *ctx)
+{
+    flush_count_t *fc = ctx;
+    apr_off_t length;
+
+    apr_brigade_length(bb, 1, &length);
+    if (length > fc->max) {
+        fc->max = length;
+    }
+    fc->flushes++;
+
+    return apr_brigade_cleanup(bb);
+}
+
+#define FLUSH_COUNT 100000
+
+static void test_write_flush(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_bucket_brigade *other = apr_brigade_create(p, ba);
+    flush_count_t fc = { 0 };
+    int n;
+
+    /* a flush for every buffer's worth of single characters */
+    for (n = 0; n < FLUSH_COUNT; n++) {
+        apr_brigade_putc(bb, count_flush, &fc, 'x');
+    }
+    ABTS_INT_EQUAL(tc, FLUSH_COUNT / (APR_BUCKET_BUFF_SIZE + 1), fc.flushes);
+    ABTS_ASSERT(tc, "flushed at a buffer's worth",
+                fc.max == APR_BUCKET_BUFF_SIZE + 1);
+    apr_brigade_cleanup(bb);
+
+    /* and so whatever else the slabs are used for */
+    fc.flushes = 0;
+    fc.max = 0;
+    for (n = 0; n < FLUSH_COUNT / 10; n++) {
+        apr_brigade_puts(bb, count_flush, &fc, THESTR);
+        if (n % 100 == 0) {
+            apr_brigade_write(other, NULL, NULL, THESTR, strlen(THESTR));
+        }
+    }
+    ABTS_ASSERT(tc, "puts flushed",
+                fc.flushes >= FLUSH_COUNT / 10 * strlen(THESTR)
+                              / (APR_BUCKET_BUFF_SIZE + strlen(THESTR)));
+    ABTS_ASSERT(tc, "puts flushed at a buffer's worth",
+                fc.max > APR_BUCKET_BUFF_SIZE - strlen(THESTR)
+                && fc.max <= APR_BUCKET_BUFF_SIZE + strlen(THESTR));
+
+    apr_brigade_destroy(bb);
+    apr_brigade_destroy(other);
+    apr_bucket_alloc_destroy(ba);
+}
+
 abts_suite *testbuckets(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -521,6 +997,10 @@ abts_suite *testbuckets(abts_suite *suite)
     abts_run_test(suite, test_split, NULL);
     abts_run_test(suite, test_bwrite, NULL);
     abts_run_test(suite, test_splitline, NULL);
+    abts_run_test(suite, test_splitline_small, NULL);
+    abts_run_test(suite, test_splitline_eagain, NULL);
+    abts_run_test(suite, test_find, NULL);
+    abts_run_test(suite, test_split_boundary, NULL);
     abts_run_test(suite, test_splits, NULL);
     abts_run_test(suite, test_insertfile, NULL);
     abts_run_test(suite, test_manyfile, NULL);
@@ -528,6 +1008,10 @@ abts_suite *testbuckets(abts_suite *suite)
     abts_run_test(suite, test_partition, NULL);
     abts_run_test(suite, test_write_split, NULL);
     abts_run_test(suite, test_write_putstrs, NULL);
+    abts_run_test(suite, test_write_flush, NULL);
+    abts_run_test(suite, test_slab, NULL);
+    abts_run_test(suite, test_peek_iovec, NULL);
+    abts_run_test(suite, test_pipe_read_size, NULL);
 
     return suite;
 }
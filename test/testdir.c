@@ -23,8 +23,15 @@
 #include "apr_general.h"
 #include "apr_lib.h"
 #include "apr_thread_proc.h"
+#include "apr_thread_pool.h"
+#include "apr_strings.h"
+#include "apr_atomic.h"
 #include "testutil.h"
 
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 static void test_mkdir(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -359,6 +366,257 @@ static void test_uncleared_errno(abts_case *tc, void *data)
 
 }
 
+#define BATCH_DIR   "data/batchdir"
+#define BATCH_FILES 150
+
+/* Read the whole directory by batches of n, checking the entries */
+static void read_batches(abts_case *tc, apr_dir_t *dir, apr_size_t n)
+{
+    apr_finfo_t *finfo = apr_palloc(p, n * sizeof(*finfo));
+    apr_pool_t *subp;
+    apr_size_t i, nfinfo;
+    apr_off_t total = 0;
+    int files = 0, dirs = 0;
+    apr_status_t rv;
+
+    apr_pool_create(&subp, p);
+    for (;;) {
+        nfinfo = n;
+        rv = apr_dir_read_batch(finfo, &nfinfo,
+                                APR_FINFO_TYPE | APR_FINFO_SIZE, dir, subp);
+        if (APR_STATUS_IS_ENOENT(rv)) {
+            ABTS_SIZE_EQUAL(tc, 0, nfinfo);
+            break;
+        }
+        APR_ASSERT_SUCCESS(tc, "read batch", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        ABTS_TRUE(tc, nfinfo > 0 && nfinfo <= n);
+        for (i = 0; i < nfinfo; i++) {
+            ABTS_TRUE(tc, (finfo[i].valid & APR_FINFO_NAME) != 0);
+            if (finfo[i].filetype == APR_DIR) {
+                ABTS_TRUE(tc, !strcmp(finfo[i].name, ".")
+                              || !strcmp(finfo[i].name, ".."));
+                dirs++;
+            }
+            else {
+                ABTS_INT_EQUAL(tc, APR_REG, finfo[i].filetype);
+                ABTS_TRUE(tc, finfo[i].size
+                              == (apr_off_t)apr_atoi64(finfo[i].name + 1));
+                total += finfo[i].size;
+                files++;
+            }
+        }
+        apr_pool_clear(subp);
+    }
+    apr_pool_destroy(subp);
+
+    ABTS_INT_EQUAL(tc, 2, dirs);
+    ABTS_INT_EQUAL(tc, BATCH_FILES, files);
+    ABTS_TRUE(tc, total == BATCH_FILES * (BATCH_FILES - 1) / 2);
+}
+
+static void test_read_batch(abts_case *tc, void *data)
+{
+    apr_dir_t *dir;
+    apr_file_t *f;
+    char name[64];
+    apr_size_t i;
+#if APR_HAS_THREADS
+    apr_thread_pool_t *tp;
+    apr_status_t rv;
+#endif
+
+    APR_ASSERT_SUCCESS(tc, "make dir",
+                       apr_dir_make(BATCH_DIR, APR_FPROT_OS_DEFAULT, p));
+    for (i = 0; i < BATCH_FILES; i++) {
+        apr_size_t len = i;
+
+        apr_snprintf(name, sizeof(name), BATCH_DIR "/f%03" APR_SIZE_T_FMT, i);
+        APR_ASSERT_SUCCESS(tc, "create file",
+                           apr_file_open(&f, name, APR_FOPEN_WRITE
+                                         | APR_FOPEN_CREATE,
+                                         APR_FPROT_OS_DEFAULT, p));
+        memset(name, 'x', sizeof(name));
+        while (len) {
+            apr_size_t n = len > sizeof(name) ? sizeof(name) : len;
+            APR_ASSERT_SUCCESS(tc, "write file",
+                               apr_file_write_full(f, name, n, NULL));
+            len -= n;
+        }
+        apr_file_close(f);
+    }
+
+    APR_ASSERT_SUCCESS(tc, "open dir", apr_dir_open(&dir, BATCH_DIR, p));
+    read_batches(tc, dir, 16);
+
+    APR_ASSERT_SUCCESS(tc, "rewind dir", apr_dir_rewind(dir));
+    read_batches(tc, dir, 1);
+
+#if APR_HAS_THREADS
+    APR_ASSERT_SUCCESS(tc, "create thread pool",
+                       apr_thread_pool_create(&tp, 0, 4, p));
+    rv = apr_dir_thread_pool_set(dir, tp);
+    if (rv != APR_ENOTIMPL) {
+        APR_ASSERT_SUCCESS(tc, "set thread pool", rv);
+    }
+    APR_ASSERT_SUCCESS(tc, "rewind dir", apr_dir_rewind(dir));
+    read_batches(tc, dir, 256);
+    apr_thread_pool_destroy(tp);
+#endif
+
+    APR_ASSERT_SUCCESS(tc, "close dir", apr_dir_close(dir));
+
+    for (i = 0; i < BATCH_FILES; i++) {
+        apr_snprintf(name, sizeof(name), BATCH_DIR "/f%03" APR_SIZE_T_FMT, i);
+        apr_file_remove(name, p);
+    }
+    APR_ASSERT_SUCCESS(tc, "remove dir", apr_dir_remove(BATCH_DIR, p));
+}
+
+#define WALK_DIR "data/walktree"
+#define WALK_LINK "data/walklink"
+
+typedef struct {
+    apr_uint32_t files;
+    apr_uint32_t dirs;
+    apr_uint32_t bad;
+    const char *root;
+    const char *skip;
+    int stop;
+} walk_count_t;
+
+static apr_dir_walk_e walk_count(void *baton, const char *path,
+                                 const apr_finfo_t *finfo, apr_pool_t *pool)
+{
+    walk_count_t *wc = baton;
+    const char *root = wc->root ? wc->root : WALK_DIR;
+    apr_size_t rootlen = strlen(root);
+
+    if (strncmp(path, root, rootlen) || path[rootlen] != '/'
+        || !(finfo->valid & APR_FINFO_SIZE)
+        || strcmp(finfo->name, strrchr(path, '/') + 1)) {
+        apr_atomic_inc32(&wc->bad);
+    }
+    if (finfo->filetype == APR_DIR) {
+        apr_atomic_inc32(&wc->dirs);
+        if (wc->skip && !strcmp(finfo->name, wc->skip)) {
+            return APR_DIR_WALK_SKIP;
+        }
+    }
+    else {
+        apr_atomic_inc32(&wc->files);
+    }
+    return wc->stop ? APR_DIR_WALK_STOP : APR_DIR_WALK_CONTINUE;
+}
+
+static void walk_tree(abts_case *tc, apr_int32_t flags, int nthreads,
+                      const char *skip, apr_uint32_t dirs, apr_uint32_t files)
+{
+    walk_count_t wc;
+
+    memset(&wc, 0, sizeof(wc));
+    wc.skip = skip;
+    APR_ASSERT_SUCCESS(tc, "walk tree",
+                       apr_dir_walk(WALK_DIR, APR_FINFO_SIZE, flags,
+                                    nthreads, walk_count, &wc, p));
+    ABTS_INT_EQUAL(tc, dirs, wc.dirs);
+    ABTS_INT_EQUAL(tc, files, wc.files);
+    ABTS_INT_EQUAL(tc, 0, wc.bad);
+}
+
+static void test_walk(abts_case *tc, void *data)
+{
+    static const char *const tops[] = { "a", "b", "c" };
+    static const char *const subs[] = { "x", "y" };
+    walk_count_t wc;
+    apr_file_t *f;
+    apr_status_t rv;
+    char *path;
+    int i, j, k;
+
+    APR_ASSERT_SUCCESS(tc, "make dir",
+                       apr_dir_make(WALK_DIR, APR_FPROT_OS_DEFAULT, p));
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 2; j++) {
+            path = apr_pstrcat(p, WALK_DIR "/", tops[i], "/", subs[j], NULL);
+            APR_ASSERT_SUCCESS(tc, "make dirs",
+                               apr_dir_make_recursive(path,
+                                                      APR_FPROT_OS_DEFAULT,
+                                                      p));
+            for (k = 0; k < 5; k++) {
+                APR_ASSERT_SUCCESS(tc, "create file",
+                                   apr_file_open(&f, apr_psprintf(p, "%s/f%d",
+                                                                  path, k),
+                                                 APR_FOPEN_WRITE
+                                                 | APR_FOPEN_CREATE,
+                                                 APR_FPROT_OS_DEFAULT, p));
+                apr_file_close(f);
+            }
+        }
+    }
+    APR_ASSERT_SUCCESS(tc, "create file",
+                       apr_file_open(&f, WALK_DIR "/top",
+                                     APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                                     APR_FPROT_OS_DEFAULT, p));
+    apr_file_close(f);
+
+    memset(&wc, 0, sizeof(wc));
+    rv = apr_dir_walk(WALK_DIR, 0, 0, 1, walk_count, &wc, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_dir_walk");
+    }
+    else {
+        walk_tree(tc, 0, 1, NULL, 9, 31);
+        walk_tree(tc, APR_DIR_WALK_BREADTH, 1, NULL, 9, 31);
+        walk_tree(tc, APR_DIR_WALK_FOLLOW | APR_DIR_WALK_XDEV, 1, NULL,
+                  9, 31);
+        walk_tree(tc, 0, 4, NULL, 9, 31);
+        walk_tree(tc, APR_DIR_WALK_BREADTH, 3, NULL, 9, 31);
+        walk_tree(tc, 0, 1, "b", 7, 21);
+        walk_tree(tc, 0, 4, "x", 9, 16);
+
+        memset(&wc, 0, sizeof(wc));
+        wc.stop = 1;
+        ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                       apr_dir_walk(WALK_DIR, 0, 0, 1, walk_count, &wc, p));
+        ABTS_INT_EQUAL(tc, 1, wc.dirs + wc.files);
+
+        ABTS_TRUE(tc, apr_dir_walk("data/walknothere", 0, 0, 1, walk_count,
+                                   &wc, p) != APR_SUCCESS);
+
+#if APR_HAVE_UNISTD_H
+        /* a symlinked root is walked, even without APR_DIR_WALK_FOLLOW */
+        apr_file_remove(WALK_LINK, p);
+        if (symlink("walktree", WALK_LINK) == 0) {
+            memset(&wc, 0, sizeof(wc));
+            wc.root = WALK_LINK;
+            APR_ASSERT_SUCCESS(tc, "walk symlinked root",
+                               apr_dir_walk(WALK_LINK, APR_FINFO_SIZE, 0, 2,
+                                            walk_count, &wc, p));
+            ABTS_INT_EQUAL(tc, 9, wc.dirs);
+            ABTS_INT_EQUAL(tc, 31, wc.files);
+            ABTS_INT_EQUAL(tc, 0, wc.bad);
+            apr_file_remove(WALK_LINK, p);
+        }
+#endif
+    }
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 2; j++) {
+            path = apr_pstrcat(p, WALK_DIR "/", tops[i], "/", subs[j], NULL);
+            for (k = 0; k < 5; k++) {
+                apr_file_remove(apr_psprintf(p, "%s/f%d", path, k), p);
+            }
+            apr_dir_remove(path, p);
+        }
+        apr_dir_remove(apr_pstrcat(p, WALK_DIR "/", tops[i], NULL), p);
+    }
+    apr_file_remove(WALK_DIR "/top", p);
+    APR_ASSERT_SUCCESS(tc, "remove dir", apr_dir_remove(WALK_DIR, p));
+}
+
 static void test_rmkdir_nocwd(abts_case *tc, void *data)
 {
     char *cwd, *path;
@@ -394,6 +652,8 @@ abts_suite *testdir(abts_suite *suite)
     abts_run_test(suite, test_rmkdir_nocwd, NULL);
 
     abts_run_test(suite, test_rewind, NULL);
+    abts_run_test(suite, test_read_batch, NULL);
+    abts_run_test(suite, test_walk, NULL);
 
     abts_run_test(suite, test_opendir, NULL);
     abts_run_test(suite, test_opendir_notthere, NULL);
@@ -0,0 +1,270 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_file_io.h"
+#include "apr_file_info.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_FILES   1000000
+#define DEFAULT_THREADS 4
+#define DEFAULT_DIR     "data/walkperf"
+#define FILES_PER_DIR   100
+
+static const char *topdir = DEFAULT_DIR;
+static int num_files = DEFAULT_FILES;
+static int num_threads = DEFAULT_THREADS;
+static int cleanup = 0;
+
+static const char *leaf_dir(int l, apr_pool_t *pool)
+{
+    return apr_psprintf(pool, "%s/d%03d/d%03d", topdir,
+                        l / FILES_PER_DIR, l % FILES_PER_DIR);
+}
+
+/* The tree: topdir/dNNN/dNNN/fNNN, FILES_PER_DIR files in each leaf */
+static apr_status_t make_tree(apr_pool_t *pool)
+{
+    apr_pool_t *subp;
+    apr_finfo_t finfo;
+    apr_file_t *f;
+    apr_status_t rv = APR_SUCCESS;
+    int l, i;
+
+    if (apr_stat(&finfo, topdir, APR_FINFO_TYPE, pool) == APR_SUCCESS) {
+        printf("Reusing the tree in %s\n", topdir);
+        return APR_SUCCESS;
+    }
+
+    printf("Creating %d files in %s\n", num_files, topdir);
+    apr_pool_create(&subp, pool);
+    for (l = 0; l * FILES_PER_DIR < num_files && rv == APR_SUCCESS; l++) {
+        const char *dir = leaf_dir(l, subp);
+
+        rv = apr_dir_make_recursive(dir, APR_FPROT_OS_DEFAULT, subp);
+        for (i = 0; i < FILES_PER_DIR && rv == APR_SUCCESS; i++) {
+            rv = apr_file_open(&f, apr_psprintf(subp, "%s/f%03d", dir, i),
+                               APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                               APR_FPROT_OS_DEFAULT, subp);
+            if (rv == APR_SUCCESS) {
+                apr_file_close(f);
+            }
+        }
+        apr_pool_clear(subp);
+    }
+    apr_pool_destroy(subp);
+    return rv;
+}
+
+static void remove_tree(apr_pool_t *pool)
+{
+    apr_pool_t *subp;
+    int l, i;
+
+    apr_pool_create(&subp, pool);
+    for (l = 0; l * FILES_PER_DIR < num_files; l++) {
+        const char *dir = leaf_dir(l, subp);
+
+        for (i = 0; i < FILES_PER_DIR; i++) {
+            apr_file_remove(apr_psprintf(subp, "%s/f%03d", dir, i), subp);
+        }
+        apr_dir_remove(dir, subp);
+        if (l % FILES_PER_DIR == FILES_PER_DIR - 1) {
+            apr_dir_remove(apr_psprintf(subp, "%s/d%03d", topdir,
+                                        l / FILES_PER_DIR), subp);
+        }
+        apr_pool_clear(subp);
+    }
+    apr_dir_remove(apr_psprintf(subp, "%s/d%03d", topdir,
+                                (l - 1) / FILES_PER_DIR), subp);
+    apr_dir_remove(topdir, subp);
+    apr_pool_destroy(subp);
+}
+
+typedef struct {
+    apr_uint32_t entries;
+    apr_uint64_t bytes;
+} walk_stats_t;
+
+/* What consumers do without apr_dir_walk() */
+static apr_status_t naive_walk(const char *path, walk_stats_t *stats,
+                               apr_pool_t *pool)
+{
+    apr_pool_t *subp;
+    apr_dir_t *dir;
+    apr_finfo_t finfo;
+    apr_status_t rv;
+
+    if ((rv = apr_dir_open(&dir, path, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_create(&subp, pool);
+    while ((rv = apr_dir_read(&finfo, APR_FINFO_TYPE | APR_FINFO_SIZE,
+                              dir)) == APR_SUCCESS
+           || rv == APR_INCOMPLETE) {
+        char *child;
+
+        if (!strcmp(finfo.name, ".") || !strcmp(finfo.name, "..")) {
+            continue;
+        }
+        stats->entries++;
+        stats->bytes += finfo.size;
+        if (finfo.filetype == APR_DIR) {
+            apr_filepath_merge(&child, path, finfo.name, 0, subp);
+            rv = naive_walk(child, stats, subp);
+            apr_pool_clear(subp);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+        }
+    }
+    apr_pool_destroy(subp);
+    apr_dir_close(dir);
+    return APR_STATUS_IS_ENOENT(rv) ? APR_SUCCESS : rv;
+}
+
+static apr_dir_walk_e count_entry(void *baton, const char *path,
+                                  const apr_finfo_t *finfo, apr_pool_t *pool)
+{
+    walk_stats_t *stats = baton;
+
+    apr_atomic_inc32(&stats->entries);
+    return APR_DIR_WALK_CONTINUE;
+}
+
+static void report(const char *desc, walk_stats_t *stats, apr_time_t start)
+{
+    apr_time_t elapsed = apr_time_now() - start;
+
+    if (!elapsed) {
+        elapsed = 1;
+    }
+    printf("    %-32s %9u entries in %7" APR_TIME_T_FMT " ms, %9"
+           APR_UINT64_T_FMT " entries/s\n", desc, stats->entries,
+           apr_time_as_msec(elapsed),
+           (apr_uint64_t)stats->entries * APR_USEC_PER_SEC / elapsed);
+}
+
+static apr_status_t run_walks(apr_pool_t *pool)
+{
+    walk_stats_t stats;
+    apr_time_t start;
+    apr_status_t rv;
+    const char *desc;
+    int i;
+
+    memset(&stats, 0, sizeof(stats));
+    start = apr_time_now();
+    if ((rv = naive_walk(topdir, &stats, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    report("apr_dir_read recursion", &stats, start);
+
+    for (i = 0; i < 3; i++) {
+        apr_int32_t flags = (i == 1) ? APR_DIR_WALK_BREADTH : 0;
+        int nthreads = (i == 2) ? num_threads : 1;
+
+        memset(&stats, 0, sizeof(stats));
+        start = apr_time_now();
+        rv = apr_dir_walk(topdir, APR_FINFO_SIZE, flags, nthreads,
+                          count_entry, &stats, pool);
+        if (rv == APR_ENOTIMPL) {
+            printf("    apr_dir_walk is not implemented on this platform\n");
+            return APR_SUCCESS;
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        desc = apr_psprintf(pool, "apr_dir_walk %s, %d thread%s",
+                            flags ? "breadth" : "depth", nthreads,
+                            nthreads > 1 ? "s" : "");
+        report(desc, &stats, start);
+    }
+    return APR_SUCCESS;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR Directory Walk Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "cd:n:t:", &optchar, &optarg))
+           == APR_SUCCESS) {
+        if (optchar == 'c') {
+            cleanup = 1;
+        }
+        else if (optchar == 'd') {
+            topdir = optarg;
+        }
+        else if (optchar == 'n') {
+            num_files = atoi(optarg);
+        }
+        else if (optchar == 't') {
+            num_threads = atoi(optarg);
+        }
+    }
+
+    if ((rv != APR_SUCCESS && rv != APR_EOF) || num_files < FILES_PER_DIR
+        || num_threads < 1) {
+        fprintf(stderr, "Usage: %s [-d dir] [-n files] [-t threads] [-c]\n"
+                "  -c removes the tree when done, it is kept otherwise\n",
+                argv[0]);
+        exit(-1);
+    }
+
+    if ((rv = make_tree(pool)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not create the tree: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-2);
+    }
+
+    printf("Walking %s\n", topdir);
+    rv = run_walks(pool);
+    if (cleanup) {
+        remove_tree(pool);
+    }
+    if (rv != APR_SUCCESS) {
+        fprintf(stderr, "walk failed : [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-2);
+    }
+
+    return 0;
+}
@@ -219,6 +219,14 @@ SOURCE=.\testfile.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\testfileaio.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\testfileappender.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\testfilecopy.c
 # End Source File
 # Begin Source File
@@ -323,6 +331,10 @@ SOURCE=.\testrand.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\testresolver.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\testshm.c
 # End Source File
 # Begin Source File
@@ -339,6 +351,10 @@ SOURCE=.\testsock.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\testsocketpool.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\testsock.h
 # End Source File
 # Begin Source File
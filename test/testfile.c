@@ -108,6 +108,104 @@ static void test_read(abts_case *tc, void *data)
     apr_file_close(filetest);
 }
 
+static void test_read_at(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_size_t nbytes;
+    char str[32], str2[32];
+    struct iovec vec[2];
+    apr_file_t *filetest = NULL;
+    int buffered;
+
+    for (buffered = 0; buffered <= APR_FOPEN_BUFFERED;
+         buffered += APR_FOPEN_BUFFERED) {
+        rv = apr_file_open(&filetest, FILENAME, APR_FOPEN_READ | buffered,
+                           APR_FPROT_UREAD | APR_FPROT_UWRITE, p);
+        APR_ASSERT_SUCCESS(tc, "Opening test file " FILENAME, rv);
+
+        nbytes = 6;
+        rv = apr_file_read_at(filetest, str, &nbytes, 5);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "apr_file_read_at");
+            apr_file_close(filetest);
+            return;
+        }
+        APR_ASSERT_SUCCESS(tc, "read at offset", rv);
+        ABTS_SIZE_EQUAL(tc, 6, nbytes);
+        ABTS_STR_NEQUAL(tc, "is the", str, 6);
+
+        /* the file position is left alone */
+        nbytes = 4;
+        APR_ASSERT_SUCCESS(tc, "read after read_at",
+                           apr_file_read(filetest, str, &nbytes));
+        ABTS_STR_NEQUAL(tc, "This", str, 4);
+
+        vec[0].iov_base = str;
+        vec[0].iov_len = 4;
+        vec[1].iov_base = str2;
+        vec[1].iov_len = sizeof(str2);
+        APR_ASSERT_SUCCESS(tc, "readv at offset",
+                           apr_file_readv_at(filetest, vec, 2, 8, &nbytes));
+        ABTS_SIZE_EQUAL(tc, strlen(TESTSTR) - 8, nbytes);
+        ABTS_STR_NEQUAL(tc, "the ", str, 4);
+        ABTS_STR_NEQUAL(tc, "file data file.", str2, 15);
+
+        nbytes = sizeof(str);
+        rv = apr_file_read_at(filetest, str, &nbytes, strlen(TESTSTR));
+        ABTS_INT_EQUAL(tc, APR_EOF, rv);
+        ABTS_SIZE_EQUAL(tc, 0, nbytes);
+
+        apr_file_close(filetest);
+    }
+}
+
+static void test_write_at(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_size_t nbytes;
+    apr_off_t off = 0;
+    char str[16];
+    apr_file_t *f = NULL;
+    const char *fname = DIRNAME "/file_write_at.txt";
+
+    rv = apr_file_open(&f, fname,
+                       APR_FOPEN_READ | APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                       | APR_FOPEN_TRUNCATE | APR_FOPEN_BUFFERED,
+                       APR_FPROT_UREAD | APR_FPROT_UWRITE, p);
+    APR_ASSERT_SUCCESS(tc, "open file", rv);
+
+    /* buffered data is written out before writing at an offset */
+    APR_ASSERT_SUCCESS(tc, "write file",
+                       apr_file_write_full(f, "0123456789", 10, NULL));
+    nbytes = 2;
+    rv = apr_file_write_at(f, "ab", &nbytes, 5);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_write_at");
+        apr_file_close(f);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "write at offset", rv);
+    ABTS_SIZE_EQUAL(tc, 2, nbytes);
+
+    /* data buffered for reading is kept up to date */
+    APR_ASSERT_SUCCESS(tc, "seek to start", apr_file_seek(f, APR_SET, &off));
+    nbytes = 3;
+    APR_ASSERT_SUCCESS(tc, "read start",
+                       apr_file_read(f, str, &nbytes));
+    ABTS_STR_NEQUAL(tc, "012", str, 3);
+    nbytes = 2;
+    APR_ASSERT_SUCCESS(tc, "write at buffered offset",
+                       apr_file_write_at(f, "cd", &nbytes, 8));
+    nbytes = 7;
+    APR_ASSERT_SUCCESS(tc, "read rest",
+                       apr_file_read(f, str, &nbytes));
+    ABTS_SIZE_EQUAL(tc, 7, nbytes);
+    ABTS_STR_NEQUAL(tc, "34ab7cd", str, 7);
+
+    apr_file_close(f);
+    apr_file_remove(fname, p);
+}
+
 static void test_readzero(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -373,6 +471,65 @@ static void test_buffer_set_get(abts_case *tc, void *data)
     
     apr_file_close(filetest);
 }
+#define ADVISE_FILENAME DIRNAME "/file_advise.bin"
+#define ADVISE_SIZE     (1024 * 1024 + 4321)
+
+static void test_advise(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f = NULL;
+    char *buf = apr_palloc(p, ADVISE_SIZE);
+    char *got = apr_palloc(p, ADVISE_SIZE);
+    apr_size_t i, n;
+    apr_off_t off;
+
+    for (i = 0; i < ADVISE_SIZE; i++) {
+        buf[i] = (char)(i % 251);
+    }
+    rv = apr_file_open(&f, ADVISE_FILENAME,
+                       APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE,
+                       APR_FPROT_UREAD | APR_FPROT_UWRITE, p);
+    APR_ASSERT_SUCCESS(tc, "open file for writing", rv);
+    APR_ASSERT_SUCCESS(tc, "write file",
+                       apr_file_write_full(f, buf, ADVISE_SIZE, NULL));
+
+    rv = apr_file_advise(f, 0, 0, APR_FILE_ADVICE_WILLNEED);
+    ABTS_ASSERT(tc, "advice taken or not implemented",
+                rv == APR_SUCCESS || APR_STATUS_IS_ENOTIMPL(rv));
+    rv = apr_file_advise(f, 0, 0, 42);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    apr_file_close(f);
+
+    /* The advice must not change what is read */
+    rv = apr_file_open(&f, ADVISE_FILENAME,
+                       APR_FOPEN_READ | APR_FOPEN_BUFFERED
+                       | APR_FOPEN_SEQUENTIAL | APR_FOPEN_NOCACHE, 0, p);
+    APR_ASSERT_SUCCESS(tc, "open file sequential", rv);
+    ABTS_TRUE(tc, apr_file_buffer_size_get(f) >= APR_BUFFERSIZE);
+
+    for (i = 0; i < ADVISE_SIZE; i += n) {
+        n = ADVISE_SIZE - i > 1000 ? 1000 : ADVISE_SIZE - i;
+        rv = apr_file_read(f, got + i, &n);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    APR_ASSERT_SUCCESS(tc, "read sequential file", rv);
+    ABTS_SIZE_EQUAL(tc, ADVISE_SIZE, i);
+    ABTS_TRUE(tc, memcmp(buf, got, ADVISE_SIZE) == 0);
+
+    off = 12345;
+    APR_ASSERT_SUCCESS(tc, "seek back",
+                       apr_file_seek(f, APR_SET, &off));
+    n = 100000;
+    APR_ASSERT_SUCCESS(tc, "read after seek",
+                       apr_file_read_full(f, got, n, &n));
+    ABTS_TRUE(tc, memcmp(buf + 12345, got, n) == 0);
+
+    apr_file_close(f);
+    apr_file_remove(ADVISE_FILENAME, p);
+}
+
 static void test_getc(abts_case *tc, void *data)
 {
     apr_file_t *f = NULL;
@@ -773,6 +930,64 @@ static void test_writev_buffered_seek(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "remove file", apr_file_remove(fname, p));
 }
 
+static void test_writev_buffered_large(abts_case *tc, void *data)
+{
+    apr_file_t *f;
+    apr_off_t off = 0;
+    struct iovec vec[4];
+    apr_size_t nbytes, large = 3 * 4096;
+    apr_size_t expectlen = large + strlen(LINE1 LINE2) * 2 + strlen(LINE1);
+    char *big = apr_palloc(p, large), *expect = apr_palloc(p, expectlen);
+    const char *fname = "data/testwritev_large.dat";
+
+    memset(big, 'x', large);
+    memcpy(expect, LINE1 LINE2, strlen(LINE1 LINE2));
+    memcpy(expect + strlen(LINE1 LINE2), big, large);
+    memcpy(expect + strlen(LINE1 LINE2) + large, LINE1 LINE2 LINE1,
+           strlen(LINE1 LINE2 LINE1));
+
+    APR_ASSERT_SUCCESS(tc, "open file for writing",
+                       apr_file_open(&f, fname,
+                                     APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE |
+                                     APR_FOPEN_BUFFERED, APR_FPROT_OS_DEFAULT, p));
+
+    /* small pieces stay in the buffer */
+    vec[0].iov_base = LINE1;
+    vec[0].iov_len = strlen(LINE1);
+    vec[1].iov_base = LINE2;
+    vec[1].iov_len = strlen(LINE2);
+    APR_ASSERT_SUCCESS(tc, "writev of small pieces",
+                       apr_file_writev(f, vec, 2, &nbytes));
+    ABTS_SIZE_EQUAL(tc, strlen(LINE1) + strlen(LINE2), nbytes);
+
+    /* a large one is written out along with the buffer */
+    vec[0].iov_base = big;
+    vec[0].iov_len = large;
+    vec[1].iov_base = LINE1;
+    vec[1].iov_len = strlen(LINE1);
+    vec[2].iov_base = LINE2;
+    vec[2].iov_len = strlen(LINE2);
+    APR_ASSERT_SUCCESS(tc, "writev of a large piece",
+                       apr_file_writev_full(f, vec, 3, &nbytes));
+    ABTS_SIZE_EQUAL(tc, large + strlen(LINE1) + strlen(LINE2), nbytes);
+
+    vec[0].iov_base = LINE1;
+    vec[0].iov_len = strlen(LINE1);
+    APR_ASSERT_SUCCESS(tc, "writev after the large piece",
+                       apr_file_writev(f, vec, 1, &nbytes));
+
+    APR_ASSERT_SUCCESS(tc, "get position",
+                       apr_file_seek(f, APR_CUR, &off));
+    ABTS_TRUE(tc, off == (apr_off_t)expectlen);
+
+    APR_ASSERT_SUCCESS(tc, "close for writing",
+                       apr_file_close(f));
+
+    file_contents_equal(tc, fname, expect, expectlen);
+
+    APR_ASSERT_SUCCESS(tc, "remove file", apr_file_remove(fname, p));
+}
+
 static void test_truncate(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -1043,6 +1258,8 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, link_nonexisting, NULL);
     abts_run_test(suite, test_read, NULL); 
     abts_run_test(suite, test_readzero, NULL); 
+    abts_run_test(suite, test_read_at, NULL);
+    abts_run_test(suite, test_write_at, NULL);
     abts_run_test(suite, test_seek, NULL);
     abts_run_test(suite, test_filename, NULL);
     abts_run_test(suite, test_fileclose, NULL);
@@ -1062,6 +1279,7 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, test_writev_full, NULL);
     abts_run_test(suite, test_writev_buffered, NULL);
     abts_run_test(suite, test_writev_buffered_seek, NULL);
+    abts_run_test(suite, test_writev_buffered_large, NULL);
     abts_run_test(suite, test_bigread, NULL);
     abts_run_test(suite, test_mod_neg, NULL);
     abts_run_test(suite, test_truncate, NULL);
@@ -1070,6 +1288,7 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, test_fail_write_flush, NULL);
     abts_run_test(suite, test_fail_read_flush, NULL);
     abts_run_test(suite, test_buffer_set_get, NULL);
+    abts_run_test(suite, test_advise, NULL);
     abts_run_test(suite, test_xthread, NULL);
 
     return suite;
@@ -0,0 +1,215 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_file_aio.h"
+#include "apr_file_io.h"
+#include "apr_poll.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "testutil.h"
+
+#if APR_HAS_FILE_AIO
+
+#define AIO_FILENAME "data/file_aio.txt"
+#define AIO_TESTSTR  "asynchronous file data"
+
+/* Wait for the next completion */
+static apr_file_aio_op_t *wait_op(abts_case *tc, apr_file_aio_t *aio)
+{
+    apr_file_aio_op_t *op = NULL;
+    apr_int32_t num = 1;
+
+    APR_ASSERT_SUCCESS(tc, "poll for completion",
+                       apr_file_aio_poll(aio, apr_time_from_sec(5), &op,
+                                         &num));
+    ABTS_INT_EQUAL(tc, 1, num);
+    return op;
+}
+
+static void run_ops(abts_case *tc, apr_int32_t flags)
+{
+    apr_file_aio_t *aio;
+    apr_file_aio_op_t op, op2, *done[2];
+    apr_file_t *f;
+    apr_finfo_t finfo;
+    apr_int32_t num;
+    char buf[64];
+
+    APR_ASSERT_SUCCESS(tc, "create aio", apr_file_aio_create(&aio, 2, flags, p));
+    ABTS_PTR_NOTNULL(tc, apr_file_aio_method_name(aio));
+
+    /* open */
+    memset(&op, 0, sizeof(op));
+    op.type = APR_FILE_AIO_OPEN;
+    op.fname = AIO_FILENAME;
+    op.flags = APR_FOPEN_READ | APR_FOPEN_WRITE | APR_FOPEN_CREATE
+               | APR_FOPEN_TRUNCATE;
+    op.perm = APR_FPROT_UREAD | APR_FPROT_UWRITE;
+    op.pool = p;
+    APR_ASSERT_SUCCESS(tc, "submit open", apr_file_aio_submit(aio, &op));
+    ABTS_PTR_EQUAL(tc, &op, wait_op(tc, aio));
+    APR_ASSERT_SUCCESS(tc, "open file", op.status);
+    f = op.file;
+
+    /* write, then sync */
+    op.type = APR_FILE_AIO_WRITE;
+    op.buf = AIO_TESTSTR;
+    op.nbytes = strlen(AIO_TESTSTR);
+    op.offset = 0;
+    APR_ASSERT_SUCCESS(tc, "submit write", apr_file_aio_submit(aio, &op));
+    ABTS_PTR_EQUAL(tc, &op, wait_op(tc, aio));
+    APR_ASSERT_SUCCESS(tc, "write file", op.status);
+    ABTS_SIZE_EQUAL(tc, strlen(AIO_TESTSTR), op.nbytes);
+
+    op.type = APR_FILE_AIO_FSYNC;
+    APR_ASSERT_SUCCESS(tc, "submit fsync", apr_file_aio_submit(aio, &op));
+    ABTS_PTR_EQUAL(tc, &op, wait_op(tc, aio));
+    APR_ASSERT_SUCCESS(tc, "sync file", op.status);
+
+    /* two reads in flight, a third one has to wait */
+    memset(&op2, 0, sizeof(op2));
+    op.type = op2.type = APR_FILE_AIO_READ;
+    op2.file = f;
+    op.buf = buf;
+    op.nbytes = 12;
+    op.offset = 0;
+    op2.buf = buf + 32;
+    op2.nbytes = 32;
+    op2.offset = 13;
+    APR_ASSERT_SUCCESS(tc, "submit read", apr_file_aio_submit(aio, &op));
+    APR_ASSERT_SUCCESS(tc, "submit read", apr_file_aio_submit(aio, &op2));
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, apr_file_aio_submit(aio, &op));
+    done[0] = wait_op(tc, aio);
+    done[1] = wait_op(tc, aio);
+    ABTS_TRUE(tc, (done[0] == &op && done[1] == &op2)
+                  || (done[0] == &op2 && done[1] == &op));
+    APR_ASSERT_SUCCESS(tc, "read file", op.status);
+    APR_ASSERT_SUCCESS(tc, "read file", op2.status);
+    ABTS_SIZE_EQUAL(tc, 12, op.nbytes);
+    ABTS_SIZE_EQUAL(tc, strlen(AIO_TESTSTR) - 13, op2.nbytes);
+    ABTS_STR_NEQUAL(tc, "asynchronous", buf, 12);
+    ABTS_STR_NEQUAL(tc, "file data", buf + 32, 9);
+
+    /* reading at the end */
+    op.offset = strlen(AIO_TESTSTR);
+    APR_ASSERT_SUCCESS(tc, "submit read", apr_file_aio_submit(aio, &op));
+    ABTS_PTR_EQUAL(tc, &op, wait_op(tc, aio));
+    ABTS_INT_EQUAL(tc, APR_EOF, op.status);
+    ABTS_SIZE_EQUAL(tc, 0, op.nbytes);
+
+    /* stat */
+    op.type = APR_FILE_AIO_STAT;
+    op.finfo = &finfo;
+    op.flags = APR_FINFO_SIZE;
+    APR_ASSERT_SUCCESS(tc, "submit stat", apr_file_aio_submit(aio, &op));
+    ABTS_PTR_EQUAL(tc, &op, wait_op(tc, aio));
+    APR_ASSERT_SUCCESS(tc, "stat file", op.status);
+    ABTS_TRUE(tc, finfo.size == (apr_off_t)strlen(AIO_TESTSTR));
+
+    /* nothing left */
+    num = 2;
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, apr_file_aio_poll(aio, 0, done, &num));
+    ABTS_INT_EQUAL(tc, 0, num);
+
+    apr_file_close(f);
+    apr_file_remove(AIO_FILENAME, p);
+    APR_ASSERT_SUCCESS(tc, "destroy aio", apr_file_aio_destroy(aio));
+}
+
+static void test_ops(abts_case *tc, void *data)
+{
+    run_ops(tc, 0);
+}
+
+static void test_ops_nouring(abts_case *tc, void *data)
+{
+    run_ops(tc, APR_FILE_AIO_NOURING);
+}
+
+static void test_pollset(abts_case *tc, void *data)
+{
+    apr_file_aio_t *aio;
+    apr_file_aio_op_t op, *done;
+    apr_pollset_t *pollset;
+    apr_pollfd_t pfd;
+    const apr_pollfd_t *descs;
+    apr_int32_t num;
+    apr_file_t *f;
+    apr_status_t rv;
+    char buf[16];
+
+    APR_ASSERT_SUCCESS(tc, "open file",
+                       apr_file_open(&f, "data/file_datafile.txt",
+                                     APR_FOPEN_READ, 0, p));
+    APR_ASSERT_SUCCESS(tc, "create aio", apr_file_aio_create(&aio, 4, 0, p));
+    APR_ASSERT_SUCCESS(tc, "create pollset",
+                       apr_pollset_create(&pollset, 4, p, 0));
+    apr_file_aio_pollfd_get(aio, &pfd);
+    pfd.client_data = aio;
+    APR_ASSERT_SUCCESS(tc, "add aio to pollset",
+                       apr_pollset_add(pollset, &pfd));
+
+    memset(&op, 0, sizeof(op));
+    op.type = APR_FILE_AIO_READ;
+    op.file = f;
+    op.buf = buf;
+    op.nbytes = 4;
+    APR_ASSERT_SUCCESS(tc, "submit read", apr_file_aio_submit(aio, &op));
+
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(5), &num, &descs);
+    APR_ASSERT_SUCCESS(tc, "pollset signalled", rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_PTR_EQUAL(tc, aio, descs[0].client_data);
+
+    num = 1;
+    APR_ASSERT_SUCCESS(tc, "collect completion",
+                       apr_file_aio_poll(aio, 0, &done, &num));
+    ABTS_PTR_EQUAL(tc, &op, done);
+    ABTS_STR_NEQUAL(tc, "This", buf, 4);
+
+    /* drained */
+    rv = apr_pollset_poll(pollset, 0, &num, &descs);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    apr_pollset_destroy(pollset);
+    apr_file_aio_destroy(aio);
+    apr_file_close(f);
+}
+
+#else
+
+static void not_impl(abts_case *tc, void *data)
+{
+    ABTS_NOT_IMPL(tc, "apr_file_aio");
+}
+
+#endif
+
+abts_suite *testfileaio(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_FILE_AIO
+    abts_run_test(suite, test_ops, NULL);
+    abts_run_test(suite, test_ops_nouring, NULL);
+    abts_run_test(suite, test_pollset, NULL);
+#else
+    abts_run_test(suite, not_impl, NULL);
+#endif
+
+    return suite;
+}
@@ -0,0 +1,248 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_file_appender.h"
+#include "apr_file_io.h"
+#include "apr_file_info.h"
+#include "apr_thread_proc.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "testutil.h"
+
+#if APR_HAS_THREADS
+
+#define APPENDER_FILENAME "data/file_appender.txt"
+#define NUM_THREADS 4
+#define NUM_RECORDS 500
+#define RECORD_LEN  16
+
+static apr_file_t *open_log(abts_case *tc, apr_pool_t *pool)
+{
+    apr_file_t *f = NULL;
+
+    APR_ASSERT_SUCCESS(tc, "open file",
+                       apr_file_open(&f, APPENDER_FILENAME,
+                                     APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                                     | APR_FOPEN_TRUNCATE | APR_FOPEN_APPEND,
+                                     APR_FPROT_OS_DEFAULT, pool));
+    return f;
+}
+
+typedef struct {
+    apr_file_appender_t *ap;
+    char id;
+} writer_t;
+
+static void * APR_THREAD_FUNC writer(apr_thread_t *thd, void *data)
+{
+    writer_t *w = data;
+    apr_uint64_t ticket;
+    apr_status_t rv = APR_SUCCESS;
+    char rec[RECORD_LEN + 1];
+    int i;
+
+    for (i = 0; i < NUM_RECORDS && rv == APR_SUCCESS; i++) {
+        /* "<writer id><14 digits>\n" */
+        apr_snprintf(rec, sizeof(rec), "%c%014d\n", w->id, i);
+        rv = apr_file_appender_write(w->ap, rec, RECORD_LEN, &ticket);
+        if (rv == APR_SUCCESS && i % 100 == 99) {
+            rv = apr_file_appender_wait(w->ap, ticket);
+        }
+    }
+
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void check_records(abts_case *tc, apr_size_t expected)
+{
+    apr_file_t *f;
+    char rec[RECORD_LEN + 1];
+    int next[NUM_THREADS] = { 0 };
+    apr_size_t n = 0;
+    int i;
+
+    APR_ASSERT_SUCCESS(tc, "open for reading",
+                       apr_file_open(&f, APPENDER_FILENAME,
+                                     APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                                     0, p));
+    while (apr_file_read_full(f, rec, RECORD_LEN, NULL) == APR_SUCCESS) {
+        rec[RECORD_LEN] = '\0';
+        i = rec[0] - 'a';
+        ABTS_ASSERT(tc, "record from a known writer",
+                    i >= 0 && i < NUM_THREADS);
+        if (i < 0 || i >= NUM_THREADS) {
+            break;
+        }
+        /* each writer's records come out whole and in its order */
+        ABTS_INT_EQUAL(tc, next[i], (int)apr_atoi64(rec + 1));
+        ABTS_INT_EQUAL(tc, '\n', rec[RECORD_LEN - 1]);
+        next[i]++;
+        n++;
+    }
+    apr_file_close(f);
+
+    ABTS_SIZE_EQUAL(tc, expected, n);
+}
+
+static void run_writers(abts_case *tc, apr_int32_t flags, apr_size_t bufsize)
+{
+    apr_file_appender_t *ap;
+    apr_thread_t *thd[NUM_THREADS];
+    writer_t w[NUM_THREADS];
+    apr_status_t rv;
+    apr_file_t *f;
+    int i;
+
+    f = open_log(tc, p);
+    APR_ASSERT_SUCCESS(tc, "create appender",
+                       apr_file_appender_create(&ap, f, bufsize, flags, p));
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        w[i].ap = ap;
+        w[i].id = 'a' + i;
+        APR_ASSERT_SUCCESS(tc, "create writer",
+                           apr_thread_create(&thd[i], NULL, writer, &w[i], p));
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        apr_thread_join(&rv, thd[i]);
+        APR_ASSERT_SUCCESS(tc, "writer thread", rv);
+    }
+
+    APR_ASSERT_SUCCESS(tc, "destroy appender", apr_file_appender_destroy(ap));
+    apr_file_close(f);
+
+    check_records(tc, NUM_THREADS * NUM_RECORDS);
+}
+
+static void test_threads(abts_case *tc, void *data)
+{
+    run_writers(tc, 0, 0);
+}
+
+static void test_threads_datasync(abts_case *tc, void *data)
+{
+    /* a small buffer, for writers to wait for the batches to swap */
+    run_writers(tc, APR_FILE_APPENDER_DATASYNC, 256);
+}
+
+static void test_tickets(abts_case *tc, void *data)
+{
+    apr_file_appender_t *ap;
+    apr_uint64_t t1, t2, t3;
+    apr_finfo_t finfo;
+    struct iovec vec[3];
+    char big[1000];
+    apr_file_t *f;
+
+    memset(big, 'x', sizeof(big));
+    f = open_log(tc, p);
+    APR_ASSERT_SUCCESS(tc, "create appender",
+                       apr_file_appender_create(&ap, f, 1024,
+                                                APR_FILE_APPENDER_DATASYNC, p));
+
+    APR_ASSERT_SUCCESS(tc, "write record",
+                       apr_file_appender_write(ap, "hello\n", 6, &t1));
+    ABTS_TRUE(tc, t1 == 6);
+
+    vec[0].iov_base = "split ";
+    vec[0].iov_len = 6;
+    vec[1].iov_base = "record";
+    vec[1].iov_len = 6;
+    vec[2].iov_base = "\n";
+    vec[2].iov_len = 1;
+    APR_ASSERT_SUCCESS(tc, "writev record",
+                       apr_file_appender_writev(ap, vec, 3, &t2));
+    ABTS_TRUE(tc, t2 == 19);
+
+    APR_ASSERT_SUCCESS(tc, "wait for record", apr_file_appender_wait(ap, t2));
+    APR_ASSERT_SUCCESS(tc, "stat file",
+                       apr_stat(&finfo, APPENDER_FILENAME, APR_FINFO_SIZE, p));
+    ABTS_TRUE(tc, finfo.size >= 19);
+
+    /* a large record is written from our memory before returning */
+    APR_ASSERT_SUCCESS(tc, "write large record",
+                       apr_file_appender_write(ap, big, sizeof(big), &t3));
+    ABTS_TRUE(tc, t3 == 19 + sizeof(big));
+    APR_ASSERT_SUCCESS(tc, "stat file",
+                       apr_stat(&finfo, APPENDER_FILENAME, APR_FINFO_SIZE, p));
+    ABTS_TRUE(tc, finfo.size == 19 + sizeof(big));
+
+    APR_ASSERT_SUCCESS(tc, "write record",
+                       apr_file_appender_write(ap, "bye\n", 4, NULL));
+    APR_ASSERT_SUCCESS(tc, "flush", apr_file_appender_flush(ap));
+    APR_ASSERT_SUCCESS(tc, "stat file",
+                       apr_stat(&finfo, APPENDER_FILENAME, APR_FINFO_SIZE, p));
+    ABTS_TRUE(tc, finfo.size == 23 + sizeof(big));
+
+    APR_ASSERT_SUCCESS(tc, "destroy appender", apr_file_appender_destroy(ap));
+    apr_file_close(f);
+    apr_file_remove(APPENDER_FILENAME, p);
+}
+
+static void test_pool_cleanup(abts_case *tc, void *data)
+{
+    apr_file_appender_t *ap;
+    apr_pool_t *pool;
+    apr_file_t *f;
+    char rec[RECORD_LEN + 1];
+    int i;
+
+    APR_ASSERT_SUCCESS(tc, "create pool", apr_pool_create(&pool, p));
+    f = open_log(tc, pool);
+    APR_ASSERT_SUCCESS(tc, "create appender",
+                       apr_file_appender_create(&ap, f, 256, 0, pool));
+
+    for (i = 0; i < NUM_RECORDS; i++) {
+        apr_snprintf(rec, sizeof(rec), "a%014d\n", i);
+        APR_ASSERT_SUCCESS(tc, "write record",
+                           apr_file_appender_write(ap, rec, RECORD_LEN,
+                                                   NULL));
+    }
+
+    /* no apr_file_appender_destroy(): the pool stops the appender, which
+     * writes out what it accepted before the file is closed */
+    apr_pool_destroy(pool);
+
+    check_records(tc, NUM_RECORDS);
+    apr_file_remove(APPENDER_FILENAME, p);
+}
+
+#else
+
+static void not_impl(abts_case *tc, void *data)
+{
+    ABTS_NOT_IMPL(tc, "apr_file_appender without threads");
+}
+
+#endif
+
+abts_suite *testfileappender(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_threads, NULL);
+    abts_run_test(suite, test_threads_datasync, NULL);
+    abts_run_test(suite, test_tickets, NULL);
+    abts_run_test(suite, test_pool_cleanup, NULL);
+#else
+    abts_run_test(suite, not_impl, NULL);
+#endif
+
+    return suite;
+}
@@ -21,8 +21,13 @@
 #include "apr_general.h"
 #include "apr_poll.h"
 #include "apr_lib.h"
+#include "apr_stat_cache.h"
 #include "testutil.h"
 
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #define FILENAME "data/file_datafile.txt"
 #define NEWFILENAME "data/new_datafile.txt"
 #define NEWFILEDATA "This is new text in a new file."
@@ -248,6 +253,230 @@ static void test_mtime_set(abts_case *tc, void *data)
     apr_file_close(thefile);
 }
 
+static void test_stat_cache(abts_case *tc, void *data)
+{
+    apr_stat_cache_t *cache;
+    apr_stat_cache_stats_t stats;
+    apr_finfo_t finfo, cached;
+    char name[32];
+    apr_status_t rv;
+    int i;
+
+    rv = apr_stat_cache_create(&cache, 4, apr_time_from_sec(3600),
+                               APR_STAT_CACHE_TTL_ONLY, p);
+    APR_ASSERT_SUCCESS(tc, "create stat cache", rv);
+    ABTS_STR_EQUAL(tc, "ttl", apr_stat_cache_method_name(cache));
+
+    rv = apr_stat(&finfo, FILENAME, APR_FINFO_NORM, p);
+    APR_ASSERT_SUCCESS(tc, "stat file", rv);
+    for (i = 0; i < 2; i++) {
+        rv = apr_stat_cache_stat(cache, &cached, FILENAME, APR_FINFO_NORM, p);
+        APR_ASSERT_SUCCESS(tc, "stat file through the cache", rv);
+        finfo_equal(tc, &finfo, &cached);
+        ABTS_STR_EQUAL(tc, FILENAME, cached.fname);
+    }
+
+    for (i = 0; i < 2; i++) {
+        rv = apr_stat_cache_stat(cache, &cached, "data/missing_file",
+                                 APR_FINFO_MIN, p);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_ENOENT(rv));
+    }
+
+    apr_stat_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.misses);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.entries);
+
+    /* A lstat() is not answered by a stat() */
+    rv = apr_stat_cache_stat(cache, &cached, FILENAME,
+                             APR_FINFO_MIN | APR_FINFO_LINK, p);
+    APR_ASSERT_SUCCESS(tc, "lstat file through the cache", rv);
+    apr_stat_cache_invalidate(cache, FILENAME);
+    rv = apr_stat_cache_stat(cache, &cached, FILENAME, APR_FINFO_MIN, p);
+    APR_ASSERT_SUCCESS(tc, "stat invalidated file", rv);
+    apr_stat_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 4, (int)stats.misses);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.invalidations);
+
+    /* The four slots of the single set are full, more names evict */
+    for (i = 0; i < 4; i++) {
+        apr_snprintf(name, sizeof(name), "data/missing_file%d", i);
+        apr_stat_cache_stat(cache, &cached, name, APR_FINFO_MIN, p);
+    }
+    apr_stat_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 4, (int)stats.entries);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.evictions);
+
+    apr_stat_cache_clear(cache);
+    apr_stat_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.entries);
+
+    APR_ASSERT_SUCCESS(tc, "destroy stat cache",
+                       apr_stat_cache_destroy(cache));
+}
+
+/* Wait for the cache to notice a change */
+static void stat_cache_wait(apr_stat_cache_t *cache, apr_uint64_t seen)
+{
+    apr_stat_cache_stats_t stats;
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        apr_stat_cache_stats_get(cache, &stats);
+        if (stats.invalidations > seen) {
+            break;
+        }
+        apr_sleep(apr_time_from_msec(10));
+    }
+}
+
+static void test_stat_cache_notify(abts_case *tc, void *data)
+{
+    const char *fname = "data/statcache.txt";
+    const char *newname = "data/statcache_new.txt";
+    apr_stat_cache_t *cache;
+    apr_stat_cache_stats_t stats;
+    apr_finfo_t finfo;
+    apr_file_t *f;
+    apr_size_t len;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_stat_cache_create(&cache, 0, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create stat cache", rv);
+    if (strcmp(apr_stat_cache_method_name(cache), "inotify") != 0) {
+        ABTS_NOT_IMPL(tc, "stat cache change notification");
+        return;
+    }
+    apr_file_remove(newname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                       | APR_FOPEN_TRUNCATE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "create file", rv);
+    len = 1;
+    apr_file_write(f, "x", &len);
+    apr_file_close(f);
+
+    for (i = 0; i < 2; i++) {
+        rv = apr_stat_cache_stat(cache, &finfo, fname, APR_FINFO_SIZE, p);
+        APR_ASSERT_SUCCESS(tc, "stat file through the cache", rv);
+        ABTS_INT_EQUAL(tc, 1, (int)finfo.size);
+        rv = apr_stat_cache_stat(cache, &finfo, newname, APR_FINFO_SIZE, p);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_ENOENT(rv));
+    }
+    apr_stat_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.watches);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_WRITE | APR_FOPEN_APPEND,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open file", rv);
+    len = 10;
+    apr_file_write(f, "0123456789", &len);
+    apr_file_close(f);
+    stat_cache_wait(cache, stats.invalidations);
+
+    rv = apr_stat_cache_stat(cache, &finfo, fname, APR_FINFO_SIZE, p);
+    APR_ASSERT_SUCCESS(tc, "stat changed file", rv);
+    ABTS_INT_EQUAL(tc, 11, (int)finfo.size);
+
+    apr_stat_cache_stats_get(cache, &stats);
+    rv = apr_file_rename(fname, newname, p);
+    APR_ASSERT_SUCCESS(tc, "rename file", rv);
+    stat_cache_wait(cache, stats.invalidations);
+
+    rv = apr_stat_cache_stat(cache, &finfo, newname, APR_FINFO_SIZE, p);
+    APR_ASSERT_SUCCESS(tc, "stat renamed file", rv);
+    ABTS_INT_EQUAL(tc, 11, (int)finfo.size);
+    rv = apr_stat_cache_stat(cache, &finfo, fname, APR_FINFO_SIZE, p);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_ENOENT(rv));
+
+    apr_file_remove(newname, p);
+    APR_ASSERT_SUCCESS(tc, "destroy stat cache",
+                       apr_stat_cache_destroy(cache));
+}
+
+#if APR_HAVE_UNISTD_H
+static void stat_cache_release(abts_case *tc, const char *dir,
+                               const char *data)
+{
+    apr_file_t *f;
+    apr_size_t len = strlen(data);
+    apr_status_t rv;
+
+    rv = apr_dir_make_recursive(dir, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "make release directory", rv);
+    rv = apr_file_open(&f, apr_pstrcat(p, dir, "/file", NULL),
+                       APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                       | APR_FOPEN_TRUNCATE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "create release file", rv);
+    apr_file_write(f, data, &len);
+    apr_file_close(f);
+}
+
+/* Repointing a symlinked parent directory, as deployments do, is not
+ * seen by the watches but by the time to live.
+ */
+static void test_stat_cache_symlink(abts_case *tc, void *data)
+{
+    const char *link = "data/statcache_current";
+    const char *fname = "data/statcache_current/file";
+    apr_stat_cache_t *cache;
+    apr_finfo_t finfo;
+    apr_status_t rv;
+
+    stat_cache_release(tc, "data/statcache_r1", "x");
+    stat_cache_release(tc, "data/statcache_r2", "xy");
+    apr_file_remove(link, p);
+    if (symlink("statcache_r1", link) != 0) {
+        ABTS_NOT_IMPL(tc, "symbolic links");
+        return;
+    }
+
+    rv = apr_stat_cache_create(&cache, 0, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create stat cache", rv);
+    rv = apr_stat_cache_stat(cache, &finfo, fname, APR_FINFO_SIZE, p);
+    APR_ASSERT_SUCCESS(tc, "stat file through the cache", rv);
+    ABTS_INT_EQUAL(tc, 1, (int)finfo.size);
+
+    ABTS_INT_EQUAL(tc, 0, symlink("statcache_r2", "data/statcache_next"));
+    APR_ASSERT_SUCCESS(tc, "swap the link",
+                       apr_file_rename("data/statcache_next", link, p));
+
+    apr_sleep(APR_STAT_CACHE_DEFAULT_TTL + apr_time_from_msec(100));
+    rv = apr_stat_cache_stat(cache, &finfo, fname, APR_FINFO_SIZE, p);
+    APR_ASSERT_SUCCESS(tc, "stat file of the new release", rv);
+    ABTS_INT_EQUAL(tc, 2, (int)finfo.size);
+
+    APR_ASSERT_SUCCESS(tc, "destroy stat cache",
+                       apr_stat_cache_destroy(cache));
+    apr_file_remove(link, p);
+    apr_file_remove("data/statcache_r1/file", p);
+    apr_file_remove("data/statcache_r2/file", p);
+    apr_dir_remove("data/statcache_r1", p);
+    apr_dir_remove("data/statcache_r2", p);
+}
+#endif
+
+static void test_stat_cache_pool(abts_case *tc, void *data)
+{
+    apr_stat_cache_t *cache;
+    apr_finfo_t finfo;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    APR_ASSERT_SUCCESS(tc, "create pool", apr_pool_create(&pool, p));
+    rv = apr_stat_cache_create(&cache, 0, 0, 0, pool);
+    APR_ASSERT_SUCCESS(tc, "create stat cache", rv);
+    rv = apr_stat_cache_stat(cache, &finfo, FILENAME, APR_FINFO_MIN, pool);
+    APR_ASSERT_SUCCESS(tc, "stat file through the cache", rv);
+
+    /* no apr_stat_cache_destroy(): the pool stops the cache and its
+     * notification thread, if any */
+    apr_pool_destroy(pool);
+}
+
 abts_suite *testfileinfo(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -257,6 +486,12 @@ abts_suite *testfileinfo(abts_suite *suite)
     abts_run_test(suite, test_stat_eq_finfo, NULL);
     abts_run_test(suite, test_buffered_write_size, NULL);
     abts_run_test(suite, test_mtime_set, NULL);
+    abts_run_test(suite, test_stat_cache, NULL);
+    abts_run_test(suite, test_stat_cache_notify, NULL);
+#if APR_HAVE_UNISTD_H
+    abts_run_test(suite, test_stat_cache_symlink, NULL);
+#endif
+    abts_run_test(suite, test_stat_cache_pool, NULL);
 
     return suite;
 }
@@ -19,11 +19,18 @@
 #include "apr_thread_mutex.h"
 #include "apr_thread_rwlock.h"
 #include "apr_thread_cond.h"
+#include "apr_global_mutex.h"
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_getopt.h"
+#include "apr_lock_profile.h"
+#include "apr_strings.h"
 #include "testutil.h"
 
+#if APR_HAVE_TIME_H
+#include <time.h>
+#endif
+
 #if APR_HAS_THREADS
 
 #define MAX_ITER 40000
@@ -153,8 +160,10 @@ static void test_thread_mutex(abts_case *tc, void *data)
 {
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
+    unsigned int flags = data ? *(unsigned int *)data
+                              : APR_THREAD_MUTEX_DEFAULT;
 
-    s1 = apr_thread_mutex_create(&thread_mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    s1 = apr_thread_mutex_create(&thread_mutex, flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s1);
     ABTS_PTR_NOTNULL(tc, thread_mutex);
 
@@ -183,7 +192,12 @@ static void test_thread_rwlock(abts_case *tc, void *data)
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
 
-    s1 = apr_thread_rwlock_create(&rwlock, p);
+    if (data) {
+        s1 = apr_thread_rwlock_create_ex(&rwlock, *(unsigned int *)data, p);
+    }
+    else {
+        s1 = apr_thread_rwlock_create(&rwlock, p);
+    }
     if (s1 == APR_ENOTIMPL) {
         ABTS_NOT_IMPL(tc, "rwlocks not implemented");
         return;
@@ -213,6 +227,33 @@ static void test_thread_rwlock(abts_case *tc, void *data)
     apr_thread_rwlock_destroy(rwlock);
 }
 
+static void test_thread_rwlock_try(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+
+    rv = apr_thread_rwlock_create_ex(&rwlock, *(unsigned int *)data, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "rwlock flags not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "rwlock_create_ex", rv);
+
+    APR_ASSERT_SUCCESS(tc, "rdlock", apr_thread_rwlock_rdlock(rwlock));
+    rv = apr_thread_rwlock_trywrlock(rwlock);
+    ABTS_ASSERT(tc, "trywrlock while read locked", APR_STATUS_IS_EBUSY(rv));
+    APR_ASSERT_SUCCESS(tc, "unlock read", apr_thread_rwlock_unlock(rwlock));
+
+    APR_ASSERT_SUCCESS(tc, "wrlock", apr_thread_rwlock_wrlock(rwlock));
+    rv = apr_thread_rwlock_tryrdlock(rwlock);
+    ABTS_ASSERT(tc, "tryrdlock while write locked", APR_STATUS_IS_EBUSY(rv));
+    APR_ASSERT_SUCCESS(tc, "unlock write", apr_thread_rwlock_unlock(rwlock));
+
+    APR_ASSERT_SUCCESS(tc, "trywrlock", apr_thread_rwlock_trywrlock(rwlock));
+    APR_ASSERT_SUCCESS(tc, "unlock write", apr_thread_rwlock_unlock(rwlock));
+
+    apr_thread_rwlock_destroy(rwlock);
+}
+
 static void test_cond(abts_case *tc, void *data)
 {
     apr_thread_t *p1, *p2, *p3, *p4, *c1;
@@ -305,6 +346,267 @@ static void test_timeoutcond(abts_case *tc, void *data)
                        apr_thread_cond_destroy(timeout_cond));
 }
 
+static void *APR_THREAD_FUNC thread_profile_function(apr_thread_t *thd,
+                                                    void *data)
+{
+    apr_thread_mutex_lock(thread_mutex);
+    apr_thread_mutex_unlock(thread_mutex);
+    return NULL;
+}
+
+static const apr_lock_profile_info_t *find_profile(apr_array_header_t *arr,
+                                                   const void *lock)
+{
+    int n;
+
+    for (n = 0; n < arr->nelts; n++) {
+        if (APR_ARRAY_IDX(arr, n, apr_lock_profile_info_t).lock == lock) {
+            return &APR_ARRAY_IDX(arr, n, apr_lock_profile_info_t);
+        }
+    }
+    return NULL;
+}
+
+static void test_lock_profile(abts_case *tc, void *data)
+{
+    apr_thread_mutex_t *nested;
+    apr_thread_rwlock_t *rwl;
+    apr_thread_cond_t *cond;
+    apr_thread_t *t;
+    apr_array_header_t *arr;
+    const apr_lock_profile_info_t *info;
+    apr_file_t *f;
+    apr_off_t off = 0;
+    char buf[1024];
+    apr_size_t len;
+    apr_uint64_t holds;
+    apr_status_t rv;
+    int n;
+
+    apr_lock_profile_enable(1);
+    APR_ASSERT_SUCCESS(tc, "create mutex",
+                       apr_thread_mutex_create(&thread_mutex,
+                                               APR_THREAD_MUTEX_DEFAULT, p));
+    APR_ASSERT_SUCCESS(tc, "name the next lock",
+                       apr_lock_profile_name_next("testnested"));
+    APR_ASSERT_SUCCESS(tc, "create nested mutex",
+                       apr_thread_mutex_create(&nested,
+                                               APR_THREAD_MUTEX_NESTED, p));
+    APR_ASSERT_SUCCESS(tc, "create cond", apr_thread_cond_create(&cond, p));
+    rv = apr_thread_rwlock_create(&rwl, p);
+    apr_lock_profile_enable(0);
+    if (rv == APR_ENOTIMPL) {
+        rwl = NULL;
+    }
+
+    rv = apr_lock_profile_name_set(thread_mutex, "testmutex");
+    if (rv == APR_NOTFOUND) {
+        ABTS_NOT_IMPL(tc, "lock profiling not implemented");
+        apr_thread_mutex_destroy(thread_mutex);
+        apr_thread_mutex_destroy(nested);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "name the mutex", rv);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_lock_profile_name_set(&rv, "none"));
+
+    for (n = 0; n < 10; n++) {
+        apr_thread_mutex_lock(thread_mutex);
+        apr_thread_mutex_unlock(thread_mutex);
+    }
+    for (n = 0; n < 3; n++) {
+        apr_thread_mutex_lock(nested);
+    }
+    apr_sleep(apr_time_from_msec(10));
+    for (n = 0; n < 3; n++) {
+        apr_thread_mutex_unlock(nested);
+    }
+    if (rwl) {
+        for (n = 0; n < 5; n++) {
+            apr_thread_rwlock_rdlock(rwl);
+            apr_thread_rwlock_unlock(rwl);
+        }
+        for (n = 0; n < 3; n++) {
+            apr_thread_rwlock_wrlock(rwl);
+            apr_thread_rwlock_unlock(rwl);
+        }
+    }
+    apr_thread_mutex_lock(thread_mutex);
+    rv = apr_thread_cond_timedwait(cond, thread_mutex, 1000);
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, rv);
+    apr_thread_mutex_unlock(thread_mutex);
+
+    /* one contended acquisition */
+    apr_thread_mutex_lock(thread_mutex);
+    APR_ASSERT_SUCCESS(tc, "create thread",
+                       apr_thread_create(&t, NULL, thread_profile_function,
+                                         NULL, p));
+    apr_sleep(apr_time_from_msec(20));
+    apr_thread_mutex_unlock(thread_mutex);
+    apr_thread_join(&rv, t);
+
+    APR_ASSERT_SUCCESS(tc, "get profiles", apr_lock_profile_get(&arr, p));
+
+    info = find_profile(arr, thread_mutex);
+    ABTS_PTR_NOTNULL(tc, info);
+    if (info) {
+        ABTS_STR_EQUAL(tc, "thread_mutex", info->type);
+        ABTS_STR_EQUAL(tc, "testmutex", info->name);
+        /* 10 + 1 + reacquired after the wait + 2 */
+        ABTS_INT_EQUAL(tc, 14, (int)info->acquired);
+        ABTS_INT_EQUAL(tc, 1, (int)info->contended);
+        ABTS_ASSERT(tc, "waited for the mutex",
+                    info->wait_max >= apr_time_from_msec(10));
+        for (holds = 0, n = 0; n < APR_LOCK_PROFILE_BUCKETS; n++) {
+            holds += info->hold_hist[n];
+        }
+        ABTS_INT_EQUAL(tc, 14, (int)holds);
+        ABTS_ASSERT(tc, "held the mutex",
+                    info->hold_total >= apr_time_from_msec(10) * 1000);
+    }
+
+    /* the nested holds count as one, of their whole duration */
+    info = find_profile(arr, nested);
+    ABTS_PTR_NOTNULL(tc, info);
+    if (info) {
+        ABTS_STR_EQUAL(tc, "testnested", info->name);
+        ABTS_INT_EQUAL(tc, 3, (int)info->acquired);
+        for (holds = 0, n = 0; n < APR_LOCK_PROFILE_BUCKETS; n++) {
+            holds += info->hold_hist[n];
+        }
+        ABTS_INT_EQUAL(tc, 1, (int)holds);
+        ABTS_ASSERT(tc, "held the nested mutex",
+                    info->hold_total >= apr_time_from_msec(10) * 1000);
+    }
+
+    info = find_profile(arr, cond);
+    ABTS_PTR_NOTNULL(tc, info);
+    if (info) {
+        ABTS_STR_EQUAL(tc, "thread_cond", info->type);
+        ABTS_INT_EQUAL(tc, 1, (int)info->acquired);
+        ABTS_INT_EQUAL(tc, 1, (int)info->contended);
+    }
+
+    if (rwl) {
+        info = find_profile(arr, rwl);
+        ABTS_PTR_NOTNULL(tc, info);
+        if (info) {
+            ABTS_INT_EQUAL(tc, 8, (int)info->acquired);
+            ABTS_INT_EQUAL(tc, 0, (int)info->contended);
+            for (holds = 0, n = 0; n < APR_LOCK_PROFILE_BUCKETS; n++) {
+                holds += info->hold_hist[n];
+            }
+            ABTS_INT_EQUAL(tc, 3, (int)holds);
+        }
+    }
+
+    /* the contended mutex is the hottest lock */
+    rv = apr_file_open(&f, "data/lockprofile.txt",
+                       APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE | APR_FOPEN_DELONCLOSE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open dump file", rv);
+    APR_ASSERT_SUCCESS(tc, "dump profiles", apr_lock_profile_dump(f, p));
+    apr_file_seek(f, APR_SET, &off);
+    len = sizeof(buf) - 1;
+    apr_file_read(f, buf, &len);
+    buf[len] = '\0';
+    ABTS_ASSERT(tc, "dump starts with the mutex",
+                strncmp(buf, "thread_mutex  testmutex ", 24) == 0);
+    apr_file_close(f);
+
+    apr_lock_profile_reset();
+    APR_ASSERT_SUCCESS(tc, "get profiles", apr_lock_profile_get(&arr, p));
+    info = find_profile(arr, thread_mutex);
+    ABTS_PTR_NOTNULL(tc, info);
+    if (info) {
+        ABTS_INT_EQUAL(tc, 0, (int)info->acquired);
+    }
+
+    apr_thread_mutex_destroy(thread_mutex);
+    apr_thread_mutex_destroy(nested);
+    apr_thread_cond_destroy(cond);
+    if (rwl) {
+        apr_thread_rwlock_destroy(rwl);
+    }
+    APR_ASSERT_SUCCESS(tc, "get profiles", apr_lock_profile_get(&arr, p));
+    ABTS_PTR_EQUAL(tc, NULL, find_profile(arr, cond));
+}
+
+static void test_lock_profile_global(abts_case *tc, void *data)
+{
+    apr_global_mutex_t *global;
+    apr_array_header_t *arr;
+    const apr_lock_profile_info_t *info;
+    apr_status_t rv;
+
+    apr_lock_profile_enable(1);
+    APR_ASSERT_SUCCESS(tc, "name the next lock",
+                       apr_lock_profile_name_next("testglobal"));
+    rv = apr_global_mutex_create(&global, "data/testlockprofile.lock",
+                                 APR_LOCK_DEFAULT, p);
+    apr_lock_profile_enable(0);
+    APR_ASSERT_SUCCESS(tc, "create global mutex", rv);
+
+    apr_global_mutex_lock(global);
+    apr_global_mutex_unlock(global);
+
+    APR_ASSERT_SUCCESS(tc, "get profiles", apr_lock_profile_get(&arr, p));
+    info = find_profile(arr, global);
+    if (!info) {
+        ABTS_NOT_IMPL(tc, "lock profiling not implemented");
+    }
+    else {
+        /* reported as a whole, under its name */
+        ABTS_STR_EQUAL(tc, "global_mutex", info->type);
+        ABTS_STR_EQUAL(tc, "testglobal", info->name);
+        ABTS_INT_EQUAL(tc, 1, (int)info->acquired);
+    }
+
+    apr_global_mutex_destroy(global);
+}
+
+static void test_lock_profile_nsec(abts_case *tc, void *data)
+{
+    apr_array_header_t *arr;
+    const apr_lock_profile_info_t *info;
+    apr_thread_mutex_t *mutex;
+    apr_uint64_t holds;
+    int n;
+
+    apr_lock_profile_enable(1);
+    APR_ASSERT_SUCCESS(tc, "create mutex",
+                       apr_thread_mutex_create(&mutex,
+                                               APR_THREAD_MUTEX_DEFAULT, p));
+    apr_lock_profile_enable(0);
+
+    for (n = 0; n < 100; n++) {
+        apr_thread_mutex_lock(mutex);
+        apr_thread_mutex_unlock(mutex);
+    }
+
+    APR_ASSERT_SUCCESS(tc, "get profiles", apr_lock_profile_get(&arr, p));
+    info = find_profile(arr, mutex);
+    if (!info) {
+        ABTS_NOT_IMPL(tc, "lock profiling not implemented");
+    }
+    else {
+        for (holds = 0, n = 0; n < APR_LOCK_PROFILE_BUCKETS; n++) {
+            holds += info->hold_hist[n];
+        }
+        ABTS_INT_EQUAL(tc, 100, (int)holds);
+#ifdef CLOCK_MONOTONIC
+        /* holds of some nanoseconds, not whole microseconds (which
+         * would all go to bucket 0 or from bucket 10) */
+        for (holds = 0, n = 1; n < 10; n++) {
+            holds += info->hold_hist[n];
+        }
+        ABTS_ASSERT(tc, "sub-microsecond holds", holds > 0);
+#endif
+    }
+
+    apr_thread_mutex_destroy(mutex);
+}
+
 #endif /* !APR_HAS_THREADS */
 
 #if !APR_HAS_THREADS
@@ -317,15 +619,32 @@ static void threads_not_impl(abts_case *tc, void *data)
 
 abts_suite *testlock(abts_suite *suite)
 {
+#if APR_HAS_THREADS
+    static unsigned int mutex_spin = APR_THREAD_MUTEX_SPIN;
+    static unsigned int rwlock_spin = APR_THREAD_RWLOCK_SPIN;
+    static unsigned int rwlock_percpu = APR_THREAD_RWLOCK_PERCPU
+                                        | APR_THREAD_RWLOCK_SPIN;
+    static unsigned int rwlock_writer = APR_THREAD_RWLOCK_PREFER_WRITER;
+#endif
+
     suite = ADD_SUITE(suite)
 
 #if !APR_HAS_THREADS
     abts_run_test(suite, threads_not_impl, NULL);
 #else
     abts_run_test(suite, test_thread_mutex, NULL);
+    abts_run_test(suite, test_thread_mutex, &mutex_spin);
     abts_run_test(suite, test_thread_rwlock, NULL);
+    abts_run_test(suite, test_thread_rwlock, &rwlock_spin);
+    abts_run_test(suite, test_thread_rwlock, &rwlock_percpu);
+    abts_run_test(suite, test_thread_rwlock_try, &rwlock_spin);
+    abts_run_test(suite, test_thread_rwlock_try, &rwlock_percpu);
+    abts_run_test(suite, test_thread_rwlock_try, &rwlock_writer);
     abts_run_test(suite, test_cond, NULL);
     abts_run_test(suite, test_timeoutcond, NULL);
+    abts_run_test(suite, test_lock_profile, NULL);
+    abts_run_test(suite, test_lock_profile_global, NULL);
+    abts_run_test(suite, test_lock_profile_nsec, NULL);
 #endif
 
     return suite;
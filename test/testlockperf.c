@@ -17,6 +17,9 @@
 #include "apr_thread_proc.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_rwlock.h"
+#include "apr_proc_mutex.h"
+#include "apr_shm.h"
+#include "apr_strings.h"
 #include "apr_file_io.h"
 #include "apr_errno.h"
 #include "apr_general.h"
@@ -36,21 +39,32 @@ int main(void)
 #else /* !APR_HAS_THREADS */
 
 #define DEFAULT_MAX_COUNTER 1000000
+#define DEFAULT_PROC_COUNTER 100000
 #define MAX_THREADS 6
 
 static int verbose = 0;
 static long mutex_counter;
 static long max_counter = DEFAULT_MAX_COUNTER;
+static long proc_counter = DEFAULT_PROC_COUNTER;
 
 static apr_thread_mutex_t *thread_lock;
 void * APR_THREAD_FUNC thread_mutex_func(apr_thread_t *thd, void *data);
-apr_status_t test_thread_mutex(int num_threads); /* apr_thread_mutex_t */
+apr_status_t test_thread_mutex(int num_threads, unsigned int flags,
+                               const char *desc); /* apr_thread_mutex_t */
 
 static apr_thread_rwlock_t *thread_rwlock;
 void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data);
-apr_status_t test_thread_rwlock(int num_threads); /* apr_thread_rwlock_t */
-
-int test_thread_mutex_nested(int num_threads);
+void * APR_THREAD_FUNC thread_rwlock_read_func(apr_thread_t *thd, void *data);
+apr_status_t test_thread_rwlock(int num_threads, unsigned int flags,
+                                int read_mostly,
+                                const char *desc); /* apr_thread_rwlock_t */
+
+#if APR_HAS_FORK
+static apr_proc_mutex_t *proc_lock;
+static volatile long *proc_mutex_counter;
+apr_status_t test_proc_mutex(int num_procs, apr_lockmech_e mech,
+                             const char *mechname); /* apr_proc_mutex_t */
+#endif
 
 apr_pool_t *pool;
 int i = 0, x = 0;
@@ -79,18 +93,46 @@ void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data)
     return NULL;
 }
 
-int test_thread_mutex(int num_threads)
+/* One write for every 100 reads */
+void * APR_THREAD_FUNC thread_rwlock_read_func(apr_thread_t *thd, void *data)
+{
+    int i;
+
+    for (i = 0; i < max_counter; i++) {
+        if (i % 100) {
+            apr_thread_rwlock_rdlock(thread_rwlock);
+        }
+        else {
+            apr_thread_rwlock_wrlock(thread_rwlock);
+            mutex_counter++;
+        }
+        apr_thread_rwlock_unlock(thread_rwlock);
+    }
+    return NULL;
+}
+
+static void report(apr_time_t elapsed, long ops)
+{
+    printf("microseconds: %" APR_INT64_T_FMT " usec (%" APR_INT64_T_FMT
+           " nsec/op)\n", elapsed, ops ? elapsed * 1000 / ops : 0);
+}
+
+apr_status_t test_thread_mutex(int num_threads, unsigned int flags,
+                               const char *desc)
 {
     apr_thread_t *t[MAX_THREADS];
     apr_status_t s[MAX_THREADS];
     apr_time_t time_start, time_stop;
+    char msg[80];
     int i;
 
     mutex_counter = 0;
 
     printf("apr_thread_mutex_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_mutex_t (UNNESTED)");
-    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_UNNESTED, pool);
+    apr_snprintf(msg, sizeof msg,
+                 "    Initializing the apr_thread_mutex_t (%s)", desc);
+    printf("%-60s", msg);
+    s[0] = apr_thread_mutex_create(&thread_lock, flags, pool);
     if (s[0] != APR_SUCCESS) {
         printf("Failed!\n");
         return s[0];
@@ -119,37 +161,48 @@ int test_thread_mutex(int num_threads)
     /* printf("OK\n"); */
 
     time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
+    report(time_stop - time_start, max_counter * num_threads);
     if (mutex_counter != max_counter * num_threads)
         printf("error: counter = %ld\n", mutex_counter);
+    apr_thread_mutex_destroy(thread_lock);
 
     return APR_SUCCESS;
 }
 
-int test_thread_mutex_nested(int num_threads)
+apr_status_t test_thread_rwlock(int num_threads, unsigned int flags,
+                                int read_mostly, const char *desc)
 {
     apr_thread_t *t[MAX_THREADS];
     apr_status_t s[MAX_THREADS];
     apr_time_t time_start, time_stop;
+    char msg[80];
+    long expected;
     int i;
 
     mutex_counter = 0;
 
-    printf("apr_thread_mutex_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_mutex_t (NESTED)");
-    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_NESTED, pool);
+    printf("apr_thread_rwlock_t Tests\n");
+    apr_snprintf(msg, sizeof msg,
+                 "    Initializing the apr_thread_rwlock_t (%s)", desc);
+    printf("%-60s", msg);
+    s[0] = apr_thread_rwlock_create_ex(&thread_rwlock, flags, pool);
+    if (s[0] == APR_ENOTIMPL) {
+        printf("Not implemented\n");
+        return APR_SUCCESS;
+    }
     if (s[0] != APR_SUCCESS) {
         printf("Failed!\n");
         return s[0];
     }
     printf("OK\n");
 
-    apr_thread_mutex_lock(thread_lock);
+    apr_thread_rwlock_wrlock(thread_rwlock);
     /* set_concurrency(4)? -aaron */
     printf("    Starting %d threads    ", num_threads); 
     for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_mutex_func, NULL, pool);
+        s[i] = apr_thread_create(&t[i], NULL, read_mostly
+                                 ? thread_rwlock_read_func
+                                 : thread_rwlock_func, NULL, pool);
         if (s[i] != APR_SUCCESS) {
             printf("Failed!\n");
             return s[i];
@@ -158,7 +211,7 @@ int test_thread_mutex_nested(int num_threads)
     printf("OK\n");
 
     time_start = apr_time_now();
-    apr_thread_mutex_unlock(thread_lock);
+    apr_thread_rwlock_unlock(thread_rwlock);
 
     /* printf("%-60s", "    Waiting for threads to exit"); */
     for (i = 0; i < num_threads; ++i) {
@@ -167,61 +220,91 @@ int test_thread_mutex_nested(int num_threads)
     /* printf("OK\n"); */
 
     time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
+    report(time_stop - time_start, max_counter * num_threads);
+    expected = read_mostly ? (max_counter + 99) / 100 * num_threads
+                           : max_counter * num_threads;
+    if (mutex_counter != expected)
         printf("error: counter = %ld\n", mutex_counter);
+    apr_thread_rwlock_destroy(thread_rwlock);
 
     return APR_SUCCESS;
 }
 
-int test_thread_rwlock(int num_threads)
+#if APR_HAS_FORK
+apr_status_t test_proc_mutex(int num_procs, apr_lockmech_e mech,
+                             const char *mechname)
 {
-    apr_thread_t *t[MAX_THREADS];
-    apr_status_t s[MAX_THREADS];
+    apr_proc_t p[MAX_THREADS];
+    apr_shm_t *shm;
     apr_time_t time_start, time_stop;
+    apr_status_t rv;
+    char msg[80];
     int i;
 
-    mutex_counter = 0;
-
-    printf("apr_thread_rwlock_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_rwlock_t");
-    s[0] = apr_thread_rwlock_create(&thread_rwlock, pool);
-    if (s[0] != APR_SUCCESS) {
+    printf("apr_proc_mutex_t Tests\n");
+    apr_snprintf(msg, sizeof msg,
+                 "    Initializing the apr_proc_mutex_t (%s)", mechname);
+    printf("%-60s", msg);
+    rv = apr_proc_mutex_create(&proc_lock, NULL, mech, pool);
+    if (rv == APR_ENOTIMPL) {
+        printf("Not implemented\n");
+        return APR_SUCCESS;
+    }
+    if (rv != APR_SUCCESS) {
         printf("Failed!\n");
-        return s[0];
+        return rv;
     }
+    rv = apr_shm_create(&shm, sizeof(long), NULL, pool);
+    if (rv != APR_SUCCESS) {
+        printf("Failed!\n");
+        return rv;
+    }
+    proc_mutex_counter = apr_shm_baseaddr_get(shm);
+    *proc_mutex_counter = 0;
     printf("OK\n");
 
-    apr_thread_rwlock_wrlock(thread_rwlock);
-    /* set_concurrency(4)? -aaron */
-    printf("    Starting %d threads    ", num_threads); 
-    for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_rwlock_func, NULL, pool);
-        if (s[i] != APR_SUCCESS) {
+    apr_proc_mutex_lock(proc_lock);
+    printf("    Starting %d processes    ", num_procs); 
+    fflush(stdout);
+    for (i = 0; i < num_procs; ++i) {
+        rv = apr_proc_fork(&p[i], pool);
+        if (rv == APR_INCHILD) {
+            long n;
+
+            apr_initialize();
+            if (apr_proc_mutex_child_init(&proc_lock, NULL, pool))
+                exit(1);
+            for (n = 0; n < proc_counter; n++) {
+                apr_proc_mutex_lock(proc_lock);
+                (*proc_mutex_counter)++;
+                apr_proc_mutex_unlock(proc_lock);
+            }
+            exit(0);
+        }
+        if (rv != APR_INPARENT) {
             printf("Failed!\n");
-            return s[i];
+            return rv;
         }
     }
     printf("OK\n");
 
     time_start = apr_time_now();
-    apr_thread_rwlock_unlock(thread_rwlock);
+    apr_proc_mutex_unlock(proc_lock);
 
-    /* printf("%-60s", "    Waiting for threads to exit"); */
-    for (i = 0; i < num_threads; ++i) {
-        apr_thread_join(&s[i], t[i]);
+    for (i = 0; i < num_procs; ++i) {
+        apr_proc_wait(&p[i], NULL, NULL, APR_WAIT);
     }
-    /* printf("OK\n"); */
 
     time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
-        printf("error: counter = %ld\n", mutex_counter);
+    report(time_stop - time_start, proc_counter * num_procs);
+    if (*proc_mutex_counter != proc_counter * num_procs)
+        printf("error: counter = %ld\n", *proc_mutex_counter);
 
+    apr_shm_destroy(shm);
+    apr_proc_mutex_destroy(proc_lock);
     return APR_SUCCESS;
 }
+#endif
 
 int main(int argc, const char * const *argv)
 {
@@ -245,10 +328,13 @@ int main(int argc, const char * const *argv)
         exit(-1);
     }
         
-    while ((rv = apr_getopt(opt, "c:v", &optchar, &optarg)) == APR_SUCCESS) {
+    while ((rv = apr_getopt(opt, "c:p:v", &optchar, &optarg)) == APR_SUCCESS) {
         if (optchar == 'c') {
             max_counter = atol(optarg);
         }
+        else if (optchar == 'p') {
+            proc_counter = atol(optarg);
+        }
         else if (optchar == 'v') {
             verbose = 1;
         }
@@ -261,24 +347,78 @@ int main(int argc, const char * const *argv)
     }
 
     for (i = 1; i <= MAX_THREADS; ++i) {
-        if ((rv = test_thread_mutex(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_mutex test failed : [%d] %s\n",
-                    rv, apr_strerror(rv, (char*)errmsg, 200));
-            exit(-3);
+        static const struct {
+            unsigned int flags;
+            const char *desc;
+        } mutexes[] = {
+            { APR_THREAD_MUTEX_UNNESTED, "UNNESTED" },
+            { APR_THREAD_MUTEX_NESTED, "NESTED" },
+            { APR_THREAD_MUTEX_UNNESTED | APR_THREAD_MUTEX_SPIN,
+              "UNNESTED, SPIN" }
+        }, rwlocks[] = {
+            { APR_THREAD_RWLOCK_DEFAULT, "DEFAULT" },
+            { APR_THREAD_RWLOCK_SPIN, "SPIN" },
+            { APR_THREAD_RWLOCK_PREFER_WRITER, "PREFER_WRITER" },
+            { APR_THREAD_RWLOCK_PERCPU, "PERCPU" }
+        };
+        int m, read_mostly;
+
+        for (m = 0; m < sizeof(mutexes) / sizeof(mutexes[0]); ++m) {
+            if ((rv = test_thread_mutex(i, mutexes[m].flags,
+                                        mutexes[m].desc)) != APR_SUCCESS) {
+                fprintf(stderr,"thread_mutex (%s) test failed : [%d] %s\n",
+                        mutexes[m].desc, rv,
+                        apr_strerror(rv, (char*)errmsg, 200));
+                exit(-3);
+            }
         }
 
-        if ((rv = test_thread_mutex_nested(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_mutex (NESTED) test failed : [%d] %s\n",
-                    rv, apr_strerror(rv, (char*)errmsg, 200));
-            exit(-4);
+        for (read_mostly = 0; read_mostly <= 1; ++read_mostly) {
+            for (m = 0; m < sizeof(rwlocks) / sizeof(rwlocks[0]); ++m) {
+                char desc[80];
+
+                apr_snprintf(desc, sizeof desc, "%s%s", rwlocks[m].desc,
+                             read_mostly ? ", 1% writes" : "");
+                if ((rv = test_thread_rwlock(i, rwlocks[m].flags,
+                                             read_mostly, desc))
+                    != APR_SUCCESS) {
+                    fprintf(stderr,"thread_rwlock (%s) test failed : [%d] %s\n",
+                            desc, rv, apr_strerror(rv, (char*)errmsg, 200));
+                    exit(-6);
+                }
+            }
         }
+    }
 
-        if ((rv = test_thread_rwlock(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_rwlock test failed : [%d] %s\n",
-                    rv, apr_strerror(rv, (char*)errmsg, 200));
-            exit(-6);
+#if APR_HAS_FORK
+    {
+        static const struct {
+            apr_lockmech_e mech;
+            const char *name;
+        } mechs[] = {
+            { APR_LOCK_DEFAULT, "default" },
+            { APR_LOCK_FCNTL, "fcntl" },
+            { APR_LOCK_FLOCK, "flock" },
+            { APR_LOCK_SYSVSEM, "sysvsem" },
+            { APR_LOCK_POSIXSEM, "posixsem" },
+            { APR_LOCK_PROC_PTHREAD, "pthread" },
+            { APR_LOCK_FUTEX, "futex" }
+        };
+        int m;
+
+        for (i = 1; i <= MAX_THREADS; ++i) {
+            for (m = 0; m < sizeof(mechs) / sizeof(mechs[0]); ++m) {
+                if ((rv = test_proc_mutex(i, mechs[m].mech,
+                                          mechs[m].name)) != APR_SUCCESS) {
+                    fprintf(stderr,"proc_mutex (%s) test failed : [%d] %s\n",
+                            mechs[m].name, rv,
+                            apr_strerror(rv, (char*)errmsg, 200));
+                    exit(-7);
+                }
+            }
         }
     }
+#endif
 
     return 0;
 }
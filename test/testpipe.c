@@ -124,6 +124,122 @@ static void read_write_notimeout(abts_case *tc, void *data)
     ABTS_STR_EQUAL(tc, "this is a test", input);
 }
 
+#if APR_HAS_SPLICE
+static void splice_pipe(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *file, *readp1, *writep1, *readp2, *writep2, *readp3, *writep3;
+    char buf[64];
+    apr_size_t nbytes;
+
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp1, &writep1, p));
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp2, &writep2, p));
+
+    /* pipe to pipe */
+    nbytes = strlen("this is a test");
+    APR_ASSERT_SUCCESS(tc, "write", apr_file_write(writep1, "this is a test",
+                                                   &nbytes));
+    apr_file_close(writep1);
+    nbytes = sizeof(buf);
+    rv = apr_file_splice(writep2, readp1, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, strlen("this is a test"), nbytes);
+    nbytes = sizeof(buf);
+    rv = apr_file_splice(writep2, readp1, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, nbytes);
+
+    /* file to pipe */
+    APR_ASSERT_SUCCESS(tc, "open file",
+                       apr_file_open(&file, "data/file_datafile.txt",
+                                     APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, p));
+    nbytes = 4;
+    rv = apr_file_splice(writep2, file, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 4, nbytes);
+    apr_file_close(file);
+
+    nbytes = sizeof(buf) - 1;
+    APR_ASSERT_SUCCESS(tc, "read", apr_file_read(readp2, buf, &nbytes));
+    buf[nbytes] = '\0';
+    ABTS_STR_EQUAL(tc, "this is a testThis", buf);
+
+    /* a non-blocking pipe with nothing to read */
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp3, &writep3, p));
+    APR_ASSERT_SUCCESS(tc, "set timeout",
+                       apr_file_pipe_timeout_set(readp2, 0));
+    nbytes = sizeof(buf);
+    rv = apr_file_splice(writep3, readp2, &nbytes);
+    ABTS_ASSERT(tc, "should have gotten EAGAIN", APR_STATUS_IS_EAGAIN(rv));
+    APR_ASSERT_SUCCESS(tc, "set timeout",
+                       apr_file_pipe_timeout_set(readp2, 100000));
+    nbytes = sizeof(buf);
+    rv = apr_file_splice(writep3, readp2, &nbytes);
+    ABTS_ASSERT(tc, "should have timed out", APR_STATUS_IS_TIMEUP(rv));
+
+    apr_file_close(readp1);
+    apr_file_close(readp2);
+    apr_file_close(writep2);
+    apr_file_close(readp3);
+    apr_file_close(writep3);
+}
+
+static void tee_pipe(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *file, *readp1, *writep1, *readp2, *writep2;
+    char buf[64];
+    apr_size_t nbytes;
+
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp1, &writep1, p));
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp2, &writep2, p));
+
+    nbytes = strlen("this is a test");
+    APR_ASSERT_SUCCESS(tc, "write", apr_file_write(writep1, "this is a test",
+                                                   &nbytes));
+    nbytes = sizeof(buf);
+    rv = apr_file_tee(writep2, readp1, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, strlen("this is a test"), nbytes);
+
+    /* the data is in both pipes */
+    nbytes = sizeof(buf) - 1;
+    APR_ASSERT_SUCCESS(tc, "read", apr_file_read(readp1, buf, &nbytes));
+    buf[nbytes] = '\0';
+    ABTS_STR_EQUAL(tc, "this is a test", buf);
+    nbytes = sizeof(buf) - 1;
+    APR_ASSERT_SUCCESS(tc, "read", apr_file_read(readp2, buf, &nbytes));
+    buf[nbytes] = '\0';
+    ABTS_STR_EQUAL(tc, "this is a test", buf);
+
+    /* nothing to copy before the timeout */
+    APR_ASSERT_SUCCESS(tc, "set timeout",
+                       apr_file_pipe_timeout_set(readp1, 100000));
+    nbytes = sizeof(buf);
+    rv = apr_file_tee(writep2, readp1, &nbytes);
+    ABTS_ASSERT(tc, "should have timed out", APR_STATUS_IS_TIMEUP(rv));
+
+    /* pipes only */
+    APR_ASSERT_SUCCESS(tc, "open file",
+                       apr_file_open(&file, "data/file_datafile.txt",
+                                     APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, p));
+    nbytes = 4;
+    rv = apr_file_tee(writep2, file, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL, rv);
+    apr_file_close(file);
+
+    apr_file_close(readp1);
+    apr_file_close(writep1);
+    apr_file_close(readp2);
+    apr_file_close(writep2);
+}
+#endif
+
 static void test_pipe_writefull(abts_case *tc, void *data)
 {
     int iterations = 1000;
@@ -226,6 +342,10 @@ abts_suite *testpipe(abts_suite *suite)
     abts_run_test(suite, read_write, NULL);
     abts_run_test(suite, close_pipe, NULL);
     abts_run_test(suite, read_write_notimeout, NULL);
+#if APR_HAS_SPLICE
+    abts_run_test(suite, splice_pipe, NULL);
+    abts_run_test(suite, tee_pipe, NULL);
+#endif
     abts_run_test(suite, test_pipe_writefull, NULL);
     abts_run_test(suite, close_pipe, NULL);
     abts_run_test(suite, wait_pipe, NULL);
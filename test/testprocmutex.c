@@ -23,6 +23,9 @@
 #include "apr_getopt.h"
 #include <stdio.h>
 #include <stdlib.h>
+#if APR_HAVE_UNISTD_H
+#include <unistd.h> /* for _exit() */
+#endif
 #include "testutil.h"
 
 #if APR_HAS_FORK
@@ -148,6 +151,105 @@ static void test_exclusive(abts_case *tc, const char *lockname,
     ABTS_ASSERT(tc, "Locks don't appear to work with trylock",
                 *x == MAX_COUNTER);
 }
+
+static void test_timedlock(abts_case *tc, apr_lockmech_e mech)
+{
+    apr_proc_t child;
+    apr_status_t rv;
+
+    rv = apr_proc_mutex_create(&proc_lock, NULL, mech, p);
+    APR_ASSERT_SUCCESS(tc, "create the mutex", rv);
+    if (rv != APR_SUCCESS)
+        return;
+
+    rv = apr_proc_mutex_lock(proc_lock);
+    APR_ASSERT_SUCCESS(tc, "lock the mutex", rv);
+
+    rv = apr_proc_fork(&child, p);
+    if (rv == APR_INCHILD) {
+        apr_time_t start;
+
+        apr_initialize();
+        if (apr_proc_mutex_child_init(&proc_lock, NULL, p))
+            exit(1);
+
+        rv = apr_proc_mutex_timedlock(proc_lock, 0);
+        if (rv == APR_ENOTIMPL)
+            exit(2);
+        if (!APR_STATUS_IS_TIMEUP(rv))
+            exit(3);
+
+        start = apr_time_now();
+        rv = apr_proc_mutex_timedlock(proc_lock, apr_time_from_msec(20));
+        if (!APR_STATUS_IS_TIMEUP(rv))
+            exit(4);
+        if (apr_time_now() - start < apr_time_from_msec(15))
+            exit(5);
+
+        /* the parent lets go of the mutex once it sees this */
+        *x = 1;
+        rv = apr_proc_mutex_timedlock(proc_lock, apr_time_from_sec(10));
+        if (rv != APR_SUCCESS)
+            exit(6);
+        if (apr_proc_mutex_unlock(proc_lock))
+            exit(7);
+        exit(0);
+    }
+    ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+
+    *x = 0;
+    while (*x == 0) {
+        apr_sleep(1000);
+    }
+    rv = apr_proc_mutex_unlock(proc_lock);
+    APR_ASSERT_SUCCESS(tc, "unlock the mutex", rv);
+
+    {
+        int code;
+        apr_exit_why_e why;
+
+        rv = apr_proc_wait(&child, &code, &why, APR_WAIT);
+        if (rv == APR_CHILD_DONE && why == APR_PROC_EXIT && code == 2) {
+            ABTS_NOT_IMPL(tc, "apr_proc_mutex_timedlock not implemented");
+        }
+        else {
+            ABTS_ASSERT(tc, "child did not terminate with success",
+                        rv == APR_CHILD_DONE && why == APR_PROC_EXIT
+                        && code == 0);
+        }
+    }
+    apr_proc_mutex_destroy(proc_lock);
+}
+
+#if APR_HAS_FUTEX_SERIALIZE
+/* A futex mutex must not stay locked when its owner dies. */
+static void test_owner_death(abts_case *tc)
+{
+    apr_proc_t child;
+    apr_status_t rv;
+
+    rv = apr_proc_mutex_create(&proc_lock, NULL, APR_LOCK_FUTEX, p);
+    APR_ASSERT_SUCCESS(tc, "create the mutex", rv);
+    if (rv != APR_SUCCESS)
+        return;
+
+    rv = apr_proc_fork(&child, p);
+    if (rv == APR_INCHILD) {
+        /* _exit() so that no cleanup releases the mutex */
+        if (apr_proc_mutex_lock(proc_lock))
+            _exit(1);
+        _exit(0);
+    }
+    ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+    await_child(tc, &child);
+
+    rv = apr_proc_mutex_timedlock(proc_lock, apr_time_from_sec(5));
+    APR_ASSERT_SUCCESS(tc, "take over the mutex of a dead owner", rv);
+    rv = apr_proc_mutex_unlock(proc_lock);
+    APR_ASSERT_SUCCESS(tc, "unlock the recovered mutex", rv);
+    apr_proc_mutex_destroy(proc_lock);
+}
+#endif
 #endif
 
 static void proc_mutex(abts_case *tc, void *data)
@@ -171,6 +273,11 @@ static void proc_mutex(abts_case *tc, void *data)
 
     x = apr_shm_baseaddr_get(shm);
     test_exclusive(tc, NULL, *mech);
+    test_timedlock(tc, *mech);
+#if APR_HAS_FUTEX_SERIALIZE
+    if (*mech == APR_LOCK_FUTEX)
+        test_owner_death(tc);
+#endif
     rv = apr_shm_destroy(shm);
     APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
 #else
@@ -205,6 +312,10 @@ abts_suite *testprocmutex(abts_suite *suite)
     mech = APR_LOCK_FLOCK;
     abts_run_test(suite, proc_mutex, &mech);
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    mech = APR_LOCK_FUTEX;
+    abts_run_test(suite, proc_mutex, &mech);
+#endif
 
     return suite;
 }
@@ -0,0 +1,641 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "apr_resolver.h"
+#include "apr_network_io.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
+#include "apr_poll.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "testutil.h"
+
+#if APR_HAS_RESOLVER && APR_HAS_THREADS
+
+/* A nameserver on the loopback for the zone example.test:
+ *
+ *   a.example.test      A 192.0.2.1, A 192.0.2.2, AAAA 2001:db8::1, TTL 300
+ *   alias.example.test  CNAME a.example.test, TTL 60
+ *   v6.example.test     AAAA 2001:db8::2
+ *   fail.example.test   answered with SERVFAIL
+ *   drop.example.test   not answered
+ *
+ * and NXDOMAIN with a negative TTL of 30 for anything else.
+ */
+typedef struct fake_dns_t {
+    apr_socket_t *sock;
+    apr_sockaddr_t *sa;
+    apr_sockaddr_t *from;
+    apr_thread_t *thd;
+    apr_uint32_t queries;
+    volatile apr_uint32_t stop;
+} fake_dns_t;
+
+static void put16(unsigned char *msg, apr_size_t *pos, unsigned v)
+{
+    msg[(*pos)++] = (v >> 8) & 0xff;
+    msg[(*pos)++] = v & 0xff;
+}
+
+static void put32(unsigned char *msg, apr_size_t *pos, apr_uint32_t v)
+{
+    put16(msg, pos, v >> 16);
+    put16(msg, pos, v & 0xffff);
+}
+
+static void put_name(unsigned char *msg, apr_size_t *pos, const char *name)
+{
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        apr_size_t len = dot ? (apr_size_t)(dot - name) : strlen(name);
+
+        msg[(*pos)++] = (unsigned char)len;
+        memcpy(msg + *pos, name, len);
+        *pos += len;
+        name += len + (dot != NULL);
+    }
+    msg[(*pos)++] = 0;
+}
+
+/* A record owned by the question name when owner is NULL */
+static void put_rr(unsigned char *msg, apr_size_t *pos, const char *owner,
+                   int type, apr_uint32_t ttl, const void *rdata,
+                   apr_size_t rdlen)
+{
+    if (owner) {
+        put_name(msg, pos, owner);
+    }
+    else {
+        put16(msg, pos, 0xc000 | 12);
+    }
+    put16(msg, pos, type);
+    put16(msg, pos, 1);
+    put32(msg, pos, ttl);
+    put16(msg, pos, (unsigned)rdlen);
+    memcpy(msg + *pos, rdata, rdlen);
+    *pos += rdlen;
+}
+
+static void put_soa(unsigned char *msg, apr_size_t *pos)
+{
+    unsigned char rdata[128];
+    apr_size_t len = 0;
+
+    put_name(rdata, &len, "ns.example.test");
+    put_name(rdata, &len, "admin.example.test");
+    put32(rdata, &len, 1);          /* serial */
+    put32(rdata, &len, 3600);       /* refresh */
+    put32(rdata, &len, 600);        /* retry */
+    put32(rdata, &len, 86400);      /* expire */
+    put32(rdata, &len, 30);         /* minimum */
+    put_rr(msg, pos, "example.test", 6, 3600, rdata, len);
+}
+
+static const unsigned char addr_a1[4] = { 192, 0, 2, 1 };
+static const unsigned char addr_a2[4] = { 192, 0, 2, 2 };
+static const unsigned char addr_aaaa1[16] = { 0x20, 0x01, 0x0d, 0xb8,
+                                              0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, 0, 1 };
+static const unsigned char addr_aaaa2[16] = { 0x20, 0x01, 0x0d, 0xb8,
+                                              0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, 0, 2 };
+
+/* Answer a query, returning the length of the answer or 0 for none */
+static apr_size_t fake_dns_answer(const unsigned char *query, apr_size_t len,
+                                  unsigned char *msg)
+{
+    char name[256];
+    apr_size_t qpos = 12, pos, nlen = 0;
+    unsigned an = 0, ns = 0, rcode = 0, type;
+    const char *owner = NULL;
+
+    if (len < 12) {
+        return 0;
+    }
+    while (qpos < len && query[qpos]) {
+        apr_size_t l = query[qpos++];
+
+        if (qpos + l > len || nlen + l + 1 >= sizeof(name)) {
+            return 0;
+        }
+        if (nlen) {
+            name[nlen++] = '.';
+        }
+        memcpy(name + nlen, query + qpos, l);
+        nlen += l;
+        qpos += l;
+    }
+    name[nlen] = '\0';
+    qpos++;
+    if (qpos + 4 > len) {
+        return 0;
+    }
+    type = (query[qpos] << 8) | query[qpos + 1];
+    qpos += 4;
+
+    if (!strcasecmp(name, "drop.example.test")) {
+        return 0;
+    }
+
+    memcpy(msg, query, qpos);
+    pos = qpos;
+    if (!strcasecmp(name, "alias.example.test")) {
+        unsigned char target[64];
+        apr_size_t tlen = 0;
+
+        put_name(target, &tlen, "a.example.test");
+        put_rr(msg, &pos, NULL, 5, 60, target, tlen);
+        an++;
+        owner = "a.example.test";
+        strcpy(name, owner);
+    }
+    if (!strcasecmp(name, "a.example.test")) {
+        if (type == 1) {
+            put_rr(msg, &pos, owner, 1, 300, addr_a1, 4);
+            put_rr(msg, &pos, owner, 1, 300, addr_a2, 4);
+            an += 2;
+        }
+        else if (type == 28) {
+            put_rr(msg, &pos, owner, 28, 300, addr_aaaa1, 16);
+            an++;
+        }
+    }
+    else if (!strcasecmp(name, "v6.example.test")) {
+        if (type == 28) {
+            put_rr(msg, &pos, NULL, 28, 300, addr_aaaa2, 16);
+            an++;
+        }
+        else {
+            put_soa(msg, &pos);
+            ns++;
+        }
+    }
+    else if (!strcasecmp(name, "fail.example.test")) {
+        rcode = 2;
+    }
+    else {
+        put_soa(msg, &pos);
+        ns++;
+        rcode = 3;
+    }
+
+    msg[2] = 0x80 | (query[2] & 0x01);  /* QR, RD */
+    msg[3] = 0x80 | rcode;              /* RA */
+    msg[6] = an >> 8;
+    msg[7] = an & 0xff;
+    msg[8] = ns >> 8;
+    msg[9] = ns & 0xff;
+    msg[10] = msg[11] = 0;
+    return pos;
+}
+
+static void * APR_THREAD_FUNC fake_dns_thread(apr_thread_t *thd, void *data)
+{
+    fake_dns_t *dns = data;
+    unsigned char query[512], msg[1024];
+    apr_sockaddr_t *from = dns->from;
+
+    while (!apr_atomic_read32(&dns->stop)) {
+        apr_size_t len = sizeof(query);
+
+        if (apr_socket_recvfrom(from, dns->sock, 0, (char *)query, &len)
+            != APR_SUCCESS) {
+            continue;
+        }
+        apr_atomic_inc32(&dns->queries);
+        len = fake_dns_answer(query, len, msg);
+        if (len) {
+            apr_socket_sendto(dns->sock, from, 0, (char *)msg, &len);
+        }
+    }
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void fake_dns_start(abts_case *tc, fake_dns_t *dns)
+{
+    apr_sockaddr_t *sa;
+
+    memset(dns, 0, sizeof(*dns));
+    APR_ASSERT_SUCCESS(tc, "get loopback address",
+                       apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0,
+                                             0, p));
+    APR_ASSERT_SUCCESS(tc, "create nameserver socket",
+                       apr_socket_create(&dns->sock, APR_INET, SOCK_DGRAM, 0,
+                                         p));
+    APR_ASSERT_SUCCESS(tc, "bind nameserver socket",
+                       apr_socket_bind(dns->sock, sa));
+    APR_ASSERT_SUCCESS(tc, "get nameserver address",
+                       apr_socket_addr_get(&dns->sa, APR_LOCAL, dns->sock));
+    APR_ASSERT_SUCCESS(tc, "get client address",
+                       apr_sockaddr_info_get(&dns->from, "127.0.0.1",
+                                             APR_INET, 0, 0, p));
+    apr_socket_timeout_set(dns->sock, apr_time_from_msec(50));
+    APR_ASSERT_SUCCESS(tc, "start nameserver",
+                       apr_thread_create(&dns->thd, NULL, fake_dns_thread,
+                                         dns, p));
+}
+
+static void fake_dns_stop(fake_dns_t *dns)
+{
+    apr_status_t rv;
+
+    apr_atomic_set32(&dns->stop, 1);
+    apr_thread_join(&rv, dns->thd);
+    apr_socket_close(dns->sock);
+}
+
+static apr_resolver_t *stub_create(abts_case *tc, fake_dns_t *dns,
+                                   apr_resolver_cache_t *cache)
+{
+    apr_resolver_t *res;
+
+    APR_ASSERT_SUCCESS(tc, "create resolver",
+                       apr_resolver_create(&res, 4, cache, APR_RESOLVER_STUB,
+                                           p));
+    ABTS_STR_EQUAL(tc, "stub", apr_resolver_method_name(res));
+    APR_ASSERT_SUCCESS(tc, "set nameserver",
+                       apr_resolver_nameserver_add(res, dns->sa));
+    APR_ASSERT_SUCCESS(tc, "set timeout",
+                       apr_resolver_timeout_set(res, apr_time_from_msec(200),
+                                                1));
+    return res;
+}
+
+/* Submit a query and wait for it */
+static void resolve(abts_case *tc, apr_resolver_t *res,
+                    apr_resolver_query_t *query, const char *hostname,
+                    apr_int32_t family, apr_int32_t flags)
+{
+    apr_resolver_query_t *done = NULL;
+    apr_int32_t num = 1;
+
+    memset(query, 0, sizeof(*query));
+    query->hostname = hostname;
+    query->family = family;
+    query->flags = flags;
+    query->port = 8080;
+    query->pool = p;
+    APR_ASSERT_SUCCESS(tc, "submit query", apr_resolver_submit(res, query));
+    APR_ASSERT_SUCCESS(tc, "poll for completion",
+                       apr_resolver_poll(res, apr_time_from_sec(5), &done,
+                                         &num));
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_PTR_EQUAL(tc, query, done);
+}
+
+static int count_addrs(apr_sockaddr_t *sa)
+{
+    int n = 0;
+
+    for (; sa; sa = sa->next) {
+        n++;
+    }
+    return n;
+}
+
+static const char *addr_str(apr_sockaddr_t *sa)
+{
+    char *ip = NULL;
+
+    if (!sa || apr_sockaddr_ip_get(&ip, sa) != APR_SUCCESS) {
+        return "";
+    }
+    return ip;
+}
+
+static void test_stub(abts_case *tc, void *data)
+{
+    fake_dns_t dns;
+    apr_resolver_cache_t *cache;
+    apr_resolver_cache_stats_t stats;
+    apr_resolver_t *res;
+    apr_resolver_query_t query;
+
+    fake_dns_start(tc, &dns);
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_resolver_cache_create(&cache, 0, 0, 0, p));
+    res = stub_create(tc, &dns, cache);
+
+    resolve(tc, res, &query, "a.example.test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve name", query.status);
+    ABTS_INT_EQUAL(tc, 2, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query.sa));
+    ABTS_STR_EQUAL(tc, "192.0.2.2", addr_str(query.sa->next));
+    ABTS_INT_EQUAL(tc, 8080, query.sa->port);
+    ABTS_STR_EQUAL(tc, "a.example.test.", query.sa->hostname);
+    ABTS_ASSERT(tc, "ttl of the answer",
+                query.ttl > 0 && query.ttl <= apr_time_from_sec(300));
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&dns.queries));
+
+    /* The second time around, from the cache */
+    resolve(tc, res, &query, "A.Example.Test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve cached name", query.status);
+    ABTS_INT_EQUAL(tc, 2, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query.sa));
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&dns.queries));
+
+    apr_resolver_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.misses);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.entries);
+
+    /* Aliases are followed, the shortest time to live wins */
+    resolve(tc, res, &query, "alias.example.test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve alias", query.status);
+    ABTS_INT_EQUAL(tc, 2, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query.sa));
+    ABTS_ASSERT(tc, "ttl of the alias",
+                query.ttl > 0 && query.ttl <= apr_time_from_sec(60));
+
+    /* Numeric addresses need no nameserver */
+    resolve(tc, res, &query, "127.0.0.1", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve numeric address", query.status);
+    ABTS_STR_EQUAL(tc, "127.0.0.1", addr_str(query.sa));
+    ABTS_INT_EQUAL(tc, -1, (int)query.ttl);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&dns.queries));
+
+    apr_resolver_destroy(res);
+    fake_dns_stop(&dns);
+}
+
+#if APR_HAVE_IPV6
+static void test_stub_families(abts_case *tc, void *data)
+{
+    fake_dns_t dns;
+    apr_resolver_t *res;
+    apr_resolver_query_t query;
+
+    fake_dns_start(tc, &dns);
+    res = stub_create(tc, &dns, NULL);
+
+    /* Both questions at once, IPv4 first */
+    resolve(tc, res, &query, "a.example.test.", APR_UNSPEC, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve name", query.status);
+    ABTS_INT_EQUAL(tc, 3, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query.sa));
+    ABTS_STR_EQUAL(tc, "2001:db8::1", addr_str(query.sa->next->next));
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&dns.queries));
+
+    resolve(tc, res, &query, "a.example.test.", APR_UNSPEC,
+            APR_IPV6_ADDR_OK);
+    APR_ASSERT_SUCCESS(tc, "resolve IPv6 first", query.status);
+    ABTS_INT_EQUAL(tc, 1, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "2001:db8::1", addr_str(query.sa));
+
+    resolve(tc, res, &query, "v6.example.test.", APR_UNSPEC,
+            APR_IPV4_ADDR_OK);
+    APR_ASSERT_SUCCESS(tc, "resolve IPv4 first", query.status);
+    ABTS_INT_EQUAL(tc, 1, count_addrs(query.sa));
+    ABTS_STR_EQUAL(tc, "2001:db8::2", addr_str(query.sa));
+
+    resolve(tc, res, &query, "v6.example.test.", APR_INET, 0);
+    ABTS_INT_EQUAL(tc, 0, query.status == APR_SUCCESS);
+    ABTS_PTR_EQUAL(tc, NULL, query.sa);
+
+    apr_resolver_destroy(res);
+    fake_dns_stop(&dns);
+}
+#endif
+
+static void test_stub_negative(abts_case *tc, void *data)
+{
+    fake_dns_t dns;
+    apr_resolver_cache_t *cache;
+    apr_resolver_cache_stats_t stats;
+    apr_resolver_t *res;
+    apr_resolver_query_t query;
+    apr_status_t nx;
+
+    fake_dns_start(tc, &dns);
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_resolver_cache_create(&cache, 0, 0, 0, p));
+    res = stub_create(tc, &dns, cache);
+
+    resolve(tc, res, &query, "nx.example.test.", APR_INET, 0);
+    nx = query.status;
+    ABTS_INT_EQUAL(tc, 0, nx == APR_SUCCESS);
+    ABTS_ASSERT(tc, "negative ttl",
+                query.ttl > 0 && query.ttl <= apr_time_from_sec(30));
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&dns.queries));
+
+    /* No such host, from the cache */
+    resolve(tc, res, &query, "nx.example.test.", APR_INET, 0);
+    ABTS_INT_EQUAL(tc, nx, query.status);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&dns.queries));
+
+    /* Failures are not cached */
+    resolve(tc, res, &query, "fail.example.test.", APR_INET, 0);
+    ABTS_INT_EQUAL(tc, 0, query.status == APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, 0, query.status == nx);
+    resolve(tc, res, &query, "drop.example.test.", APR_INET, 0);
+    ABTS_INT_EQUAL(tc, 0, query.status == APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, 0, query.status == nx);
+    ABTS_INT_EQUAL(tc, 3, apr_atomic_read32(&dns.queries));
+
+    apr_resolver_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.entries);
+
+    apr_resolver_cache_clear(cache);
+    apr_resolver_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.entries);
+
+    apr_resolver_destroy(res);
+    fake_dns_stop(&dns);
+}
+
+static void test_cache_ttl(abts_case *tc, void *data)
+{
+    fake_dns_t dns;
+    apr_resolver_cache_t *cache;
+    apr_resolver_t *res, *res2;
+    apr_resolver_query_t query;
+
+    fake_dns_start(tc, &dns);
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_resolver_cache_create(&cache, 0,
+                                                 apr_time_from_msec(100),
+                                                 -1, p));
+    res = stub_create(tc, &dns, cache);
+
+    resolve(tc, res, &query, "a.example.test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve name", query.status);
+    ABTS_ASSERT(tc, "ttl capped",
+                query.ttl > 0 && query.ttl <= apr_time_from_msec(100));
+
+    /* Another resolver shares the answer, whatever its method */
+    APR_ASSERT_SUCCESS(tc, "create resolver",
+                       apr_resolver_create(&res2, 4, cache, 0, p));
+    ABTS_STR_EQUAL(tc, "getaddrinfo", apr_resolver_method_name(res2));
+    resolve(tc, res2, &query, "a.example.test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve shared name", query.status);
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query.sa));
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&dns.queries));
+
+    apr_sleep(apr_time_from_msec(150));
+    resolve(tc, res, &query, "a.example.test.", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve expired name", query.status);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&dns.queries));
+
+    /* Negative answers are not kept */
+    resolve(tc, res, &query, "nx.example.test.", APR_INET, 0);
+    resolve(tc, res, &query, "nx.example.test.", APR_INET, 0);
+    ABTS_INT_EQUAL(tc, 4, apr_atomic_read32(&dns.queries));
+
+    apr_resolver_destroy(res2);
+    apr_resolver_destroy(res);
+    fake_dns_stop(&dns);
+}
+
+static void test_getaddrinfo(abts_case *tc, void *data)
+{
+    apr_resolver_cache_t *cache;
+    apr_resolver_cache_stats_t stats;
+    apr_resolver_t *res;
+    apr_resolver_query_t query;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "localhost", APR_INET, 0, 0, p);
+    if (rv != APR_SUCCESS) {
+        ABTS_NOT_IMPL(tc, "resolving localhost");
+        return;
+    }
+
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_resolver_cache_create(&cache, 0, 0, 0, p));
+    APR_ASSERT_SUCCESS(tc, "create resolver",
+                       apr_resolver_create(&res, 4, cache, 0, p));
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL,
+                   apr_resolver_nameserver_add(res, sa));
+
+    resolve(tc, res, &query, "localhost", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve localhost", query.status);
+    ABTS_STR_EQUAL(tc, addr_str(sa), addr_str(query.sa));
+    ABTS_INT_EQUAL(tc, 8080, query.sa->port);
+
+    resolve(tc, res, &query, "localhost", APR_INET, 0);
+    APR_ASSERT_SUCCESS(tc, "resolve cached localhost", query.status);
+    ABTS_STR_EQUAL(tc, addr_str(sa), addr_str(query.sa));
+    apr_resolver_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.hits);
+
+    apr_resolver_destroy(res);
+}
+
+static apr_status_t pollcb_func(void *baton, apr_pollfd_t *pfd)
+{
+    *(int *)baton += 1;
+    return APR_SUCCESS;
+}
+
+static void test_pollcb(abts_case *tc, void *data)
+{
+    fake_dns_t dns;
+    apr_resolver_t *res;
+    apr_resolver_query_t query[2], *done[2];
+    apr_pollcb_t *pollcb;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    apr_status_t rv;
+    int signalled = 0, i;
+
+    fake_dns_start(tc, &dns);
+    res = stub_create(tc, &dns, NULL);
+
+    rv = apr_pollcb_create(&pollcb, 1, p, 0);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb");
+        apr_resolver_destroy(res);
+        fake_dns_stop(&dns);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create pollcb", rv);
+    apr_resolver_pollfd_get(res, &pfd);
+    APR_ASSERT_SUCCESS(tc, "add resolver to pollcb",
+                       apr_pollcb_add(pollcb, &pfd));
+
+    for (i = 0; i < 2; i++) {
+        memset(&query[i], 0, sizeof(query[i]));
+        query[i].hostname = i ? "alias.example.test." : "a.example.test.";
+        query[i].family = APR_INET;
+        query[i].pool = p;
+        APR_ASSERT_SUCCESS(tc, "submit query",
+                           apr_resolver_submit(res, &query[i]));
+    }
+
+    for (num = 0; num < 2;) {
+        apr_int32_t n = 2 - num;
+
+        rv = apr_pollcb_poll(pollcb, apr_time_from_sec(5), pollcb_func,
+                             &signalled);
+        APR_ASSERT_SUCCESS(tc, "pollcb signalled", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        rv = apr_resolver_poll(res, 0, done + num, &n);
+        if (rv == APR_SUCCESS) {
+            num += n;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 2, num);
+    ABTS_ASSERT(tc, "signalled", signalled >= 1);
+    APR_ASSERT_SUCCESS(tc, "first query", query[0].status);
+    APR_ASSERT_SUCCESS(tc, "second query", query[1].status);
+    ABTS_STR_EQUAL(tc, "192.0.2.1", addr_str(query[1].sa));
+
+    /* drained */
+    num = 2;
+    rv = apr_resolver_poll(res, 0, done, &num);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    rv = apr_pollcb_poll(pollcb, 0, pollcb_func, &signalled);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    apr_resolver_destroy(res);
+    fake_dns_stop(&dns);
+}
+
+#else
+
+static void not_impl(abts_case *tc, void *data)
+{
+    ABTS_NOT_IMPL(tc, "apr_resolver");
+}
+
+#endif
+
+abts_suite *testresolver(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_RESOLVER && APR_HAS_THREADS
+    abts_run_test(suite, test_stub, NULL);
+#if APR_HAVE_IPV6
+    abts_run_test(suite, test_stub_families, NULL);
+#endif
+    abts_run_test(suite, test_stub_negative, NULL);
+    abts_run_test(suite, test_cache_ttl, NULL);
+    abts_run_test(suite, test_getaddrinfo, NULL);
+    abts_run_test(suite, test_pollcb, NULL);
+#else
+    abts_run_test(suite, not_impl, NULL);
+#endif
+
+    return suite;
+}
@@ -177,6 +177,79 @@ static void test_rmm(abts_case *tc, void *data)
     apr_pool_destroy(pool);
 }
 
+#define MANY_COUNT 2000
+
+static void test_rmm_many(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_rmm_t *rmm, *rmm2;
+    apr_size_t size, total = 0;
+    apr_rmm_off_t *off, big;
+    void *base;
+    int i;
+
+    rv = apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < MANY_COUNT; i++) {
+        total += APR_ALIGN_DEFAULT(i % 200 + 1);
+    }
+    size = total + apr_rmm_overhead_get(MANY_COUNT);
+    base = apr_palloc(pool, size);
+
+    rv = apr_rmm_init(&rmm, NULL, base, size, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Varying sizes must all fit in the advertised overhead */
+    off = apr_palloc(pool, MANY_COUNT * sizeof(apr_rmm_off_t));
+    for (i = 0; i < MANY_COUNT; i++) {
+        off[i] = apr_rmm_malloc(rmm, i % 200 + 1);
+        ABTS_TRUE(tc, !!off[i]);
+        memset(apr_rmm_addr_get(rmm, off[i]), i & 0xff, i % 200 + 1);
+    }
+
+    /* Another process would attach to the very same region */
+    rv = apr_rmm_attach(&rmm2, NULL, base, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Free every other block, then the rest, through either handle */
+    for (i = 0; i < MANY_COUNT; i += 2) {
+        rv = apr_rmm_free(rmm2, off[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 1; i < MANY_COUNT; i += 2) {
+        unsigned char *c = apr_rmm_addr_get(rmm, off[i]);
+        ABTS_INT_EQUAL(tc, i & 0xff, c[i % 200]);
+        rv = apr_rmm_free(rmm, off[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* Freeing twice, or something never allocated, is refused */
+    rv = apr_rmm_free(rmm, off[1]);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_rmm_free(rmm, off[1] + APR_ALIGN_DEFAULT(1));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    /* Everything coalesced back into a single block */
+    big = apr_rmm_malloc(rmm, total);
+    ABTS_TRUE(tc, !!big);
+    rv = apr_rmm_free(rmm, big);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_rmm_detach(rmm2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_rmm_destroy(rmm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* A destroyed (or never initialized) region can't be attached */
+    rv = apr_rmm_attach(&rmm2, NULL, base, pool);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_pool_destroy(pool);
+}
+
 #endif /* APR_HAS_SHARED_MEMORY */
 
 abts_suite *testrmm(abts_suite *suite)
@@ -185,6 +258,7 @@ abts_suite *testrmm(abts_suite *suite)
 
 #if APR_HAS_SHARED_MEMORY
     abts_run_test(suite, test_rmm, NULL);
+    abts_run_test(suite, test_rmm_many, NULL);
 #endif
 
     return suite;
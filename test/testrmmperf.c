@@ -0,0 +1,178 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "apr_rmm.h"
+#include "apr_strings.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "testutil.h"
+
+#define DEFAULT_OBJECTS   100000
+#define DEFAULT_ROUNDS    10
+#define MAX_OBJECT_SIZE   512
+
+static int verbose = 0;
+static int num_objects = DEFAULT_OBJECTS;
+static int num_rounds = DEFAULT_ROUNDS;
+
+static apr_uint32_t seed = 1;
+
+/* Deterministic so that runs can be compared */
+static apr_uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static apr_status_t test_rmm_perf(apr_pool_t *pool)
+{
+    apr_status_t rv;
+    apr_rmm_t *rmm;
+    apr_rmm_off_t *off;
+    apr_size_t size;
+    apr_time_t start, fill = 0, churn = 0, drain = 0;
+    apr_uint64_t ops;
+    int i, j;
+
+    size = (apr_size_t)num_objects * MAX_OBJECT_SIZE
+         + apr_rmm_overhead_get(num_objects);
+    printf("%-60s", apr_psprintf(pool, "    Initializing a %" APR_SIZE_T_FMT
+                                 " byte region", size));
+    rv = apr_rmm_init(&rmm, NULL, apr_palloc(pool, size), size, pool);
+    if (rv != APR_SUCCESS) {
+        printf("Failed!\n");
+        return rv;
+    }
+    printf("OK\n");
+
+    off = apr_pcalloc(pool, num_objects * sizeof(apr_rmm_off_t));
+
+    for (j = 0; j < num_rounds; j++) {
+        /* Fill the region with objects of random sizes */
+        start = apr_time_now();
+        for (i = 0; i < num_objects; i++) {
+            off[i] = apr_rmm_malloc(rmm, next_random() % MAX_OBJECT_SIZE + 1);
+            if (!off[i]) {
+                printf("error: allocation %d failed\n", i);
+                return APR_ENOMEM;
+            }
+        }
+        fill += apr_time_now() - start;
+
+        /* Replace random objects, fragmenting the free lists */
+        start = apr_time_now();
+        for (i = 0; i < num_objects; i++) {
+            int k = next_random() % num_objects;
+
+            if ((rv = apr_rmm_free(rmm, off[k])) != APR_SUCCESS) {
+                printf("error: free of %d failed\n", k);
+                return rv;
+            }
+            off[k] = apr_rmm_malloc(rmm, next_random() % MAX_OBJECT_SIZE + 1);
+            if (!off[k]) {
+                printf("error: reallocation %d failed\n", k);
+                return APR_ENOMEM;
+            }
+        }
+        churn += apr_time_now() - start;
+
+        /* And release them all again, coalescing */
+        start = apr_time_now();
+        for (i = 0; i < num_objects; i++) {
+            if ((rv = apr_rmm_free(rmm, off[i])) != APR_SUCCESS) {
+                printf("error: free of %d failed\n", i);
+                return rv;
+            }
+        }
+        drain += apr_time_now() - start;
+
+        if (verbose) {
+            printf("    round %d done\n", j + 1);
+        }
+    }
+
+    ops = (apr_uint64_t)num_objects * num_rounds;
+    printf("    %d objects, %d rounds\n", num_objects, num_rounds);
+    printf("    apr_rmm_malloc (fill):   %8" APR_UINT64_T_FMT " ns/op\n",
+           (apr_uint64_t)fill * 1000 / ops);
+    printf("    apr_rmm_free+malloc:     %8" APR_UINT64_T_FMT " ns/op\n",
+           (apr_uint64_t)churn * 1000 / ops);
+    printf("    apr_rmm_free (drain):    %8" APR_UINT64_T_FMT " ns/op\n",
+           (apr_uint64_t)drain * 1000 / ops);
+
+    return apr_rmm_destroy(rmm);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR RMM Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:r:v", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_objects = atoi(optarg);
+        }
+        else if (optchar == 'r') {
+            num_rounds = atoi(optarg);
+        }
+        else if (optchar == 'v') {
+            verbose = 1;
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if (num_objects <= 0 || num_rounds <= 0) {
+        fprintf(stderr, "Usage: %s [-n objects] [-r rounds] [-v]\n", argv[0]);
+        exit(-1);
+    }
+
+    printf("apr_rmm_t Tests\n");
+    if ((rv = test_rmm_perf(pool)) != APR_SUCCESS) {
+        fprintf(stderr, "rmm test failed : [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-2);
+    }
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_shm.h"
+#include "apr_shm_hash.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_lib.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "abts.h"
+#include "testutil.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#define KEY_MAX 32
+#define VAL_MAX 64
+#define NSLOTS  1024
+
+static apr_shm_hash_t *create_table(abts_case *tc, apr_size_t nslots,
+                                    void **base)
+{
+    apr_shm_hash_t *ht;
+    apr_size_t size = apr_shm_hash_size_get(nslots, KEY_MAX, VAL_MAX);
+    apr_status_t rv;
+
+    *base = apr_palloc(p, size);
+    rv = apr_shm_hash_init(&ht, NULL, *base, size, KEY_MAX, VAL_MAX, p);
+    APR_ASSERT_SUCCESS(tc, "Error initializing the table", rv);
+    ABTS_SIZE_EQUAL(tc, nslots, apr_shm_hash_capacity(ht));
+
+    return ht;
+}
+
+static void test_set_get(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    char val[VAL_MAX];
+    apr_size_t vlen;
+    void *base;
+
+    ht = create_table(tc, NSLOTS, &base);
+
+    rv = apr_shm_hash_set(ht, "key", 3, "value", 5);
+    APR_ASSERT_SUCCESS(tc, "Error setting a key", rv);
+    ABTS_SIZE_EQUAL(tc, 1, apr_shm_hash_count(ht));
+
+    vlen = sizeof(val);
+    rv = apr_shm_hash_get(ht, "key", 3, val, &vlen);
+    APR_ASSERT_SUCCESS(tc, "Error getting a key", rv);
+    ABTS_SIZE_EQUAL(tc, 5, vlen);
+    ABTS_TRUE(tc, !memcmp(val, "value", 5));
+
+    /* Replace */
+    rv = apr_shm_hash_set(ht, "key", 3, "other value", 11);
+    APR_ASSERT_SUCCESS(tc, "Error replacing a key", rv);
+    ABTS_SIZE_EQUAL(tc, 1, apr_shm_hash_count(ht));
+
+    vlen = 4;
+    rv = apr_shm_hash_get(ht, "key", 3, val, &vlen);
+    ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+    ABTS_SIZE_EQUAL(tc, 11, vlen);
+
+    vlen = sizeof(val);
+    rv = apr_shm_hash_get(ht, "key", 3, val, &vlen);
+    APR_ASSERT_SUCCESS(tc, "Error getting a key", rv);
+    ABTS_SIZE_EQUAL(tc, 11, vlen);
+    ABTS_TRUE(tc, !memcmp(val, "other value", 11));
+
+    vlen = sizeof(val);
+    rv = apr_shm_hash_get(ht, "kez", 3, val, &vlen);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    /* Too large */
+    rv = apr_shm_hash_set(ht, "key", 3, val, VAL_MAX + 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_shm_hash_set(ht, val, KEY_MAX + 1, "value", 5);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    rv = apr_shm_hash_remove(ht, "key", 3);
+    APR_ASSERT_SUCCESS(tc, "Error removing a key", rv);
+    ABTS_SIZE_EQUAL(tc, 0, apr_shm_hash_count(ht));
+
+    rv = apr_shm_hash_remove(ht, "key", 3);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    vlen = sizeof(val);
+    rv = apr_shm_hash_get(ht, "key", 3, val, &vlen);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+}
+
+static void test_many(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht, *ht2;
+    apr_status_t rv;
+    char val[VAL_MAX];
+    apr_size_t vlen;
+    void *base;
+    int i, stored = 0;
+
+    ht = create_table(tc, NSLOTS, &base);
+
+    /* Fill three quarters of the table */
+    for (i = 0; i < NSLOTS * 3 / 4; i++) {
+        const char *key = apr_itoa(p, i);
+
+        rv = apr_shm_hash_set(ht, key, strlen(key), &i, sizeof(i));
+        if (rv == APR_SUCCESS) {
+            stored++;
+        }
+        else {
+            ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, stored, apr_shm_hash_count(ht));
+    ABTS_TRUE(tc, stored > NSLOTS / 2);
+
+    /* Remove the odd ones */
+    for (i = 1; i < NSLOTS * 3 / 4; i += 2) {
+        const char *key = apr_itoa(p, i);
+
+        rv = apr_shm_hash_remove(ht, key, strlen(key));
+        if (rv == APR_SUCCESS) {
+            stored--;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, stored, apr_shm_hash_count(ht));
+
+    /* The even ones are still there, whichever handle is used */
+    rv = apr_shm_hash_attach(&ht2, NULL, base, p);
+    APR_ASSERT_SUCCESS(tc, "Error attaching to the table", rv);
+    for (i = 0; i < NSLOTS * 3 / 4; i += 2) {
+        const char *key = apr_itoa(p, i);
+        int v;
+
+        vlen = sizeof(v);
+        rv = apr_shm_hash_get(ht2, key, strlen(key), &v, &vlen);
+        if (rv == APR_SUCCESS) {
+            ABTS_INT_EQUAL(tc, i, v);
+            stored--;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, stored);
+
+    for (i = 1; i < NSLOTS * 3 / 4; i += 2) {
+        const char *key = apr_itoa(p, i);
+
+        vlen = sizeof(val);
+        rv = apr_shm_hash_get(ht2, key, strlen(key), val, &vlen);
+        ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    }
+
+    /* A region which holds no table can't be attached */
+    memset(base, 0, 64);
+    rv = apr_shm_hash_attach(&ht2, NULL, base, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+}
+
+static int evicted;
+
+static int count_evictions(void *ctx, const void *key, apr_size_t klen,
+                           const void *val, apr_size_t vlen)
+{
+    evicted++;
+    return *(int *)ctx;
+}
+
+static void test_evict(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    void *base;
+    int i, allow = 0;
+
+    ht = create_table(tc, 8, &base);
+
+    for (i = 0; i < 8; i++) {
+        const char *key = apr_itoa(p, i);
+
+        rv = apr_shm_hash_set(ht, key, strlen(key), &i, sizeof(i));
+        APR_ASSERT_SUCCESS(tc, "Error setting a key", rv);
+    }
+    ABTS_SIZE_EQUAL(tc, 8, apr_shm_hash_count(ht));
+
+    /* Full, and no hook */
+    rv = apr_shm_hash_set(ht, "full", 4, &i, sizeof(i));
+    ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+
+    /* Full, and the hook refuses */
+    apr_shm_hash_evict_hook_set(ht, count_evictions, &allow);
+    evicted = 0;
+    rv = apr_shm_hash_set(ht, "full", 4, &i, sizeof(i));
+    ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+    ABTS_INT_EQUAL(tc, 1, evicted);
+
+    /* Full, and the hook allows eviction of the oldest entry */
+    allow = 1;
+    evicted = 0;
+    rv = apr_shm_hash_set(ht, "full", 4, &i, sizeof(i));
+    APR_ASSERT_SUCCESS(tc, "Error setting a key with eviction", rv);
+    ABTS_INT_EQUAL(tc, 1, evicted);
+    ABTS_SIZE_EQUAL(tc, 8, apr_shm_hash_count(ht));
+
+    i = 0;
+    {
+        apr_size_t vlen = sizeof(i);
+
+        rv = apr_shm_hash_get(ht, "0", 1, &i, &vlen);
+        ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+        rv = apr_shm_hash_get(ht, "full", 4, &i, &vlen);
+        APR_ASSERT_SUCCESS(tc, "Error getting a key", rv);
+        ABTS_INT_EQUAL(tc, 8, i);
+    }
+}
+
+#if APR_HAS_SHARED_MEMORY && APR_HAS_FORK
+
+#define N_CHILD_READS 20000
+
+static void test_fork(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_shm_t *shm;
+    apr_proc_t proc;
+    apr_status_t rv;
+    apr_size_t size = apr_shm_hash_size_get(NSLOTS, KEY_MAX, VAL_MAX);
+    int i, exitcode;
+    apr_exit_why_e why;
+
+    rv = apr_shm_create(&shm, size, NULL, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "anonymous shared memory not supported");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Error allocating shared memory block", rv);
+
+    rv = apr_shm_hash_init(&ht, NULL, apr_shm_baseaddr_get(shm), size,
+                           KEY_MAX, VAL_MAX, p);
+    APR_ASSERT_SUCCESS(tc, "Error initializing the table", rv);
+
+    rv = apr_shm_hash_set(ht, "counter", 7, "0", 1);
+    APR_ASSERT_SUCCESS(tc, "Error setting a key", rv);
+
+    rv = apr_proc_fork(&proc, p);
+    if (rv == APR_INCHILD) {
+        /* The value must always be read whole: a run of a single
+         * repeated digit, as written by the parent.
+         */
+        char val[VAL_MAX];
+        apr_size_t j, vlen;
+
+        for (i = 0; i < N_CHILD_READS; i++) {
+            vlen = sizeof(val);
+            if (apr_shm_hash_get(ht, "counter", 7, val, &vlen)
+                    != APR_SUCCESS) {
+                exit(1);
+            }
+            for (j = 1; j < vlen; j++) {
+                if (val[j] != val[0]) {
+                    exit(2);
+                }
+            }
+        }
+        exit(0);
+    }
+    ABTS_INT_EQUAL(tc, APR_INPARENT, rv);
+
+    for (i = 0; i < N_CHILD_READS; i++) {
+        char val[VAL_MAX];
+
+        memset(val, '0' + i % 10, sizeof(val));
+        rv = apr_shm_hash_set(ht, "counter", 7, val, i % VAL_MAX + 1);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    APR_ASSERT_SUCCESS(tc, "Error setting a key", rv);
+
+    rv = apr_proc_wait(&proc, &exitcode, &why, APR_WAIT);
+    ABTS_INT_EQUAL(tc, APR_CHILD_DONE, rv);
+    ABTS_INT_EQUAL(tc, APR_PROC_EXIT, why);
+    ABTS_INT_EQUAL(tc, 0, exitcode);
+
+    rv = apr_shm_destroy(shm);
+    APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
+}
+
+#endif /* APR_HAS_SHARED_MEMORY && APR_HAS_FORK */
+
+abts_suite *testshmhash(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+    abts_run_test(suite, test_set_get, NULL);
+    abts_run_test(suite, test_many, NULL);
+    abts_run_test(suite, test_evict, NULL);
+#if APR_HAS_SHARED_MEMORY && APR_HAS_FORK
+    abts_run_test(suite, test_fork, NULL);
+#endif
+
+    return suite;
+}
@@ -0,0 +1,226 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "apr_shm.h"
+#include "apr_shm_hash.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "testutil.h"
+
+#if !APR_HAS_SHARED_MEMORY || !APR_HAS_FORK
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for shared memory or fork().\n");
+    return 0;
+}
+#else /* !APR_HAS_SHARED_MEMORY || !APR_HAS_FORK */
+
+#define DEFAULT_KEYS      10000
+#define DEFAULT_READS     1000000
+#define MAX_WORKERS       8
+#define KEY_MAX           32
+#define VAL_MAX           64
+
+static int verbose = 0;
+static int num_keys = DEFAULT_KEYS;
+static long num_reads = DEFAULT_READS;
+
+/* Shared with the workers, after the table */
+typedef struct {
+    volatile apr_uint32_t ready;
+    volatile apr_uint32_t go;
+    volatile apr_uint32_t misses;
+} control_t;
+
+static int worker(apr_shm_hash_t *ht, control_t *ctl, int id)
+{
+    apr_uint32_t seed = id + 1;
+    char key[KEY_MAX], val[VAL_MAX];
+    apr_size_t vlen;
+    long i, misses = 0;
+
+    apr_atomic_inc32(&ctl->ready);
+    while (!apr_atomic_read32(&ctl->go)) {
+        /* spin until every worker is ready */
+    }
+
+    for (i = 0; i < num_reads; i++) {
+        int k;
+
+        seed = seed * 1103515245 + 12345;
+        k = (seed >> 8) % num_keys;
+        apr_snprintf(key, sizeof(key), "key-%d", k);
+        vlen = sizeof(val);
+        if (apr_shm_hash_get(ht, key, strlen(key), val, &vlen)
+                != APR_SUCCESS) {
+            misses++;
+        }
+    }
+    if (misses) {
+        apr_atomic_add32(&ctl->misses, (apr_uint32_t)misses);
+    }
+    return 0;
+}
+
+static apr_status_t test_read_scaling(apr_pool_t *pool, int num_workers)
+{
+    apr_proc_t procs[MAX_WORKERS];
+    apr_shm_hash_t *ht;
+    apr_shm_t *shm;
+    apr_size_t size;
+    apr_status_t rv;
+    control_t *ctl;
+    apr_time_t start, elapsed;
+    char key[KEY_MAX], val[VAL_MAX];
+    int i;
+
+    /* Twice as many slots as keys, plus the control block */
+    size = apr_shm_hash_size_get(num_keys * 2, KEY_MAX, VAL_MAX);
+    if ((rv = apr_shm_create(&shm, size + APR_ALIGN_DEFAULT(sizeof(control_t)),
+                             NULL, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_shm_hash_init(&ht, NULL, apr_shm_baseaddr_get(shm), size,
+                           KEY_MAX, VAL_MAX, pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    ctl = (control_t *)((char *)apr_shm_baseaddr_get(shm) + size);
+    memset(ctl, 0, sizeof(*ctl));
+
+    memset(val, 'v', sizeof(val));
+    for (i = 0; i < num_keys; i++) {
+        apr_snprintf(key, sizeof(key), "key-%d", i);
+        if ((rv = apr_shm_hash_set(ht, key, strlen(key), val,
+                                   sizeof(val))) != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    fflush(stdout);
+    for (i = 0; i < num_workers; i++) {
+        rv = apr_proc_fork(&procs[i], pool);
+        if (rv == APR_INCHILD) {
+            exit(worker(ht, ctl, i));
+        }
+        else if (rv != APR_INPARENT) {
+            return rv;
+        }
+    }
+
+    while (apr_atomic_read32(&ctl->ready) != (apr_uint32_t)num_workers) {
+        apr_sleep(1000);
+    }
+    start = apr_time_now();
+    apr_atomic_set32(&ctl->go, 1);
+
+    for (i = 0; i < num_workers; i++) {
+        int exitcode;
+        apr_exit_why_e why;
+
+        apr_proc_wait(&procs[i], &exitcode, &why, APR_WAIT);
+        if (why != APR_PROC_EXIT || exitcode != 0) {
+            printf("error: worker %d failed\n", i);
+            return APR_EGENERAL;
+        }
+    }
+    elapsed = apr_time_now() - start;
+    if (!elapsed) {
+        elapsed = 1;
+    }
+
+    printf("    %d worker(s): %10" APR_UINT64_T_FMT " lookups/s, "
+           "%6" APR_UINT64_T_FMT " ns/lookup per worker\n", num_workers,
+           (apr_uint64_t)num_reads * num_workers * APR_USEC_PER_SEC / elapsed,
+           (apr_uint64_t)elapsed * 1000 / num_reads);
+    if (ctl->misses) {
+        printf("error: %u lookups missed\n", ctl->misses);
+        return APR_EGENERAL;
+    }
+
+    return apr_shm_destroy(shm);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    int i;
+
+    printf("APR Shared Memory Hash Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "k:c:v", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'k') {
+            num_keys = atoi(optarg);
+        }
+        else if (optchar == 'c') {
+            num_reads = atol(optarg);
+        }
+        else if (optchar == 'v') {
+            verbose = 1;
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if (num_keys <= 0 || num_reads <= 0) {
+        fprintf(stderr, "Usage: %s [-k keys] [-c lookups] [-v]\n", argv[0]);
+        exit(-1);
+    }
+
+    printf("apr_shm_hash_t read scaling (%d keys, %ld lookups per worker)\n",
+           num_keys, num_reads);
+    for (i = 1; i <= MAX_WORKERS; i *= 2) {
+        if ((rv = test_read_scaling(pool, i)) != APR_SUCCESS) {
+            fprintf(stderr, "shm_hash test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-2);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_SHARED_MEMORY || !APR_HAS_FORK */
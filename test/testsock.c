@@ -23,6 +23,7 @@
 #include "apr_lib.h"
 #include "apr_strings.h"
 #include "apr_poll.h"
+#include "apr_buckets.h"
 #define APR_WANT_BYTEFUNC
 #include "apr_want.h"
 
@@ -496,6 +497,120 @@ static void test_get_addr(abts_case *tc, void *data)
     apr_pool_destroy(subp);
 }
 
+static void test_splice(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *ld, *sd, *cd;
+    apr_sockaddr_t *sa;
+    apr_file_t *readp, *writep;
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    char *payload, *buf;
+    apr_size_t len, nbytes, total, i;
+    apr_off_t left;
+
+    ld = setup_socket(tc);
+    if (!ld) return;
+
+    APR_ASSERT_SUCCESS(tc, "get local address of bound socket",
+                       apr_socket_addr_get(&sa, APR_LOCAL, ld));
+    rv = apr_socket_create(&cd, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "create client socket", rv);
+    APR_ASSERT_SUCCESS(tc, "connect to listener", apr_socket_connect(cd, sa));
+    APR_ASSERT_SUCCESS(tc, "accept connection", apr_socket_accept(&sd, ld, p));
+
+    len = 8000;
+    payload = apr_palloc(p, len);
+    for (i = 0; i < len; i++) {
+        payload[i] = 'a' + i % 26;
+    }
+    buf = apr_palloc(p, len + 1);
+
+    /* a pipe bucket between data buckets goes out in order */
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp, &writep, p));
+    APR_ASSERT_SUCCESS(tc, "write to pipe",
+                       apr_file_write_full(writep, payload, len, NULL));
+    apr_file_close(writep);
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("head", 4, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pipe_create(readp, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("tail", 4, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+
+    nbytes = (apr_size_t)-1;
+    rv = apr_brigade_splice_to_socket(bb, cd, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "splice brigade to socket", rv);
+    ABTS_SIZE_EQUAL(tc, len + 8, nbytes);
+    ABTS_ASSERT(tc, "only the EOS bucket is left",
+                APR_BUCKET_IS_EOS(APR_BRIGADE_FIRST(bb))
+                && APR_BRIGADE_FIRST(bb) == APR_BRIGADE_LAST(bb));
+
+    for (total = 0; total < len + 8; total += nbytes) {
+        nbytes = len + 8 - total;
+        if (nbytes > len) {
+            nbytes = len;
+        }
+        rv = apr_socket_recv(sd, buf, &nbytes);
+        APR_ASSERT_SUCCESS(tc, "receive", rv);
+        if (rv) break;
+        if (total == 0) {
+            ABTS_ASSERT(tc, "head first", memcmp(buf, "head", 4) == 0);
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, len + 8, total);
+    ABTS_ASSERT(tc, "tail last", memcmp(buf + nbytes - 4, "tail", 4) == 0);
+
+    /* a limited amount, splitting a data bucket */
+    apr_brigade_cleanup(bb);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("0123456789",
+                                                           10, ba));
+    nbytes = 6;
+    APR_ASSERT_SUCCESS(tc, "send part of the brigade",
+                       apr_brigade_splice_to_socket(bb, cd, &nbytes));
+    ABTS_SIZE_EQUAL(tc, 6, nbytes);
+    APR_ASSERT_SUCCESS(tc, "brigade length",
+                       apr_brigade_length(bb, 1, &left));
+    ABTS_INT_EQUAL(tc, 4, (int)left);
+    nbytes = 6;
+    APR_ASSERT_SUCCESS(tc, "receive", apr_socket_recv(sd, buf, &nbytes));
+    ABTS_SIZE_EQUAL(tc, 6, nbytes);
+    ABTS_ASSERT(tc, "got the start", memcmp(buf, "012345", 6) == 0);
+
+#if APR_HAS_SPLICE
+    /* socket to pipe */
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp, &writep, p));
+    nbytes = 10;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(cd, "abcdefghij", &nbytes));
+    nbytes = 100;
+    rv = apr_socket_splice_recv(sd, writep, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "splice socket to pipe", rv);
+    ABTS_SIZE_EQUAL(tc, 10, nbytes);
+    nbytes = 100;
+    APR_ASSERT_SUCCESS(tc, "read pipe", apr_file_read(readp, buf, &nbytes));
+    ABTS_SIZE_EQUAL(tc, 10, nbytes);
+    ABTS_ASSERT(tc, "got the data", memcmp(buf, "abcdefghij", 10) == 0);
+
+    apr_socket_close(cd);
+    nbytes = 100;
+    rv = apr_socket_splice_recv(sd, writep, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, nbytes);
+    apr_file_close(readp);
+    apr_file_close(writep);
+#else
+    apr_socket_close(cd);
+#endif
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    apr_socket_close(sd);
+    apr_socket_close(ld);
+}
+
 static void test_wait(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -607,6 +722,277 @@ static void test_nonblock_inheritance(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Problem closing socket", rv);
 }
 
+static apr_socket_t *connect_to(abts_case *tc, apr_sockaddr_t *sa)
+{
+    apr_socket_t *cd;
+    apr_status_t rv;
+
+    rv = apr_socket_create(&cd, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "create client socket", rv);
+    rv = apr_socket_connect(cd, sa);
+    APR_ASSERT_SUCCESS(tc, "connect to listener", rv);
+    return cd;
+}
+
+static void test_accept_many(abts_case *tc, void *data)
+{
+    apr_socket_t *ld, *cd[3], *sd[8];
+    apr_pool_t *pools[8];
+    apr_sockaddr_t *sa;
+    apr_int32_t num;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&ld, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating socket", rv);
+    APR_ASSERT_SUCCESS(tc, "bind", apr_socket_bind(ld, sa));
+    APR_ASSERT_SUCCESS(tc, "listen", apr_socket_listen(ld, 8));
+    APR_ASSERT_SUCCESS(tc, "get listener address",
+                       apr_socket_addr_get(&sa, APR_LOCAL, ld));
+    APR_ASSERT_SUCCESS(tc, "make listener non-blocking",
+                       apr_socket_timeout_set(ld, 0));
+
+    for (i = 0; i < 8; i++) {
+        pools[i] = p;
+    }
+    for (i = 0; i < 3; i++) {
+        cd[i] = connect_to(tc, sa);
+    }
+
+    num = 8;
+    rv = apr_socket_accept_many(sd, &num, ld, pools);
+    APR_ASSERT_SUCCESS(tc, "accept connections", rv);
+    ABTS_INT_EQUAL(tc, 3, num);
+    for (i = 0; i < num; i++) {
+        apr_socket_close(sd[i]);
+    }
+
+    num = 8;
+    rv = apr_socket_accept_many(sd, &num, ld, pools);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, num);
+
+    for (i = 0; i < 3; i++) {
+        apr_socket_close(cd[i]);
+    }
+    apr_socket_close(ld);
+}
+
+static void test_listen_group(abts_case *tc, void *data)
+{
+    apr_socket_t *ld[2], *cd[6], *sd[6];
+    apr_pool_t *pools[6];
+    apr_sockaddr_t *sa, *sa0, *sa1;
+    apr_int32_t num;
+    apr_status_t rv;
+    int i, total;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_listen_group_create(ld, 2, sa, SOCK_STREAM,
+                                        APR_PROTO_TCP, 8, 0, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "SO_REUSEPORT listener groups");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create listener group", rv);
+    ABTS_INT_EQUAL(tc, 0, sa->port);
+
+    APR_ASSERT_SUCCESS(tc, "get listener address",
+                       apr_socket_addr_get(&sa0, APR_LOCAL, ld[0]));
+    APR_ASSERT_SUCCESS(tc, "get listener address",
+                       apr_socket_addr_get(&sa1, APR_LOCAL, ld[1]));
+    ABTS_ASSERT(tc, "port picked", sa0->port != 0);
+    ABTS_INT_EQUAL(tc, sa0->port, sa1->port);
+
+    for (i = 0; i < 6; i++) {
+        pools[i] = p;
+        cd[i] = connect_to(tc, sa0);
+    }
+
+    /* The connections are spread over the listeners */
+    total = 0;
+    for (i = 0; i < 2; i++) {
+        APR_ASSERT_SUCCESS(tc, "make listener non-blocking",
+                           apr_socket_timeout_set(ld[i], 0));
+        num = 6 - total;
+        rv = apr_socket_accept_many(sd + total, &num, ld[i], pools);
+        if (rv == APR_SUCCESS) {
+            total += num;
+        }
+        else {
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+        }
+    }
+    ABTS_INT_EQUAL(tc, 6, total);
+
+    for (i = 0; i < 6; i++) {
+        apr_socket_close(cd[i]);
+    }
+    for (i = 0; i < total; i++) {
+        apr_socket_close(sd[i]);
+    }
+    apr_socket_close(ld[0]);
+    apr_socket_close(ld[1]);
+
+    rv = apr_socket_listen_group_create(ld, 2, sa, SOCK_STREAM,
+                                        APR_PROTO_TCP, 8,
+                                        APR_LISTEN_GROUP_CPU, p);
+    if (rv != APR_ENOTIMPL) {
+        APR_ASSERT_SUCCESS(tc, "create steered listener group", rv);
+        apr_socket_close(ld[0]);
+        apr_socket_close(ld[1]);
+    }
+}
+
+/* A loopback address on the given port */
+static apr_sockaddr_t *loopback_addr(abts_case *tc, apr_port_t port)
+{
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, port, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    return sa;
+}
+
+static apr_socket_t *listen_on(abts_case *tc, apr_int32_t backlog,
+                               apr_port_t *port)
+{
+    apr_socket_t *ld;
+    apr_sockaddr_t *sa = loopback_addr(tc, 0);
+    apr_status_t rv;
+
+    rv = apr_socket_create(&ld, sa->family, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating socket", rv);
+    APR_ASSERT_SUCCESS(tc, "bind", apr_socket_bind(ld, sa));
+    APR_ASSERT_SUCCESS(tc, "listen", apr_socket_listen(ld, backlog));
+    APR_ASSERT_SUCCESS(tc, "get listener address",
+                       apr_socket_addr_get(&sa, APR_LOCAL, ld));
+    *port = sa->port;
+    return ld;
+}
+
+/* A port which drops connection requests: a listener whose queue is
+ * kept full.
+ */
+static apr_socket_t *blackhole(abts_case *tc, apr_socket_t **cd,
+                               apr_port_t *port)
+{
+    apr_socket_t *ld = listen_on(tc, 0, port);
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        APR_ASSERT_SUCCESS(tc, "create client socket",
+                           apr_socket_create(&cd[i], APR_INET, SOCK_STREAM,
+                                             APR_PROTO_TCP, p));
+        apr_socket_timeout_set(cd[i], 0);
+        apr_socket_connect(cd[i], loopback_addr(tc, *port));
+    }
+
+    /* The second request is left hanging where the queue overflows */
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLOUT;
+    pfd.desc.s = cd[1];
+    if (apr_poll(&pfd, 1, &num, apr_time_from_msec(50)) == APR_SUCCESS) {
+        for (i = 0; i < 2; i++) {
+            apr_socket_close(cd[i]);
+        }
+        apr_socket_close(ld);
+        return NULL;
+    }
+    return ld;
+}
+
+static void test_connect_multi(abts_case *tc, void *data)
+{
+    apr_socket_t *ld, *bd, *cd, *sd, *fill[2];
+    apr_sockaddr_t *sa, *refused, *dropped;
+    apr_port_t port, closed_port, dropped_port;
+    apr_time_t start;
+    apr_status_t rv;
+
+    ld = listen_on(tc, 8, &port);
+
+    /* A port nobody listens on */
+    apr_socket_close(listen_on(tc, 1, &closed_port));
+    refused = loopback_addr(tc, closed_port);
+
+    rv = apr_socket_connect_multi(&cd, refused, SOCK_STREAM, APR_PROTO_TCP,
+                                  0, apr_time_from_sec(5), p);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_ECONNREFUSED(rv));
+    ABTS_PTR_EQUAL(tc, NULL, cd);
+
+    /* A refused attempt makes way for the next one at once */
+    refused->next = loopback_addr(tc, port);
+    start = apr_time_now();
+    rv = apr_socket_connect_multi(&cd, refused, SOCK_STREAM, APR_PROTO_TCP,
+                                  apr_time_from_sec(5), apr_time_from_sec(5),
+                                  p);
+    APR_ASSERT_SUCCESS(tc, "connect past refused address", rv);
+    ABTS_ASSERT(tc, "no delay after refusal",
+                apr_time_now() - start < apr_time_from_sec(2));
+    APR_ASSERT_SUCCESS(tc, "get remote address",
+                       apr_socket_addr_get(&sa, APR_REMOTE, cd));
+    ABTS_INT_EQUAL(tc, port, sa->port);
+    APR_ASSERT_SUCCESS(tc, "accept", apr_socket_accept(&sd, ld, p));
+    apr_socket_close(sd);
+    apr_socket_close(cd);
+
+    bd = blackhole(tc, fill, &dropped_port);
+    if (!bd) {
+        ABTS_NOT_IMPL(tc, "dropping connection requests on the loopback");
+        apr_socket_close(ld);
+        return;
+    }
+    dropped = loopback_addr(tc, dropped_port);
+
+    rv = apr_socket_connect_multi(&cd, dropped, SOCK_STREAM, APR_PROTO_TCP,
+                                  0, apr_time_from_msec(100), p);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    /* The next attempt starts after the delay and wins the race */
+    dropped->next = loopback_addr(tc, port);
+    start = apr_time_now();
+    rv = apr_socket_connect_multi(&cd, dropped, SOCK_STREAM, APR_PROTO_TCP,
+                                  apr_time_from_msec(50),
+                                  apr_time_from_sec(5), p);
+    APR_ASSERT_SUCCESS(tc, "connect past dropped address", rv);
+    ABTS_ASSERT(tc, "raced past the dropped address",
+                apr_time_now() - start < apr_time_from_msec(900));
+    APR_ASSERT_SUCCESS(tc, "get remote address",
+                       apr_socket_addr_get(&sa, APR_REMOTE, cd));
+    ABTS_INT_EQUAL(tc, port, sa->port);
+
+    /* The winner is blocking and usable */
+    APR_ASSERT_SUCCESS(tc, "accept", apr_socket_accept(&sd, ld, p));
+    {
+        apr_interval_time_t t;
+        apr_size_t len = 4;
+        char buf[4];
+
+        apr_socket_timeout_get(cd, &t);
+        ABTS_INT_EQUAL(tc, -1, (int)t);
+        APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(cd, "ping", &len));
+        len = sizeof(buf);
+        APR_ASSERT_SUCCESS(tc, "recv", apr_socket_recv(sd, buf, &len));
+        ABTS_INT_EQUAL(tc, 4, (int)len);
+    }
+    apr_socket_close(sd);
+    apr_socket_close(cd);
+
+    apr_socket_close(fill[0]);
+    apr_socket_close(fill[1]);
+    apr_socket_close(bd);
+    apr_socket_close(ld);
+}
+
 abts_suite *testsock(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -621,8 +1007,12 @@ abts_suite *testsock(abts_suite *suite)
     abts_run_test(suite, test_timeout, NULL);
     abts_run_test(suite, test_print_addr, NULL);
     abts_run_test(suite, test_get_addr, NULL);
+    abts_run_test(suite, test_splice, NULL);
     abts_run_test(suite, test_wait, NULL);
     abts_run_test(suite, test_nonblock_inheritance, NULL);
+    abts_run_test(suite, test_accept_many, NULL);
+    abts_run_test(suite, test_listen_group, NULL);
+    abts_run_test(suite, test_connect_multi, NULL);
 #if APR_HAVE_SOCKADDR_UN
     socket_name = UNIX_SOCKET_NAME;
     socket_type = APR_UNIX;
@@ -0,0 +1,221 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_socket_pool.h"
+#include "apr_network_io.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "testutil.h"
+
+/* A listener on the loopback, whose connections wait in its backlog */
+static apr_socket_t *listen_on(abts_case *tc, apr_sockaddr_t **sa)
+{
+    apr_socket_t *listener;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+    rv = apr_socket_bind(listener, *sa);
+    APR_ASSERT_SUCCESS(tc, "bind listener", rv);
+    rv = apr_socket_listen(listener, 16);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "get listener address", rv);
+
+    return listener;
+}
+
+static void test_reuse(abts_case *tc, void *data)
+{
+    apr_socket_pool_t *spool;
+    apr_socket_pool_stats_t stats;
+    apr_socket_t *l1, *l2, *a, *b, *c, *s;
+    apr_sockaddr_t *sa1, *sa2;
+    apr_status_t rv;
+
+    l1 = listen_on(tc, &sa1);
+    l2 = listen_on(tc, &sa2);
+
+    rv = apr_socket_pool_create(&spool, 0, 4, 0, -1, p);
+    APR_ASSERT_SUCCESS(tc, "create connection pool", rv);
+
+    rv = apr_socket_pool_acquire(&a, spool, sa1);
+    APR_ASSERT_SUCCESS(tc, "acquire a new connection", rv);
+    rv = apr_socket_pool_release(spool, a, 1);
+    APR_ASSERT_SUCCESS(tc, "release the connection", rv);
+    rv = apr_socket_pool_acquire(&s, spool, sa1);
+    APR_ASSERT_SUCCESS(tc, "acquire the idle connection", rv);
+    ABTS_PTR_EQUAL(tc, a, s);
+
+    /* the connection released last is reused first */
+    rv = apr_socket_pool_acquire(&b, spool, sa1);
+    APR_ASSERT_SUCCESS(tc, "acquire a second connection", rv);
+    ABTS_ASSERT(tc, "a second connection", a != b);
+    apr_socket_pool_release(spool, a, 1);
+    apr_socket_pool_release(spool, b, 1);
+    rv = apr_socket_pool_acquire(&s, spool, sa1);
+    APR_ASSERT_SUCCESS(tc, "acquire an idle connection", rv);
+    ABTS_PTR_EQUAL(tc, b, s);
+    rv = apr_socket_pool_acquire(&s, spool, sa1);
+    APR_ASSERT_SUCCESS(tc, "acquire the other idle connection", rv);
+    ABTS_PTR_EQUAL(tc, a, s);
+
+    /* connections to another address are not shared */
+    rv = apr_socket_pool_acquire(&c, spool, sa2);
+    APR_ASSERT_SUCCESS(tc, "acquire a connection to another address", rv);
+    ABTS_ASSERT(tc, "a third connection", c != a && c != b);
+
+    apr_socket_pool_stats_get(spool, &stats);
+    ABTS_INT_EQUAL(tc, 3, (int)stats.connected);
+    ABTS_INT_EQUAL(tc, 3, (int)stats.reused);
+    ABTS_INT_EQUAL(tc, 3, stats.active);
+    ABTS_INT_EQUAL(tc, 0, stats.idle);
+    ABTS_INT_EQUAL(tc, 2, stats.addresses);
+
+    apr_socket_pool_release(spool, a, 0);
+    apr_socket_pool_release(spool, b, 1);
+    apr_socket_pool_release(spool, c, 1);
+    apr_socket_pool_stats_get(spool, &stats);
+    ABTS_INT_EQUAL(tc, 0, stats.active);
+    ABTS_INT_EQUAL(tc, 2, stats.idle);
+
+    /* not a pooled socket */
+    rv = apr_socket_pool_release(spool, l1, 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_socket_close(l1);
+    apr_socket_close(l2);
+}
+
+static void test_limits(abts_case *tc, void *data)
+{
+    apr_socket_pool_t *spool;
+    apr_socket_pool_stats_t stats;
+    apr_socket_t *l, *a, *b, *s;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    l = listen_on(tc, &sa);
+
+    rv = apr_socket_pool_create(&spool, 2, 1, 0, -1, p);
+    APR_ASSERT_SUCCESS(tc, "create connection pool", rv);
+
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a connection", rv);
+    rv = apr_socket_pool_acquire(&b, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a second connection", rv);
+    rv = apr_socket_pool_acquire(&s, spool, sa);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    /* one idle connection is kept, the older one is closed */
+    apr_socket_pool_release(spool, a, 1);
+    apr_socket_pool_release(spool, b, 1);
+    apr_socket_pool_stats_get(spool, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.refused);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.expired);
+    ABTS_INT_EQUAL(tc, 1, stats.idle);
+    ABTS_INT_EQUAL(tc, 0, stats.active);
+
+    rv = apr_socket_pool_acquire(&s, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire the idle connection", rv);
+    ABTS_PTR_EQUAL(tc, b, s);
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire below the limit", rv);
+
+    apr_socket_pool_release(spool, a, 0);
+    apr_socket_pool_release(spool, b, 0);
+    apr_socket_close(l);
+}
+
+static void test_dead(abts_case *tc, void *data)
+{
+    apr_socket_pool_t *spool;
+    apr_socket_pool_stats_t stats;
+    apr_socket_t *l, *a, *s;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    l = listen_on(tc, &sa);
+
+    rv = apr_socket_pool_create(&spool, 0, 4, 0, -1, p);
+    APR_ASSERT_SUCCESS(tc, "create connection pool", rv);
+
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a connection", rv);
+    apr_socket_pool_release(spool, a, 1);
+
+    /* the server closes the idle connection */
+    rv = apr_socket_accept(&s, l, p);
+    APR_ASSERT_SUCCESS(tc, "accept", rv);
+    apr_socket_close(s);
+    apr_sleep(apr_time_from_msec(50));
+
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a new connection", rv);
+
+    apr_socket_pool_stats_get(spool, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.dead);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.reused);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.connected);
+    ABTS_INT_EQUAL(tc, 1, stats.active);
+
+    apr_socket_pool_release(spool, a, 0);
+    apr_socket_close(l);
+}
+
+static void test_ttl(abts_case *tc, void *data)
+{
+    apr_socket_pool_t *spool;
+    apr_socket_pool_stats_t stats;
+    apr_socket_t *l, *a;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    l = listen_on(tc, &sa);
+
+    rv = apr_socket_pool_create(&spool, 0, 4, apr_time_from_msec(20), -1, p);
+    APR_ASSERT_SUCCESS(tc, "create connection pool", rv);
+
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a connection", rv);
+    apr_socket_pool_release(spool, a, 1);
+    apr_sleep(apr_time_from_msec(50));
+
+    rv = apr_socket_pool_acquire(&a, spool, sa);
+    APR_ASSERT_SUCCESS(tc, "acquire a new connection", rv);
+
+    apr_socket_pool_stats_get(spool, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.expired);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.reused);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.connected);
+
+    apr_socket_pool_release(spool, a, 0);
+    apr_socket_close(l);
+}
+
+abts_suite *testsocketpool(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_reuse, NULL);
+    abts_run_test(suite, test_limits, NULL);
+    abts_run_test(suite, test_dead, NULL);
+    abts_run_test(suite, test_ttl, NULL);
+
+    return suite;
+}
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include "apr_network_io.h"
 #include "apr_errno.h"
 #include "apr_general.h"
@@ -190,6 +192,146 @@ static void sendto_receivefrom6(abts_case *tc, void *data)
 }
 #endif
 
+static void sendto_receivefrom_batch(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *sock, *sock2;
+    apr_sockaddr_t *to, *from, *sa;
+    apr_socket_msg_t msgs[8];
+    apr_sockaddr_t addrs[8];
+    char sendbuf[3000], recvbuf[8][3000];
+    apr_int32_t num;
+    apr_size_t total;
+    int i;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&sock, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket", rv);
+    rv = apr_socket_create(&sock2, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket2", rv);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket",
+                       apr_socket_bind(sock, sa));
+    APR_ASSERT_SUCCESS(tc, "Could not get socket address",
+                       apr_socket_addr_get(&to, APR_LOCAL, sock));
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket2",
+                       apr_socket_bind(sock2, sa));
+    APR_ASSERT_SUCCESS(tc, "Could not get socket2 address",
+                       apr_socket_addr_get(&from, APR_LOCAL, sock2));
+
+    for (i = 0; i < 5; i++) {
+        sendbuf[i] = 'a' + i;
+        msgs[i].addr = to;
+        msgs[i].buf = sendbuf + i;
+        msgs[i].len = 1;
+        msgs[i].segment_size = 0;
+    }
+    num = 5;
+    rv = apr_socket_sendto_batch(sock2, msgs, &num, 0);
+    APR_ASSERT_SUCCESS(tc, "Could not send datagrams", rv);
+    ABTS_INT_EQUAL(tc, 5, num);
+
+    for (i = 0; i < 8; i++) {
+        msgs[i].addr = &addrs[i];
+        msgs[i].buf = recvbuf[i];
+        msgs[i].len = sizeof(recvbuf[i]);
+    }
+    num = 8;
+    rv = apr_socket_recvfrom_batch(sock, msgs, &num, 0);
+    APR_ASSERT_SUCCESS(tc, "Could not receive datagrams", rv);
+    ABTS_INT_EQUAL(tc, 5, num);
+    for (i = 0; i < num; i++) {
+        ABTS_SIZE_EQUAL(tc, 1, msgs[i].nbytes);
+        ABTS_INT_EQUAL(tc, 'a' + i, recvbuf[i][0]);
+        ABTS_INT_EQUAL(tc, from->port, addrs[i].port);
+    }
+
+    /* A segmented datagram arrives as segments, or coalesced with GRO */
+    rv = apr_socket_opt_set(sock, APR_UDP_GRO, 1);
+    ABTS_ASSERT(tc, "Could not set GRO on socket",
+                rv == APR_SUCCESS || rv == APR_ENOTIMPL);
+    memset(sendbuf, 'x', sizeof(sendbuf));
+    msgs[0].addr = to;
+    msgs[0].buf = sendbuf;
+    msgs[0].len = sizeof(sendbuf);
+    msgs[0].segment_size = 1000;
+    num = 1;
+    rv = apr_socket_sendto_batch(sock2, msgs, &num, 0);
+    APR_ASSERT_SUCCESS(tc, "Could not send segmented datagram", rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_SIZE_EQUAL(tc, sizeof(sendbuf), msgs[0].nbytes);
+
+    APR_ASSERT_SUCCESS(tc, "Could not set timeout",
+                       apr_socket_timeout_set(sock, apr_time_from_sec(5)));
+    for (total = 0; total < sizeof(sendbuf); ) {
+        for (i = 0; i < 8; i++) {
+            msgs[i].addr = NULL;
+            msgs[i].buf = recvbuf[i];
+            msgs[i].len = sizeof(recvbuf[i]);
+        }
+        num = 8;
+        rv = apr_socket_recvfrom_batch(sock, msgs, &num, 0);
+        APR_ASSERT_SUCCESS(tc, "Could not receive segments", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        for (i = 0; i < num; i++) {
+            total += msgs[i].nbytes;
+            if (msgs[i].nbytes > 1000) {
+                ABTS_SIZE_EQUAL(tc, 1000, msgs[i].segment_size);
+            }
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, sizeof(sendbuf), total);
+
+    /* More segments than a single send may have (64 on Linux), to a
+     * socket without GRO to receive them one by one */
+    apr_socket_close(sock);
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&sock, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Could not create socket", rv);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket",
+                       apr_socket_bind(sock, sa));
+    APR_ASSERT_SUCCESS(tc, "Could not get socket address",
+                       apr_socket_addr_get(&to, APR_LOCAL, sock));
+    msgs[0].addr = to;
+    msgs[0].buf = sendbuf;
+    msgs[0].len = sizeof(sendbuf);
+    msgs[0].segment_size = 20;
+    num = 1;
+    rv = apr_socket_sendto_batch(sock2, msgs, &num, 0);
+    APR_ASSERT_SUCCESS(tc, "Could not send 150 segments", rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_SIZE_EQUAL(tc, sizeof(sendbuf), msgs[0].nbytes);
+
+    APR_ASSERT_SUCCESS(tc, "Could not set timeout",
+                       apr_socket_timeout_set(sock, apr_time_from_sec(5)));
+    for (total = 0; total < sizeof(sendbuf); ) {
+        for (i = 0; i < 8; i++) {
+            msgs[i].addr = NULL;
+            msgs[i].buf = recvbuf[i];
+            msgs[i].len = sizeof(recvbuf[i]);
+        }
+        num = 8;
+        rv = apr_socket_recvfrom_batch(sock, msgs, &num, 0);
+        APR_ASSERT_SUCCESS(tc, "Could not receive segments", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        for (i = 0; i < num; i++) {
+            ABTS_SIZE_EQUAL(tc, 20, msgs[i].nbytes);
+            total += msgs[i].nbytes;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, sizeof(sendbuf), total);
+
+    apr_socket_close(sock);
+    apr_socket_close(sock2);
+}
+
 static void socket_userdata(abts_case *tc, void *data)
 {
     apr_socket_t *sock1, *sock2;
@@ -223,6 +365,7 @@ abts_suite *testsockets(abts_suite *suite)
     abts_run_test(suite, udp_socket, NULL);
 
     abts_run_test(suite, sendto_receivefrom, NULL);
+    abts_run_test(suite, sendto_receivefrom_batch, NULL);
 
 #if APR_HAVE_IPV6
     abts_run_test(suite, tcp6_socket, NULL);
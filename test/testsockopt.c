@@ -15,11 +15,16 @@
  */
 
 #include "apr_network_io.h"
+#include "apr_file_io.h"
+#include "apr_time.h"
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_lib.h"
 #include "testutil.h"
 
+#include <errno.h>
+#include <string.h>
+
 static apr_socket_t *sock = NULL;
 
 static void create_socket(abts_case *tc, void *data)
@@ -115,6 +120,344 @@ static void corkable(abts_case *tc, void *data)
 #endif
 }
 
+/* Options the system may lack, or reserve to the administrator */
+static void latency_option(abts_case *tc, apr_int32_t opt, apr_int32_t on)
+{
+    apr_status_t rv;
+    apr_int32_t ck;
+
+    rv = apr_socket_opt_set(sock, opt, on);
+    if (rv == APR_ENOTIMPL || rv == APR_FROM_OS_ERROR(EPERM)
+        || APR_STATUS_IS_EACCES(rv)) {
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_socket_opt_get(sock, opt, &ck);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, ck);
+}
+
+static void latency_options(abts_case *tc, void *data)
+{
+    latency_option(tc, APR_TCP_NOTSENT_LOWAT, 16384);
+    latency_option(tc, APR_TCP_QUICKACK, 1);
+    latency_option(tc, APR_SO_BUSY_POLL, 50);
+    latency_option(tc, APR_SO_PREFER_BUSY_POLL, 1);
+}
+
+static void fastopen(abts_case *tc, void *data)
+{
+    apr_socket_t *listener, *client, *server;
+    apr_socket_stats_t stats;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    apr_int32_t cpu;
+    apr_size_t len;
+    char buf[16];
+    int i;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+
+    rv = apr_socket_opt_set(listener, APR_TCP_FASTOPEN, 16);
+    if (rv == APR_ENOTIMPL) {
+        apr_socket_close(listener);
+        ABTS_NOT_IMPL(tc, "TCP Fast Open");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "set APR_TCP_FASTOPEN", rv);
+
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "bind listener", rv);
+    rv = apr_socket_listen(listener, 5);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "get listener address", rv);
+
+    /* the second connection may carry its data in the SYN, with the
+     * cookie obtained by the first */
+    for (i = 0; i < 2; i++) {
+        rv = apr_socket_create(&client, APR_INET, SOCK_STREAM, 0, p);
+        APR_ASSERT_SUCCESS(tc, "create client", rv);
+
+        len = 5;
+        rv = apr_socket_connect_data(client, sa, "hello", &len);
+        APR_ASSERT_SUCCESS(tc, "connect with data", rv);
+        ABTS_SIZE_EQUAL(tc, 5, len);
+        if (apr_socket_stats_get(client, &stats) == APR_SUCCESS) {
+            ABTS_ASSERT(tc, "data sent counted", stats.bytes_sent == 5);
+        }
+
+        rv = apr_socket_accept(&server, listener, p);
+        APR_ASSERT_SUCCESS(tc, "accept", rv);
+
+        len = sizeof(buf);
+        rv = apr_socket_recv(server, buf, &len);
+        APR_ASSERT_SUCCESS(tc, "receive", rv);
+        ABTS_SIZE_EQUAL(tc, 5, len);
+        ABTS_ASSERT(tc, "data received", memcmp(buf, "hello", 5) == 0);
+
+        rv = apr_socket_opt_get(server, APR_SO_INCOMING_CPU, &cpu);
+        if (rv != APR_ENOTIMPL) {
+            APR_ASSERT_SUCCESS(tc, "get APR_SO_INCOMING_CPU", rv);
+            ABTS_ASSERT(tc, "incoming CPU", cpu >= -1);
+        }
+
+        apr_socket_close(server);
+        apr_socket_close(client);
+    }
+
+    apr_socket_close(listener);
+}
+
+static void tcp_info_stats(abts_case *tc, void *data)
+{
+    apr_socket_t *listener, *client, *server;
+    apr_socket_tcp_info_t info;
+    apr_socket_stats_t stats;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    apr_size_t len;
+    char buf[1000];
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "bind listener", rv);
+    rv = apr_socket_listen(listener, 5);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "get listener address", rv);
+
+    rv = apr_socket_create(&client, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create client", rv);
+    rv = apr_socket_connect(client, sa);
+    APR_ASSERT_SUCCESS(tc, "connect", rv);
+    rv = apr_socket_accept(&server, listener, p);
+    APR_ASSERT_SUCCESS(tc, "accept", rv);
+
+    rv = apr_socket_stats_get(client, &stats);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "socket statistics");
+    }
+    else {
+        APR_ASSERT_SUCCESS(tc, "get client statistics", rv);
+        ABTS_ASSERT(tc, "nothing sent yet", stats.send_calls == 0
+                                            && stats.bytes_sent == 0);
+
+        memset(buf, 'x', sizeof(buf));
+        len = sizeof(buf);
+        rv = apr_socket_send(client, buf, &len);
+        APR_ASSERT_SUCCESS(tc, "send", rv);
+
+        rv = apr_socket_stats_get(client, &stats);
+        APR_ASSERT_SUCCESS(tc, "get client statistics", rv);
+        ABTS_ASSERT(tc, "one send call", stats.send_calls == 1);
+        ABTS_ASSERT(tc, "bytes sent", stats.bytes_sent == len);
+
+        len = sizeof(buf);
+        rv = apr_socket_recv(server, buf, &len);
+        APR_ASSERT_SUCCESS(tc, "receive", rv);
+
+        /* nothing more to read */
+        rv = apr_socket_timeout_set(server, 0);
+        APR_ASSERT_SUCCESS(tc, "make server non-blocking", rv);
+        rv = apr_socket_recv(server, buf, &len);
+        ABTS_ASSERT(tc, "would block", APR_STATUS_IS_EAGAIN(rv));
+
+        rv = apr_socket_stats_get(server, &stats);
+        APR_ASSERT_SUCCESS(tc, "get server statistics", rv);
+        ABTS_ASSERT(tc, "receive calls", stats.recv_calls == 2);
+        ABTS_ASSERT(tc, "one would block", stats.recv_eagain == 1);
+        ABTS_ASSERT(tc, "bytes received",
+                    stats.bytes_received > 0
+                    && stats.bytes_received <= sizeof(buf));
+    }
+
+    rv = apr_socket_tcp_info_get(client, &info);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "TCP_INFO");
+    }
+    else {
+        APR_ASSERT_SUCCESS(tc, "get TCP information", rv);
+        ABTS_ASSERT(tc, "round trip time", info.rtt >= 0);
+        ABTS_ASSERT(tc, "segment size", info.snd_mss > 0);
+        ABTS_ASSERT(tc, "congestion window", info.snd_cwnd > 0);
+    }
+
+    apr_socket_close(server);
+    apr_socket_close(client);
+    apr_socket_close(listener);
+}
+
+#if APR_HAS_SENDFILE
+static void sendfile_stats(abts_case *tc, void *data)
+{
+    apr_socket_t *listener, *client, *server;
+    apr_socket_stats_t stats;
+    apr_sockaddr_t *sa;
+    apr_file_t *f;
+    apr_hdtr_t hdtr;
+    struct iovec hdr;
+    apr_off_t off = 0;
+    apr_status_t rv;
+    apr_size_t len;
+    char buf[1000];
+
+    rv = apr_file_open(&f, "data/sockopt_sendfile.txt",
+                       APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE | APR_FOPEN_DELONCLOSE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open file", rv);
+    memset(buf, 'x', sizeof(buf));
+    rv = apr_file_write_full(f, buf, sizeof(buf), NULL);
+    APR_ASSERT_SUCCESS(tc, "write file", rv);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "bind listener", rv);
+    rv = apr_socket_listen(listener, 5);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "get listener address", rv);
+
+    rv = apr_socket_create(&client, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create client", rv);
+    rv = apr_socket_connect(client, sa);
+    APR_ASSERT_SUCCESS(tc, "connect", rv);
+    rv = apr_socket_accept(&server, listener, p);
+    APR_ASSERT_SUCCESS(tc, "accept", rv);
+
+    /* the header is copied from memory, the file is not */
+    hdr.iov_base = "head:";
+    hdr.iov_len = 5;
+    hdtr.headers = &hdr;
+    hdtr.numheaders = 1;
+    hdtr.trailers = NULL;
+    hdtr.numtrailers = 0;
+    len = sizeof(buf);
+    rv = apr_socket_sendfile(client, f, &hdtr, &off, &len, 0);
+    APR_ASSERT_SUCCESS(tc, "sendfile", rv);
+    ABTS_SIZE_EQUAL(tc, 5 + sizeof(buf), len);
+
+    rv = apr_socket_stats_get(client, &stats);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "socket statistics");
+    }
+    else {
+        APR_ASSERT_SUCCESS(tc, "get client statistics", rv);
+#ifdef __linux__
+        ABTS_ASSERT(tc, "file bytes sent",
+                    stats.sendfile_bytes == sizeof(buf));
+        ABTS_ASSERT(tc, "all bytes sent", stats.bytes_sent == len);
+#else
+        ABTS_ASSERT(tc, "file bytes sent",
+                    stats.sendfile_bytes <= stats.bytes_sent);
+#endif
+    }
+
+    apr_socket_close(server);
+    apr_socket_close(client);
+    apr_socket_close(listener);
+    apr_file_close(f);
+}
+#endif
+
+static void peek_splice_stats(abts_case *tc, void *data)
+{
+    apr_socket_t *listener, *client, *server;
+    apr_socket_stats_t stats;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    apr_size_t len;
+    int eof = 1;
+#if APR_HAS_SPLICE
+    apr_file_t *readp, *writep;
+    char buf[16];
+#endif
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "bind listener", rv);
+    rv = apr_socket_listen(listener, 5);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "get listener address", rv);
+
+    rv = apr_socket_create(&client, APR_INET, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "create client", rv);
+    rv = apr_socket_connect(client, sa);
+    APR_ASSERT_SUCCESS(tc, "connect", rv);
+    rv = apr_socket_accept(&server, listener, p);
+    APR_ASSERT_SUCCESS(tc, "accept", rv);
+
+    len = 10;
+    rv = apr_socket_send(client, "0123456789", &len);
+    APR_ASSERT_SUCCESS(tc, "send", rv);
+    apr_sleep(apr_time_from_msec(20));
+
+    /* peeking at the data does not count it */
+    rv = apr_socket_atreadeof(server, &eof);
+    APR_ASSERT_SUCCESS(tc, "check for EOF", rv);
+    ABTS_INT_EQUAL(tc, 0, eof);
+    rv = apr_socket_stats_get(server, &stats);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "socket statistics");
+        goto out;
+    }
+    APR_ASSERT_SUCCESS(tc, "get server statistics", rv);
+    ABTS_ASSERT(tc, "nothing received yet", stats.bytes_received == 0);
+
+#if APR_HAS_SPLICE
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&readp, &writep, p));
+
+    /* socket to pipe */
+    len = 10;
+    rv = apr_socket_splice_recv(server, writep, &len);
+    APR_ASSERT_SUCCESS(tc, "splice socket to pipe", rv);
+    ABTS_SIZE_EQUAL(tc, 10, len);
+    rv = apr_socket_stats_get(server, &stats);
+    APR_ASSERT_SUCCESS(tc, "get server statistics", rv);
+    ABTS_ASSERT(tc, "bytes spliced in", stats.splice_recv_bytes == 10);
+    ABTS_ASSERT(tc, "bytes received", stats.bytes_received == 10);
+
+    /* and back from the pipe to the socket */
+    len = 10;
+    rv = apr_socket_splice_send(server, readp, &len);
+    APR_ASSERT_SUCCESS(tc, "splice pipe to socket", rv);
+    ABTS_SIZE_EQUAL(tc, 10, len);
+    rv = apr_socket_stats_get(server, &stats);
+    APR_ASSERT_SUCCESS(tc, "get server statistics", rv);
+    ABTS_ASSERT(tc, "bytes spliced out", stats.sendfile_bytes == 10);
+    ABTS_ASSERT(tc, "bytes sent", stats.bytes_sent == 10);
+
+    len = sizeof(buf);
+    rv = apr_socket_recv(client, buf, &len);
+    APR_ASSERT_SUCCESS(tc, "receive", rv);
+    ABTS_SIZE_EQUAL(tc, 10, len);
+
+    apr_file_close(readp);
+    apr_file_close(writep);
+#endif
+
+out:
+    apr_socket_close(server);
+    apr_socket_close(client);
+    apr_socket_close(listener);
+}
+
 static void close_socket(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -132,6 +475,13 @@ abts_suite *testsockopt(abts_suite *suite)
     abts_run_test(suite, set_debug, NULL);
     abts_run_test(suite, remove_keepalive, NULL);
     abts_run_test(suite, corkable, NULL);
+    abts_run_test(suite, latency_options, NULL);
+    abts_run_test(suite, fastopen, NULL);
+    abts_run_test(suite, tcp_info_stats, NULL);
+#if APR_HAS_SENDFILE
+    abts_run_test(suite, sendfile_stats, NULL);
+#endif
+    abts_run_test(suite, peek_splice_stats, NULL);
     abts_run_test(suite, close_socket, NULL);
 
     return suite;
@@ -0,0 +1,275 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_network_io.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !APR_HAS_THREADS
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for threads.\n");
+    return 0;
+}
+#else /* !APR_HAS_THREADS */
+
+#define MAX_BATCH   64
+#define MAX_SIZE    1472
+/* The payload of a segmented datagram */
+#define MAX_SEGMENTED 65000
+#define IDLE_TIME   apr_time_from_msec(200)
+
+typedef enum {
+    MODE_SINGLE,    /* apr_socket_sendto() / apr_socket_recvfrom() */
+    MODE_BATCH,     /* apr_socket_sendto_batch() / _recvfrom_batch() */
+    MODE_SEGMENT    /* one segmented datagram per batch, with GRO */
+} mode_e;
+
+static const char *mode_names[] = { "single", "batch", "segment" };
+
+static apr_uint64_t num_packets = 1000000;
+static apr_size_t packet_size = 64;
+static int batch = 32;
+
+typedef struct sender_t {
+    apr_socket_t *sock;
+    apr_sockaddr_t *to;
+    mode_e mode;
+    apr_uint64_t sent;
+    apr_interval_time_t elapsed;
+    apr_status_t rv;
+} sender_t;
+
+static void * APR_THREAD_FUNC sender(apr_thread_t *thd, void *data)
+{
+    sender_t *s = data;
+    static char buf[MAX_BATCH * MAX_SIZE];
+    apr_socket_msg_t msgs[MAX_BATCH];
+    apr_time_t start = apr_time_now();
+    apr_int32_t num;
+    apr_size_t len;
+    int i, segments = batch;
+
+    memset(buf, 'x', sizeof(buf));
+    for (i = 0; i < batch; i++) {
+        msgs[i].addr = s->to;
+        msgs[i].buf = buf + i * packet_size;
+        msgs[i].len = packet_size;
+        msgs[i].segment_size = 0;
+    }
+    if (s->mode == MODE_SEGMENT) {
+        while (segments > 1 && segments * packet_size > MAX_SEGMENTED) {
+            segments--;
+        }
+        msgs[0].len = segments * packet_size;
+        msgs[0].segment_size = packet_size;
+    }
+
+    while (s->sent < num_packets && s->rv == APR_SUCCESS) {
+        switch (s->mode) {
+        case MODE_SINGLE:
+            len = packet_size;
+            s->rv = apr_socket_sendto(s->sock, s->to, 0, buf, &len);
+            s->sent++;
+            break;
+        case MODE_BATCH:
+            num = batch;
+            s->rv = apr_socket_sendto_batch(s->sock, msgs, &num, 0);
+            s->sent += num;
+            break;
+        case MODE_SEGMENT:
+            num = 1;
+            s->rv = apr_socket_sendto_batch(s->sock, msgs, &num, 0);
+            s->sent += num * segments;
+            break;
+        }
+    }
+    s->elapsed = apr_time_now() - start;
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static apr_status_t run(mode_e mode, apr_pool_t *pool)
+{
+    static char buf[MAX_BATCH][MAX_SEGMENTED];
+    apr_socket_msg_t msgs[MAX_BATCH];
+    apr_socket_t *rsock;
+    apr_sockaddr_t *sa;
+    apr_thread_t *thd;
+    sender_t s;
+    apr_uint64_t received = 0, calls = 0;
+    apr_time_t start = 0, last = 0;
+    apr_status_t rv, trv;
+    apr_int32_t num;
+    int i;
+
+    memset(&s, 0, sizeof(s));
+    s.mode = mode;
+    if ((rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0,
+                                    pool)) != APR_SUCCESS
+        || (rv = apr_socket_create(&rsock, APR_INET, SOCK_DGRAM, 0,
+                                   pool)) != APR_SUCCESS
+        || (rv = apr_socket_bind(rsock, sa)) != APR_SUCCESS
+        || (rv = apr_socket_addr_get(&s.to, APR_LOCAL, rsock))
+            != APR_SUCCESS
+        || (rv = apr_socket_timeout_set(rsock, IDLE_TIME)) != APR_SUCCESS
+        || (rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0,
+                                       pool)) != APR_SUCCESS
+        || (rv = apr_socket_create(&s.sock, APR_INET, SOCK_DGRAM, 0,
+                                   pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_socket_opt_set(rsock, APR_SO_RCVBUF, 8 << 20);
+    if (mode == MODE_SEGMENT) {
+        apr_socket_opt_set(rsock, APR_UDP_GRO, 1);
+    }
+
+    if ((rv = apr_thread_create(&thd, NULL, sender, &s, pool))
+            != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (;;) {
+        if (mode == MODE_SINGLE) {
+            apr_size_t len = sizeof(buf[0]);
+
+            num = 1;
+            rv = apr_socket_recvfrom(sa, rsock, 0, buf[0], &len);
+            msgs[0].nbytes = len;
+            msgs[0].segment_size = 0;
+        }
+        else {
+            for (i = 0; i < batch; i++) {
+                msgs[i].addr = NULL;
+                msgs[i].buf = buf[i];
+                msgs[i].len = sizeof(buf[i]);
+            }
+            num = batch;
+            rv = apr_socket_recvfrom_batch(rsock, msgs, &num, 0);
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        last = apr_time_now();
+        if (!start) {
+            start = last;
+        }
+        calls++;
+        for (i = 0; i < num; i++) {
+            received += msgs[i].segment_size
+                        ? msgs[i].nbytes / packet_size : 1;
+        }
+    }
+    apr_thread_join(&trv, thd);
+    apr_socket_close(rsock);
+    apr_socket_close(s.sock);
+
+    if (s.rv != APR_SUCCESS) {
+        return s.rv;
+    }
+    if (!APR_STATUS_IS_TIMEUP(rv) && !APR_STATUS_IS_EAGAIN(rv)) {
+        return rv;
+    }
+    if (last <= start) {
+        last = start + 1;
+    }
+    if (!s.elapsed) {
+        s.elapsed = 1;
+    }
+
+    printf("    %-8s send %9" APR_UINT64_T_FMT " pps, receive %9"
+           APR_UINT64_T_FMT " pps, %6.2f packets/recv call, %5.2f%% lost\n",
+           mode_names[mode],
+           s.sent * APR_USEC_PER_SEC / s.elapsed,
+           received * APR_USEC_PER_SEC / (last - start),
+           calls ? (double)received / calls : 0.0,
+           s.sent ? 100.0 * (s.sent - received) / s.sent : 0.0);
+    return APR_SUCCESS;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    int mode;
+
+    printf("APR Datagram Packet Rate Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:s:b:", &optchar, &optarg))
+           == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_packets = apr_atoi64(optarg);
+        }
+        else if (optchar == 's') {
+            packet_size = atoi(optarg);
+        }
+        else if (optchar == 'b') {
+            batch = atoi(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if (!num_packets || !packet_size || packet_size > MAX_SIZE
+        || batch < 1 || batch > MAX_BATCH) {
+        fprintf(stderr, "Usage: %s [-n packets] [-s size (max %d)] "
+                "[-b batch (max %d)]\n", argv[0], MAX_SIZE, MAX_BATCH);
+        exit(-1);
+    }
+
+    printf("Sending %" APR_UINT64_T_FMT " datagrams of %" APR_SIZE_T_FMT
+           " bytes, %d per batch, over loopback\n",
+           num_packets, packet_size, batch);
+    for (mode = MODE_SINGLE; mode <= MODE_SEGMENT; mode++) {
+        if ((rv = run(mode, pool)) != APR_SUCCESS) {
+            fprintf(stderr, "    %-8s failed : [%d] %s\n", mode_names[mode],
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        }
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_THREADS */
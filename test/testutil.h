@@ -72,6 +72,8 @@ abts_suite *testdso(abts_suite *suite);
 abts_suite *testdup(abts_suite *suite);
 abts_suite *testenv(abts_suite *suite);
 abts_suite *testfile(abts_suite *suite);
+abts_suite *testfileaio(abts_suite *suite);
+abts_suite *testfileappender(abts_suite *suite);
 abts_suite *testfilecopy(abts_suite *suite);
 abts_suite *testfileinfo(abts_suite *suite);
 abts_suite *testflock(abts_suite *suite);
@@ -95,9 +97,12 @@ abts_suite *testpool(abts_suite *suite);
 abts_suite *testproc(abts_suite *suite);
 abts_suite *testprocmutex(abts_suite *suite);
 abts_suite *testrand(abts_suite *suite);
+abts_suite *testresolver(abts_suite *suite);
 abts_suite *testsleep(abts_suite *suite);
 abts_suite *testshm(abts_suite *suite);
+abts_suite *testshmhash(abts_suite *suite);
 abts_suite *testsock(abts_suite *suite);
+abts_suite *testsocketpool(abts_suite *suite);
 abts_suite *testsockets(abts_suite *suite);
 abts_suite *testsockopt(abts_suite *suite);
 abts_suite *teststr(abts_suite *suite);
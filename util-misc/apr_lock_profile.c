@@ -0,0 +1,412 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_atomic.h"
+#include "apr_strings.h"
+#include "apr_portable.h"
+#include "apr_lock_profile_internal.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>     /* for qsort() */
+#endif
+#if APR_HAVE_TIME_H
+#include <time.h>       /* for clock_gettime() */
+#endif
+
+struct apr_lock_profile_t {
+    apr_lock_profile_t *next;
+    apr_lock_profile_t *prev;
+    apr_pool_t *pool;
+    /* serializes the updates which are not made under the lock itself,
+     * i.e. shared acquisitions and condition variable waits */
+    volatile apr_uint32_t busy;
+    /* nesting of the current exclusive hold (recursive mutexes), and
+     * when it started, in nanoseconds */
+    apr_uint32_t hold_depth;
+    apr_uint64_t hold_start;
+    apr_lock_profile_info_t info;
+};
+
+static volatile apr_uint32_t profiling = 0;
+
+/* All the profiles, guarded by registry_lock.  Locks are created and
+ * destroyed rarely enough for a spin lock to do, and a spin lock needs
+ * no initialization (which could only be done by a lock).
+ */
+static apr_lock_profile_t *registry = NULL;
+static volatile apr_uint32_t registry_lock = 0;
+
+/* The names given with apr_lock_profile_name_next(), per thread, also
+ * guarded by registry_lock.
+ */
+#define PENDING_NAMES 16
+static struct {
+#if APR_HAS_THREADS
+    apr_os_thread_t thread;
+#endif
+    const char *name;
+} pending[PENDING_NAMES];
+static int npending = 0;
+
+static void spin_lock(volatile apr_uint32_t *lock)
+{
+    int n = 0;
+
+    while (apr_atomic_cas32(lock, 1, 0) != 0) {
+        if (++n % 64 == 0) {
+            apr_sleep(0);
+        }
+    }
+}
+
+static void spin_unlock(volatile apr_uint32_t *lock)
+{
+    apr_atomic_set32(lock, 0);
+}
+
+#if APR_HAS_THREADS
+#define PENDING_MINE(i) apr_os_thread_equal(pending[i].thread, \
+                                            apr_os_thread_current())
+#else
+#define PENDING_MINE(i) 1
+#endif
+
+/* Hold times are short, mostly well below a microsecond */
+static apr_uint64_t hold_clock(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (apr_uint64_t)ts.tv_sec * APR_UINT64_C(1000000000)
+               + ts.tv_nsec;
+    }
+#endif
+    return (apr_uint64_t)apr_time_now() * 1000;
+}
+
+static int hold_bucket(apr_uint64_t hold)
+{
+    int bucket = 0;
+
+    while (hold > 0 && bucket < APR_LOCK_PROFILE_BUCKETS - 1) {
+        hold >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Take the name for the calling thread's next lock, if any; called with
+ * registry_lock held.
+ */
+static const char *pending_take(void)
+{
+    int i;
+
+    for (i = 0; i < npending; i++) {
+        if (PENDING_MINE(i)) {
+            const char *name = pending[i].name;
+
+            pending[i] = pending[--npending];
+            return name;
+        }
+    }
+    return NULL;
+}
+
+static void record_wait(apr_lock_profile_info_t *info,
+                        apr_interval_time_t wait)
+{
+    info->acquired++;
+    if (wait >= 0) {
+        info->contended++;
+        info->wait_total += wait;
+        if (wait > info->wait_max) {
+            info->wait_max = wait;
+        }
+    }
+}
+
+apr_lock_profile_t *apr_lock_profile_register(const void *lock,
+                                              const char *type,
+                                              apr_pool_t *pool)
+{
+    apr_lock_profile_t *prof;
+
+    if (!apr_atomic_read32(&profiling)) {
+        if (npending) {
+            spin_lock(&registry_lock);
+            pending_take();
+            spin_unlock(&registry_lock);
+        }
+        return NULL;
+    }
+
+    prof = apr_pcalloc(pool, sizeof(*prof));
+    prof->pool = pool;
+    prof->info.lock = lock;
+    prof->info.type = type;
+
+    spin_lock(&registry_lock);
+    if (npending) {
+        const char *name = pending_take();
+
+        if (name) {
+            prof->info.name = apr_pstrdup(pool, name);
+        }
+    }
+    prof->next = registry;
+    if (registry) {
+        registry->prev = prof;
+    }
+    registry = prof;
+    spin_unlock(&registry_lock);
+
+    return prof;
+}
+
+void apr_lock_profile_unregister(apr_lock_profile_t *prof)
+{
+    spin_lock(&registry_lock);
+    if (prof->prev) {
+        prof->prev->next = prof->next;
+    }
+    else {
+        registry = prof->next;
+    }
+    if (prof->next) {
+        prof->next->prev = prof->prev;
+    }
+    prof->next = prof->prev = NULL;
+    spin_unlock(&registry_lock);
+}
+
+void apr_lock_profile_acquired(apr_lock_profile_t *prof,
+                               apr_interval_time_t wait)
+{
+    record_wait(&prof->info, wait);
+    if (prof->hold_depth++ == 0) {
+        prof->hold_start = hold_clock();
+    }
+}
+
+void apr_lock_profile_shared(apr_lock_profile_t *prof,
+                             apr_interval_time_t wait)
+{
+    spin_lock(&prof->busy);
+    record_wait(&prof->info, wait);
+    spin_unlock(&prof->busy);
+}
+
+void apr_lock_profile_released(apr_lock_profile_t *prof)
+{
+    apr_uint64_t hold;
+
+    /* only the outermost hold counts, and nothing for a shared one */
+    if (prof->hold_depth == 0 || --prof->hold_depth > 0) {
+        return;
+    }
+    hold = hold_clock() - prof->hold_start;
+    prof->info.hold_total += hold;
+    prof->info.hold_hist[hold_bucket(hold)]++;
+}
+
+void apr_lock_profile_waited(apr_lock_profile_t *prof,
+                             apr_interval_time_t wait, int timedout)
+{
+    spin_lock(&prof->busy);
+    prof->info.acquired++;
+    if (timedout) {
+        prof->info.contended++;
+    }
+    prof->info.wait_total += wait;
+    if (wait > prof->info.wait_max) {
+        prof->info.wait_max = wait;
+    }
+    spin_unlock(&prof->busy);
+}
+
+void apr_lock_profile_name_copy(apr_lock_profile_t *to,
+                                apr_lock_profile_t *from)
+{
+    spin_lock(&registry_lock);
+    if (from->info.name) {
+        to->info.name = apr_pstrdup(to->pool, from->info.name);
+    }
+    spin_unlock(&registry_lock);
+}
+
+APR_DECLARE(void) apr_lock_profile_enable(int on)
+{
+    apr_atomic_set32(&profiling, on ? 1 : 0);
+}
+
+APR_DECLARE(apr_status_t) apr_lock_profile_name_set(const void *lock,
+                                                    const char *name)
+{
+    apr_lock_profile_t *prof;
+
+    spin_lock(&registry_lock);
+    for (prof = registry; prof; prof = prof->next) {
+        if (prof->info.lock == lock) {
+            prof->info.name = name ? apr_pstrdup(prof->pool, name) : NULL;
+            break;
+        }
+    }
+    spin_unlock(&registry_lock);
+
+    return prof ? APR_SUCCESS : APR_NOTFOUND;
+}
+
+APR_DECLARE(apr_status_t) apr_lock_profile_name_next(const char *name)
+{
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+    spin_lock(&registry_lock);
+    for (i = 0; i < npending; i++) {
+        if (PENDING_MINE(i)) {
+            break;
+        }
+    }
+    if (!name) {
+        if (i < npending) {
+            pending[i] = pending[--npending];
+        }
+    }
+    else if (i < npending) {
+        pending[i].name = name;
+    }
+    else if (npending < PENDING_NAMES) {
+#if APR_HAS_THREADS
+        pending[npending].thread = apr_os_thread_current();
+#endif
+        pending[npending++].name = name;
+    }
+    else {
+        rv = APR_ENOSPC;
+    }
+    spin_unlock(&registry_lock);
+
+    return rv;
+}
+
+static int profile_cmp(const void *a, const void *b)
+{
+    const apr_lock_profile_info_t *pa = a, *pb = b;
+
+    if (pa->wait_total != pb->wait_total) {
+        return pa->wait_total < pb->wait_total ? 1 : -1;
+    }
+    if (pa->contended != pb->contended) {
+        return pa->contended < pb->contended ? 1 : -1;
+    }
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_lock_profile_get(apr_array_header_t **profiles,
+                                               apr_pool_t *pool)
+{
+    apr_array_header_t *arr;
+    apr_lock_profile_t *prof;
+    int n = 0;
+
+    spin_lock(&registry_lock);
+    for (prof = registry; prof; prof = prof->next) {
+        n++;
+    }
+    arr = apr_array_make(pool, n, sizeof(apr_lock_profile_info_t));
+    for (prof = registry; prof; prof = prof->next) {
+        apr_lock_profile_info_t *info = apr_array_push(arr);
+
+        *info = prof->info;
+        if (info->name) {
+            info->name = apr_pstrdup(pool, info->name);
+        }
+    }
+    spin_unlock(&registry_lock);
+
+    if (arr->nelts > 1) {
+        qsort(arr->elts, arr->nelts, arr->elt_size, profile_cmp);
+    }
+
+    *profiles = arr;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_lock_profile_dump(apr_file_t *out,
+                                                apr_pool_t *pool)
+{
+    apr_array_header_t *arr;
+    apr_status_t rv;
+    int i, b, last;
+
+    if ((rv = apr_lock_profile_get(&arr, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < arr->nelts; i++) {
+        const apr_lock_profile_info_t *info =
+            &APR_ARRAY_IDX(arr, i, apr_lock_profile_info_t);
+
+        apr_file_printf(out, "%-13s %-20s %pp acquired %" APR_UINT64_T_FMT
+                        " contended %" APR_UINT64_T_FMT
+                        " wait %" APR_TIME_T_FMT "/%" APR_TIME_T_FMT
+                        " usec hold %" APR_UINT64_T_FMT " nsec",
+                        info->type, info->name ? info->name : "-",
+                        info->lock, info->acquired, info->contended,
+                        info->wait_total, info->wait_max, info->hold_total);
+
+        for (last = APR_LOCK_PROFILE_BUCKETS - 1; last >= 0; last--) {
+            if (info->hold_hist[last]) {
+                break;
+            }
+        }
+        if (last >= 0) {
+            apr_file_puts(" hist", out);
+            for (b = 0; b <= last; b++) {
+                apr_file_printf(out, " %" APR_UINT64_T_FMT,
+                                info->hold_hist[b]);
+            }
+        }
+        rv = apr_file_putc('\n', out);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_lock_profile_reset(void)
+{
+    apr_lock_profile_t *prof;
+
+    spin_lock(&registry_lock);
+    for (prof = registry; prof; prof = prof->next) {
+        apr_lock_profile_info_t *info = &prof->info;
+
+        info->acquired = info->contended = 0;
+        info->wait_total = info->wait_max = 0;
+        info->hold_total = 0;
+        memset(info->hold_hist, 0, sizeof(info->hold_hist));
+    }
+    spin_unlock(&registry_lock);
+}
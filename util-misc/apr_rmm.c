@@ -20,51 +20,94 @@
 #include "apr_lib.h"
 #include "apr_strings.h"
 
-/* The RMM region is made up of two doubly-linked-list of blocks; the
- * list of used blocks, and the list of free blocks (either list may
- * be empty).  The base pointer, rmm->base, points at the beginning of
- * the shmem region in use.  Each block is addressable by an
- * apr_rmm_off_t value, which represents the offset from the base
- * pointer.  The term "address" is used here to mean such a value; an
- * "offset from rmm->base".
+/* The RMM region is managed as a "two-level segregated fit" (TLSF)
+ * allocator, which gives constant time allocation and deallocation
+ * regardless of the number of blocks in the region.  The base pointer,
+ * rmm->base, points at the beginning of the shmem region in use.  Each
+ * block is addressable by an apr_rmm_off_t value, which represents the
+ * offset from the base pointer.  The term "address" is used here to
+ * mean such a value; an "offset from rmm->base".
  *
  * The RMM region contains exactly one "rmm_hdr_block_t" structure,
  * the "header block", which is always stored at the base pointer.
- * The firstused field in this structure is the address of the first
- * block in the "used blocks" list; the firstfree field is the address
- * of the first block in the "free blocks" list.
+ * Besides a magic number and layout version (checked by apr_rmm_attach
+ * so that processes built against an incompatible layout refuse to
+ * share the region), it holds the heads of the segregated free lists
+ * and two levels of bitmaps recording which of these lists are
+ * non-empty.
  *
- * Each block is prefixed by an "rmm_block_t" structure, followed by
- * the caller-usable region represented by the block.  The next and
- * prev fields of the structure are zero if the block is at the end or
- * beginning of the linked-list respectively, or otherwise hold the
- * address of the next and previous blocks in the list.  ("address 0",
- * i.e. rmm->base is *not* a valid address for a block, since the
- * header block is always stored at that address).
+ * Free block sizes are split into "first level" classes by their
+ * power of two, and each first level class is split again into
+ * RMM_SL_COUNT linear "second level" classes.  Blocks smaller than
+ * RMM_SMALL_BLOCK all live in first level class 0, in linear classes
+ * of RMM_ALIGN bytes each.  Finding a free block therefore only takes
+ * a couple of find-first-set operations on the bitmaps.
  *
- * At creation, the RMM region is initialized to hold a single block
- * on the free list representing the entire available shm segment
- * (minus header block); subsequent allocation and deallocation of
- * blocks involves splitting blocks and coalescing adjacent blocks,
- * and switching them between the free and used lists as
- * appropriate. */
+ * Each block, free or used, is prefixed by an "rmm_block_t" structure,
+ * followed by the caller-usable region represented by the block.  The
+ * size field holds the size of the whole block, header included, with
+ * RMM_BLOCK_FREE set while the block is on a free list.  The prev_phys
+ * field is the address of the physically preceding block (zero for the
+ * first block), which together with the size lets adjacent free blocks
+ * be coalesced in constant time.  The prev and next free list links
+ * are only meaningful while the block is free; they overlap the
+ * caller-usable region of a used block.  ("address 0", i.e. rmm->base
+ * is *not* a valid address for a block, since the header block is
+ * always stored at that address).
+ *
+ * At creation, the RMM region is initialized to hold a single free
+ * block representing the entire available shm segment (minus header
+ * block); subsequent allocation and deallocation of blocks involves
+ * splitting blocks and coalescing physically adjacent free blocks.
+ */
 
 typedef struct rmm_block_t {
+    apr_rmm_off_t prev_phys;
     apr_size_t size;
+    /* Free list links, only valid while the block is free */
     apr_rmm_off_t prev;
     apr_rmm_off_t next;
 } rmm_block_t;
 
+#define RMM_MAGIC        0x524d4d54 /* "RMMT" */
+#define RMM_VERSION      1
+
+#define RMM_ALIGN        APR_ALIGN_DEFAULT(1)
+#define RMM_BLOCK_FREE   ((apr_size_t)1)
+#define RMM_SIZE_MASK    (~(apr_size_t)(RMM_ALIGN - 1))
+
+#define RMM_SL_LOG2      3
+#define RMM_SL_COUNT     (1 << RMM_SL_LOG2)
+#define RMM_ALIGN_LOG2   3
+#define RMM_FL_SHIFT     (RMM_SL_LOG2 + RMM_ALIGN_LOG2)
+#define RMM_SMALL_BLOCK  ((apr_size_t)1 << RMM_FL_SHIFT)
+#if APR_SIZEOF_VOIDP >= 8
+#define RMM_FL_MAX       40
+#else
+#define RMM_FL_MAX       31
+#endif
+#define RMM_FL_COUNT     (RMM_FL_MAX - RMM_FL_SHIFT + 1)
+#define RMM_MAX_BLOCK    (((apr_size_t)1 << RMM_FL_MAX) - 1)
+
 /* Always at our apr_rmm_off(0):
  */
 typedef struct rmm_hdr_block_t {
+    apr_uint32_t magic;
+    apr_uint32_t version;
+    apr_size_t hdrsize;
     apr_size_t abssize;
-    apr_rmm_off_t /* rmm_block_t */ firstused;
-    apr_rmm_off_t /* rmm_block_t */ firstfree;
+    apr_size_t fl_bitmap;
+    apr_uint32_t sl_bitmap[RMM_FL_COUNT];
+    apr_rmm_off_t /* rmm_block_t */ freelist[RMM_FL_COUNT][RMM_SL_COUNT];
 } rmm_hdr_block_t;
 
 #define RMM_HDR_BLOCK_SIZE (APR_ALIGN_DEFAULT(sizeof(rmm_hdr_block_t)))
-#define RMM_BLOCK_SIZE (APR_ALIGN_DEFAULT(sizeof(rmm_block_t)))
+#define RMM_BLOCK_SIZE (APR_ALIGN_DEFAULT(APR_OFFSETOF(rmm_block_t, prev)))
+#define RMM_MIN_BLOCK_SIZE (APR_ALIGN_DEFAULT(sizeof(rmm_block_t)))
+
+#define RMM_BLOCK(rmm, off) ((rmm_block_t*)((char*)(rmm)->base + (off)))
+#define RMM_BLOCK_SIZE_GET(blk) ((blk)->size & RMM_SIZE_MASK)
+#define RMM_BLOCK_IS_FREE(blk) ((blk)->size & RMM_BLOCK_FREE)
 
 struct apr_rmm_t {
     apr_pool_t *p;
@@ -73,141 +116,178 @@ struct apr_rmm_t {
     apr_anylock_t lock;
 };
 
-static apr_rmm_off_t find_block_by_offset(apr_rmm_t *rmm, apr_rmm_off_t next, 
-                                          apr_rmm_off_t find, int includes)
+/* Index of the most significant bit set, or -1 */
+static APR_INLINE int rmm_fls(apr_size_t word)
 {
-    apr_rmm_off_t prev = 0;
-
-    while (next) {
-        struct rmm_block_t *blk = (rmm_block_t*)((char*)rmm->base + next);
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+    return word ? 63 - __builtin_clzll((unsigned long long)word) : -1;
+#else
+    int bit = -1;
+
+    while (word) {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
 
-        if (find == next)
-            return next;
+/* Index of the least significant bit set, or -1 */
+static APR_INLINE int rmm_ffs(apr_size_t word)
+{
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+    return word ? __builtin_ctzll((unsigned long long)word) : -1;
+#else
+    return rmm_fls(word & (~word + 1));
+#endif
+}
 
-        /* Overshot? */
-        if (find < next)
-            return includes ? prev : 0;
+/* Compute the free list a block of the given size is filed under */
+static void mapping_insert(apr_size_t size, int *fl, int *sl)
+{
+    if (size < RMM_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size / (RMM_SMALL_BLOCK / RMM_SL_COUNT));
+    }
+    else {
+        int t = rmm_fls(size);
 
-        prev = next;
-        next = blk->next;
+        *sl = (int)(size >> (t - RMM_SL_LOG2)) ^ RMM_SL_COUNT;
+        *fl = t - (RMM_FL_SHIFT - 1);
     }
-    return includes ? prev : 0;
 }
 
-static apr_rmm_off_t find_block_of_size(apr_rmm_t *rmm, apr_size_t size)
+/* Compute the first free list whose blocks are all at least size bytes */
+static void mapping_search(apr_size_t size, int *fl, int *sl)
 {
-    apr_rmm_off_t next = rmm->base->firstfree;
-    apr_rmm_off_t best = 0;
-    apr_rmm_off_t bestsize = 0;
+    if (size >= RMM_SMALL_BLOCK) {
+        size += ((apr_size_t)1 << (rmm_fls(size) - RMM_SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
 
-    while (next) {
-        struct rmm_block_t *blk = (rmm_block_t*)((char*)rmm->base + next);
+static void remove_free_block(apr_rmm_t *rmm, apr_rmm_off_t this)
+{
+    rmm_block_t *blk = RMM_BLOCK(rmm, this);
+    int fl, sl;
 
-        if (blk->size == size)
-            return next;
+    mapping_insert(RMM_BLOCK_SIZE_GET(blk), &fl, &sl);
 
-        if (blk->size >= size) {
-            /* XXX: sub optimal algorithm 
-             * We need the most thorough best-fit logic, since we can
-             * never grow our rmm, we are SOL when we hit the wall.
-             */
-            if (!bestsize || (blk->size < bestsize)) {
-                bestsize = blk->size;
-                best = next;
+    if (blk->next) {
+        RMM_BLOCK(rmm, blk->next)->prev = blk->prev;
+    }
+    if (blk->prev) {
+        RMM_BLOCK(rmm, blk->prev)->next = blk->next;
+    }
+    else {
+        rmm->base->freelist[fl][sl] = blk->next;
+        if (!blk->next) {
+            rmm->base->sl_bitmap[fl] &= ~(1U << sl);
+            if (!rmm->base->sl_bitmap[fl]) {
+                rmm->base->fl_bitmap &= ~((apr_size_t)1 << fl);
             }
         }
-
-        next = blk->next;
     }
+    blk->size &= ~RMM_BLOCK_FREE;
+    blk->prev = blk->next = 0;
+}
 
-    if (bestsize > RMM_BLOCK_SIZE + size) {
-        struct rmm_block_t *blk = (rmm_block_t*)((char*)rmm->base + best);
-        struct rmm_block_t *new = (rmm_block_t*)((char*)rmm->base + best + size);
-
-        new->size = blk->size - size;
-        new->next = blk->next;
-        new->prev = best;
+static void insert_free_block(apr_rmm_t *rmm, apr_rmm_off_t this)
+{
+    rmm_block_t *blk = RMM_BLOCK(rmm, this);
+    int fl, sl;
 
-        blk->size = size;
-        blk->next = best + size;
+    mapping_insert(RMM_BLOCK_SIZE_GET(blk), &fl, &sl);
 
-        if (new->next) {
-            blk = (rmm_block_t*)((char*)rmm->base + new->next);
-            blk->prev = best + size;
-        }
+    blk->size |= RMM_BLOCK_FREE;
+    blk->prev = 0;
+    blk->next = rmm->base->freelist[fl][sl];
+    if (blk->next) {
+        RMM_BLOCK(rmm, blk->next)->prev = this;
     }
+    rmm->base->freelist[fl][sl] = this;
+    rmm->base->sl_bitmap[fl] |= 1U << sl;
+    rmm->base->fl_bitmap |= (apr_size_t)1 << fl;
+}
 
-    return best;
+/* Address of the block physically following this one, or 0 */
+static APR_INLINE apr_rmm_off_t next_phys_block(apr_rmm_t *rmm,
+                                                apr_rmm_off_t this)
+{
+    apr_rmm_off_t next = this + RMM_BLOCK_SIZE_GET(RMM_BLOCK(rmm, this));
+
+    return next < rmm->base->abssize ? next : 0;
 }
 
-static void move_block(apr_rmm_t *rmm, apr_rmm_off_t this, int free)
-{   
-    struct rmm_block_t *blk = (rmm_block_t*)((char*)rmm->base + this);
+static apr_rmm_off_t find_block_of_size(apr_rmm_t *rmm, apr_size_t size)
+{
+    apr_rmm_off_t best = 0;
+    apr_size_t map;
+    int fl, sl;
 
-    /* close the gap */
-    if (blk->prev) {
-        struct rmm_block_t *prev = (rmm_block_t*)((char*)rmm->base + blk->prev);
-        prev->next = blk->next;
-    }
-    else {
-        if (free) {
-            rmm->base->firstused = blk->next;
-        }
-        else {
-            rmm->base->firstfree = blk->next;
-        }
-    }
-    if (blk->next) {
-        struct rmm_block_t *next = (rmm_block_t*)((char*)rmm->base + blk->next);
-        next->prev = blk->prev;
+    if (size > RMM_MAX_BLOCK) {
+        return 0;
     }
 
-    /* now find it in the other list, pushing it to the head if required */
-    if (free) {
-        blk->prev = find_block_by_offset(rmm, rmm->base->firstfree, this, 1);
-        if (!blk->prev) {
-            blk->next = rmm->base->firstfree;
-            rmm->base->firstfree = this;
+    /* Any block on the lists at or above the rounded up class will do,
+     * and the bitmaps find the first of these without a search.
+     */
+    mapping_search(size, &fl, &sl);
+    if (fl < RMM_FL_COUNT) {
+        map = rmm->base->sl_bitmap[fl] & (~0U << sl);
+        if (!map) {
+            map = rmm->base->fl_bitmap & (~(apr_size_t)0 << (fl + 1));
+            if (map) {
+                fl = rmm_ffs(map);
+                map = rmm->base->sl_bitmap[fl];
+            }
         }
-    }
-    else {
-        blk->prev = find_block_by_offset(rmm, rmm->base->firstused, this, 1);
-        if (!blk->prev) {
-            blk->next = rmm->base->firstused;
-            rmm->base->firstused = this;
+        if (map) {
+            best = rmm->base->freelist[fl][rmm_ffs(map)];
         }
     }
 
-    /* and open it up */
-    if (blk->prev) {
-        struct rmm_block_t *prev = (rmm_block_t*)((char*)rmm->base + blk->prev);
-        if (free && (blk->prev + prev->size == this)) {
-            /* Collapse us into our predecessor */
-            prev->size += blk->size;
-            this = blk->prev;
-            blk = prev;
+    if (!best) {
+        /* Since we can never grow our rmm we are SOL when we hit the
+         * wall, so rather than failing outright, walk the list the
+         * request itself falls into; it may hold a large enough block.
+         */
+        apr_rmm_off_t next;
+
+        mapping_insert(size, &fl, &sl);
+        next = rmm->base->freelist[fl][sl];
+        while (next) {
+            rmm_block_t *blk = RMM_BLOCK(rmm, next);
+
+            if (RMM_BLOCK_SIZE_GET(blk) >= size) {
+                best = next;
+                break;
+            }
+            next = blk->next;
         }
-        else {
-            blk->next = prev->next;
-            prev->next = this;
+        if (!best) {
+            return 0;
         }
     }
 
-    if (blk->next) {
-        struct rmm_block_t *next = (rmm_block_t*)((char*)rmm->base + blk->next);
-        if (free && (this + blk->size == blk->next)) {
-            /* Collapse us into our successor */
-            blk->size += next->size;
-            blk->next = next->next;
-            if (blk->next) {
-                next = (rmm_block_t*)((char*)rmm->base + blk->next);
-                next->prev = this;
-            }
-        }
-        else {
-            next->prev = this;
+    remove_free_block(rmm, best);
+
+    if (RMM_BLOCK_SIZE_GET(RMM_BLOCK(rmm, best)) >= size + RMM_MIN_BLOCK_SIZE) {
+        rmm_block_t *blk = RMM_BLOCK(rmm, best);
+        rmm_block_t *new = RMM_BLOCK(rmm, best + size);
+        apr_rmm_off_t next;
+
+        new->size = RMM_BLOCK_SIZE_GET(blk) - size;
+        new->prev_phys = best;
+        blk->size = size;
+
+        if ((next = next_phys_block(rmm, best + size))) {
+            RMM_BLOCK(rmm, next)->prev_phys = best + size;
         }
+        insert_free_block(rmm, best + size);
     }
+
+    return best;
 }
 
 APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock, 
@@ -215,9 +295,15 @@ APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
                                        apr_pool_t *p)
 {
     apr_status_t rv;
+    rmm_hdr_block_t *hdr = base;
     rmm_block_t *blk;
     apr_anylock_t nulllock;
     
+    if (size < RMM_HDR_BLOCK_SIZE + RMM_MIN_BLOCK_SIZE
+        || size - RMM_HDR_BLOCK_SIZE > RMM_MAX_BLOCK) {
+        return APR_EINVAL;
+    }
+
     if (!lock) {
         nulllock.type = apr_anylock_none;
         nulllock.lock.pm = NULL;
@@ -232,15 +318,16 @@ APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
     (*rmm)->size = size;
     (*rmm)->lock = *lock;
 
-    (*rmm)->base->abssize = size;
-    (*rmm)->base->firstused = 0;
-    (*rmm)->base->firstfree = RMM_HDR_BLOCK_SIZE;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = RMM_MAGIC;
+    hdr->version = RMM_VERSION;
+    hdr->hdrsize = RMM_HDR_BLOCK_SIZE;
+    hdr->abssize = size;
 
-    blk = (rmm_block_t *)((char*)base + (*rmm)->base->firstfree);
-
-    blk->size = size - (*rmm)->base->firstfree;
-    blk->prev = 0;
-    blk->next = 0;
+    blk = RMM_BLOCK(*rmm, RMM_HDR_BLOCK_SIZE);
+    blk->size = size - RMM_HDR_BLOCK_SIZE;
+    blk->prev_phys = 0;
+    insert_free_block(*rmm, RMM_HDR_BLOCK_SIZE);
 
     return APR_ANYLOCK_UNLOCK(lock);
 }
@@ -248,31 +335,12 @@ APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
 APR_DECLARE(apr_status_t) apr_rmm_destroy(apr_rmm_t *rmm)
 {
     apr_status_t rv;
-    rmm_block_t *blk;
 
     if ((rv = APR_ANYLOCK_LOCK(&rmm->lock)) != APR_SUCCESS) {
         return rv;
     }
     /* Blast it all --- no going back :) */
-    if (rmm->base->firstused) {
-        apr_rmm_off_t this = rmm->base->firstused;
-        do {
-            blk = (rmm_block_t *)((char*)rmm->base + this);
-            this = blk->next;
-            blk->next = blk->prev = 0;
-        } while (this);
-        rmm->base->firstused = 0;
-    }
-    if (rmm->base->firstfree) {
-        apr_rmm_off_t this = rmm->base->firstfree;
-        do {
-            blk = (rmm_block_t *)((char*)rmm->base + this);
-            this = blk->next;
-            blk->next = blk->prev = 0;
-        } while (this);
-        rmm->base->firstfree = 0;
-    }
-    rmm->base->abssize = 0;
+    memset(rmm->base, 0, sizeof(*rmm->base));
     rmm->size = 0;
 
     return APR_ANYLOCK_UNLOCK(&rmm->lock);
@@ -281,15 +349,23 @@ APR_DECLARE(apr_status_t) apr_rmm_destroy(apr_rmm_t *rmm)
 APR_DECLARE(apr_status_t) apr_rmm_attach(apr_rmm_t **rmm, apr_anylock_t *lock,
                                          void *base, apr_pool_t *p)
 {
+    rmm_hdr_block_t *hdr = base;
     apr_anylock_t nulllock;
 
+    /* Refuse regions laid out by an incompatible version of this code
+     * (or not initialized by apr_rmm_init at all).
+     */
+    if (hdr->magic != RMM_MAGIC || hdr->version != RMM_VERSION
+        || hdr->hdrsize != RMM_HDR_BLOCK_SIZE) {
+        return APR_EINVAL;
+    }
+
     if (!lock) {
         nulllock.type = apr_anylock_none;
         nulllock.lock.pm = NULL;
         lock = &nulllock;
     }
 
-    /* sanity would be good here */
     (*rmm) = (apr_rmm_t *)apr_pcalloc(p, sizeof(apr_rmm_t));
     (*rmm)->p = p;
     (*rmm)->base = base;
@@ -304,13 +380,22 @@ APR_DECLARE(apr_status_t) apr_rmm_detach(apr_rmm_t *rmm)
     return APR_SUCCESS;
 }
 
+static apr_size_t block_size_for(apr_size_t reqsize)
+{
+    apr_size_t size = APR_ALIGN_DEFAULT(reqsize) + RMM_BLOCK_SIZE;
+
+    if (size < reqsize) {
+        return 0;
+    }
+    return size < RMM_MIN_BLOCK_SIZE ? RMM_MIN_BLOCK_SIZE : size;
+}
+
 APR_DECLARE(apr_rmm_off_t) apr_rmm_malloc(apr_rmm_t *rmm, apr_size_t reqsize)
 {
     apr_size_t size;
     apr_rmm_off_t this;
     
-    size = APR_ALIGN_DEFAULT(reqsize) + RMM_BLOCK_SIZE;
-    if (size < reqsize) {
+    if (!(size = block_size_for(reqsize))) {
         return 0;
     }
 
@@ -319,7 +404,6 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_malloc(apr_rmm_t *rmm, apr_size_t reqsize)
     this = find_block_of_size(rmm, size);
 
     if (this) {
-        move_block(rmm, this, 0);
         this += RMM_BLOCK_SIZE;
     }
 
@@ -332,8 +416,7 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_calloc(apr_rmm_t *rmm, apr_size_t reqsize)
     apr_size_t size;
     apr_rmm_off_t this;
         
-    size = APR_ALIGN_DEFAULT(reqsize) + RMM_BLOCK_SIZE;
-    if (size < reqsize) {
+    if (!(size = block_size_for(reqsize))) {
         return 0;
     }
 
@@ -341,13 +424,13 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_calloc(apr_rmm_t *rmm, apr_size_t reqsize)
 
     this = find_block_of_size(rmm, size);
 
+    APR_ANYLOCK_UNLOCK(&rmm->lock);
+
     if (this) {
-        move_block(rmm, this, 0);
         this += RMM_BLOCK_SIZE;
         memset((char*)rmm->base + this, 0, size - RMM_BLOCK_SIZE);
     }
 
-    APR_ANYLOCK_UNLOCK(&rmm->lock);
     return this;
 }
 
@@ -373,8 +456,8 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_realloc(apr_rmm_t *rmm, void *entity,
         return 0;
     }
 
-    blk = (rmm_block_t*)((char*)rmm->base + old - RMM_BLOCK_SIZE);
-    oldsize = blk->size;
+    blk = RMM_BLOCK(rmm, old - RMM_BLOCK_SIZE);
+    oldsize = RMM_BLOCK_SIZE_GET(blk) - RMM_BLOCK_SIZE;
 
     memcpy(apr_rmm_addr_get(rmm, this),
            apr_rmm_addr_get(rmm, old), oldsize < size ? oldsize : size);
@@ -387,46 +470,61 @@ APR_DECLARE(apr_status_t) apr_rmm_free(apr_rmm_t *rmm, apr_rmm_off_t this)
 {
     apr_status_t rv;
     struct rmm_block_t *blk;
+    apr_rmm_off_t prev, next;
+    apr_size_t size;
 
     /* A little sanity check is always healthy, especially here.
      * If we really cared, we could make this compile-time
      */
-    if (this < RMM_HDR_BLOCK_SIZE + RMM_BLOCK_SIZE) {
+    if (this < RMM_HDR_BLOCK_SIZE + RMM_BLOCK_SIZE
+        || this - RMM_BLOCK_SIZE > rmm->size - RMM_MIN_BLOCK_SIZE) {
         return APR_EINVAL;
     }
 
     this -= RMM_BLOCK_SIZE;
 
-    blk = (rmm_block_t*)((char*)rmm->base + this);
+    blk = RMM_BLOCK(rmm, this);
 
     if ((rv = APR_ANYLOCK_LOCK(&rmm->lock)) != APR_SUCCESS) {
         return rv;
     }
-    if (blk->prev) {
-        struct rmm_block_t *prev = (rmm_block_t*)((char*)rmm->base + blk->prev);
-        if (prev->next != this) {
-            APR_ANYLOCK_UNLOCK(&rmm->lock);
-            return APR_EINVAL;
-        }
-    }
-    else {
-        if (rmm->base->firstused != this) {
-            APR_ANYLOCK_UNLOCK(&rmm->lock);
-            return APR_EINVAL;
-        }
-    }
 
-    if (blk->next) {
-        struct rmm_block_t *next = (rmm_block_t*)((char*)rmm->base + blk->next);
-        if (next->prev != this) {
-            APR_ANYLOCK_UNLOCK(&rmm->lock);
-            return APR_EINVAL;
-        }
+    /* The block must be in use, and its boundary tags must agree with
+     * those of its physical neighbours.
+     */
+    size = RMM_BLOCK_SIZE_GET(blk);
+    prev = blk->prev_phys;
+    if (RMM_BLOCK_IS_FREE(blk) || size < RMM_MIN_BLOCK_SIZE
+        || size > rmm->base->abssize - this
+        || (prev && (prev >= this
+                     || prev + RMM_BLOCK_SIZE_GET(RMM_BLOCK(rmm, prev))
+                        != this))) {
+        APR_ANYLOCK_UNLOCK(&rmm->lock);
+        return APR_EINVAL;
+    }
+    next = next_phys_block(rmm, this);
+    if (next && RMM_BLOCK(rmm, next)->prev_phys != this) {
+        APR_ANYLOCK_UNLOCK(&rmm->lock);
+        return APR_EINVAL;
     }
 
-    /* Ok, it remained [apparently] sane, so unlink it
+    /* Ok, it remained [apparently] sane, so coalesce it with any free
+     * neighbours and put it back on the free lists.
      */
-    move_block(rmm, this, 1);
+    if (prev && RMM_BLOCK_IS_FREE(RMM_BLOCK(rmm, prev))) {
+        remove_free_block(rmm, prev);
+        RMM_BLOCK(rmm, prev)->size += size;
+        this = prev;
+        blk = RMM_BLOCK(rmm, this);
+    }
+    if (next && RMM_BLOCK_IS_FREE(RMM_BLOCK(rmm, next))) {
+        remove_free_block(rmm, next);
+        blk->size += RMM_BLOCK_SIZE_GET(RMM_BLOCK(rmm, next));
+    }
+    if ((next = next_phys_block(rmm, this))) {
+        RMM_BLOCK(rmm, next)->prev_phys = this;
+    }
+    insert_free_block(rmm, this);
     
     return APR_ANYLOCK_UNLOCK(&rmm->lock);
 }
@@ -450,8 +548,9 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_offset_get(apr_rmm_t *rmm, void* entity)
 
 APR_DECLARE(apr_size_t) apr_rmm_overhead_get(int n) 
 {
-    /* overhead per block is at most APR_ALIGN_DEFAULT(1) wasted bytes
-     * for alignment overhead, plus the size of the rmm_block_t
-     * structure. */
-    return RMM_HDR_BLOCK_SIZE + n * (RMM_BLOCK_SIZE + APR_ALIGN_DEFAULT(1));
+    /* overhead per block is at most the minimum block size; that is
+     * the rmm_block_t header plus APR_ALIGN_DEFAULT(1) wasted bytes for
+     * alignment, or the free list links tiny allocations are padded
+     * out to hold. */
+    return RMM_HDR_BLOCK_SIZE + n * RMM_MIN_BLOCK_SIZE;
 }
@@ -0,0 +1,463 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_general.h"
+#include "apr_shm_hash.h"
+#include "apr_atomic.h"
+#include "apr_errno.h"
+#include "apr_hash.h"
+#include "apr_lib.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+
+/* The table is an array of fixed size slots, following a header block
+ * stored at the base of the memory region.  Nothing in the region is a
+ * pointer, so it may be mapped at any address.
+ *
+ * Keys are placed by linear probing within a window of at most
+ * SHM_HASH_MAX_PROBE slots from their home slot, so that neither
+ * lookups nor insertions ever scan more than a bounded number of
+ * slots.  Removed entries leave a DELETED tombstone behind, unless
+ * the following slot is EMPTY, in which case the tombstones before
+ * it are reclaimed as EMPTY too.  Entries never move once stored.
+ *
+ * Each slot carries a sequence number which writers make odd while
+ * they modify the slot and even again when done.  Readers copy the
+ * slot out and retry if the sequence was odd or changed meanwhile,
+ * so they never write to the shared memory nor wait on a lock.
+ * Writers serialize on the apr_anylock_t given at creation.
+ */
+
+#define SHM_HASH_MAGIC     0x53484854 /* "SHHT" */
+#define SHM_HASH_VERSION   1
+
+#define SHM_HASH_MAX_PROBE 32
+
+/* How many times a reader waits for a writer to finish with a slot,
+ * spinning the first times then yielding, before it gives up.
+ */
+#define SHM_HASH_READ_SPINS 100
+#define SHM_HASH_READ_TRIES 100000
+
+#define SLOT_EMPTY         0
+#define SLOT_USED          1
+#define SLOT_DELETED       2
+
+typedef struct shm_hash_slot_t {
+    volatile apr_uint32_t seq;
+    apr_uint32_t state;
+    apr_uint32_t hash;
+    apr_uint32_t stamp;
+    apr_uint32_t klen;
+    apr_uint32_t vlen;
+    /* key_max bytes of key, then val_max bytes of value */
+} shm_hash_slot_t;
+
+/* Always at offset 0 of the region:
+ */
+typedef struct shm_hash_hdr_t {
+    apr_uint32_t magic;
+    apr_uint32_t version;
+    apr_size_t hdrsize;
+    apr_size_t slotsize;
+    apr_size_t nslots;
+    apr_size_t key_max;
+    apr_size_t val_max;
+    volatile apr_uint32_t count;
+    apr_uint32_t stamp;
+} shm_hash_hdr_t;
+
+#define SHM_HASH_HDR_SIZE (APR_ALIGN_DEFAULT(sizeof(shm_hash_hdr_t)))
+#define SHM_HASH_SLOT_HDR_SIZE (APR_ALIGN_DEFAULT(sizeof(shm_hash_slot_t)))
+#define SHM_HASH_SLOT_SIZE(kmax, vmax) \
+    (APR_ALIGN_DEFAULT(SHM_HASH_SLOT_HDR_SIZE + (kmax) + (vmax)))
+
+/* Readers need their loads of a slot ordered against the loads of its
+ * sequence number, without the cost (and cache line ping-pong) of an
+ * atomic read-modify-write.
+ */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define SHM_HASH_READ_BARRIER() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define SHM_HASH_READ_BARRIER() __sync_synchronize()
+#else
+#define SHM_HASH_READ_BARRIER() apr_atomic_cas32(&shm_hash_fence, 0, 0)
+static apr_uint32_t shm_hash_fence;
+#endif
+
+struct apr_shm_hash_t {
+    apr_pool_t *pool;
+    shm_hash_hdr_t *base;
+    char *slots;
+    apr_anylock_t lock;
+    apr_shm_hash_evict_fn_t *evict;
+    void *evict_ctx;
+};
+
+#define SLOT_AT(ht, i) \
+    ((shm_hash_slot_t *)((ht)->slots + (i) * (ht)->base->slotsize))
+#define SLOT_KEY(s) ((char *)(s) + SHM_HASH_SLOT_HDR_SIZE)
+#define SLOT_VAL(ht, s) (SLOT_KEY(s) + (ht)->base->key_max)
+
+static apr_uint32_t shm_hash_key(const void *key, apr_size_t klen)
+{
+    apr_ssize_t len = klen;
+    apr_uint32_t h = apr_hashfunc_default(key, &len);
+
+    /* Spread the bits, the times-33 hash is weak in its low bits which
+     * is all we use to pick a home slot.
+     */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Wait a little for a writer to finish with a slot; a writer which died
+ * in the middle of its update must not hang the readers forever.
+ */
+static apr_status_t slot_read_backoff(int *tries)
+{
+    if (++*tries > SHM_HASH_READ_TRIES) {
+        return APR_EBUSY;
+    }
+    if (*tries <= SHM_HASH_READ_SPINS) {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __asm__ __volatile__ ("pause" : : : "memory");
+#elif defined(__GNUC__) && defined(__aarch64__)
+        __asm__ __volatile__ ("yield" : : : "memory");
+#endif
+    }
+    else {
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#else
+        apr_sleep(0);
+#endif
+    }
+    return APR_SUCCESS;
+}
+
+static APR_INLINE void slot_write_begin(shm_hash_slot_t *s)
+{
+    apr_atomic_inc32(&s->seq);
+}
+
+static APR_INLINE void slot_write_end(shm_hash_slot_t *s)
+{
+    apr_atomic_inc32(&s->seq);
+}
+
+APR_DECLARE(apr_size_t) apr_shm_hash_size_get(apr_size_t nslots,
+                                              apr_size_t key_max,
+                                              apr_size_t val_max)
+{
+    return SHM_HASH_HDR_SIZE + nslots * SHM_HASH_SLOT_SIZE(key_max, val_max);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_init(apr_shm_hash_t **ht,
+                                            apr_anylock_t *lock,
+                                            void *membuf, apr_size_t memsize,
+                                            apr_size_t key_max,
+                                            apr_size_t val_max,
+                                            apr_pool_t *pool)
+{
+    shm_hash_hdr_t *hdr = membuf;
+    apr_size_t slotsize, nslots;
+    apr_anylock_t nulllock;
+    apr_status_t rv;
+
+    if (!key_max || key_max > APR_UINT32_MAX || val_max > APR_UINT32_MAX) {
+        return APR_EINVAL;
+    }
+    slotsize = SHM_HASH_SLOT_SIZE(key_max, val_max);
+    if (memsize < SHM_HASH_HDR_SIZE + slotsize) {
+        return APR_EINVAL;
+    }
+    nslots = (memsize - SHM_HASH_HDR_SIZE) / slotsize;
+
+    if (!lock) {
+        nulllock.type = apr_anylock_none;
+        nulllock.lock.pm = NULL;
+        lock = &nulllock;
+    }
+    if ((rv = APR_ANYLOCK_LOCK(lock)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    memset(membuf, 0, SHM_HASH_HDR_SIZE + nslots * slotsize);
+    hdr->magic = SHM_HASH_MAGIC;
+    hdr->version = SHM_HASH_VERSION;
+    hdr->hdrsize = SHM_HASH_HDR_SIZE;
+    hdr->slotsize = slotsize;
+    hdr->nslots = nslots;
+    hdr->key_max = key_max;
+    hdr->val_max = val_max;
+
+    *ht = apr_pcalloc(pool, sizeof(apr_shm_hash_t));
+    (*ht)->pool = pool;
+    (*ht)->base = hdr;
+    (*ht)->slots = (char *)membuf + SHM_HASH_HDR_SIZE;
+    (*ht)->lock = *lock;
+
+    return APR_ANYLOCK_UNLOCK(lock);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_attach(apr_shm_hash_t **ht,
+                                              apr_anylock_t *lock,
+                                              void *membuf,
+                                              apr_pool_t *pool)
+{
+    shm_hash_hdr_t *hdr = membuf;
+    apr_anylock_t nulllock;
+
+    if (hdr->magic != SHM_HASH_MAGIC || hdr->version != SHM_HASH_VERSION
+        || hdr->hdrsize != SHM_HASH_HDR_SIZE
+        || hdr->slotsize != SHM_HASH_SLOT_SIZE(hdr->key_max, hdr->val_max)) {
+        return APR_EINVAL;
+    }
+
+    if (!lock) {
+        nulllock.type = apr_anylock_none;
+        nulllock.lock.pm = NULL;
+        lock = &nulllock;
+    }
+
+    *ht = apr_pcalloc(pool, sizeof(apr_shm_hash_t));
+    (*ht)->pool = pool;
+    (*ht)->base = hdr;
+    (*ht)->slots = (char *)membuf + SHM_HASH_HDR_SIZE;
+    (*ht)->lock = *lock;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_shm_hash_evict_hook_set(apr_shm_hash_t *ht,
+                                              apr_shm_hash_evict_fn_t *evict,
+                                              void *ctx)
+{
+    ht->evict = evict;
+    ht->evict_ctx = ctx;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_get(apr_shm_hash_t *ht,
+                                           const void *key, apr_size_t klen,
+                                           void *val, apr_size_t *vlen)
+{
+    apr_uint32_t hash = shm_hash_key(key, klen);
+    apr_size_t nslots = ht->base->nslots;
+    apr_size_t key_max = ht->base->key_max;
+    apr_size_t val_max = ht->base->val_max;
+    apr_size_t idx = hash % nslots;
+    apr_size_t i;
+
+    for (i = 0; i < SHM_HASH_MAX_PROBE && i < nslots; i++) {
+        shm_hash_slot_t *s = SLOT_AT(ht, idx);
+        apr_uint32_t seq, state;
+        apr_size_t len;
+        int found, tries = 0;
+
+        for (;;) {
+            while ((seq = s->seq) & 1) {
+                /* writer in progress */
+                if (slot_read_backoff(&tries) != APR_SUCCESS) {
+                    return APR_EBUSY;
+                }
+            }
+            SHM_HASH_READ_BARRIER();
+
+            found = 0;
+            len = 0;
+            state = s->state;
+            if (state == SLOT_USED && s->hash == hash && s->klen == klen
+                && klen <= key_max && !memcmp(SLOT_KEY(s), key, klen)) {
+                len = s->vlen;
+                if (len > val_max) {
+                    len = val_max;
+                }
+                if (len <= *vlen) {
+                    memcpy(val, SLOT_VAL(ht, s), len);
+                }
+                found = 1;
+            }
+
+            SHM_HASH_READ_BARRIER();
+            if (s->seq == seq) {
+                break;
+            }
+            if (slot_read_backoff(&tries) != APR_SUCCESS) {
+                return APR_EBUSY;
+            }
+        }
+
+        if (found) {
+            apr_size_t bufsize = *vlen;
+
+            *vlen = len;
+            return len <= bufsize ? APR_SUCCESS : APR_ENOSPC;
+        }
+        if (state == SLOT_EMPTY) {
+            break;
+        }
+        if (++idx == nslots) {
+            idx = 0;
+        }
+    }
+
+    return APR_NOTFOUND;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_set(apr_shm_hash_t *ht,
+                                           const void *key, apr_size_t klen,
+                                           const void *val, apr_size_t vlen)
+{
+    shm_hash_hdr_t *hdr = ht->base;
+    apr_uint32_t hash = shm_hash_key(key, klen);
+    shm_hash_slot_t *s, *slot = NULL, *victim = NULL;
+    apr_size_t idx = hash % hdr->nslots;
+    apr_size_t i;
+    apr_status_t rv;
+
+    if (!klen || klen > hdr->key_max || vlen > hdr->val_max) {
+        return APR_EINVAL;
+    }
+
+    if ((rv = APR_ANYLOCK_LOCK(&ht->lock)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < SHM_HASH_MAX_PROBE && i < hdr->nslots; i++) {
+        s = SLOT_AT(ht, idx);
+
+        if (s->state == SLOT_USED) {
+            if (s->hash == hash && s->klen == klen
+                && !memcmp(SLOT_KEY(s), key, klen)) {
+                /* Replace the value in place */
+                slot_write_begin(s);
+                memcpy(SLOT_VAL(ht, s), val, vlen);
+                s->vlen = (apr_uint32_t)vlen;
+                s->stamp = hdr->stamp++;
+                slot_write_end(s);
+                return APR_ANYLOCK_UNLOCK(&ht->lock);
+            }
+            if (!victim || (apr_int32_t)(s->stamp - victim->stamp) < 0) {
+                victim = s;
+            }
+        }
+        else if (!slot) {
+            slot = s;
+        }
+        if (s->state == SLOT_EMPTY) {
+            break;
+        }
+        if (++idx == hdr->nslots) {
+            idx = 0;
+        }
+    }
+
+    if (slot) {
+        apr_atomic_inc32(&hdr->count);
+    }
+    else if (victim && ht->evict
+             && ht->evict(ht->evict_ctx, SLOT_KEY(victim), victim->klen,
+                          SLOT_VAL(ht, victim), victim->vlen)) {
+        slot = victim;
+    }
+    else {
+        APR_ANYLOCK_UNLOCK(&ht->lock);
+        return APR_ENOSPC;
+    }
+
+    slot_write_begin(slot);
+    slot->state = SLOT_USED;
+    slot->hash = hash;
+    slot->klen = (apr_uint32_t)klen;
+    slot->vlen = (apr_uint32_t)vlen;
+    slot->stamp = hdr->stamp++;
+    memcpy(SLOT_KEY(slot), key, klen);
+    memcpy(SLOT_VAL(ht, slot), val, vlen);
+    slot_write_end(slot);
+
+    return APR_ANYLOCK_UNLOCK(&ht->lock);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_remove(apr_shm_hash_t *ht,
+                                              const void *key,
+                                              apr_size_t klen)
+{
+    shm_hash_hdr_t *hdr = ht->base;
+    apr_uint32_t hash = shm_hash_key(key, klen);
+    apr_size_t idx = hash % hdr->nslots;
+    apr_size_t i;
+    apr_status_t rv;
+
+    if ((rv = APR_ANYLOCK_LOCK(&ht->lock)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < SHM_HASH_MAX_PROBE && i < hdr->nslots; i++) {
+        shm_hash_slot_t *s = SLOT_AT(ht, idx);
+
+        if (s->state == SLOT_EMPTY) {
+            break;
+        }
+        if (s->state == SLOT_USED && s->hash == hash && s->klen == klen
+            && !memcmp(SLOT_KEY(s), key, klen)) {
+            apr_size_t next = idx + 1 == hdr->nslots ? 0 : idx + 1;
+
+            /* No key can live past an EMPTY slot, so if the next one is
+             * EMPTY this slot and any tombstones before it can be too.
+             */
+            if (SLOT_AT(ht, next)->state == SLOT_EMPTY) {
+                do {
+                    slot_write_begin(s);
+                    s->state = SLOT_EMPTY;
+                    slot_write_end(s);
+
+                    idx = idx ? idx - 1 : hdr->nslots - 1;
+                    s = SLOT_AT(ht, idx);
+                } while (s->state == SLOT_DELETED);
+            }
+            else {
+                slot_write_begin(s);
+                s->state = SLOT_DELETED;
+                slot_write_end(s);
+            }
+            apr_atomic_dec32(&hdr->count);
+
+            return APR_ANYLOCK_UNLOCK(&ht->lock);
+        }
+        if (++idx == hdr->nslots) {
+            idx = 0;
+        }
+    }
+
+    APR_ANYLOCK_UNLOCK(&ht->lock);
+    return APR_NOTFOUND;
+}
+
+APR_DECLARE(apr_size_t) apr_shm_hash_count(apr_shm_hash_t *ht)
+{
+    return apr_atomic_read32(&ht->base->count);
+}
+
+APR_DECLARE(apr_size_t) apr_shm_hash_capacity(apr_shm_hash_t *ht)
+{
+    return ht->base->nslots;
+}
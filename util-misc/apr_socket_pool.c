@@ -0,0 +1,404 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_socket_pool.h"
+#include "apr_allocator.h"
+#include "apr_hash.h"
+#include "apr_poll.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_rwlock.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+/* The key of the pooled sockets' data */
+#define SOCKET_POOL_KEY "apr_socket_pool"
+
+/* The longest key of an address: its family, port and IPv6 address */
+#define ADDR_KEY_MAX (sizeof(apr_int32_t) + sizeof(apr_port_t) + 16)
+
+typedef struct sp_host_t sp_host_t;
+
+/* A connection, allocated from a pool of its own */
+typedef struct sp_conn_t {
+    apr_pool_t *pool;
+    apr_socket_t *sock;
+    apr_socket_pool_t *spool;
+    sp_host_t *host;
+    apr_time_t released;
+} sp_conn_t;
+
+/* The connections to an address */
+struct sp_host_t {
+    sp_host_t *next;
+    apr_sockaddr_t *sa;
+    char key[ADDR_KEY_MAX];
+    apr_size_t klen;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+    /* The idle connections, the one released last on top */
+    sp_conn_t **idle;
+    apr_uint32_t nidle;
+    /* The connections acquired or idle */
+    apr_uint32_t nconns;
+    /* Idle connections handed out again, dead ones included */
+    apr_uint64_t popped;
+    apr_uint64_t connected;
+    apr_uint64_t refused;
+    apr_uint64_t expired;
+    apr_uint64_t dead;
+};
+
+struct apr_socket_pool_t {
+    apr_pool_t *pool;
+    apr_uint32_t max;
+    apr_uint32_t max_idle;
+    apr_interval_time_t ttl;
+    apr_interval_time_t timeout;
+    apr_hash_t *hosts;
+    sp_host_t *host_list;
+#if APR_HAS_THREADS
+    apr_thread_rwlock_t *hosts_lock;
+#endif
+};
+
+#if APR_HAS_THREADS
+#define host_lock(h)        apr_thread_mutex_lock((h)->lock)
+#define host_unlock(h)      apr_thread_mutex_unlock((h)->lock)
+#define hosts_rdlock(sp)    apr_thread_rwlock_rdlock((sp)->hosts_lock)
+#define hosts_wrlock(sp)    apr_thread_rwlock_wrlock((sp)->hosts_lock)
+#define hosts_unlock(sp)    apr_thread_rwlock_unlock((sp)->hosts_lock)
+#else
+#define host_lock(h)
+#define host_unlock(h)
+#define hosts_rdlock(sp)
+#define hosts_wrlock(sp)
+#define hosts_unlock(sp)
+#endif
+
+APR_DECLARE(apr_status_t) apr_socket_pool_create(apr_socket_pool_t **spool,
+                                                 apr_uint32_t max,
+                                                 apr_uint32_t max_idle,
+                                                 apr_interval_time_t ttl,
+                                                 apr_interval_time_t timeout,
+                                                 apr_pool_t *p)
+{
+    apr_socket_pool_t *sp;
+    apr_allocator_t *allocator;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    /* The connections have pools of their own, created and destroyed by
+     * any thread: give them an allocator with a mutex.
+     */
+    if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_pool_create_ex(&pool, p, NULL, allocator))
+            != APR_SUCCESS) {
+        apr_allocator_destroy(allocator);
+        return rv;
+    }
+    apr_allocator_owner_set(allocator, pool);
+    apr_pool_tag(pool, "apr_socket_pool");
+#if APR_HAS_THREADS
+    {
+        apr_thread_mutex_t *mutex;
+
+        rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT, pool);
+        if (rv != APR_SUCCESS) {
+            apr_pool_destroy(pool);
+            return rv;
+        }
+        apr_allocator_mutex_set(allocator, mutex);
+    }
+#endif
+
+    sp = apr_pcalloc(pool, sizeof(*sp));
+    sp->pool = pool;
+    sp->max = max;
+    sp->max_idle = max_idle;
+    sp->ttl = ttl;
+    sp->timeout = timeout;
+    sp->hosts = apr_hash_make(pool);
+#if APR_HAS_THREADS
+    rv = apr_thread_rwlock_create(&sp->hosts_lock, pool);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return rv;
+    }
+#endif
+
+    *spool = sp;
+    return APR_SUCCESS;
+}
+
+static apr_size_t addr_key(const apr_sockaddr_t *sa, char *key)
+{
+    apr_int32_t family = sa->family;
+    apr_size_t len = sa->ipaddr_len < 16 ? sa->ipaddr_len : 16;
+
+    memcpy(key, &family, sizeof(family));
+    memcpy(key + sizeof(family), &sa->port, sizeof(sa->port));
+    memcpy(key + sizeof(family) + sizeof(sa->port), sa->ipaddr_ptr, len);
+    return sizeof(family) + sizeof(sa->port) + len;
+}
+
+/* Find the connections to sa, or set them up */
+static apr_status_t host_get(sp_host_t **host, apr_socket_pool_t *spool,
+                             const apr_sockaddr_t *sa)
+{
+    char key[ADDR_KEY_MAX];
+    apr_size_t klen = addr_key(sa, key);
+    apr_status_t rv = APR_SUCCESS;
+    sp_host_t *h;
+
+    hosts_rdlock(spool);
+    h = apr_hash_get(spool->hosts, key, klen);
+    hosts_unlock(spool);
+    if (h) {
+        *host = h;
+        return APR_SUCCESS;
+    }
+
+    hosts_wrlock(spool);
+    /* another thread may have been first */
+    h = apr_hash_get(spool->hosts, key, klen);
+    if (!h) {
+        h = apr_pcalloc(spool->pool, sizeof(*h));
+        memcpy(h->key, key, klen);
+        h->klen = klen;
+        h->idle = apr_palloc(spool->pool,
+                             (spool->max_idle ? spool->max_idle : 1)
+                             * sizeof(*h->idle));
+        /* the address must live as long as the connections to it */
+        rv = apr_sockaddr_info_copy(&h->sa, sa, spool->pool);
+#if APR_HAS_THREADS
+        if (rv == APR_SUCCESS) {
+            rv = apr_thread_mutex_create(&h->lock, APR_THREAD_MUTEX_DEFAULT,
+                                         spool->pool);
+        }
+#endif
+        if (rv == APR_SUCCESS) {
+            apr_hash_set(spool->hosts, h->key, h->klen, h);
+            h->next = spool->host_list;
+            spool->host_list = h;
+        }
+    }
+    hosts_unlock(spool);
+
+    *host = h;
+    return rv;
+}
+
+static apr_status_t conn_open(sp_conn_t **conn, apr_socket_pool_t *spool,
+                              sp_host_t *host)
+{
+    apr_pool_t *p;
+    sp_conn_t *c;
+    apr_status_t rv;
+
+    if ((rv = apr_pool_create(&p, spool->pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    c = apr_palloc(p, sizeof(*c));
+    c->pool = p;
+    c->spool = spool;
+    c->host = host;
+
+    rv = apr_socket_create(&c->sock, host->sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_timeout_set(c->sock, spool->timeout);
+    }
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_connect(c->sock, host->sa);
+        if (spool->timeout == 0 && APR_STATUS_IS_EINPROGRESS(rv)) {
+            /* the caller waits for the socket to be writable */
+            rv = APR_SUCCESS;
+        }
+    }
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_data_set(c->sock, c, SOCKET_POOL_KEY, NULL);
+    }
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(p);
+        return rv;
+    }
+
+    *conn = c;
+    return APR_SUCCESS;
+}
+
+/* Closes the socket, with the pool it was created from */
+static void conn_close(sp_conn_t *conn)
+{
+    apr_pool_destroy(conn->pool);
+}
+
+/* An idle connection has nothing to read, unless the peer closed it or
+ * broke the protocol; both are reasons not to reuse it.
+ */
+static int conn_alive(sp_conn_t *conn)
+{
+    apr_pollfd_t pfd;
+    apr_int32_t n = 0;
+    apr_status_t rv;
+
+    pfd.p = conn->pool;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.rtnevents = 0;
+    pfd.desc.s = conn->sock;
+    pfd.client_data = NULL;
+
+    rv = apr_poll(&pfd, 1, &n, 0);
+    return APR_STATUS_IS_TIMEUP(rv) || (rv == APR_SUCCESS && n == 0);
+}
+
+APR_DECLARE(apr_status_t) apr_socket_pool_acquire(apr_socket_t **sock,
+                                                  apr_socket_pool_t *spool,
+                                                  apr_sockaddr_t *sa)
+{
+    apr_time_t now = spool->ttl ? apr_time_now() : 0;
+    sp_host_t *host;
+    sp_conn_t *conn;
+    apr_status_t rv;
+
+    if ((rv = host_get(&host, spool, sa)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    host_lock(host);
+    while (host->nidle) {
+        int expired;
+
+        conn = host->idle[--host->nidle];
+        expired = spool->ttl && now - conn->released > spool->ttl;
+        if (!expired) {
+            host->popped++;
+        }
+        host_unlock(host);
+
+        if (!expired && conn_alive(conn)) {
+            apr_socket_timeout_set(conn->sock, spool->timeout);
+            *sock = conn->sock;
+            return APR_SUCCESS;
+        }
+        conn_close(conn);
+
+        host_lock(host);
+        host->nconns--;
+        if (expired) {
+            host->expired++;
+        }
+        else {
+            host->dead++;
+        }
+    }
+    if (spool->max && host->nconns >= spool->max) {
+        host->refused++;
+        host_unlock(host);
+        return APR_EAGAIN;
+    }
+    /* count the connection in now, for the limit */
+    host->nconns++;
+    host->connected++;
+    host_unlock(host);
+
+    if ((rv = conn_open(&conn, spool, host)) != APR_SUCCESS) {
+        host_lock(host);
+        host->nconns--;
+        host->connected--;
+        host_unlock(host);
+        return rv;
+    }
+
+    *sock = conn->sock;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_pool_release(apr_socket_pool_t *spool,
+                                                  apr_socket_t *sock,
+                                                  int reuse)
+{
+    sp_conn_t *conn = NULL, *evicted = NULL;
+    sp_host_t *host;
+
+    apr_socket_data_get((void **)&conn, SOCKET_POOL_KEY, sock);
+    if (!conn || conn->spool != spool) {
+        return APR_EINVAL;
+    }
+    host = conn->host;
+
+    if (reuse && spool->max_idle) {
+        conn->released = apr_time_now();
+
+        host_lock(host);
+        /* Make room, or close the oldest connection if it expired; one
+         * at a time, the next releases take care of the others.
+         */
+        if (host->nidle == spool->max_idle
+            || (host->nidle && spool->ttl
+                && conn->released - host->idle[0]->released > spool->ttl)) {
+            evicted = host->idle[0];
+            host->nidle--;
+            memmove(host->idle, host->idle + 1,
+                    host->nidle * sizeof(*host->idle));
+            host->nconns--;
+            host->expired++;
+        }
+        host->idle[host->nidle++] = conn;
+        host_unlock(host);
+
+        if (evicted) {
+            conn_close(evicted);
+        }
+        return APR_SUCCESS;
+    }
+
+    conn_close(conn);
+
+    host_lock(host);
+    host->nconns--;
+    host_unlock(host);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_socket_pool_stats_get(apr_socket_pool_t *spool,
+                                            apr_socket_pool_stats_t *stats)
+{
+    sp_host_t *h;
+
+    memset(stats, 0, sizeof(*stats));
+
+    hosts_rdlock(spool);
+    for (h = spool->host_list; h; h = h->next) {
+        host_lock(h);
+        stats->reused += h->popped - h->dead;
+        stats->connected += h->connected;
+        stats->refused += h->refused;
+        stats->expired += h->expired;
+        stats->dead += h->dead;
+        stats->active += h->nconns - h->nidle;
+        stats->idle += h->nidle;
+        host_unlock(h);
+        stats->addresses++;
+    }
+    hosts_unlock(spool);
+}